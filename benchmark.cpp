@@ -0,0 +1,606 @@
+#include "benchmark.h"
+#include "bvh.h"
+#include "debugdraw.h"
+#include "frameuniforms.h"
+#include "instances.h"
+#include "scenegraph.h"
+#include "shadercache.h"
+#include "shaderlibrary.h"
+#include "textureatlas.h"
+#include "texturecache.h"
+#include "texturestreamer.h"
+#include "virtualtexture.h"
+
+#include <algorithm>
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CCameraPath::CCameraPath()
+{
+	Events = NULL;
+	EventsCount = MaxEventsCount = 0;
+
+	Recording = false;
+	RecordFrame = 0;
+}
+
+CCameraPath::~CCameraPath()
+{
+	Destroy();
+}
+
+void CCameraPath::AddEvent(int FirstFrame, int LastFrame, int Type, float v0, float v1, float v2, float v3, float v4, float v5)
+{
+	if(EventsCount == MaxEventsCount)
+	{
+		MaxEventsCount = MaxEventsCount > 0 ? MaxEventsCount * 2 : 64;
+
+		CCameraPathEvent *NewEvents = new CCameraPathEvent[MaxEventsCount];
+
+		if(EventsCount > 0)
+		{
+			memcpy(NewEvents, Events, sizeof(CCameraPathEvent) * EventsCount);
+		}
+
+		delete [] Events;
+
+		Events = NewEvents;
+	}
+
+	CCameraPathEvent &Event = Events[EventsCount++];
+
+	Event.FirstFrame = FirstFrame;
+	Event.LastFrame = LastFrame;
+	Event.Type = Type;
+	Event.Values[0] = v0; Event.Values[1] = v1; Event.Values[2] = v2;
+	Event.Values[3] = v3; Event.Values[4] = v4; Event.Values[5] = v5;
+}
+
+void CCameraPath::Apply(int Frame)
+{
+	for(int i = 0; i < EventsCount; i++)
+	{
+		CCameraPathEvent &Event = Events[i];
+
+		if(Frame < Event.FirstFrame || Frame > Event.LastFrame) continue;
+
+		float *v = Event.Values;
+
+		switch(Event.Type)
+		{
+			case CAMERA_PATH_LOOK_AT:
+				Camera.LookAt(vec3(v[0], v[1], v[2]), vec3(v[3], v[4], v[5]), true);
+				break;
+
+			case CAMERA_PATH_MOVE:
+				Camera.Move(vec3(v[0], v[1], v[2]));
+				break;
+
+			case CAMERA_PATH_MOUSE_MOVE:
+				Camera.OnMouseMove((int)v[0], (int)v[1]);
+				break;
+
+			case CAMERA_PATH_MOUSE_WHEEL:
+				Camera.OnMouseWheel((short)v[0]);
+				break;
+		}
+	}
+}
+
+void CCameraPath::CreateOrbit(int Frames)
+{
+	Destroy();
+
+	AddEvent(0, 0, CAMERA_PATH_LOOK_AT, 0.0f, 0.0f, 0.0f, 1.75f, 1.75f, 5.0f);
+	AddEvent(1, Frames - 1, CAMERA_PATH_MOUSE_MOVE, 2.0f, 0.0f);
+	AddEvent(Frames / 4, Frames / 4 + 15, CAMERA_PATH_MOUSE_WHEEL, -120.0f);
+	AddEvent(Frames / 2, Frames / 2 + 15, CAMERA_PATH_MOUSE_WHEEL, 120.0f);
+}
+
+void CCameraPath::Destroy()
+{
+	delete [] Events;
+	Events = NULL;
+	EventsCount = MaxEventsCount = 0;
+}
+
+bool CCameraPath::Load(char *FileName)
+{
+	FILE *File;
+
+	if(fopen_s(&File, FileName, "rt") != 0)
+	{
+		ErrorLog.Append("Error loading file %s!\r\n", FileName);
+		return false;
+	}
+
+	Destroy();
+
+	char Line[256], Command[32];
+	int LineNumber = 0;
+	bool Error = false;
+
+	while(fgets(Line, 256, File) != NULL)
+	{
+		LineNumber++;
+
+		if(Line[0] == '#' || Line[0] == '\r' || Line[0] == '\n') continue;
+
+		int FirstFrame, LastFrame, Read;
+		float v[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+		if(sscanf(Line, "%d-%d %31s%n", &FirstFrame, &LastFrame, Command, &Read) != 3)
+		{
+			if(sscanf(Line, "%d %31s%n", &FirstFrame, Command, &Read) != 2)
+			{
+				ErrorLog.Append("Error parsing file %s, line %d!\r\n", FileName, LineNumber);
+				Error = true;
+				break;
+			}
+
+			LastFrame = FirstFrame;
+		}
+
+		int ValuesCount = sscanf(Line + Read, "%f %f %f %f %f %f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+		int Type = -1, RequiredValuesCount = 0;
+
+		if(strcmp(Command, "lookat") == 0) { Type = CAMERA_PATH_LOOK_AT; RequiredValuesCount = 6; }
+		if(strcmp(Command, "move") == 0) { Type = CAMERA_PATH_MOVE; RequiredValuesCount = 3; }
+		if(strcmp(Command, "mousemove") == 0) { Type = CAMERA_PATH_MOUSE_MOVE; RequiredValuesCount = 2; }
+		if(strcmp(Command, "mousewheel") == 0) { Type = CAMERA_PATH_MOUSE_WHEEL; RequiredValuesCount = 1; }
+
+		if(Type == -1 || ValuesCount < RequiredValuesCount)
+		{
+			ErrorLog.Append("Error parsing file %s, line %d!\r\n", FileName, LineNumber);
+			Error = true;
+			break;
+		}
+
+		AddEvent(FirstFrame, LastFrame, Type, v[0], v[1], v[2], v[3], v[4], v[5]);
+	}
+
+	fclose(File);
+
+	return !Error;
+}
+
+bool CCameraPath::Save(char *FileName)
+{
+	FILE *File;
+
+	if(fopen_s(&File, FileName, "wt") != 0)
+	{
+		ErrorLog.Append("Error saving file %s!\r\n", FileName);
+		return false;
+	}
+
+	static const char *Commands[] = {"lookat", "move", "mousemove", "mousewheel"};
+	static const int ValuesCounts[] = {6, 3, 2, 1};
+
+	fprintf(File, "# frame[-lastframe] command values\n");
+
+	for(int i = 0; i < EventsCount; i++)
+	{
+		CCameraPathEvent &Event = Events[i];
+
+		if(Event.FirstFrame == Event.LastFrame)
+		{
+			fprintf(File, "%d %s", Event.FirstFrame, Commands[Event.Type]);
+		}
+		else
+		{
+			fprintf(File, "%d-%d %s", Event.FirstFrame, Event.LastFrame, Commands[Event.Type]);
+		}
+
+		for(int v = 0; v < ValuesCounts[Event.Type]; v++)
+		{
+			fprintf(File, " %.9g", Event.Values[v]);
+		}
+
+		fprintf(File, "\n");
+	}
+
+	fclose(File);
+
+	return true;
+}
+
+void CCameraPath::RecordMove(vec3 Movement)
+{
+	if(Recording)
+	{
+		AddEvent(RecordFrame, RecordFrame, CAMERA_PATH_MOVE, Movement.x, Movement.y, Movement.z);
+	}
+}
+
+void CCameraPath::RecordMouseMove(int dx, int dy)
+{
+	if(Recording)
+	{
+		AddEvent(RecordFrame, RecordFrame, CAMERA_PATH_MOUSE_MOVE, (float)dx, (float)dy);
+	}
+}
+
+void CCameraPath::RecordMouseWheel(short zDelta)
+{
+	if(Recording)
+	{
+		AddEvent(RecordFrame, RecordFrame, CAMERA_PATH_MOUSE_WHEEL, (float)zDelta);
+	}
+}
+
+CCameraPath CameraPath;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CBenchmark::CBenchmark()
+{
+	FrameTimes = NULL;
+	Frame = Frames = 0;
+	FrameStart = ProcessStart = StartupTime = 0.0;
+
+	Running = false;
+	FrameTime = 0.016f;
+}
+
+CBenchmark::~CBenchmark()
+{
+	Destroy();
+}
+
+void CBenchmark::MarkProcessStart()
+{
+	ProcessStart = GetTime();
+}
+
+void CBenchmark::Start(int Frames, float FrameTime)
+{
+	Destroy();
+
+	this->Frames = Frames > 0 ? Frames : 1;
+	this->FrameTime = FrameTime;
+
+	FrameTimes = new double[this->Frames];
+	Frame = 0;
+
+	StartupTime = GetTime() - ProcessStart;
+
+	Running = true;
+}
+
+int CBenchmark::BeginFrame()
+{
+	FrameStart = GetTime();
+
+	return Frame;
+}
+
+bool CBenchmark::EndFrame()
+{
+	glFinish();
+
+	FrameTimes[Frame++] = GetTime() - FrameStart;
+
+	if(Frame == Frames)
+	{
+		Running = false;
+	}
+
+	return Running;
+}
+
+// a value of the report, already formatted; text is quoted and escaped when written to JSON
+
+struct CBenchmarkValue
+{
+	const char *Name;
+	CString Value;
+	bool Text;
+};
+
+static void AddValue(std::vector<CBenchmarkValue> &Values, const char *Name, const char *Format, ...)
+{
+	CBenchmarkValue Value;
+
+	Value.Name = Name;
+	Value.Text = false;
+
+	va_list ArgList;
+
+	va_start(ArgList, Format);
+	Value.Value.AppendV(Format, ArgList);
+	va_end(ArgList);
+
+	Values.push_back(std::move(Value));
+}
+
+static void AddText(std::vector<CBenchmarkValue> &Values, const char *Name, const char *Text)
+{
+	CBenchmarkValue Value;
+
+	Value.Name = Name;
+	Value.Value = Text;
+	Value.Text = true;
+
+	Values.push_back(std::move(Value));
+}
+
+// quotes, backslashes and control characters are escaped, the rest is passed through as UTF-8
+
+static CString EscapeJSON(const char *Text)
+{
+	CString Escaped;
+
+	for(const char *Character = Text; *Character; Character++)
+	{
+		unsigned char c = (unsigned char)*Character;
+
+		if(c == '"' || c == '\\')
+		{
+			Escaped.Append("\\%c", c);
+		}
+		else if(c < 0x20)
+		{
+			Escaped.Append("\\u%04x", c);
+		}
+		else
+		{
+			Escaped.AppendString(Character, 1);
+		}
+	}
+
+	return Escaped;
+}
+
+bool CBenchmark::Save(char *FileName)
+{
+	if(FrameTimes == NULL || Frame < Frames)
+	{
+		ErrorLog.Append("Benchmark did not finish (%d of %d frames)!\r\n", Frame, Frames);
+		return false;
+	}
+
+	double *SortedFrameTimes = new double[Frames];
+
+	memcpy(SortedFrameTimes, FrameTimes, sizeof(double) * Frames);
+
+	std::sort(SortedFrameTimes, SortedFrameTimes + Frames);
+
+	double Sum = 0.0;
+
+	for(int i = 0; i < Frames; i++)
+	{
+		Sum += FrameTimes[i];
+	}
+
+	double Mean = Sum / Frames;
+	double p50 = Percentile(SortedFrameTimes, 50.0);
+	double p95 = Percentile(SortedFrameTimes, 95.0);
+	double p99 = Percentile(SortedFrameTimes, 99.0);
+	double Min = SortedFrameTimes[0], Max = SortedFrameTimes[Frames - 1];
+
+	delete [] SortedFrameTimes;
+
+	CTextureStreamerStats Stats;
+
+	TextureStreamer.GetStats(Stats);
+
+	CTextureManagerStats CacheStats;
+
+	TextureManager.GetStats(CacheStats);
+
+	CTextureCacheStats CompressedStats;
+
+	TextureCache.GetStats(CompressedStats);
+
+	CVirtualTextureStats VirtualStats;
+
+	if(!OpenGLRenderer.GetVirtualTextureStats(VirtualStats))
+	{
+		memset(&VirtualStats, 0, sizeof(VirtualStats));
+	}
+
+	CShaderCacheStats ShaderStats;
+
+	ShaderCache.GetStats(ShaderStats);
+
+	CShaderLibraryStats LibraryStats;
+
+	ShaderLibrary.GetStats(LibraryStats);
+
+	CFrameUniformsStats UniformsStats;
+
+	FrameUniforms.GetStats(UniformsStats);
+
+	CTextureAtlasStats AtlasStats;
+
+	if(!OpenGLRenderer.GetAtlasStats(AtlasStats))
+	{
+		memset(&AtlasStats, 0, sizeof(AtlasStats));
+	}
+
+	CInstancesStats InstancesStats;
+
+	if(!OpenGLRenderer.GetInstancesStats(InstancesStats))
+	{
+		memset(&InstancesStats, 0, sizeof(InstancesStats));
+	}
+
+	CBVHStats SceneStats;
+
+	if(!OpenGLRenderer.GetSceneStats(SceneStats))
+	{
+		memset(&SceneStats, 0, sizeof(SceneStats));
+	}
+
+	CSceneGraphStats SceneGraphStats;
+
+	if(!OpenGLRenderer.GetSceneGraphStats(SceneGraphStats))
+	{
+		memset(&SceneGraphStats, 0, sizeof(SceneGraphStats));
+	}
+
+	CDebugDrawStats DebugDrawStats;
+
+	DebugDraw.GetStats(DebugDrawStats);
+
+	double InstancesFrames = InstancesStats.Frames > 0 ? InstancesStats.Frames : 1;
+	double SceneRefits = SceneStats.Refits > 0 ? SceneStats.Refits : 1;
+	double SceneGraphUpdates = SceneGraphStats.Updates > 0 ? SceneGraphStats.Updates : 1;
+
+	// every value is formatted once and written as a comment line of the CSV file or as a member of the JSON object
+
+	std::vector<CBenchmarkValue> Values;
+
+	const char *Renderer = (const char*)glGetString(GL_RENDERER);
+
+	AddText(Values, "renderer", Renderer ? Renderer : "");
+	AddValue(Values, "frames", "%d", Frames);
+	AddValue(Values, "frame_time_ms", "%.3f", FrameTime * 1000.0f);
+	AddValue(Values, "startup_ms", "%.3f", StartupTime * 1000.0);
+	AddValue(Values, "mean_ms", "%.6f", Mean * 1000.0);
+	AddValue(Values, "min_ms", "%.6f", Min * 1000.0);
+	AddValue(Values, "p50_ms", "%.6f", p50 * 1000.0);
+	AddValue(Values, "p95_ms", "%.6f", p95 * 1000.0);
+	AddValue(Values, "p99_ms", "%.6f", p99 * 1000.0);
+	AddValue(Values, "max_ms", "%.6f", Max * 1000.0);
+	AddValue(Values, "textures_loaded", "%d", Stats.Loaded);
+	AddValue(Values, "texture_latency_mean_ms", "%.3f", Stats.AverageLatency * 1000.0);
+	AddValue(Values, "texture_latency_max_ms", "%.3f", Stats.MaxLatency * 1000.0);
+	AddValue(Values, "texture_cache_textures", "%d", CacheStats.Textures);
+	AddValue(Values, "texture_cache_hits", "%d", CacheStats.PathHits + CacheStats.ContentHits);
+	AddValue(Values, "texture_cache_misses", "%d", CacheStats.Misses);
+	AddValue(Values, "texture_resident_bytes", "%lld", CacheStats.ResidentBytes);
+	AddValue(Values, "texture_budget_bytes", "%lld", CacheStats.Budget);
+	AddValue(Values, "texture_demotions", "%d", CacheStats.Demotions);
+	AddValue(Values, "texture_promotions", "%d", CacheStats.Promotions);
+	AddValue(Values, "texture_demoted_bytes", "%lld", CacheStats.DemotedBytes);
+	AddValue(Values, "compressed_cache_hits", "%d", CompressedStats.Hits);
+	AddValue(Values, "compressed_cache_misses", "%d", CompressedStats.Misses);
+	AddValue(Values, "compressed_cache_writes", "%d", CompressedStats.Writes);
+	AddValue(Values, "compressed_encode_ms", "%.3f", CompressedStats.EncodeTime * 1000.0);
+	AddValue(Values, "compressed_bytes", "%lld", CompressedStats.CompressedBytes);
+	AddValue(Values, "compressed_uncompressed_bytes", "%lld", CompressedStats.UncompressedBytes);
+	AddValue(Values, "virtual_tiles_physical", "%d", VirtualStats.PhysicalTiles);
+	AddValue(Values, "virtual_tiles_resident", "%d", VirtualStats.ResidentTiles);
+	AddValue(Values, "virtual_tiles_requested", "%d", VirtualStats.RequestedTiles);
+	AddValue(Values, "virtual_tiles_pending", "%d", VirtualStats.PendingTiles);
+	AddValue(Values, "virtual_tiles_loaded", "%d", VirtualStats.LoadedTiles);
+	AddValue(Values, "virtual_tiles_evicted", "%d", VirtualStats.EvictedTiles);
+	AddValue(Values, "virtual_tiles_dropped", "%d", VirtualStats.DroppedTiles);
+	AddValue(Values, "virtual_uploaded_bytes", "%lld", VirtualStats.UploadedBytes);
+	AddValue(Values, "atlas_images", "%d", AtlasStats.Images);
+	AddValue(Values, "atlas_pages", "%d", AtlasStats.Pages);
+	AddValue(Values, "atlas_efficiency", "%.4f", AtlasStats.Efficiency);
+	AddValue(Values, "atlas_binds_per_frame", "%d", AtlasStats.Binds);
+	AddValue(Values, "atlas_unbatched_binds_per_frame", "%d", AtlasStats.UnbatchedBinds);
+	AddValue(Values, "shader_cache_hits", "%d", ShaderStats.Hits);
+	AddValue(Values, "shader_cache_misses", "%d", ShaderStats.Misses);
+	AddValue(Values, "shader_cache_rejected", "%d", ShaderStats.Rejected);
+	AddValue(Values, "shader_cache_writes", "%d", ShaderStats.Writes);
+	AddValue(Values, "shader_cache_load_ms", "%.3f", ShaderStats.LoadTime * 1000.0);
+	AddValue(Values, "shader_build_ms", "%.3f", ShaderStats.BuildTime * 1000.0);
+	AddValue(Values, "shader_variants", "%d", LibraryStats.Variants);
+	AddValue(Values, "shader_programs", "%d", LibraryStats.Programs);
+	AddValue(Values, "shader_duplicates", "%d", LibraryStats.Duplicates);
+	AddValue(Values, "shader_failed", "%d", LibraryStats.Failed);
+	AddValue(Values, "shader_wait_ms", "%.3f", LibraryStats.WaitTime * 1000.0);
+	AddValue(Values, "frame_uniform_uploads", "%d", UniformsStats.FrameUploads);
+	AddValue(Values, "object_uniform_uploads", "%d", UniformsStats.ObjectUploads);
+	AddValue(Values, "object_uniform_skipped", "%d", UniformsStats.SkippedUploads);
+	AddValue(Values, "instances", "%d", InstancesStats.Instances);
+	AddValue(Values, "instances_visible", "%d", InstancesStats.Visible);
+	AddValue(Values, "instance_draw_calls_per_frame", "%d", InstancesStats.DrawCalls);
+	AddValue(Values, "instance_cull_ms", "%.3f", InstancesStats.CullTime / InstancesFrames * 1000.0);
+	AddValue(Values, "instance_update_ms", "%.3f", InstancesStats.UpdateTime / InstancesFrames * 1000.0);
+	AddValue(Values, "instance_upload_ms", "%.3f", InstancesStats.UploadTime / InstancesFrames * 1000.0);
+	AddValue(Values, "instance_submit_ms", "%.3f", InstancesStats.SubmitTime / InstancesFrames * 1000.0);
+	AddValue(Values, "bvh_objects", "%d", SceneStats.Objects);
+	AddValue(Values, "bvh_nodes", "%d", SceneStats.Nodes);
+	AddValue(Values, "bvh_depth", "%d", SceneStats.Depth);
+	AddValue(Values, "bvh_build_ms", "%.3f", SceneStats.BuildTime * 1000.0);
+	AddValue(Values, "bvh_refit_ms", "%.3f", SceneStats.RefitTime / SceneRefits * 1000.0);
+	AddValue(Values, "scene_graph_nodes", "%d", SceneGraphStats.Nodes);
+	AddValue(Values, "scene_graph_levels", "%d", SceneGraphStats.Levels);
+	AddValue(Values, "scene_graph_update_ms", "%.6f", SceneGraphStats.UpdateTime / SceneGraphUpdates * 1000.0);
+	AddValue(Values, "debug_draw_vertices", "%d", DebugDrawStats.Vertices);
+	AddValue(Values, "debug_draw_calls", "%d", DebugDrawStats.DrawCalls);
+	AddValue(Values, "debug_draw_dropped", "%d", DebugDrawStats.Dropped);
+	AddValue(Values, "debug_draw_waits", "%d", DebugDrawStats.Waits);
+
+	const char *Extension = strrchr(FileName, '.');
+	bool CSV = Extension != NULL && (strcmp(Extension, ".csv") == 0 || strcmp(Extension, ".CSV") == 0);
+
+	FILE *File;
+
+	if(fopen_s(&File, FileName, "wt") != 0)
+	{
+		ErrorLog.Append("Error saving file %s!\r\n", FileName);
+		return false;
+	}
+
+	if(CSV)
+	{
+		for(size_t i = 0; i < Values.size(); i++)
+		{
+			fprintf(File, "# %s,%s\n", Values[i].Name, (char*)Values[i].Value);
+		}
+
+		fprintf(File, "frame,cpu_ms\n");
+
+		for(int i = 0; i < Frames; i++)
+		{
+			fprintf(File, "%d,%.6f\n", i, FrameTimes[i] * 1000.0);
+		}
+	}
+	else
+	{
+		fprintf(File, "{\n");
+
+		for(size_t i = 0; i < Values.size(); i++)
+		{
+			if(Values[i].Text)
+			{
+				fprintf(File, "\t\"%s\": \"%s\",\n", Values[i].Name, (char*)EscapeJSON(Values[i].Value));
+			}
+			else
+			{
+				fprintf(File, "\t\"%s\": %s,\n", Values[i].Name, (char*)Values[i].Value);
+			}
+		}
+
+		fprintf(File, "\t\"cpu_ms\": [");
+
+		for(int i = 0; i < Frames; i++)
+		{
+			fprintf(File, i == 0 ? "%.6f" : ", %.6f", FrameTimes[i] * 1000.0);
+		}
+
+		fprintf(File, "]\n}\n");
+	}
+
+	fclose(File);
+
+	return true;
+}
+
+void CBenchmark::Destroy()
+{
+	delete [] FrameTimes;
+	FrameTimes = NULL;
+	Frame = Frames = 0;
+	Running = false;
+}
+
+double CBenchmark::Percentile(double *SortedFrameTimes, double Percent)
+{
+	int Rank = (int)ceil(Percent / 100.0 * Frames) - 1;
+
+	if(Rank < 0) Rank = 0;
+	if(Rank >= Frames) Rank = Frames - 1;
+
+	return SortedFrameTimes[Rank];
+}
+
+CBenchmark Benchmark;
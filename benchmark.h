@@ -0,0 +1,76 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+#define CAMERA_PATH_LOOK_AT 0
+#define CAMERA_PATH_MOVE 1
+#define CAMERA_PATH_MOUSE_MOVE 2
+#define CAMERA_PATH_MOUSE_WHEEL 3
+
+struct CCameraPathEvent
+{
+	int FirstFrame, LastFrame, Type;
+	float Values[6];
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CCameraPath
+{
+protected:
+	CCameraPathEvent *Events;
+	int EventsCount, MaxEventsCount;
+
+public:
+	bool Recording;
+	int RecordFrame;
+
+public:
+	CCameraPath();
+	~CCameraPath();
+
+	void AddEvent(int FirstFrame, int LastFrame, int Type, float v0 = 0.0f, float v1 = 0.0f, float v2 = 0.0f, float v3 = 0.0f, float v4 = 0.0f, float v5 = 0.0f);
+	void Apply(int Frame);
+	void CreateOrbit(int Frames);
+	void Destroy();
+	bool Load(char *FileName);
+	bool Save(char *FileName);
+
+	void RecordMove(vec3 Movement);
+	void RecordMouseMove(int dx, int dy);
+	void RecordMouseWheel(short zDelta);
+};
+
+extern CCameraPath CameraPath;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CBenchmark
+{
+protected:
+	double *FrameTimes;
+	int Frame, Frames;
+	double FrameStart, ProcessStart, StartupTime;
+
+public:
+	bool Running;
+	float FrameTime;
+
+public:
+	CBenchmark();
+	~CBenchmark();
+
+	void MarkProcessStart();
+	void Start(int Frames, float FrameTime);
+	int BeginFrame();
+	bool EndFrame();
+	bool Save(char *FileName);
+	void Destroy();
+
+protected:
+	double Percentile(double *SortedFrameTimes, double Percent);
+};
+
+extern CBenchmark Benchmark;
@@ -0,0 +1,1544 @@
+#include "blockcompress.h"
+#include "threadpool.h"
+
+#include "string.h"
+
+#include <math.h>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+int GetBlockSize(BC_FORMAT Format)
+{
+	return Format == BC_FORMAT_BC1 || Format == BC_FORMAT_BC4 ? 8 : 16;
+}
+
+GLenum GetBlockInternalFormat(BC_FORMAT Format, bool sRGB)
+{
+	switch(Format)
+	{
+		case BC_FORMAT_BC1: return sRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		case BC_FORMAT_BC3: return sRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BC_FORMAT_BC4: return GL_COMPRESSED_RED_RGTC1;
+		case BC_FORMAT_BC5: return GL_COMPRESSED_RG_RGTC2;
+		case BC_FORMAT_BC7: return sRGB ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		default: return 0;
+	}
+}
+
+bool IsBlockInternalFormat(GLenum InternalFormat)
+{
+	switch(InternalFormat)
+	{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RED_RGTC1: case GL_COMPRESSED_RG_RGTC2:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM: case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// BC4 stands for grey and needs the swizzle
+
+bool IsBlockFormatSupported(BC_FORMAT Format, bool sRGB, const CPixelFormatCaps &Caps)
+{
+	switch(Format)
+	{
+		case BC_FORMAT_BC1: case BC_FORMAT_BC3: return Caps.S3TC && (!sRGB || Caps.S3TCsRGB);
+		case BC_FORMAT_BC4: return Caps.RGTC && Caps.TextureSwizzle;
+		case BC_FORMAT_BC5: return Caps.RGTC;
+		case BC_FORMAT_BC7: return Caps.BPTC;
+		default: return false;
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the 16 texels of a block as RGBA
+
+static void LoadBlock(const BYTE *Data, int Width, int Height, int Pitch, int Channels, bool BGR, int BlockX, int BlockY, BYTE Block[16][4])
+{
+	for(int y = 0; y < 4; y++)
+	{
+		int PixelY = BlockY * 4 + y < Height ? BlockY * 4 + y : Height - 1;
+
+		for(int x = 0; x < 4; x++)
+		{
+			int PixelX = BlockX * 4 + x < Width ? BlockX * 4 + x : Width - 1;
+
+			const BYTE *Pixel = Data + PixelY * Pitch + PixelX * Channels;
+			BYTE *Texel = Block[y * 4 + x];
+
+			if(Channels >= 3)
+			{
+				Texel[0] = Pixel[BGR ? 2 : 0];
+				Texel[1] = Pixel[1];
+				Texel[2] = Pixel[BGR ? 0 : 2];
+				Texel[3] = Channels == 4 ? Pixel[3] : 255;
+			}
+			else
+			{
+				Texel[0] = Pixel[0];
+				Texel[1] = Channels == 2 ? Pixel[1] : Pixel[0];
+				Texel[2] = Channels == 2 ? 0 : Pixel[0];
+				Texel[3] = 255;
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// endpoints along the principal axis of the texels in the first Dimensions channels, or the bounding box diagonal that
+// follows the sign of the correlations for the fast tier
+
+static void FitEndpoints(const BYTE Block[16][4], int Dimensions, BC_QUALITY Quality, float *Endpoint0, float *Endpoint1)
+{
+	float Min[4], Max[4], Mean[4];
+
+	for(int c = 0; c < Dimensions; c++)
+	{
+		Min[c] = Max[c] = Block[0][c];
+		Mean[c] = 0.0f;
+
+		for(int i = 0; i < 16; i++)
+		{
+			if(Block[i][c] < Min[c]) Min[c] = Block[i][c];
+			if(Block[i][c] > Max[c]) Max[c] = Block[i][c];
+
+			Mean[c] += Block[i][c];
+		}
+
+		Mean[c] /= 16.0f;
+	}
+
+	float Covariance[4][4];
+
+	for(int a = 0; a < Dimensions; a++)
+	{
+		for(int b = 0; b < Dimensions; b++)
+		{
+			float Sum = 0.0f;
+
+			for(int i = 0; i < 16; i++)
+			{
+				Sum += (Block[i][a] - Mean[a]) * (Block[i][b] - Mean[b]);
+			}
+
+			Covariance[a][b] = Sum;
+		}
+	}
+
+	if(Quality == BC_QUALITY_FAST)
+	{
+		int Widest = 0;
+
+		for(int c = 1; c < Dimensions; c++)
+		{
+			if(Max[c] - Min[c] > Max[Widest] - Min[Widest]) Widest = c;
+		}
+
+		for(int c = 0; c < Dimensions; c++)
+		{
+			float Inset = (Max[c] - Min[c]) / 16.0f;
+
+			Endpoint0[c] = Min[c] + Inset;
+			Endpoint1[c] = Max[c] - Inset;
+
+			if(Covariance[c][Widest] < 0.0f)
+			{
+				float Temp = Endpoint0[c];
+				Endpoint0[c] = Endpoint1[c];
+				Endpoint1[c] = Temp;
+			}
+		}
+
+		return;
+	}
+
+	float Axis[4];
+
+	for(int c = 0; c < Dimensions; c++)
+	{
+		Axis[c] = Max[c] - Min[c];
+	}
+
+	for(int Iteration = 0; Iteration < 8; Iteration++)
+	{
+		float Next[4], Length = 0.0f;
+
+		for(int a = 0; a < Dimensions; a++)
+		{
+			Next[a] = 0.0f;
+
+			for(int b = 0; b < Dimensions; b++)
+			{
+				Next[a] += Covariance[a][b] * Axis[b];
+			}
+
+			Length = Length > fabsf(Next[a]) ? Length : fabsf(Next[a]);
+		}
+
+		if(Length == 0.0f) break;
+
+		for(int c = 0; c < Dimensions; c++)
+		{
+			Axis[c] = Next[c] / Length;
+		}
+	}
+
+	float AxisLength = 0.0f;
+
+	for(int c = 0; c < Dimensions; c++)
+	{
+		AxisLength += Axis[c] * Axis[c];
+	}
+
+	if(AxisLength == 0.0f)
+	{
+		for(int c = 0; c < Dimensions; c++)
+		{
+			Endpoint0[c] = Endpoint1[c] = Mean[c];
+		}
+
+		return;
+	}
+
+	float MinT = 1.0e30f, MaxT = -1.0e30f;
+
+	for(int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+
+		for(int c = 0; c < Dimensions; c++)
+		{
+			t += (Block[i][c] - Mean[c]) * Axis[c];
+		}
+
+		if(t < MinT) MinT = t;
+		if(t > MaxT) MaxT = t;
+	}
+
+	for(int c = 0; c < Dimensions; c++)
+	{
+		Endpoint0[c] = Mean[c] + Axis[c] * MinT / AxisLength;
+		Endpoint1[c] = Mean[c] + Axis[c] * MaxT / AxisLength;
+
+		Endpoint0[c] = Endpoint0[c] < 0.0f ? 0.0f : Endpoint0[c] > 255.0f ? 255.0f : Endpoint0[c];
+		Endpoint1[c] = Endpoint1[c] < 0.0f ? 0.0f : Endpoint1[c] > 255.0f ? 255.0f : Endpoint1[c];
+	}
+}
+
+// least squares endpoints for the texels given the weight of the second endpoint in each texel, false if the system
+// is singular because all weights are equal
+
+static bool RefineEndpoints(const BYTE Block[16][4], int Dimensions, const float *Weights, float *Endpoint0, float *Endpoint1)
+{
+	float Alpha2 = 0.0f, Beta2 = 0.0f, AlphaBeta = 0.0f, AlphaX[4] = {0.0f}, BetaX[4] = {0.0f};
+
+	for(int i = 0; i < 16; i++)
+	{
+		float Beta = Weights[i], Alpha = 1.0f - Beta;
+
+		Alpha2 += Alpha * Alpha;
+		Beta2 += Beta * Beta;
+		AlphaBeta += Alpha * Beta;
+
+		for(int c = 0; c < Dimensions; c++)
+		{
+			AlphaX[c] += Alpha * Block[i][c];
+			BetaX[c] += Beta * Block[i][c];
+		}
+	}
+
+	float Determinant = Alpha2 * Beta2 - AlphaBeta * AlphaBeta;
+
+	if(fabsf(Determinant) < 1.0e-6f)
+	{
+		return false;
+	}
+
+	for(int c = 0; c < Dimensions; c++)
+	{
+		float e0 = (AlphaX[c] * Beta2 - BetaX[c] * AlphaBeta) / Determinant;
+		float e1 = (BetaX[c] * Alpha2 - AlphaX[c] * AlphaBeta) / Determinant;
+
+		Endpoint0[c] = e0 < 0.0f ? 0.0f : e0 > 255.0f ? 255.0f : e0;
+		Endpoint1[c] = e1 < 0.0f ? 0.0f : e1 > 255.0f ? 255.0f : e1;
+	}
+
+	return true;
+}
+
+static int GetRefinements(BC_QUALITY Quality)
+{
+	return Quality == BC_QUALITY_FAST ? 0 : Quality == BC_QUALITY_NORMAL ? 1 : 4;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static int Pack565(const float *Color)
+{
+	int r = (int)(Color[0] * 31.0f / 255.0f + 0.5f), g = (int)(Color[1] * 63.0f / 255.0f + 0.5f), b = (int)(Color[2] * 31.0f / 255.0f + 0.5f);
+
+	return (r << 11) | (g << 5) | b;
+}
+
+static void Unpack565(int Packed, int *Color)
+{
+	int r = (Packed >> 11) & 31, g = (Packed >> 5) & 63, b = Packed & 31;
+
+	Color[0] = (r << 3) | (r >> 2);
+	Color[1] = (g << 2) | (g >> 4);
+	Color[2] = (b << 3) | (b >> 2);
+}
+
+static void GetBC1Palette(int Color0, int Color1, int Palette[4][3])
+{
+	Unpack565(Color0, Palette[0]);
+	Unpack565(Color1, Palette[1]);
+
+	for(int c = 0; c < 3; c++)
+	{
+		Palette[2][c] = (2 * Palette[0][c] + Palette[1][c]) / 3;
+		Palette[3][c] = (Palette[0][c] + 2 * Palette[1][c]) / 3;
+	}
+}
+
+static int FindBC1Indices(const BYTE Block[16][4], int Color0, int Color1, int *Indices)
+{
+	int Palette[4][3];
+
+	GetBC1Palette(Color0, Color1, Palette);
+
+	int Error = 0;
+
+	for(int i = 0; i < 16; i++)
+	{
+		int BestError = 0x7FFFFFFF;
+
+		for(int j = 0; j < 4; j++)
+		{
+			int dr = Block[i][0] - Palette[j][0], dg = Block[i][1] - Palette[j][1], db = Block[i][2] - Palette[j][2];
+			int TexelError = dr * dr + dg * dg + db * db;
+
+			if(TexelError < BestError)
+			{
+				BestError = TexelError;
+				Indices[i] = j;
+			}
+		}
+
+		Error += BestError;
+	}
+
+	return Error;
+}
+
+// the 5 and 6 bit endpoint pairs whose 2/3 interpolant hits each 8 bit value most closely, a solid block encoded with
+// these is exact or off by one instead of off by up to 4
+
+struct CSingleColorTables
+{
+	BYTE Match5[256][2], Match6[256][2];
+
+	CSingleColorTables()
+	{
+		Build(Match5, 5);
+		Build(Match6, 6);
+	}
+
+	static void Build(BYTE Match[256][2], int Bits)
+	{
+		int Levels = 1 << Bits;
+
+		for(int Value = 0; Value < 256; Value++)
+		{
+			int BestError = 256;
+
+			for(int a = 0; a < Levels; a++)
+			{
+				for(int b = 0; b < Levels; b++)
+				{
+					int ea = Bits == 5 ? (a << 3) | (a >> 2) : (a << 2) | (a >> 4);
+					int eb = Bits == 5 ? (b << 3) | (b >> 2) : (b << 2) | (b >> 4);
+					int Error = abs((2 * ea + eb) / 3 - Value);
+
+					if(Error < BestError)
+					{
+						BestError = Error;
+						Match[Value][0] = (BYTE)a;
+						Match[Value][1] = (BYTE)b;
+					}
+				}
+			}
+		}
+	}
+};
+
+static const CSingleColorTables& GetSingleColorTables()
+{
+	static CSingleColorTables Tables;
+
+	return Tables;
+}
+
+static bool IsSolidColor(const BYTE Block[16][4])
+{
+	for(int i = 1; i < 16; i++)
+	{
+		if(Block[i][0] != Block[0][0] || Block[i][1] != Block[0][1] || Block[i][2] != Block[0][2]) return false;
+	}
+
+	return true;
+}
+
+static void EncodeBC1(const BYTE Block[16][4], BC_QUALITY Quality, BYTE *Output)
+{
+	int Color0, Color1, Indices[16];
+
+	if(IsSolidColor(Block))
+	{
+		const CSingleColorTables &Tables = GetSingleColorTables();
+
+		Color0 = (Tables.Match5[Block[0][0]][0] << 11) | (Tables.Match6[Block[0][1]][0] << 5) | Tables.Match5[Block[0][2]][0];
+		Color1 = (Tables.Match5[Block[0][0]][1] << 11) | (Tables.Match6[Block[0][1]][1] << 5) | Tables.Match5[Block[0][2]][1];
+
+		for(int i = 0; i < 16; i++)
+		{
+			Indices[i] = 2;
+		}
+	}
+	else
+	{
+		float Endpoint0[4], Endpoint1[4];
+
+		FitEndpoints(Block, 3, Quality, Endpoint0, Endpoint1);
+
+		Color0 = Pack565(Endpoint0);
+		Color1 = Pack565(Endpoint1);
+
+		int Error = FindBC1Indices(Block, Color0, Color1, Indices);
+
+		for(int Refinement = 0; Refinement < GetRefinements(Quality); Refinement++)
+		{
+			static const float IndexWeights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+			float Weights[16];
+
+			for(int i = 0; i < 16; i++)
+			{
+				Weights[i] = IndexWeights[Indices[i]];
+			}
+
+			if(!RefineEndpoints(Block, 3, Weights, Endpoint0, Endpoint1)) break;
+
+			int RefinedColor0 = Pack565(Endpoint0), RefinedColor1 = Pack565(Endpoint1), RefinedIndices[16];
+			int RefinedError = FindBC1Indices(Block, RefinedColor0, RefinedColor1, RefinedIndices);
+
+			if(RefinedError >= Error) break;
+
+			Error = RefinedError;
+			Color0 = RefinedColor0;
+			Color1 = RefinedColor1;
+			memcpy(Indices, RefinedIndices, sizeof(Indices));
+		}
+	}
+
+	// the 4 color mode needs Color0 > Color1, equal endpoints only use index 0 which means the same in both modes
+
+	if(Color0 < Color1)
+	{
+		int Temp = Color0;
+		Color0 = Color1;
+		Color1 = Temp;
+
+		for(int i = 0; i < 16; i++)
+		{
+			Indices[i] ^= 1;
+		}
+	}
+	else if(Color0 == Color1)
+	{
+		memset(Indices, 0, sizeof(Indices));
+	}
+
+	unsigned int Bits = 0;
+
+	for(int i = 0; i < 16; i++)
+	{
+		Bits |= Indices[i] << (i * 2);
+	}
+
+	Output[0] = (BYTE)Color0;
+	Output[1] = (BYTE)(Color0 >> 8);
+	Output[2] = (BYTE)Color1;
+	Output[3] = (BYTE)(Color1 >> 8);
+	Output[4] = (BYTE)Bits;
+	Output[5] = (BYTE)(Bits >> 8);
+	Output[6] = (BYTE)(Bits >> 16);
+	Output[7] = (BYTE)(Bits >> 24);
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// Value0 > Value1 interpolates 6 values between them, otherwise 4 values plus 0 and 255
+
+static void GetBC4Palette(int Value0, int Value1, int *Palette)
+{
+	Palette[0] = Value0;
+	Palette[1] = Value1;
+
+	if(Value0 > Value1)
+	{
+		for(int i = 1; i < 7; i++)
+		{
+			Palette[i + 1] = ((7 - i) * Value0 + i * Value1 + 3) / 7;
+		}
+	}
+	else
+	{
+		for(int i = 1; i < 5; i++)
+		{
+			Palette[i + 1] = ((5 - i) * Value0 + i * Value1 + 2) / 5;
+		}
+
+		Palette[6] = 0;
+		Palette[7] = 255;
+	}
+}
+
+static int FindBC4Indices(const BYTE *Values, int Value0, int Value1, int *Indices)
+{
+	int Palette[8];
+
+	GetBC4Palette(Value0, Value1, Palette);
+
+	int Error = 0;
+
+	for(int i = 0; i < 16; i++)
+	{
+		int BestError = 0x7FFFFFFF;
+
+		for(int j = 0; j < 8; j++)
+		{
+			int TexelError = (Values[i] - Palette[j]) * (Values[i] - Palette[j]);
+
+			if(TexelError < BestError)
+			{
+				BestError = TexelError;
+				Indices[i] = j;
+			}
+		}
+
+		Error += BestError;
+	}
+
+	return Error;
+}
+
+static void EncodeBC4(const BYTE *Values, BC_QUALITY Quality, BYTE *Output)
+{
+	int Min = 255, Max = 0, InnerMin = 255, InnerMax = 0;
+
+	for(int i = 0; i < 16; i++)
+	{
+		if(Values[i] < Min) Min = Values[i];
+		if(Values[i] > Max) Max = Values[i];
+
+		if(Values[i] != 0 && Values[i] < InnerMin) InnerMin = Values[i];
+		if(Values[i] != 255 && Values[i] > InnerMax) InnerMax = Values[i];
+	}
+
+	int Value0 = Max, Value1 = Min, Indices[16];
+	int Error = FindBC4Indices(Values, Value0, Value1, Indices);
+
+	// blocks reaching 0 or 255 may do better spending the interpolated values on the range in between
+
+	if(Quality != BC_QUALITY_FAST && (Min == 0 || Max == 255) && InnerMin <= InnerMax)
+	{
+		int SixIndices[16];
+		int SixError = FindBC4Indices(Values, InnerMin, InnerMax, SixIndices);
+
+		if(SixError < Error)
+		{
+			Error = SixError;
+			Value0 = InnerMin;
+			Value1 = InnerMax;
+			memcpy(Indices, SixIndices, sizeof(Indices));
+		}
+	}
+
+	if(Quality == BC_QUALITY_HIGH && Max > Min)
+	{
+		for(int Inset0 = 0; Inset0 < 4; Inset0++)
+		{
+			for(int Inset1 = 0; Inset1 < 4; Inset1++)
+			{
+				int Candidate0 = Max - Inset0, Candidate1 = Min + Inset1, CandidateIndices[16];
+
+				if(Candidate0 <= Candidate1) continue;
+
+				int CandidateError = FindBC4Indices(Values, Candidate0, Candidate1, CandidateIndices);
+
+				if(CandidateError < Error)
+				{
+					Error = CandidateError;
+					Value0 = Candidate0;
+					Value1 = Candidate1;
+					memcpy(Indices, CandidateIndices, sizeof(Indices));
+				}
+			}
+		}
+	}
+
+	Output[0] = (BYTE)Value0;
+	Output[1] = (BYTE)Value1;
+
+	unsigned long long Bits = 0;
+
+	for(int i = 0; i < 16; i++)
+	{
+		Bits |= (unsigned long long)Indices[i] << (i * 3);
+	}
+
+	for(int i = 0; i < 6; i++)
+	{
+		Output[2 + i] = (BYTE)(Bits >> (i * 8));
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// BC7 mode 6: one subset, 7 bit RGBA endpoints with a shared low bit each and 4 bit indices
+
+static const int BC7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+class CBitWriter
+{
+public:
+	BYTE *Data;
+	int Position;
+
+public:
+	CBitWriter(BYTE *Data) { this->Data = Data; Position = 0; }
+
+	void Write(unsigned int Value, int Bits)
+	{
+		for(int i = 0; i < Bits; i++, Position++)
+		{
+			Data[Position >> 3] |= ((Value >> i) & 1) << (Position & 7);
+		}
+	}
+};
+
+class CBitReader
+{
+public:
+	const BYTE *Data;
+	int Position;
+
+public:
+	CBitReader(const BYTE *Data) { this->Data = Data; Position = 0; }
+
+	unsigned int Read(int Bits)
+	{
+		unsigned int Value = 0;
+
+		for(int i = 0; i < Bits; i++, Position++)
+		{
+			Value |= ((Data[Position >> 3] >> (Position & 7)) & 1) << i;
+		}
+
+		return Value;
+	}
+};
+
+static void QuantizeBC7Endpoint(const float *Endpoint, int PBit, int *Quantized)
+{
+	for(int c = 0; c < 4; c++)
+	{
+		int q = (int)((Endpoint[c] - PBit) / 2.0f + 0.5f);
+
+		Quantized[c] = q < 0 ? 0 : q > 127 ? 127 : q;
+	}
+}
+
+static int GetBC7PBit(const float *Endpoint)
+{
+	int BestPBit = 0;
+	float BestError = 1.0e30f;
+
+	for(int PBit = 0; PBit < 2; PBit++)
+	{
+		int Quantized[4];
+
+		QuantizeBC7Endpoint(Endpoint, PBit, Quantized);
+
+		float Error = 0.0f;
+
+		for(int c = 0; c < 4; c++)
+		{
+			float d = ((Quantized[c] << 1) | PBit) - Endpoint[c];
+			Error += d * d;
+		}
+
+		if(Error < BestError)
+		{
+			BestError = Error;
+			BestPBit = PBit;
+		}
+	}
+
+	return BestPBit;
+}
+
+// each texel is projected on the endpoint line and only the nearest weights are compared
+
+static int FindBC7Indices(const BYTE Block[16][4], const int *Quantized0, int PBit0, const int *Quantized1, int PBit1, int *Indices)
+{
+	int Endpoints[2][4], Palette[16][4], Direction[4], LengthSquared = 0;
+
+	for(int c = 0; c < 4; c++)
+	{
+		Endpoints[0][c] = (Quantized0[c] << 1) | PBit0;
+		Endpoints[1][c] = (Quantized1[c] << 1) | PBit1;
+
+		Direction[c] = Endpoints[1][c] - Endpoints[0][c];
+		LengthSquared += Direction[c] * Direction[c];
+
+		for(int j = 0; j < 16; j++)
+		{
+			Palette[j][c] = ((64 - BC7Weights[j]) * Endpoints[0][c] + BC7Weights[j] * Endpoints[1][c] + 32) >> 6;
+		}
+	}
+
+	// the weight closest to each of the 65 positions along the line
+
+	int Nearest[65];
+
+	for(int w = 0, j = 0; w <= 64; w++)
+	{
+		while(j < 15 && BC7Weights[j + 1] - w < w - BC7Weights[j]) j++;
+
+		Nearest[w] = j;
+	}
+
+	int Error = 0;
+
+	for(int i = 0; i < 16; i++)
+	{
+		int Dot = 0;
+
+		for(int c = 0; c < 4; c++)
+		{
+			Dot += (Block[i][c] - Endpoints[0][c]) * Direction[c];
+		}
+
+		int w = LengthSquared > 0 ? (Dot * 64 + LengthSquared / 2) / LengthSquared : 0;
+		int Center = Nearest[w < 0 ? 0 : w > 64 ? 64 : w];
+
+		int BestError = 0x7FFFFFFF;
+
+		for(int j = Center > 0 ? Center - 1 : 0; j <= Center + 1 && j < 16; j++)
+		{
+			int TexelError = 0;
+
+			for(int c = 0; c < 4; c++)
+			{
+				int d = Block[i][c] - Palette[j][c];
+				TexelError += d * d;
+			}
+
+			if(TexelError < BestError)
+			{
+				BestError = TexelError;
+				Indices[i] = j;
+			}
+		}
+
+		Error += BestError;
+	}
+
+	return Error;
+}
+
+struct CBC7Endpoints
+{
+	int Quantized0[4], Quantized1[4], PBit0, PBit1, Indices[16], Error;
+};
+
+static void QuantizeBC7Endpoints(const BYTE Block[16][4], const float *Endpoint0, const float *Endpoint1, bool SearchPBits, CBC7Endpoints &Result)
+{
+	Result.Error = 0x7FFFFFFF;
+
+	for(int PBits = 0; PBits < 4; PBits++)
+	{
+		CBC7Endpoints Candidate;
+
+		if(SearchPBits)
+		{
+			Candidate.PBit0 = PBits & 1;
+			Candidate.PBit1 = PBits >> 1;
+		}
+		else
+		{
+			Candidate.PBit0 = GetBC7PBit(Endpoint0);
+			Candidate.PBit1 = GetBC7PBit(Endpoint1);
+		}
+
+		QuantizeBC7Endpoint(Endpoint0, Candidate.PBit0, Candidate.Quantized0);
+		QuantizeBC7Endpoint(Endpoint1, Candidate.PBit1, Candidate.Quantized1);
+
+		Candidate.Error = FindBC7Indices(Block, Candidate.Quantized0, Candidate.PBit0, Candidate.Quantized1, Candidate.PBit1, Candidate.Indices);
+
+		if(Candidate.Error < Result.Error)
+		{
+			Result = Candidate;
+		}
+
+		if(!SearchPBits) break;
+	}
+}
+
+static void EncodeBC7(const BYTE Block[16][4], BC_QUALITY Quality, BYTE *Output)
+{
+	float Endpoint0[4], Endpoint1[4];
+
+	FitEndpoints(Block, 4, Quality, Endpoint0, Endpoint1);
+
+	bool SearchPBits = Quality == BC_QUALITY_HIGH;
+
+	CBC7Endpoints Best;
+
+	QuantizeBC7Endpoints(Block, Endpoint0, Endpoint1, SearchPBits, Best);
+
+	for(int Refinement = 0; Refinement < GetRefinements(Quality); Refinement++)
+	{
+		float Weights[16];
+
+		for(int i = 0; i < 16; i++)
+		{
+			Weights[i] = BC7Weights[Best.Indices[i]] / 64.0f;
+		}
+
+		if(!RefineEndpoints(Block, 4, Weights, Endpoint0, Endpoint1)) break;
+
+		CBC7Endpoints Refined;
+
+		QuantizeBC7Endpoints(Block, Endpoint0, Endpoint1, SearchPBits, Refined);
+
+		if(Refined.Error >= Best.Error) break;
+
+		Best = Refined;
+	}
+
+	// the most significant index bit of texel 0 is implied 0, the endpoints are swapped if it would be 1
+
+	if(Best.Indices[0] >= 8)
+	{
+		for(int c = 0; c < 4; c++)
+		{
+			int Temp = Best.Quantized0[c];
+			Best.Quantized0[c] = Best.Quantized1[c];
+			Best.Quantized1[c] = Temp;
+		}
+
+		int Temp = Best.PBit0;
+		Best.PBit0 = Best.PBit1;
+		Best.PBit1 = Temp;
+
+		for(int i = 0; i < 16; i++)
+		{
+			Best.Indices[i] = 15 - Best.Indices[i];
+		}
+	}
+
+	memset(Output, 0, 16);
+
+	CBitWriter Writer(Output);
+
+	Writer.Write(1 << 6, 7);
+
+	for(int c = 0; c < 4; c++)
+	{
+		Writer.Write(Best.Quantized0[c], 7);
+		Writer.Write(Best.Quantized1[c], 7);
+	}
+
+	Writer.Write(Best.PBit0, 1);
+	Writer.Write(Best.PBit1, 1);
+
+	for(int i = 0; i < 16; i++)
+	{
+		Writer.Write(Best.Indices[i], i == 0 ? 3 : 4);
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static void EncodeBlock(const BYTE Block[16][4], BC_FORMAT Format, BC_QUALITY Quality, BYTE *Output)
+{
+	BYTE Values[2][16];
+
+	for(int i = 0; i < 16; i++)
+	{
+		Values[0][i] = Block[i][Format == BC_FORMAT_BC3 ? 3 : 0];
+		Values[1][i] = Block[i][1];
+	}
+
+	switch(Format)
+	{
+		case BC_FORMAT_BC1:
+			EncodeBC1(Block, Quality, Output);
+			break;
+
+		case BC_FORMAT_BC3:
+			EncodeBC4(Values[0], Quality, Output);
+			EncodeBC1(Block, Quality, Output + 8);
+			break;
+
+		case BC_FORMAT_BC4:
+			EncodeBC4(Values[0], Quality, Output);
+			break;
+
+		case BC_FORMAT_BC5:
+			EncodeBC4(Values[0], Quality, Output);
+			EncodeBC4(Values[1], Quality, Output + 8);
+			break;
+
+		case BC_FORMAT_BC7:
+			EncodeBC7(Block, Quality, Output);
+			break;
+
+		default:
+			break;
+	}
+}
+
+void EncodeBlocks(const BYTE *Data, int Width, int Height, int Pitch, int Channels, bool BGR, BC_FORMAT Format, BC_QUALITY Quality, BYTE *Blocks)
+{
+	int BlocksX = (Width + 3) / 4, BlocksY = (Height + 3) / 4, BlockSize = GetBlockSize(Format);
+
+	ThreadPool.ParallelFor(BlocksY, 4, [=](int Begin, int End)
+	{
+		BYTE Block[16][4];
+
+		for(int BlockY = Begin; BlockY < End; BlockY++)
+		{
+			BYTE *Output = Blocks + BlockY * BlocksX * BlockSize;
+
+			for(int BlockX = 0; BlockX < BlocksX; BlockX++, Output += BlockSize)
+			{
+				LoadBlock(Data, Width, Height, Pitch, Channels, BGR, BlockX, BlockY, Block);
+				EncodeBlock(Block, Format, Quality, Output);
+			}
+		}
+	});
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static void DecodeBC1(const BYTE *Input, BYTE Block[16][4], bool FourColors)
+{
+	int Color0 = Input[0] | (Input[1] << 8), Color1 = Input[2] | (Input[3] << 8);
+	int Palette[4][3];
+
+	GetBC1Palette(Color0, Color1, Palette);
+
+	bool Transparent = false;
+
+	if(Color0 <= Color1 && !FourColors)
+	{
+		for(int c = 0; c < 3; c++)
+		{
+			Palette[2][c] = (Palette[0][c] + Palette[1][c]) / 2;
+			Palette[3][c] = 0;
+		}
+
+		Transparent = true;
+	}
+
+	unsigned int Bits = Input[4] | (Input[5] << 8) | (Input[6] << 16) | ((unsigned int)Input[7] << 24);
+
+	for(int i = 0; i < 16; i++)
+	{
+		int Index = (Bits >> (i * 2)) & 3;
+
+		for(int c = 0; c < 3; c++)
+		{
+			Block[i][c] = (BYTE)Palette[Index][c];
+		}
+
+		Block[i][3] = Transparent && Index == 3 ? 0 : 255;
+	}
+}
+
+static void DecodeBC4(const BYTE *Input, BYTE Block[16][4], int Channel)
+{
+	int Palette[8];
+
+	GetBC4Palette(Input[0], Input[1], Palette);
+
+	unsigned long long Bits = 0;
+
+	for(int i = 0; i < 6; i++)
+	{
+		Bits |= (unsigned long long)Input[2 + i] << (i * 8);
+	}
+
+	for(int i = 0; i < 16; i++)
+	{
+		Block[i][Channel] = (BYTE)Palette[(Bits >> (i * 3)) & 7];
+	}
+}
+
+// only mode 6 is decoded, that is the only mode EncodeBlocks writes
+
+static void DecodeBC7(const BYTE *Input, BYTE Block[16][4])
+{
+	CBitReader Reader(Input);
+
+	if(Reader.Read(7) != 1 << 6)
+	{
+		memset(Block, 0, 16 * 4);
+		return;
+	}
+
+	int Endpoints[2][4];
+
+	for(int c = 0; c < 4; c++)
+	{
+		Endpoints[0][c] = Reader.Read(7) << 1;
+		Endpoints[1][c] = Reader.Read(7) << 1;
+	}
+
+	int PBit0 = Reader.Read(1), PBit1 = Reader.Read(1);
+
+	for(int c = 0; c < 4; c++)
+	{
+		Endpoints[0][c] |= PBit0;
+		Endpoints[1][c] |= PBit1;
+	}
+
+	for(int i = 0; i < 16; i++)
+	{
+		int Weight = BC7Weights[Reader.Read(i == 0 ? 3 : 4)];
+
+		for(int c = 0; c < 4; c++)
+		{
+			Block[i][c] = (BYTE)(((64 - Weight) * Endpoints[0][c] + Weight * Endpoints[1][c] + 32) >> 6);
+		}
+	}
+}
+
+// writes RGBA, BC4 and BC5 leave the missing channels 0 and alpha 255
+
+void DecodeBlocks(const BYTE *Blocks, int Width, int Height, BC_FORMAT Format, BYTE *Data, int Pitch)
+{
+	int BlocksX = (Width + 3) / 4, BlocksY = (Height + 3) / 4, BlockSize = GetBlockSize(Format);
+
+	for(int BlockY = 0; BlockY < BlocksY; BlockY++)
+	{
+		for(int BlockX = 0; BlockX < BlocksX; BlockX++, Blocks += BlockSize)
+		{
+			BYTE Block[16][4] = {{0}};
+
+			switch(Format)
+			{
+				case BC_FORMAT_BC1:
+					DecodeBC1(Blocks, Block, false);
+					break;
+
+				case BC_FORMAT_BC3:
+					DecodeBC1(Blocks + 8, Block, true);
+					DecodeBC4(Blocks, Block, 3);
+					break;
+
+				case BC_FORMAT_BC4:
+				case BC_FORMAT_BC5:
+					DecodeBC4(Blocks, Block, 0);
+					if(Format == BC_FORMAT_BC5) DecodeBC4(Blocks + 8, Block, 1);
+					for(int i = 0; i < 16; i++) Block[i][3] = 255;
+					break;
+
+				case BC_FORMAT_BC7:
+					DecodeBC7(Blocks, Block);
+					break;
+
+				default:
+					break;
+			}
+
+			for(int y = 0; y < 4 && BlockY * 4 + y < Height; y++)
+			{
+				for(int x = 0; x < 4 && BlockX * 4 + x < Width; x++)
+				{
+					memcpy(Data + (BlockY * 4 + y) * Pitch + (BlockX * 4 + x) * 4, Block[y * 4 + x], 4);
+				}
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// DDS as written by SaveDDS carries the DX10 extension header, the only way to store BC7 and sRGB, older files name the
+// format with a FourCC
+
+#define DDS_FOURCC(a, b, c, d) ((DWORD)(a) | ((DWORD)(b) << 8) | ((DWORD)(c) << 16) | ((DWORD)(d) << 24))
+
+#define DDS_MAGIC DDS_FOURCC('D', 'D', 'S', ' ')
+
+#define DDSD_CAPS 0x1
+#define DDSD_HEIGHT 0x2
+#define DDSD_WIDTH 0x4
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDSD_LINEARSIZE 0x80000
+
+#define DDPF_FOURCC 0x4
+
+#define DDSCAPS_COMPLEX 0x8
+#define DDSCAPS_TEXTURE 0x1000
+#define DDSCAPS_MIPMAP 0x400000
+
+#define DDSCAPS2_CUBEMAP 0x200
+#define DDSCAPS2_VOLUME 0x200000
+
+#define DDS_DIMENSION_TEXTURE2D 3
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4
+
+#define DDS_ALPHA_MODE_UNKNOWN 0
+#define DDS_ALPHA_MODE_STRAIGHT 1
+#define DDS_ALPHA_MODE_OPAQUE 3
+#define DDS_ALPHA_MODE_MASK 0x7
+
+struct CDDSPixelFormat
+{
+	DWORD Size, Flags, FourCC, RGBBitCount, RBitMask, GBitMask, BBitMask, ABitMask;
+};
+
+struct CDDSHeader
+{
+	DWORD Size, Flags, Height, Width, PitchOrLinearSize, Depth, MipMapCount, Reserved1[11];
+	CDDSPixelFormat PixelFormat;
+	DWORD Caps, Caps2, Caps3, Caps4, Reserved2;
+};
+
+struct CDDSHeaderDX10
+{
+	DWORD DXGIFormat, ResourceDimension, MiscFlag, ArraySize, MiscFlags2;
+};
+
+// the first entry of each format is the one SaveDDS writes
+
+static const struct { BC_FORMAT Format; bool sRGB; DWORD DXGIFormat; } DXGIFormats[] =
+{
+	{BC_FORMAT_BC1, false, 71},
+	{BC_FORMAT_BC1, true, 72},
+	{BC_FORMAT_BC3, false, 77},
+	{BC_FORMAT_BC3, true, 78},
+	{BC_FORMAT_BC4, false, 80},
+	{BC_FORMAT_BC5, false, 83},
+	{BC_FORMAT_BC7, false, 98},
+	{BC_FORMAT_BC7, true, 99}
+};
+
+static const struct { BC_FORMAT Format; DWORD FourCC; } FourCCFormats[] =
+{
+	{BC_FORMAT_BC1, DDS_FOURCC('D', 'X', 'T', '1')},
+	{BC_FORMAT_BC3, DDS_FOURCC('D', 'X', 'T', '5')},
+	{BC_FORMAT_BC4, DDS_FOURCC('A', 'T', 'I', '1')},
+	{BC_FORMAT_BC4, DDS_FOURCC('B', 'C', '4', 'U')},
+	{BC_FORMAT_BC5, DDS_FOURCC('A', 'T', 'I', '2')},
+	{BC_FORMAT_BC5, DDS_FOURCC('B', 'C', '5', 'U')}
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// KTX2 without supercompression, the level index gives the offset of every level
+
+static const BYTE KTX2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct CKTX2Header
+{
+	BYTE Identifier[12];
+	DWORD VkFormat, TypeSize, PixelWidth, PixelHeight, PixelDepth, LayerCount, FaceCount, LevelCount, SupercompressionScheme;
+	DWORD DFDByteOffset, DFDByteLength, KVDByteOffset, KVDByteLength;
+	unsigned long long SGDByteOffset, SGDByteLength;
+};
+
+struct CKTX2Level
+{
+	unsigned long long ByteOffset, ByteLength, UncompressedByteLength;
+};
+
+static const struct { BC_FORMAT Format; bool sRGB; DWORD VkFormat; } VkFormats[] =
+{
+	{BC_FORMAT_BC1, false, 131},
+	{BC_FORMAT_BC1, true, 132},
+	{BC_FORMAT_BC1, false, 133},
+	{BC_FORMAT_BC1, true, 134},
+	{BC_FORMAT_BC3, false, 137},
+	{BC_FORMAT_BC3, true, 138},
+	{BC_FORMAT_BC4, false, 139},
+	{BC_FORMAT_BC5, false, 141},
+	{BC_FORMAT_BC7, false, 145},
+	{BC_FORMAT_BC7, true, 146}
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CCompressedMipmapChain::CCompressedMipmapChain()
+{
+	Format = BC_FORMAT_NONE;
+	sRGB = Opaque = false;
+	Levels = NULL;
+	LevelsCount = 0;
+	Buffer = NULL;
+	Size = 0;
+}
+
+CCompressedMipmapChain::~CCompressedMipmapChain()
+{
+	Destroy();
+}
+
+bool CCompressedMipmapChain::Encode(const CMipmapChain &Mipmaps, int Channels, bool BGR, BC_FORMAT Format, BC_QUALITY Quality)
+{
+	Destroy();
+
+	if(Mipmaps.LevelsCount == 0 || Format == BC_FORMAT_NONE || Channels < 1 || Channels > 4)
+	{
+		return false;
+	}
+
+	SetLevels(Format, Mipmaps.Levels[0].Width, Mipmaps.Levels[0].Height, Mipmaps.LevelsCount);
+
+	Opaque = Channels < 4;
+
+	Buffer = new BYTE[Size];
+
+	size_t Offset = 0;
+
+	for(int i = 0; i < LevelsCount; Offset += Levels[i++].Size)
+	{
+		const CMipmapLevel &Level = Mipmaps.Levels[i];
+
+		Levels[i].Data = Buffer + Offset;
+
+		EncodeBlocks(Level.Data, Level.Width, Level.Height, Level.Pitch, Channels, BGR, Format, Quality, Levels[i].Data);
+	}
+
+	return true;
+}
+
+// the levels point into the mapped file, the pages are read in here so the upload does not wait for the disk
+
+bool CCompressedMipmapChain::Load(const char *FileName)
+{
+	Destroy();
+
+	if(!File.Open(FileName))
+	{
+		return false;
+	}
+
+	DWORD Magic = 0;
+
+	if(File.Size >= sizeof(Magic))
+	{
+		memcpy(&Magic, File.Data, sizeof(Magic));
+	}
+
+	bool Mapped = Magic == DDS_MAGIC ? MapDDS() : MapKTX2();
+
+	if(!Mapped)
+	{
+		Destroy();
+		return false;
+	}
+
+	File.Prefetch();
+
+	return true;
+}
+
+bool CCompressedMipmapChain::SaveDDS(const char *FileName)
+{
+	if(LevelsCount == 0)
+	{
+		return false;
+	}
+
+	DWORD Magic = DDS_MAGIC;
+	CDDSHeader Header;
+	CDDSHeaderDX10 HeaderDX10;
+
+	memset(&Header, 0, sizeof(Header));
+	memset(&HeaderDX10, 0, sizeof(HeaderDX10));
+
+	Header.Size = sizeof(CDDSHeader);
+	Header.Flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	Header.Height = Levels[0].Height;
+	Header.Width = Levels[0].Width;
+	Header.PitchOrLinearSize = (DWORD)Levels[0].Size;
+	Header.MipMapCount = LevelsCount;
+	Header.PixelFormat.Size = sizeof(CDDSPixelFormat);
+	Header.PixelFormat.Flags = DDPF_FOURCC;
+	Header.PixelFormat.FourCC = DDS_FOURCC('D', 'X', '1', '0');
+	Header.Caps = DDSCAPS_TEXTURE | (LevelsCount > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+	for(int i = (int)(sizeof(DXGIFormats) / sizeof(DXGIFormats[0])) - 1; i >= 0; i--)
+	{
+		if(DXGIFormats[i].Format == Format && DXGIFormats[i].sRGB == sRGB) HeaderDX10.DXGIFormat = DXGIFormats[i].DXGIFormat;
+	}
+
+	HeaderDX10.ResourceDimension = DDS_DIMENSION_TEXTURE2D;
+	HeaderDX10.ArraySize = 1;
+	HeaderDX10.MiscFlags2 = Opaque ? DDS_ALPHA_MODE_OPAQUE : DDS_ALPHA_MODE_STRAIGHT;
+
+	FILE *File;
+
+	if(fopen_s(&File, FileName, "wb") != 0)
+	{
+		return false;
+	}
+
+	bool Written = fwrite(&Magic, sizeof(Magic), 1, File) == 1 && fwrite(&Header, sizeof(Header), 1, File) == 1 && fwrite(&HeaderDX10, sizeof(HeaderDX10), 1, File) == 1;
+
+	for(int i = 0; i < LevelsCount; i++)
+	{
+		Written = Written && fwrite(Levels[i].Data, 1, Levels[i].Size, File) == Levels[i].Size;
+	}
+
+	Written = fclose(File) == 0 && Written;
+
+	if(!Written)
+	{
+		remove(FileName);
+	}
+
+	return Written;
+}
+
+// the largest levels go first, at least one level is kept; the data stays where it is
+
+void CCompressedMipmapChain::DropLevels(int Count)
+{
+	if(Count > LevelsCount - 1) Count = LevelsCount - 1;
+
+	if(Count <= 0)
+	{
+		return;
+	}
+
+	for(int i = 0; i < Count; i++)
+	{
+		Size -= Levels[i].Size;
+	}
+
+	memmove(Levels, Levels + Count, (LevelsCount - Count) * sizeof(CCompressedLevel));
+
+	LevelsCount -= Count;
+}
+
+void CCompressedMipmapChain::Destroy()
+{
+	delete [] Levels;
+	delete [] Buffer;
+
+	File.Close();
+
+	Format = BC_FORMAT_NONE;
+	sRGB = Opaque = false;
+	Levels = NULL;
+	LevelsCount = 0;
+	Buffer = NULL;
+	Size = 0;
+}
+
+// a 65536 x 65536 level of 16 byte blocks is 4 GB, the sizes the files are checked against do not fit an int
+
+void CCompressedMipmapChain::SetLevels(BC_FORMAT Format, int Width, int Height, int LevelsCount)
+{
+	this->Format = Format;
+	this->LevelsCount = LevelsCount;
+
+	Opaque = Format == BC_FORMAT_BC4 || Format == BC_FORMAT_BC5;
+
+	Levels = new CCompressedLevel[LevelsCount];
+
+	Size = 0;
+
+	for(int i = 0; i < LevelsCount; i++)
+	{
+		CCompressedLevel &Level = Levels[i];
+
+		Level.Data = NULL;
+		Level.Width = Width >> i > 0 ? Width >> i : 1;
+		Level.Height = Height >> i > 0 ? Height >> i : 1;
+		Level.Pitch = (Level.Width + 3) / 4 * GetBlockSize(Format);
+		Level.Rows = (Level.Height + 3) / 4;
+		Level.Size = (size_t)Level.Pitch * Level.Rows;
+
+		Size += Level.Size;
+	}
+}
+
+bool CCompressedMipmapChain::MapDDS()
+{
+	DWORD Magic;
+	CDDSHeader Header;
+	CDDSHeaderDX10 HeaderDX10;
+
+	size_t Offset = sizeof(Magic) + sizeof(Header);
+
+	if(File.Size < Offset)
+	{
+		return false;
+	}
+
+	memcpy(&Header, File.Data + sizeof(Magic), sizeof(Header));
+
+	if(Header.Size != sizeof(CDDSHeader) || !(Header.PixelFormat.Flags & DDPF_FOURCC) || (Header.Caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)))
+	{
+		return false;
+	}
+
+	BC_FORMAT DDSFormat = BC_FORMAT_NONE;
+	bool DDSsRGB = false;
+
+	if(Header.PixelFormat.FourCC == DDS_FOURCC('D', 'X', '1', '0'))
+	{
+		if(File.Size < Offset + sizeof(HeaderDX10))
+		{
+			return false;
+		}
+
+		memcpy(&HeaderDX10, File.Data + Offset, sizeof(HeaderDX10));
+
+		Offset += sizeof(HeaderDX10);
+
+		if(HeaderDX10.ResourceDimension != DDS_DIMENSION_TEXTURE2D || HeaderDX10.ArraySize != 1 || (HeaderDX10.MiscFlag & DDS_RESOURCE_MISC_TEXTURECUBE))
+		{
+			return false;
+		}
+
+		for(int i = 0; i < (int)(sizeof(DXGIFormats) / sizeof(DXGIFormats[0])); i++)
+		{
+			if(DXGIFormats[i].DXGIFormat == HeaderDX10.DXGIFormat)
+			{
+				DDSFormat = DXGIFormats[i].Format;
+				DDSsRGB = DXGIFormats[i].sRGB;
+			}
+		}
+	}
+	else
+	{
+		for(int i = 0; i < (int)(sizeof(FourCCFormats) / sizeof(FourCCFormats[0])); i++)
+		{
+			if(FourCCFormats[i].FourCC == Header.PixelFormat.FourCC) DDSFormat = FourCCFormats[i].Format;
+		}
+	}
+
+	int Count = (Header.Flags & DDSD_MIPMAPCOUNT) && Header.MipMapCount > 0 ? Header.MipMapCount : 1;
+
+	if(DDSFormat == BC_FORMAT_NONE || Header.Width == 0 || Header.Height == 0 || Header.Width > 65536 || Header.Height > 65536 || Count > CMipmapChain::GetLevelsCount(Header.Width, Header.Height))
+	{
+		return false;
+	}
+
+	SetLevels(DDSFormat, Header.Width, Header.Height, Count);
+
+	sRGB = DDSsRGB;
+
+	int AlphaMode = Header.PixelFormat.FourCC == DDS_FOURCC('D', 'X', '1', '0') ? HeaderDX10.MiscFlags2 & DDS_ALPHA_MODE_MASK : DDS_ALPHA_MODE_UNKNOWN;
+
+	if(AlphaMode != DDS_ALPHA_MODE_UNKNOWN)
+	{
+		Opaque = AlphaMode == DDS_ALPHA_MODE_OPAQUE;
+	}
+
+	// the levels follow each other, largest first
+
+	if(File.Size < Offset + Size)
+	{
+		return false;
+	}
+
+	for(int i = 0; i < LevelsCount; Offset += Levels[i++].Size)
+	{
+		Levels[i].Data = (BYTE*)File.Data + Offset;
+	}
+
+	return true;
+}
+
+bool CCompressedMipmapChain::MapKTX2()
+{
+	CKTX2Header Header;
+
+	if(File.Size < sizeof(Header))
+	{
+		return false;
+	}
+
+	memcpy(&Header, File.Data, sizeof(Header));
+
+	if(memcmp(Header.Identifier, KTX2Identifier, sizeof(KTX2Identifier)) != 0)
+	{
+		return false;
+	}
+
+	if(Header.PixelDepth > 1 || Header.LayerCount > 1 || Header.FaceCount != 1 || Header.SupercompressionScheme != 0)
+	{
+		return false;
+	}
+
+	BC_FORMAT KTX2Format = BC_FORMAT_NONE;
+	bool KTX2sRGB = false;
+
+	for(int i = 0; i < (int)(sizeof(VkFormats) / sizeof(VkFormats[0])); i++)
+	{
+		if(VkFormats[i].VkFormat == Header.VkFormat)
+		{
+			KTX2Format = VkFormats[i].Format;
+			KTX2sRGB = VkFormats[i].sRGB;
+		}
+	}
+
+	int Count = Header.LevelCount > 0 ? Header.LevelCount : 1;
+
+	if(KTX2Format == BC_FORMAT_NONE || Header.PixelWidth == 0 || Header.PixelHeight == 0 || Header.PixelWidth > 65536 || Header.PixelHeight > 65536 || Count > CMipmapChain::GetLevelsCount(Header.PixelWidth, Header.PixelHeight))
+	{
+		return false;
+	}
+
+	if(File.Size < sizeof(Header) + Count * sizeof(CKTX2Level))
+	{
+		return false;
+	}
+
+	SetLevels(KTX2Format, Header.PixelWidth, Header.PixelHeight, Count);
+
+	sRGB = KTX2sRGB;
+
+	for(int i = 0; i < LevelsCount; i++)
+	{
+		CKTX2Level Level;
+
+		memcpy(&Level, File.Data + sizeof(Header) + i * sizeof(CKTX2Level), sizeof(Level));
+
+		if(Level.ByteLength != (unsigned long long)Levels[i].Size || Level.ByteOffset > File.Size || Level.ByteLength > File.Size - Level.ByteOffset)
+		{
+			return false;
+		}
+
+		Levels[i].Data = (BYTE*)File.Data + Level.ByteOffset;
+	}
+
+	return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "platform.h"
+#include "mipmap.h"
+#include "pixelformat.h"
+
+#include <GL/glew.h>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+enum BC_FORMAT
+{
+	BC_FORMAT_NONE,
+	BC_FORMAT_BC1,
+	BC_FORMAT_BC3,
+	BC_FORMAT_BC4,
+	BC_FORMAT_BC5,
+	BC_FORMAT_BC7
+};
+
+// fast fits the endpoints to the bounding box, normal to the principal axis and refines them once by least squares,
+// high refines them until the error stops falling and searches the BC4 endpoints and the BC7 p-bits
+
+enum BC_QUALITY
+{
+	BC_QUALITY_FAST,
+	BC_QUALITY_NORMAL,
+	BC_QUALITY_HIGH
+};
+
+int GetBlockSize(BC_FORMAT Format);
+GLenum GetBlockInternalFormat(BC_FORMAT Format, bool sRGB = false);
+bool IsBlockInternalFormat(GLenum InternalFormat);
+bool IsBlockFormatSupported(BC_FORMAT Format, bool sRGB, const CPixelFormatCaps &Caps);
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the pixels are 8 bit per channel with 1 to 4 channels, BGR swaps the first and the third channel; BC1 encodes RGB, BC3
+// and BC7 RGBA, BC4 the first channel and BC5 the first two, partial blocks at the right and bottom edges repeat the
+// last column and row; blocks are written in rows of (Width + 3) / 4
+
+void EncodeBlocks(const BYTE *Data, int Width, int Height, int Pitch, int Channels, bool BGR, BC_FORMAT Format, BC_QUALITY Quality, BYTE *Blocks);
+void DecodeBlocks(const BYTE *Blocks, int Width, int Height, BC_FORMAT Format, BYTE *Data, int Pitch);
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// a level holds (Height + 3) / 4 rows of blocks, Pitch bytes each; the data of a loaded chain is a read only view of the
+// file
+
+struct CCompressedLevel
+{
+	BYTE *Data;
+	int Width, Height, Pitch, Rows;
+	size_t Size;
+};
+
+// Load maps DDS (DX10 or DXT1, DXT5, ATI1, ATI2 FourCC) and uncompressed KTX2 files of the formats above and the
+// sRGB variants; the rows are used in file order, the first row is the bottom one like with FreeImage, so files from
+// other tools have to be written flipped (texconv -vflip, toktx --lower_left_maps_to_s0t0); Opaque is kept in the
+// alpha mode of the DX10 header, files without one count as opaque only when the format has no alpha
+
+class CCompressedMipmapChain
+{
+public:
+	BC_FORMAT Format;
+	bool sRGB, Opaque;
+	CCompressedLevel *Levels;
+	int LevelsCount;
+	BYTE *Buffer;
+	size_t Size;
+
+protected:
+	CMappedFile File;
+
+public:
+	CCompressedMipmapChain();
+	~CCompressedMipmapChain();
+
+	bool Encode(const CMipmapChain &Mipmaps, int Channels, bool BGR, BC_FORMAT Format, BC_QUALITY Quality);
+	bool Load(const char *FileName);
+	bool SaveDDS(const char *FileName);
+	void DropLevels(int Count);
+	void Destroy();
+
+protected:
+	void SetLevels(BC_FORMAT Format, int Width, int Height, int LevelsCount);
+	bool MapDDS();
+	bool MapKTX2();
+};
@@ -0,0 +1,735 @@
+#include "bvh.h"
+#include "profiler.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the stack of a query holds at most two nodes per level
+
+#define BVH_STACK_SIZE (BVH_MAX_DEPTH * 2 + 4)
+
+struct CBVHBin
+{
+	float Min[3], Max[3];
+	int Count;
+};
+
+struct CBVHStackEntry
+{
+	int Node;
+	float Distance;
+};
+
+static void ResetBins(CBVHBin *Bins, int Count)
+{
+	for(int i = 0; i < Count; i++)
+	{
+		Bins[i].Min[0] = Bins[i].Min[1] = Bins[i].Min[2] = FLT_MAX;
+		Bins[i].Max[0] = Bins[i].Max[1] = Bins[i].Max[2] = -FLT_MAX;
+		Bins[i].Count = 0;
+	}
+}
+
+static void GrowBin(CBVHBin &Bin, const float *Min, const float *Max, int Count)
+{
+	for(int k = 0; k < 3; k++)
+	{
+		Bin.Min[k] = std::min(Bin.Min[k], Min[k]);
+		Bin.Max[k] = std::max(Bin.Max[k], Max[k]);
+	}
+
+	Bin.Count += Count;
+}
+
+static float SurfaceArea(const float *Min, const float *Max)
+{
+	float x = Max[0] - Min[0], y = Max[1] - Min[1], z = Max[2] - Min[2];
+
+	return x < 0.0f ? 0.0f : 2.0f * (x * y + y * z + z * x);
+}
+
+static int BinIndex(float Center, float CentersMin, float Scale)
+{
+	return std::min(BVH_BINS - 1, (int)((Center - CentersMin) * Scale));
+}
+
+// the distance along the ray to where it enters the box, 0 when it starts inside
+
+static bool IntersectRay(const vec3 &Min, const vec3 &Max, const vec3 &Origin, const vec3 &InverseDirection, float MaxDistance, float &Distance)
+{
+	float tx1 = (Min.x - Origin.x) * InverseDirection.x, tx2 = (Max.x - Origin.x) * InverseDirection.x;
+	float ty1 = (Min.y - Origin.y) * InverseDirection.y, ty2 = (Max.y - Origin.y) * InverseDirection.y;
+	float tz1 = (Min.z - Origin.z) * InverseDirection.z, tz2 = (Max.z - Origin.z) * InverseDirection.z;
+
+	float Near = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+	float Far = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::max(tz1, tz2));
+
+	Distance = Near;
+
+	return Near <= Far && Near < MaxDistance;
+}
+
+static float SquaredDistance(const vec3 &Min, const vec3 &Max, const vec3 &Point)
+{
+	float dx = std::max(std::max(Min.x - Point.x, Point.x - Max.x), 0.0f);
+	float dy = std::max(std::max(Min.y - Point.y, Point.y - Max.y), 0.0f);
+	float dz = std::max(std::max(Min.z - Point.z, Point.z - Max.z), 0.0f);
+
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// 0 outside, 1 intersecting, 2 inside
+
+static int Classify(const CFrustum &Frustum, const vec3 &Min, const vec3 &Max)
+{
+	vec3 Center = (Min + Max) * 0.5f, Extents = (Max - Min) * 0.5f;
+
+	int Result = 2;
+
+	for(int i = 0; i < 6; i++)
+	{
+		const float *Plane = Frustum.Planes[i];
+
+		float Distance = Plane[0] * Center.x + Plane[1] * Center.y + Plane[2] * Center.z + Plane[3];
+		float Reach = fabsf(Plane[0]) * Extents.x + fabsf(Plane[1]) * Extents.y + fabsf(Plane[2]) * Extents.z;
+
+		if(Distance + Reach < 0.0f)
+		{
+			return 0;
+		}
+
+		if(Distance - Reach < 0.0f)
+		{
+			Result = 1;
+		}
+	}
+
+	return Result;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CBVH::CBVH()
+{
+	Nodes = NULL;
+	NodesCount = 0;
+	Mins = Maxs = Centers = NULL;
+	Indices = Slots = NULL;
+	Count = 0;
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CBVH::~CBVH()
+{
+	Destroy();
+}
+
+// the bounds are copied, the tree has at most 2 * Count - 1 nodes
+
+void CBVH::Build(const vec3 *Mins, const vec3 *Maxs, int Count)
+{
+	PROFILE_ZONE("CBVH::Build");
+
+	double Start = GetTime();
+
+	int Builds = Stats.Builds;
+	double BuildTime = Stats.BuildTime;
+
+	Destroy();
+
+	this->Count = Count;
+
+	this->Mins = new vec3[Count > 0 ? Count : 1];
+	this->Maxs = new vec3[Count > 0 ? Count : 1];
+	Centers = new vec3[Count > 0 ? Count : 1];
+	Indices = new int[Count > 0 ? Count : 1];
+	Slots = new int[Count > 0 ? Count : 1];
+	Nodes = new CBVHNode[Count > 0 ? Count * 2 - 1 : 1];
+
+	ThreadPool.ParallelFor(Count, BVH_PARALLEL_GRAIN, [&](int Begin, int End)
+	{
+		for(int i = Begin; i < End; i++)
+		{
+			this->Mins[i] = Mins[i];
+			this->Maxs[i] = Maxs[i];
+			Centers[i] = (Mins[i] + Maxs[i]) * 0.5f;
+			Indices[i] = i;
+		}
+	});
+
+	NodesCount = 0;
+
+	if(Count > 0)
+	{
+		NodesCount = 1;
+
+		BuildNode(0, 0, Count, 0);
+	}
+
+	// the bounds are moved into the order of the leaves, so a leaf finds those of its objects next to each other, the
+	// centers are only needed to build
+
+	vec3 *LeafMins = new vec3[Count > 0 ? Count : 1], *LeafMaxs = new vec3[Count > 0 ? Count : 1];
+
+	ThreadPool.ParallelFor(Count, BVH_PARALLEL_GRAIN, [&](int Begin, int End)
+	{
+		for(int i = Begin; i < End; i++)
+		{
+			LeafMins[i] = this->Mins[Indices[i]];
+			LeafMaxs[i] = this->Maxs[Indices[i]];
+			Slots[Indices[i]] = i;
+		}
+	});
+
+	delete [] this->Mins;
+	delete [] this->Maxs;
+	delete [] Centers;
+
+	this->Mins = LeafMins;
+	this->Maxs = LeafMaxs;
+	Centers = NULL;
+
+	Stats.Objects = Count;
+	Stats.Nodes = NodesCount;
+
+	int Stack[BVH_STACK_SIZE], Depths[BVH_STACK_SIZE], StackSize = 0;
+
+	if(NodesCount > 0)
+	{
+		Stack[StackSize] = 0;
+		Depths[StackSize++] = 1;
+	}
+
+	while(StackSize > 0)
+	{
+		StackSize--;
+
+		const CBVHNode &Node = Nodes[Stack[StackSize]];
+		int Depth = Depths[StackSize];
+
+		Stats.Depth = std::max(Stats.Depth, Depth);
+
+		if(Node.Count > 0)
+		{
+			Stats.Leaves++;
+			continue;
+		}
+
+		for(int i = 0; i < 2; i++)
+		{
+			Stack[StackSize] = Node.First + i;
+			Depths[StackSize++] = Depth + 1;
+		}
+	}
+
+	Stats.Builds = Builds + 1;
+	Stats.BuildTime = BuildTime + GetTime() - Start;
+}
+
+void CBVH::SetBounds(int Object, const vec3 &Min, const vec3 &Max)
+{
+	Mins[Slots[Object]] = Min;
+	Maxs[Slots[Object]] = Max;
+}
+
+void CBVH::GetBounds(int Object, vec3 &Min, vec3 &Max)
+{
+	Min = Mins[Slots[Object]];
+	Max = Maxs[Slots[Object]];
+}
+
+// the children of a node always come after it
+
+void CBVH::Refit()
+{
+	PROFILE_ZONE("CBVH::Refit");
+
+	double Start = GetTime();
+
+	for(int i = NodesCount - 1; i >= 0; i--)
+	{
+		CBVHNode &Node = Nodes[i];
+
+		if(Node.Count > 0)
+		{
+			vec3 Min = Mins[Node.First], Max = Maxs[Node.First];
+
+			for(int j = Node.First + 1; j < Node.First + Node.Count; j++)
+			{
+				Min = min(Min, Mins[j]);
+				Max = max(Max, Maxs[j]);
+			}
+
+			Node.Min = Min;
+			Node.Max = Max;
+		}
+		else
+		{
+			const CBVHNode &Left = Nodes[Node.First], &Right = Nodes[Node.First + 1];
+
+			Node.Min = min(Left.Min, Right.Min);
+			Node.Max = max(Left.Max, Right.Max);
+		}
+	}
+
+	Stats.Refits++;
+	Stats.RefitTime += GetTime() - Start;
+}
+
+// returns the object whose box the ray enters first within MaxDistance, -1 if there is none; Direction does not have to
+// be normalized, Distance is in its units
+
+int CBVH::RayCast(const vec3 &Origin, const vec3 &Direction, float MaxDistance, float &Distance)
+{
+	Distance = MaxDistance;
+
+	if(NodesCount == 0)
+	{
+		return -1;
+	}
+
+	vec3 InverseDirection(1.0f / Direction.x, 1.0f / Direction.y, 1.0f / Direction.z);
+
+	CBVHStackEntry Stack[BVH_STACK_SIZE];
+	int StackSize = 0, Closest = -1;
+
+	float NodeDistance;
+
+	if(IntersectRay(Nodes[0].Min, Nodes[0].Max, Origin, InverseDirection, Distance, NodeDistance))
+	{
+		Stack[StackSize].Node = 0;
+		Stack[StackSize++].Distance = NodeDistance;
+	}
+
+	while(StackSize > 0)
+	{
+		CBVHStackEntry Entry = Stack[--StackSize];
+
+		if(Entry.Distance >= Distance)
+		{
+			continue;
+		}
+
+		const CBVHNode &Node = Nodes[Entry.Node];
+
+		if(Node.Count > 0)
+		{
+			for(int i = Node.First; i < Node.First + Node.Count; i++)
+			{
+				float ObjectDistance;
+
+				if(IntersectRay(Mins[i], Maxs[i], Origin, InverseDirection, Distance, ObjectDistance))
+				{
+					Distance = ObjectDistance;
+					Closest = Indices[i];
+				}
+			}
+
+			continue;
+		}
+
+		float LeftDistance, RightDistance;
+
+		bool Left = IntersectRay(Nodes[Node.First].Min, Nodes[Node.First].Max, Origin, InverseDirection, Distance, LeftDistance);
+		bool Right = IntersectRay(Nodes[Node.First + 1].Min, Nodes[Node.First + 1].Max, Origin, InverseDirection, Distance, RightDistance);
+
+		// the nearer child goes on top
+
+		bool LeftFirst = Left && (!Right || LeftDistance < RightDistance);
+
+		if(Left && !LeftFirst)
+		{
+			Stack[StackSize].Node = Node.First;
+			Stack[StackSize++].Distance = LeftDistance;
+		}
+
+		if(Right)
+		{
+			Stack[StackSize].Node = Node.First + 1;
+			Stack[StackSize++].Distance = RightDistance;
+		}
+
+		if(LeftFirst)
+		{
+			Stack[StackSize].Node = Node.First;
+			Stack[StackSize++].Distance = LeftDistance;
+		}
+	}
+
+	return Closest;
+}
+
+// writes the objects whose boxes are not entirely outside of the frustum into Objects, which has to have room for all
+// of them, and returns their number; the objects of nodes entirely inside are taken without testing them
+
+int CBVH::FrustumQuery(const CFrustum &Frustum, int *Objects)
+{
+	if(NodesCount == 0)
+	{
+		return 0;
+	}
+
+	int Stack[BVH_STACK_SIZE], StackSize = 0, ObjectsCount = 0;
+	bool Inside[BVH_STACK_SIZE];
+
+	Stack[StackSize] = 0;
+	Inside[StackSize++] = false;
+
+	while(StackSize > 0)
+	{
+		StackSize--;
+
+		const CBVHNode &Node = Nodes[Stack[StackSize]];
+		bool NodeInside = Inside[StackSize];
+
+		if(!NodeInside)
+		{
+			int Result = Classify(Frustum, Node.Min, Node.Max);
+
+			if(Result == 0)
+			{
+				continue;
+			}
+
+			NodeInside = Result == 2;
+		}
+
+		if(Node.Count > 0)
+		{
+			for(int i = Node.First; i < Node.First + Node.Count; i++)
+			{
+				if(NodeInside || Classify(Frustum, Mins[i], Maxs[i]) != 0)
+				{
+					Objects[ObjectsCount++] = Indices[i];
+				}
+			}
+
+			continue;
+		}
+
+		for(int i = 0; i < 2; i++)
+		{
+			Stack[StackSize] = Node.First + i;
+			Inside[StackSize++] = NodeInside;
+		}
+	}
+
+	return ObjectsCount;
+}
+
+// returns the object whose box is nearest to Point within MaxDistance, -1 if there is none; Distance is 0 for boxes
+// that hold the point
+
+int CBVH::Nearest(const vec3 &Point, float MaxDistance, float &Distance)
+{
+	Distance = MaxDistance;
+
+	if(NodesCount == 0)
+	{
+		return -1;
+	}
+
+	float SquaredMaxDistance = MaxDistance * MaxDistance;
+
+	CBVHStackEntry Stack[BVH_STACK_SIZE];
+	int StackSize = 0, Closest = -1;
+
+	Stack[StackSize].Node = 0;
+	Stack[StackSize++].Distance = SquaredDistance(Nodes[0].Min, Nodes[0].Max, Point);
+
+	while(StackSize > 0)
+	{
+		CBVHStackEntry Entry = Stack[--StackSize];
+
+		if(Entry.Distance >= SquaredMaxDistance)
+		{
+			continue;
+		}
+
+		const CBVHNode &Node = Nodes[Entry.Node];
+
+		if(Node.Count > 0)
+		{
+			for(int i = Node.First; i < Node.First + Node.Count; i++)
+			{
+				float ObjectDistance = SquaredDistance(Mins[i], Maxs[i], Point);
+
+				if(ObjectDistance < SquaredMaxDistance)
+				{
+					SquaredMaxDistance = ObjectDistance;
+					Closest = Indices[i];
+				}
+			}
+
+			continue;
+		}
+
+		float LeftDistance = SquaredDistance(Nodes[Node.First].Min, Nodes[Node.First].Max, Point);
+		float RightDistance = SquaredDistance(Nodes[Node.First + 1].Min, Nodes[Node.First + 1].Max, Point);
+
+		// the nearer child goes on top
+
+		bool RightFirst = LeftDistance < RightDistance;
+
+		Stack[StackSize].Node = Node.First + (RightFirst ? 1 : 0);
+		Stack[StackSize++].Distance = RightFirst ? RightDistance : LeftDistance;
+		Stack[StackSize].Node = Node.First + (RightFirst ? 0 : 1);
+		Stack[StackSize++].Distance = RightFirst ? LeftDistance : RightDistance;
+	}
+
+	if(Closest >= 0)
+	{
+		Distance = sqrtf(SquaredMaxDistance);
+	}
+
+	return Closest;
+}
+
+int CBVH::GetCount()
+{
+	return Count;
+}
+
+void CBVH::GetStats(CBVHStats &Stats)
+{
+	Stats = this->Stats;
+}
+
+void CBVH::Destroy()
+{
+	delete [] Nodes;
+	delete [] Mins;
+	delete [] Maxs;
+	delete [] Centers;
+	delete [] Indices;
+	delete [] Slots;
+
+	Nodes = NULL;
+	NodesCount = 0;
+	Mins = Maxs = Centers = NULL;
+	Indices = Slots = NULL;
+	Count = 0;
+
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+// the objects are binned by their centers along all three axes and split where the summed areas of the two sides times
+// their objects are smallest; a node becomes a leaf when no split is cheaper than testing all of its objects, objects
+// with the same center are split in halves
+
+void CBVH::BuildNode(int NodeIndex, int First, int Count, int Depth)
+{
+	CBVHNode &Node = Nodes[NodeIndex];
+
+	vec3 CentersMin, CentersMax;
+
+	ComputeBounds(First, Count, Node.Min, Node.Max, CentersMin, CentersMax);
+
+	if(Count <= 1 || Depth >= BVH_MAX_DEPTH)
+	{
+		Node.First = First;
+		Node.Count = Count;
+		return;
+	}
+
+	vec3 Scale;
+
+	for(int a = 0; a < 3; a++)
+	{
+		float Extent = CentersMax[a] - CentersMin[a];
+
+		Scale[a] = Extent > 0.0f ? BVH_BINS / Extent : 0.0f;
+	}
+
+	// large nodes are binned in chunks on the thread pool, the bins of the chunks are summed afterwards
+
+	int ChunksCount = (Count + BVH_PARALLEL_GRAIN - 1) / BVH_PARALLEL_GRAIN;
+
+	CBVHBin NodeBins[3 * BVH_BINS];
+	std::vector<CBVHBin> ChunkBins(ChunksCount > 1 ? ChunksCount * 3 * BVH_BINS : 0);
+
+	CBVHBin *Bins = ChunksCount > 1 ? &ChunkBins[0] : NodeBins;
+
+	auto BinObjects = [&](int Begin, int End)
+	{
+		CBVHBin *ChunkBins = Bins + Begin / BVH_PARALLEL_GRAIN * 3 * BVH_BINS;
+
+		ResetBins(ChunkBins, 3 * BVH_BINS);
+
+		for(int i = First + Begin; i < First + End; i++)
+		{
+			int Object = Indices[i];
+
+			for(int a = 0; a < 3; a++)
+			{
+				CBVHBin &Bin = ChunkBins[a * BVH_BINS + BinIndex(Centers[Object][a], CentersMin[a], Scale[a])];
+
+				GrowBin(Bin, &Mins[Object].x, &Maxs[Object].x, 1);
+			}
+		}
+	};
+
+	// the std::function of the thread pool costs more than binning a small node
+
+	if(ChunksCount > 1)
+	{
+		ThreadPool.ParallelFor(Count, BVH_PARALLEL_GRAIN, BinObjects);
+	}
+	else
+	{
+		BinObjects(0, Count);
+	}
+
+	for(int c = 1; c < ChunksCount; c++)
+	{
+		for(int i = 0; i < 3 * BVH_BINS; i++)
+		{
+			CBVHBin &Bin = Bins[c * 3 * BVH_BINS + i];
+
+			GrowBin(Bins[i], Bin.Min, Bin.Max, Bin.Count);
+		}
+	}
+
+	float BestCost = FLT_MAX;
+	int BestAxis = -1, BestSplit = 0;
+
+	for(int a = 0; a < 3; a++)
+	{
+		if(Scale[a] == 0.0f)
+		{
+			continue;
+		}
+
+		CBVHBin *AxisBins = Bins + a * BVH_BINS;
+
+		float RightCosts[BVH_BINS];
+
+		CBVHBin Side;
+
+		ResetBins(&Side, 1);
+
+		for(int b = BVH_BINS - 1; b > 0; b--)
+		{
+			GrowBin(Side, AxisBins[b].Min, AxisBins[b].Max, AxisBins[b].Count);
+
+			RightCosts[b] = Side.Count * SurfaceArea(Side.Min, Side.Max);
+		}
+
+		ResetBins(&Side, 1);
+
+		for(int b = 1; b < BVH_BINS; b++)
+		{
+			GrowBin(Side, AxisBins[b - 1].Min, AxisBins[b - 1].Max, AxisBins[b - 1].Count);
+
+			float Cost = Side.Count * SurfaceArea(Side.Min, Side.Max) + RightCosts[b];
+
+			if(Side.Count > 0 && Side.Count < Count && Cost < BestCost)
+			{
+				BestCost = Cost;
+				BestAxis = a;
+				BestSplit = b;
+			}
+		}
+	}
+
+	// a traversal step costs as much as testing one object
+
+	float Area = SurfaceArea(&Node.Min.x, &Node.Max.x);
+
+	bool Split = BestAxis >= 0 && (Count > BVH_MAX_LEAF_SIZE || Area <= 0.0f || 1.0f + BestCost / Area < Count);
+
+	if(!Split && Count <= BVH_MAX_LEAF_SIZE)
+	{
+		Node.First = First;
+		Node.Count = Count;
+		return;
+	}
+
+	int Middle = Count / 2;
+
+	if(BestAxis >= 0)
+	{
+		float CentersMinAxis = CentersMin[BestAxis], ScaleAxis = Scale[BestAxis];
+
+		int *Partition = std::partition(Indices + First, Indices + First + Count, [&](int Object)
+		{
+			return BinIndex(Centers[Object][BestAxis], CentersMinAxis, ScaleAxis) < BestSplit;
+		});
+
+		Middle = (int)(Partition - (Indices + First));
+	}
+
+	int Child = NodesCount.fetch_add(2);
+
+	Node.First = Child;
+	Node.Count = 0;
+
+	if(Count > BVH_PARALLEL_GRAIN)
+	{
+		ThreadPool.ParallelFor(2, 1, [&](int Begin, int End)
+		{
+			for(int i = Begin; i < End; i++)
+			{
+				BuildNode(Child + i, i == 0 ? First : First + Middle, i == 0 ? Middle : Count - Middle, Depth + 1);
+			}
+		});
+	}
+	else
+	{
+		BuildNode(Child, First, Middle, Depth + 1);
+		BuildNode(Child + 1, First + Middle, Count - Middle, Depth + 1);
+	}
+}
+
+void CBVH::ComputeBounds(int First, int Count, vec3 &Min, vec3 &Max, vec3 &CentersMin, vec3 &CentersMax)
+{
+	int ChunksCount = (Count + BVH_PARALLEL_GRAIN - 1) / BVH_PARALLEL_GRAIN;
+
+	vec3 NodeBounds[4];
+	std::vector<vec3> ChunkBounds(ChunksCount > 1 ? ChunksCount * 4 : 0);
+
+	vec3 *AllBounds = ChunksCount > 1 ? &ChunkBounds[0] : NodeBounds;
+
+	auto BoundObjects = [&](int Begin, int End)
+	{
+		vec3 *Bounds = AllBounds + Begin / BVH_PARALLEL_GRAIN * 4;
+
+		Bounds[0] = Bounds[2] = vec3(FLT_MAX);
+		Bounds[1] = Bounds[3] = vec3(-FLT_MAX);
+
+		for(int i = First + Begin; i < First + End; i++)
+		{
+			int Object = Indices[i];
+
+			Bounds[0] = min(Bounds[0], Mins[Object]);
+			Bounds[1] = max(Bounds[1], Maxs[Object]);
+			Bounds[2] = min(Bounds[2], Centers[Object]);
+			Bounds[3] = max(Bounds[3], Centers[Object]);
+		}
+	};
+
+	if(ChunksCount > 1)
+	{
+		ThreadPool.ParallelFor(Count, BVH_PARALLEL_GRAIN, BoundObjects);
+	}
+	else
+	{
+		BoundObjects(0, Count);
+	}
+
+	Min = CentersMin = vec3(FLT_MAX);
+	Max = CentersMax = vec3(-FLT_MAX);
+
+	for(int c = 0; c < ChunksCount; c++)
+	{
+		Min = min(Min, AllBounds[c * 4 + 0]);
+		Max = max(Max, AllBounds[c * 4 + 1]);
+		CentersMin = min(CentersMin, AllBounds[c * 4 + 2]);
+		CentersMax = max(CentersMax, AllBounds[c * 4 + 3]);
+	}
+}
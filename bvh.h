@@ -0,0 +1,73 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+#include "culling.h"
+
+#include <atomic>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the bins per axis of the surface area heuristic, the objects a leaf holds at most unless the tree gets too deep, and
+// the objects above which a node is binned in chunks on the thread pool and its children are built as separate jobs
+
+#define BVH_BINS 16
+#define BVH_MAX_LEAF_SIZE 8
+#define BVH_MAX_DEPTH 60
+#define BVH_PARALLEL_GRAIN 65536
+
+// 32 bytes, an inner node has a Count of 0 and its children at First and First + 1, a leaf has its objects at First in
+// the index array
+
+struct CBVHNode
+{
+	vec3 Min;
+	int First;
+	vec3 Max;
+	int Count;
+};
+
+// the times are summed over Builds and Refits
+
+struct CBVHStats
+{
+	int Objects, Nodes, Leaves, Depth, Builds, Refits;
+	double BuildTime, RefitTime;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// a bounding volume hierarchy over axis aligned boxes; Build splits the objects with a binned surface area heuristic and
+// keeps their boxes in the order of the leaves, Slots finds them by object; after SetBounds Refit grows and shrinks the
+// boxes of the nodes bottom up without changing the tree, which stays good as long as the objects move little relative
+// to each other; the queries walk the tree with a stack, nearer children first, and return objects by the index they
+// were built with
+
+class CBVH
+{
+protected:
+	CBVHNode *Nodes;
+	std::atomic<int> NodesCount;
+	vec3 *Mins, *Maxs, *Centers;
+	int *Indices, *Slots;
+	int Count;
+	CBVHStats Stats;
+
+public:
+	CBVH();
+	~CBVH();
+
+	void Build(const vec3 *Mins, const vec3 *Maxs, int Count);
+	void SetBounds(int Object, const vec3 &Min, const vec3 &Max);
+	void GetBounds(int Object, vec3 &Min, vec3 &Max);
+	void Refit();
+	int RayCast(const vec3 &Origin, const vec3 &Direction, float MaxDistance, float &Distance);
+	int FrustumQuery(const CFrustum &Frustum, int *Objects);
+	int Nearest(const vec3 &Point, float MaxDistance, float &Distance);
+	int GetCount();
+	void GetStats(CBVHStats &Stats);
+	void Destroy();
+
+protected:
+	void BuildNode(int Node, int First, int Count, int Depth);
+	void ComputeBounds(int First, int Count, vec3 &Min, vec3 &Max, vec3 &CentersMin, vec3 &CentersMax);
+};
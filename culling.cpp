@@ -0,0 +1,397 @@
+#include "culling.h"
+#include "profiler.h"
+#include "simd.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <math.h>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CFrustum::CFrustum()
+{
+	memset(Planes, 0, sizeof(Planes));
+}
+
+// the planes are sums and differences of the fourth row of the matrix and the other three, glm stores columns
+
+void CFrustum::Set(const mat4x4 &ViewProjection)
+{
+	for(int i = 0; i < 6; i++)
+	{
+		int Row = i / 2;
+		float Sign = i & 1 ? -1.0f : 1.0f;
+
+		for(int j = 0; j < 4; j++)
+		{
+			Planes[i][j] = ViewProjection[j][3] + Sign * ViewProjection[j][Row];
+		}
+
+		float Length = sqrtf(Planes[i][0] * Planes[i][0] + Planes[i][1] * Planes[i][1] + Planes[i][2] * Planes[i][2]);
+
+		if(Length > 0.0f)
+		{
+			for(int j = 0; j < 4; j++)
+			{
+				Planes[i][j] /= Length;
+			}
+		}
+	}
+}
+
+bool CFrustum::IsVisible(const vec3 &Center, const vec3 &Extents, float Radius) const
+{
+	for(int i = 0; i < 6; i++)
+	{
+		const float *Plane = Planes[i];
+
+		float Distance = Plane[0] * Center.x + Plane[1] * Center.y + Plane[2] * Center.z + Plane[3];
+		float Reach = fabsf(Plane[0]) * Extents.x + fabsf(Plane[1]) * Extents.y + fabsf(Plane[2]) * Extents.z + Radius;
+
+		if(Distance + Reach < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the kernels write the index of every volume and advance only past the visible ones, which keeps the compaction free of
+// branches; Bounds holds the centers, the extents and the radii
+
+static int CullScalar(const float *const *Bounds, const CFrustum &Frustum, int Begin, int End, int *Visible)
+{
+	int VisibleCount = 0;
+
+	for(int i = Begin; i < End; i++)
+	{
+		vec3 Center(Bounds[0][i], Bounds[1][i], Bounds[2][i]), Extents(Bounds[3][i], Bounds[4][i], Bounds[5][i]);
+
+		Visible[VisibleCount] = i;
+		VisibleCount += Frustum.IsVisible(Center, Extents, Bounds[6][i]) ? 1 : 0;
+	}
+
+	return VisibleCount;
+}
+
+#if defined(SIMD_X86)
+
+SIMD_TARGET("sse2") static int CullSSE2(const float *const *Bounds, const CFrustum &Frustum, int Begin, int End, int *Visible)
+{
+	__m128 Planes[6][4], AbsolutePlanes[6][3];
+	__m128 SignMask = _mm_set1_ps(-0.0f), Zero = _mm_setzero_ps();
+
+	for(int p = 0; p < 6; p++)
+	{
+		for(int j = 0; j < 4; j++)
+		{
+			Planes[p][j] = _mm_set1_ps(Frustum.Planes[p][j]);
+		}
+
+		for(int j = 0; j < 3; j++)
+		{
+			AbsolutePlanes[p][j] = _mm_andnot_ps(SignMask, Planes[p][j]);
+		}
+	}
+
+	int VisibleCount = 0;
+
+	for(int i = Begin; i < End; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(Bounds[0] + i), y = _mm_loadu_ps(Bounds[1] + i), z = _mm_loadu_ps(Bounds[2] + i);
+		__m128 ex = _mm_loadu_ps(Bounds[3] + i), ey = _mm_loadu_ps(Bounds[4] + i), ez = _mm_loadu_ps(Bounds[5] + i);
+		__m128 r = _mm_loadu_ps(Bounds[6] + i);
+
+		__m128 Outside = _mm_setzero_ps();
+
+		for(int p = 0; p < 6; p++)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Planes[p][0], x), _mm_mul_ps(Planes[p][1], y)), _mm_add_ps(_mm_mul_ps(Planes[p][2], z), Planes[p][3]));
+			__m128 Reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(AbsolutePlanes[p][0], ex), _mm_mul_ps(AbsolutePlanes[p][1], ey)), _mm_add_ps(_mm_mul_ps(AbsolutePlanes[p][2], ez), r));
+
+			Outside = _mm_or_ps(Outside, _mm_cmplt_ps(_mm_add_ps(d, Reach), Zero));
+		}
+
+		int Mask = ~_mm_movemask_ps(Outside);
+
+		for(int k = 0; k < 4; k++)
+		{
+			Visible[VisibleCount] = i + k;
+			VisibleCount += (Mask >> k) & 1;
+		}
+	}
+
+	return VisibleCount;
+}
+
+SIMD_TARGET("avx2") static int CullAVX2(const float *const *Bounds, const CFrustum &Frustum, int Begin, int End, int *Visible)
+{
+	__m256 Planes[6][4], AbsolutePlanes[6][3];
+	__m256 SignMask = _mm256_set1_ps(-0.0f), Zero = _mm256_setzero_ps();
+
+	for(int p = 0; p < 6; p++)
+	{
+		for(int j = 0; j < 4; j++)
+		{
+			Planes[p][j] = _mm256_set1_ps(Frustum.Planes[p][j]);
+		}
+
+		for(int j = 0; j < 3; j++)
+		{
+			AbsolutePlanes[p][j] = _mm256_andnot_ps(SignMask, Planes[p][j]);
+		}
+	}
+
+	int VisibleCount = 0;
+
+	for(int i = Begin; i < End; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(Bounds[0] + i), y = _mm256_loadu_ps(Bounds[1] + i), z = _mm256_loadu_ps(Bounds[2] + i);
+		__m256 ex = _mm256_loadu_ps(Bounds[3] + i), ey = _mm256_loadu_ps(Bounds[4] + i), ez = _mm256_loadu_ps(Bounds[5] + i);
+		__m256 r = _mm256_loadu_ps(Bounds[6] + i);
+
+		__m256 Outside = _mm256_setzero_ps();
+
+		for(int p = 0; p < 6; p++)
+		{
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Planes[p][0], x), _mm256_mul_ps(Planes[p][1], y)), _mm256_add_ps(_mm256_mul_ps(Planes[p][2], z), Planes[p][3]));
+			__m256 Reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(AbsolutePlanes[p][0], ex), _mm256_mul_ps(AbsolutePlanes[p][1], ey)), _mm256_add_ps(_mm256_mul_ps(AbsolutePlanes[p][2], ez), r));
+
+			Outside = _mm256_or_ps(Outside, _mm256_cmp_ps(_mm256_add_ps(d, Reach), Zero, _CMP_LT_OQ));
+		}
+
+		int Mask = ~_mm256_movemask_ps(Outside);
+
+		for(int k = 0; k < 8; k++)
+		{
+			Visible[VisibleCount] = i + k;
+			VisibleCount += (Mask >> k) & 1;
+		}
+	}
+
+	return VisibleCount;
+}
+
+#elif defined(SIMD_NEON)
+
+static int CullNEON(const float *const *Bounds, const CFrustum &Frustum, int Begin, int End, int *Visible)
+{
+	float32x4_t Planes[6][4], AbsolutePlanes[6][3];
+	float32x4_t Zero = vdupq_n_f32(0.0f);
+
+	for(int p = 0; p < 6; p++)
+	{
+		for(int j = 0; j < 4; j++)
+		{
+			Planes[p][j] = vdupq_n_f32(Frustum.Planes[p][j]);
+		}
+
+		for(int j = 0; j < 3; j++)
+		{
+			AbsolutePlanes[p][j] = vabsq_f32(Planes[p][j]);
+		}
+	}
+
+	int VisibleCount = 0;
+
+	for(int i = Begin; i < End; i += 4)
+	{
+		float32x4_t x = vld1q_f32(Bounds[0] + i), y = vld1q_f32(Bounds[1] + i), z = vld1q_f32(Bounds[2] + i);
+		float32x4_t ex = vld1q_f32(Bounds[3] + i), ey = vld1q_f32(Bounds[4] + i), ez = vld1q_f32(Bounds[5] + i);
+		float32x4_t r = vld1q_f32(Bounds[6] + i);
+
+		uint32x4_t Outside = vdupq_n_u32(0);
+
+		for(int p = 0; p < 6; p++)
+		{
+			float32x4_t d = vaddq_f32(vaddq_f32(vmulq_f32(Planes[p][0], x), vmulq_f32(Planes[p][1], y)), vaddq_f32(vmulq_f32(Planes[p][2], z), Planes[p][3]));
+			float32x4_t Reach = vaddq_f32(vaddq_f32(vmulq_f32(AbsolutePlanes[p][0], ex), vmulq_f32(AbsolutePlanes[p][1], ey)), vaddq_f32(vmulq_f32(AbsolutePlanes[p][2], ez), r));
+
+			Outside = vorrq_u32(Outside, vcltq_f32(vaddq_f32(d, Reach), Zero));
+		}
+
+		uint32_t Lanes[4];
+
+		vst1q_u32(Lanes, Outside);
+
+		for(int k = 0; k < 4; k++)
+		{
+			Visible[VisibleCount] = i + k;
+			VisibleCount += Lanes[k] == 0 ? 1 : 0;
+		}
+	}
+
+	return VisibleCount;
+}
+
+#endif
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CCulling::CCulling()
+{
+	CentersX = CentersY = CentersZ = ExtentsX = ExtentsY = ExtentsZ = Radii = NULL;
+	Count = PaddedCount = 0;
+	Visible = NULL;
+	VisibleCount = 0;
+	ChunkCounts = NULL;
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CCulling::~CCulling()
+{
+	Destroy();
+}
+
+// the padding volumes have a radius no plane can see past, until the first Cull every volume counts as visible
+
+void CCulling::Init(int Count)
+{
+	Destroy();
+
+	this->Count = Count;
+
+	PaddedCount = (Count + 7) & ~7;
+
+	CentersX = new float[PaddedCount];
+	CentersY = new float[PaddedCount];
+	CentersZ = new float[PaddedCount];
+	ExtentsX = new float[PaddedCount];
+	ExtentsY = new float[PaddedCount];
+	ExtentsZ = new float[PaddedCount];
+	Radii = new float[PaddedCount];
+	Visible = new int[PaddedCount];
+	ChunkCounts = new int[(PaddedCount + CULLING_GRAIN - 1) / CULLING_GRAIN];
+
+	for(int i = 0; i < PaddedCount; i++)
+	{
+		CentersX[i] = CentersY[i] = CentersZ[i] = ExtentsX[i] = ExtentsY[i] = ExtentsZ[i] = 0.0f;
+		Radii[i] = i < Count ? 0.0f : -1.0e30f;
+		Visible[i] = i;
+	}
+
+	VisibleCount = Count;
+
+	Stats.Objects = Stats.Visible = Count;
+}
+
+void CCulling::SetBox(int Index, const vec3 &Min, const vec3 &Max)
+{
+	CentersX[Index] = (Min.x + Max.x) * 0.5f;
+	CentersY[Index] = (Min.y + Max.y) * 0.5f;
+	CentersZ[Index] = (Min.z + Max.z) * 0.5f;
+	ExtentsX[Index] = (Max.x - Min.x) * 0.5f;
+	ExtentsY[Index] = (Max.y - Min.y) * 0.5f;
+	ExtentsZ[Index] = (Max.z - Min.z) * 0.5f;
+	Radii[Index] = 0.0f;
+}
+
+void CCulling::SetSphere(int Index, const vec3 &Center, float Radius)
+{
+	CentersX[Index] = Center.x;
+	CentersY[Index] = Center.y;
+	CentersZ[Index] = Center.z;
+	ExtentsX[Index] = ExtentsY[Index] = ExtentsZ[Index] = 0.0f;
+	Radii[Index] = Radius;
+}
+
+// returns the number of visible volumes
+
+int CCulling::Cull(const mat4x4 &ViewProjection)
+{
+	PROFILE_ZONE("CCulling::Cull");
+
+	double Start = GetTime();
+
+	Frustum.Set(ViewProjection);
+
+	const float *Bounds[7] = {CentersX, CentersY, CentersZ, ExtentsX, ExtentsY, ExtentsZ, Radii};
+
+	int ChunksCount = (PaddedCount + CULLING_GRAIN - 1) / CULLING_GRAIN;
+
+	ThreadPool.ParallelFor(ChunksCount, 1, [&](int First, int Last)
+	{
+		for(int Chunk = First; Chunk < Last; Chunk++)
+		{
+			int Begin = Chunk * CULLING_GRAIN, End = std::min(Begin + CULLING_GRAIN, PaddedCount);
+
+#if defined(SIMD_X86)
+			if(CPUFeatures.AVX2) ChunkCounts[Chunk] = CullAVX2(Bounds, Frustum, Begin, End, Visible + Begin);
+			else if(CPUFeatures.SSE2) ChunkCounts[Chunk] = CullSSE2(Bounds, Frustum, Begin, End, Visible + Begin);
+			else ChunkCounts[Chunk] = CullScalar(Bounds, Frustum, Begin, End, Visible + Begin);
+#elif defined(SIMD_NEON)
+			if(CPUFeatures.NEON) ChunkCounts[Chunk] = CullNEON(Bounds, Frustum, Begin, End, Visible + Begin);
+			else ChunkCounts[Chunk] = CullScalar(Bounds, Frustum, Begin, End, Visible + Begin);
+#else
+			ChunkCounts[Chunk] = CullScalar(Bounds, Frustum, Begin, End, Visible + Begin);
+#endif
+		}
+	});
+
+	VisibleCount = 0;
+
+	for(int Chunk = 0; Chunk < ChunksCount; Chunk++)
+	{
+		int Begin = Chunk * CULLING_GRAIN;
+
+		if(VisibleCount != Begin && ChunkCounts[Chunk] > 0)
+		{
+			memmove(Visible + VisibleCount, Visible + Begin, ChunkCounts[Chunk] * sizeof(int));
+		}
+
+		VisibleCount += ChunkCounts[Chunk];
+	}
+
+	Stats.Visible = VisibleCount;
+	Stats.Frames++;
+	Stats.CullTime += GetTime() - Start;
+
+	return VisibleCount;
+}
+
+const int* CCulling::GetVisible()
+{
+	return Visible;
+}
+
+int CCulling::GetVisibleCount()
+{
+	return VisibleCount;
+}
+
+int CCulling::GetCount()
+{
+	return Count;
+}
+
+const CFrustum& CCulling::GetFrustum()
+{
+	return Frustum;
+}
+
+void CCulling::GetStats(CCullingStats &Stats)
+{
+	Stats = this->Stats;
+}
+
+void CCulling::Destroy()
+{
+	delete [] CentersX;
+	delete [] CentersY;
+	delete [] CentersZ;
+	delete [] ExtentsX;
+	delete [] ExtentsY;
+	delete [] ExtentsZ;
+	delete [] Radii;
+	delete [] Visible;
+	delete [] ChunkCounts;
+
+	CentersX = CentersY = CentersZ = ExtentsX = ExtentsY = ExtentsZ = Radii = NULL;
+	Visible = ChunkCounts = NULL;
+	Count = PaddedCount = VisibleCount = 0;
+
+	memset(&Stats, 0, sizeof(Stats));
+}
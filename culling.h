@@ -0,0 +1,67 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// objects per job of the culling, a multiple of 8
+
+#define CULLING_GRAIN 16384
+
+// Visible is that of the last Cull, the time is summed over Frames
+
+struct CCullingStats
+{
+	int Objects, Visible, Frames;
+	double CullTime;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the left, right, bottom, top, near and far planes of a view projection matrix, normalized and facing inwards
+
+class CFrustum
+{
+public:
+	float Planes[6][4];
+
+public:
+	CFrustum();
+
+	void Set(const mat4x4 &ViewProjection);
+	bool IsVisible(const vec3 &Center, const vec3 &Extents, float Radius) const;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// bounding volumes as structure of arrays, padded to a multiple of 8; a volume is a box given by its center and extents
+// grown by a radius, so boxes have a radius of 0 and spheres extents of 0, and is outside when it is entirely behind one
+// of the planes; the volumes are tested 8 at a time with AVX2 or 4 at a time with SSE2 or NEON in chunks on the thread
+// pool, every chunk writes the indices of its visible volumes at its own offset and the chunks are moved together
+// afterwards, so the visible list keeps the order of the volumes
+
+class CCulling
+{
+protected:
+	float *CentersX, *CentersY, *CentersZ, *ExtentsX, *ExtentsY, *ExtentsZ, *Radii;
+	int Count, PaddedCount;
+	int *Visible, VisibleCount;
+	int *ChunkCounts;
+	CFrustum Frustum;
+	CCullingStats Stats;
+
+public:
+	CCulling();
+	~CCulling();
+
+	void Init(int Count);
+	void SetBox(int Index, const vec3 &Min, const vec3 &Max);
+	void SetSphere(int Index, const vec3 &Center, float Radius);
+	int Cull(const mat4x4 &ViewProjection);
+	const int* GetVisible();
+	int GetVisibleCount();
+	int GetCount();
+	const CFrustum& GetFrustum();
+	void GetStats(CCullingStats &Stats);
+	void Destroy();
+};
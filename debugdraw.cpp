@@ -0,0 +1,620 @@
+#include "debugdraw.h"
+#include "profiler.h"
+#include "shaderlibrary.h"
+
+#include <ctype.h>
+#include <math.h>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// a 16 segment display with two more strokes for V and a dot; x goes from 0 to 1, y from 0 to 2
+
+static const float Segments[][4] =
+{
+	{0.0f, 2.0f, 0.5f, 2.0f}, {0.5f, 2.0f, 1.0f, 2.0f}, {1.0f, 2.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f, 0.0f},
+	{1.0f, 0.0f, 0.5f, 0.0f}, {0.5f, 0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f, 2.0f},
+	{0.0f, 1.0f, 0.5f, 1.0f}, {0.5f, 1.0f, 1.0f, 1.0f}, {0.5f, 2.0f, 0.5f, 1.0f}, {0.5f, 1.0f, 0.5f, 0.0f},
+	{0.0f, 2.0f, 0.5f, 1.0f}, {1.0f, 2.0f, 0.5f, 1.0f}, {0.0f, 0.0f, 0.5f, 1.0f}, {1.0f, 0.0f, 0.5f, 1.0f},
+	{0.0f, 1.0f, 0.5f, 0.0f}, {1.0f, 1.0f, 0.5f, 0.0f}, {0.4f, 0.0f, 0.6f, 0.0f}
+};
+
+#define SEGMENT(Index) (1u << (Index))
+#define SEGMENTS_TOP (SEGMENT(0) | SEGMENT(1))
+#define SEGMENTS_RIGHT (SEGMENT(2) | SEGMENT(3))
+#define SEGMENTS_BOTTOM (SEGMENT(4) | SEGMENT(5))
+#define SEGMENTS_LEFT (SEGMENT(6) | SEGMENT(7))
+#define SEGMENTS_MIDDLE (SEGMENT(8) | SEGMENT(9))
+#define SEGMENTS_CENTER (SEGMENT(10) | SEGMENT(11))
+
+struct CGlyph
+{
+	char Character;
+	unsigned int Segments;
+};
+
+static const CGlyph Glyphs[] =
+{
+	{'0', SEGMENTS_TOP | SEGMENTS_RIGHT | SEGMENTS_BOTTOM | SEGMENTS_LEFT | SEGMENT(13) | SEGMENT(14)},
+	{'1', SEGMENTS_RIGHT},
+	{'2', SEGMENTS_TOP | SEGMENT(2) | SEGMENTS_MIDDLE | SEGMENT(6) | SEGMENTS_BOTTOM},
+	{'3', SEGMENTS_TOP | SEGMENTS_RIGHT | SEGMENT(9) | SEGMENTS_BOTTOM},
+	{'4', SEGMENT(7) | SEGMENTS_MIDDLE | SEGMENTS_RIGHT},
+	{'5', SEGMENTS_TOP | SEGMENT(7) | SEGMENTS_MIDDLE | SEGMENT(3) | SEGMENTS_BOTTOM},
+	{'6', SEGMENTS_TOP | SEGMENTS_LEFT | SEGMENTS_MIDDLE | SEGMENT(3) | SEGMENTS_BOTTOM},
+	{'7', SEGMENTS_TOP | SEGMENTS_RIGHT},
+	{'8', SEGMENTS_TOP | SEGMENTS_RIGHT | SEGMENTS_BOTTOM | SEGMENTS_LEFT | SEGMENTS_MIDDLE},
+	{'9', SEGMENTS_TOP | SEGMENT(7) | SEGMENTS_RIGHT | SEGMENTS_MIDDLE | SEGMENTS_BOTTOM},
+	{'A', SEGMENTS_TOP | SEGMENTS_LEFT | SEGMENTS_RIGHT | SEGMENTS_MIDDLE},
+	{'B', SEGMENTS_TOP | SEGMENTS_RIGHT | SEGMENTS_BOTTOM | SEGMENTS_CENTER | SEGMENT(9)},
+	{'C', SEGMENTS_TOP | SEGMENTS_LEFT | SEGMENTS_BOTTOM},
+	{'D', SEGMENTS_TOP | SEGMENTS_RIGHT | SEGMENTS_BOTTOM | SEGMENTS_CENTER},
+	{'E', SEGMENTS_TOP | SEGMENTS_LEFT | SEGMENTS_BOTTOM | SEGMENT(8)},
+	{'F', SEGMENTS_TOP | SEGMENTS_LEFT | SEGMENT(8)},
+	{'G', SEGMENTS_TOP | SEGMENTS_LEFT | SEGMENTS_BOTTOM | SEGMENT(3) | SEGMENT(9)},
+	{'H', SEGMENTS_LEFT | SEGMENTS_RIGHT | SEGMENTS_MIDDLE},
+	{'I', SEGMENTS_TOP | SEGMENTS_BOTTOM | SEGMENTS_CENTER},
+	{'J', SEGMENTS_RIGHT | SEGMENTS_BOTTOM | SEGMENT(6)},
+	{'K', SEGMENTS_LEFT | SEGMENT(8) | SEGMENT(13) | SEGMENT(15)},
+	{'L', SEGMENTS_LEFT | SEGMENTS_BOTTOM},
+	{'M', SEGMENTS_LEFT | SEGMENTS_RIGHT | SEGMENT(12) | SEGMENT(13)},
+	{'N', SEGMENTS_LEFT | SEGMENTS_RIGHT | SEGMENT(12) | SEGMENT(15)},
+	{'O', SEGMENTS_TOP | SEGMENTS_RIGHT | SEGMENTS_BOTTOM | SEGMENTS_LEFT},
+	{'P', SEGMENTS_TOP | SEGMENTS_LEFT | SEGMENT(2) | SEGMENTS_MIDDLE},
+	{'Q', SEGMENTS_TOP | SEGMENTS_RIGHT | SEGMENTS_BOTTOM | SEGMENTS_LEFT | SEGMENT(15)},
+	{'R', SEGMENTS_TOP | SEGMENTS_LEFT | SEGMENT(2) | SEGMENTS_MIDDLE | SEGMENT(15)},
+	{'S', SEGMENTS_TOP | SEGMENT(7) | SEGMENTS_MIDDLE | SEGMENT(3) | SEGMENTS_BOTTOM},
+	{'T', SEGMENTS_TOP | SEGMENTS_CENTER},
+	{'U', SEGMENTS_LEFT | SEGMENTS_RIGHT | SEGMENTS_BOTTOM},
+	{'V', SEGMENT(7) | SEGMENT(2) | SEGMENT(16) | SEGMENT(17)},
+	{'W', SEGMENTS_LEFT | SEGMENTS_RIGHT | SEGMENT(14) | SEGMENT(15)},
+	{'X', SEGMENT(12) | SEGMENT(13) | SEGMENT(14) | SEGMENT(15)},
+	{'Y', SEGMENT(12) | SEGMENT(13) | SEGMENT(11)},
+	{'Z', SEGMENTS_TOP | SEGMENT(13) | SEGMENT(14) | SEGMENTS_BOTTOM},
+	{'-', SEGMENTS_MIDDLE},
+	{'+', SEGMENTS_MIDDLE | SEGMENTS_CENTER},
+	{'=', SEGMENTS_MIDDLE | SEGMENTS_BOTTOM},
+	{'_', SEGMENTS_BOTTOM},
+	{'/', SEGMENT(13) | SEGMENT(14)},
+	{'.', SEGMENT(18)}
+};
+
+// the edges of a box whose corners are numbered by x in bit 0, y in bit 1 and z in bit 2
+
+static const int BoxEdges[12][2] =
+{
+	{0, 1}, {2, 3}, {4, 5}, {6, 7}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {0, 4}, {1, 5}, {2, 6}, {3, 7}
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CDebugDraw::CDebugDraw()
+{
+	ProgramVariant = -1;
+	Program = NULL;
+	PositionAttribute = ColorAttribute = -1;
+	Buffer = VertexArray = 0;
+	Mapped = NULL;
+	memset(Fences, 0, sizeof(Fences));
+	Region = 0;
+	Enabled = false;
+	Right = vec3(1.0f, 0.0f, 0.0f);
+	Up = vec3(0.0f, 1.0f, 0.0f);
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CDebugDraw::~CDebugDraw()
+{
+}
+
+// GLSL 1.50 from OpenGL 3.2 on, as core profiles may not take 1.20
+
+void CDebugDraw::AddPrograms()
+{
+	if(ProgramVariant != -1)
+	{
+		return;
+	}
+
+	if(gl_version >= 32)
+	{
+		ProgramVariant = ShaderLibrary.Add("glsl150debugdraw.vs", "glsl150debugdraw.fs");
+	}
+	else if(gl_version >= 21)
+	{
+		ProgramVariant = ShaderLibrary.Add("glsl120debugdraw.vs", "glsl120debugdraw.fs");
+	}
+}
+
+bool CDebugDraw::Init()
+{
+	if(gl_version < 15)
+	{
+		return true;
+	}
+
+	if(gl_version >= 21)
+	{
+		AddPrograms();
+
+		if((Program = ShaderLibrary.Get(ProgramVariant)) == NULL)
+		{
+			return false;
+		}
+
+		PositionAttribute = glGetAttribLocation(*Program, "Position");
+		ColorAttribute = glGetAttribLocation(*Program, "Color");
+	}
+
+	GLsizeiptr Size = DEBUG_DRAW_MAX_VERTICES * sizeof(CDebugVertex);
+
+	glGenBuffers(1, &Buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, Buffer);
+
+	if(IsPersistentMappingSupported())
+	{
+		GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glBufferStorage(GL_ARRAY_BUFFER, Size * DEBUG_DRAW_REGIONS, NULL, Flags);
+
+		Mapped = (CDebugVertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, Size * DEBUG_DRAW_REGIONS, Flags);
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, Size, NULL, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	VertexArray = CreateVertexArray(Buffer);
+
+	Enabled = true;
+
+	return true;
+}
+
+bool CDebugDraw::IsEnabled()
+{
+	return Enabled;
+}
+
+// the text faces the camera
+
+void CDebugDraw::Begin(const mat4x4 &View, const mat4x4 &Projection)
+{
+	ViewProjection = Projection * View;
+
+	Right = vec3(View[0][0], View[1][0], View[2][0]);
+	Up = vec3(View[0][1], View[1][1], View[2][1]);
+
+	Stats.Vertices = Stats.DrawCalls = 0;
+}
+
+void CDebugDraw::Line(const vec3 &a, const vec3 &b, DWORD Color)
+{
+	CDebugVertex Vertices[2] = {{a, Color}, {b, Color}};
+
+	Lines.insert(Lines.end(), Vertices, Vertices + 2);
+}
+
+void CDebugDraw::Point(const vec3 &Position, DWORD Color)
+{
+	CDebugVertex Vertex = {Position, Color};
+
+	Points.push_back(Vertex);
+}
+
+void CDebugDraw::Box(const vec3 &Min, const vec3 &Max, DWORD Color)
+{
+	vec3 Corners[8];
+
+	for(int i = 0; i < 8; i++)
+	{
+		Corners[i] = vec3(i & 1 ? Max.x : Min.x, i & 2 ? Max.y : Min.y, i & 4 ? Max.z : Min.z);
+	}
+
+	Edges(Corners, Color);
+}
+
+// the cube from -0.5 to 0.5 transformed
+
+void CDebugDraw::Box(const mat4x4 &Transform, DWORD Color)
+{
+	vec3 Corners[8];
+
+	for(int i = 0; i < 8; i++)
+	{
+		vec4 Corner = Transform * vec4(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f, 1.0f);
+
+		Corners[i] = vec3(Corner.x, Corner.y, Corner.z);
+	}
+
+	Edges(Corners, Color);
+}
+
+// three great circles
+
+void CDebugDraw::Sphere(const vec3 &Center, float Radius, DWORD Color, int Segments)
+{
+	vec3 Previous[3];
+
+	for(int i = 0; i <= Segments; i++)
+	{
+		float Angle = i * 6.28318531f / Segments;
+		float s = sinf(Angle) * Radius, c = cosf(Angle) * Radius;
+
+		vec3 Current[3] = {Center + vec3(c, s, 0.0f), Center + vec3(c, 0.0f, s), Center + vec3(0.0f, c, s)};
+
+		for(int k = 0; i > 0 && k < 3; k++)
+		{
+			Line(Previous[k], Current[k], Color);
+		}
+
+		for(int k = 0; k < 3; k++)
+		{
+			Previous[k] = Current[k];
+		}
+	}
+}
+
+// the corners of the clip space cube taken back to world space
+
+void CDebugDraw::Frustum(const mat4x4 &ViewProjection, DWORD Color)
+{
+	mat4x4 InverseViewProjection = inverse(ViewProjection);
+
+	vec3 Corners[8];
+
+	for(int i = 0; i < 8; i++)
+	{
+		vec4 Corner = InverseViewProjection * vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+
+		Corners[i] = vec3(Corner.x, Corner.y, Corner.z) / Corner.w;
+	}
+
+	Edges(Corners, Color);
+}
+
+// centered on Position; lowercase letters are drawn as uppercase ones, characters without a glyph as spaces
+
+void CDebugDraw::Text(const vec3 &Position, float Height, const char *Text, DWORD Color)
+{
+	float Scale = Height * 0.5f, Advance = Height * 0.75f;
+
+	int Length = (int)strlen(Text);
+
+	vec3 Origin = Position - Right * ((Length * Advance - (Advance - Scale)) * 0.5f) - Up * (Height * 0.5f);
+
+	for(int i = 0; i < Length; i++, Origin = Origin + Right * Advance)
+	{
+		char Character = (char)toupper((unsigned char)Text[i]);
+
+		unsigned int Mask = 0;
+
+		for(int g = 0; g < (int)(sizeof(Glyphs) / sizeof(Glyphs[0])); g++)
+		{
+			if(Glyphs[g].Character == Character)
+			{
+				Mask = Glyphs[g].Segments;
+				break;
+			}
+		}
+
+		for(int s = 0; Mask != 0; s++, Mask >>= 1)
+		{
+			if(Mask & 1)
+			{
+				Line(Origin + Right * (Segments[s][0] * Scale) + Up * (Segments[s][1] * Scale), Origin + Right * (Segments[s][2] * Scale) + Up * (Segments[s][3] * Scale), Color);
+			}
+		}
+	}
+}
+
+// returns the batch for Draw, -1 when there is nothing to draw it with
+
+int CDebugDraw::Bake()
+{
+	if(!Enabled)
+	{
+		Lines.clear();
+		Points.clear();
+		return -1;
+	}
+
+	CDebugDrawBatch Batch;
+
+	Batch.LinesCount = (int)Lines.size();
+	Batch.PointsCount = (int)Points.size();
+
+	glGenBuffers(1, &Batch.Buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, Batch.Buffer);
+	glBufferData(GL_ARRAY_BUFFER, (Batch.LinesCount + Batch.PointsCount) * sizeof(CDebugVertex), NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, Batch.LinesCount * sizeof(CDebugVertex), Lines.data());
+	glBufferSubData(GL_ARRAY_BUFFER, Batch.LinesCount * sizeof(CDebugVertex), Batch.PointsCount * sizeof(CDebugVertex), Points.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	Batch.VertexArray = CreateVertexArray(Batch.Buffer);
+
+	Batches.push_back(Batch);
+
+	Lines.clear();
+	Points.clear();
+
+	return (int)Batches.size() - 1;
+}
+
+void CDebugDraw::Draw(int Batch)
+{
+	if(Batch < 0 || Batch >= (int)Batches.size())
+	{
+		return;
+	}
+
+	const CDebugDrawBatch &DrawBatch = Batches[Batch];
+
+	Bind(DrawBatch.Buffer, DrawBatch.VertexArray);
+
+	if(DrawBatch.LinesCount > 0)
+	{
+		glDrawArrays(GL_LINES, 0, DrawBatch.LinesCount);
+
+		Stats.DrawCalls++;
+	}
+
+	if(DrawBatch.PointsCount > 0)
+	{
+		glPointSize(DEBUG_DRAW_POINT_SIZE);
+		glDrawArrays(GL_POINTS, DrawBatch.LinesCount, DrawBatch.PointsCount);
+		glPointSize(1.0f);
+
+		Stats.DrawCalls++;
+	}
+
+	Stats.Vertices += DrawBatch.LinesCount + DrawBatch.PointsCount;
+
+	Unbind(DrawBatch.VertexArray);
+}
+
+// a region is written again DEBUG_DRAW_REGIONS frames later, the wait for its fence only blocks when the GPU is that
+// far behind; what does not fit into DEBUG_DRAW_MAX_VERTICES is dropped, lines first kept
+
+void CDebugDraw::Flush()
+{
+	PROFILE_GPU_ZONE("CDebugDraw::Flush");
+
+	int LinesCount = std::min((int)Lines.size(), DEBUG_DRAW_MAX_VERTICES) & ~1;
+	int PointsCount = std::min((int)Points.size(), DEBUG_DRAW_MAX_VERTICES - LinesCount);
+
+	Stats.Dropped += (int)(Lines.size() + Points.size()) - LinesCount - PointsCount;
+	if(Enabled && LinesCount + PointsCount > 0)
+	{
+		int First = 0;
+
+		if(Mapped)
+		{
+			if(Fences[Region])
+			{
+				if(glClientWaitSync(Fences[Region], GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+				{
+					Stats.Waits++;
+
+					glClientWaitSync(Fences[Region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+				}
+
+				glDeleteSync(Fences[Region]);
+
+				Fences[Region] = 0;
+			}
+
+			First = Region * DEBUG_DRAW_MAX_VERTICES;
+
+			memcpy(Mapped + First, Lines.data(), LinesCount * sizeof(CDebugVertex));
+			memcpy(Mapped + First + LinesCount, Points.data(), PointsCount * sizeof(CDebugVertex));
+		}
+		else
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, Buffer);
+			glBufferData(GL_ARRAY_BUFFER, DEBUG_DRAW_MAX_VERTICES * sizeof(CDebugVertex), NULL, GL_STREAM_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, LinesCount * sizeof(CDebugVertex), Lines.data());
+			glBufferSubData(GL_ARRAY_BUFFER, LinesCount * sizeof(CDebugVertex), PointsCount * sizeof(CDebugVertex), Points.data());
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+
+		Bind(Buffer, VertexArray);
+
+		if(LinesCount > 0)
+		{
+			glDrawArrays(GL_LINES, First, LinesCount);
+
+			Stats.DrawCalls++;
+		}
+
+		if(PointsCount > 0)
+		{
+			glPointSize(DEBUG_DRAW_POINT_SIZE);
+			glDrawArrays(GL_POINTS, First + LinesCount, PointsCount);
+			glPointSize(1.0f);
+
+			Stats.DrawCalls++;
+		}
+
+		Unbind(VertexArray);
+
+		if(Mapped)
+		{
+			Fences[Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			Region = (Region + 1) % DEBUG_DRAW_REGIONS;
+		}
+
+		Stats.Vertices += LinesCount + PointsCount;
+	}
+
+	Lines.clear();
+	Points.clear();
+}
+
+void CDebugDraw::GetStats(CDebugDrawStats &Stats)
+{
+	Stats = this->Stats;
+}
+
+void CDebugDraw::Destroy()
+{
+	for(size_t i = 0; i < Batches.size(); i++)
+	{
+		if(Batches[i].VertexArray) glDeleteVertexArrays(1, &Batches[i].VertexArray);
+
+		glDeleteBuffers(1, &Batches[i].Buffer);
+	}
+
+	Batches.clear();
+
+	for(int i = 0; i < DEBUG_DRAW_REGIONS; i++)
+	{
+		if(Fences[i]) glDeleteSync(Fences[i]);
+
+		Fences[i] = 0;
+	}
+
+	if(Mapped)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, Buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		Mapped = NULL;
+	}
+
+	if(VertexArray) glDeleteVertexArrays(1, &VertexArray);
+	if(Buffer) glDeleteBuffers(1, &Buffer);
+
+	Buffer = VertexArray = 0;
+
+	// the program belongs to ShaderLibrary, which forgets its variants when it is destroyed too
+
+	ProgramVariant = -1;
+	Program = NULL;
+
+	PositionAttribute = ColorAttribute = -1;
+	Region = 0;
+	Enabled = false;
+
+	Lines.clear();
+	Points.clear();
+}
+
+bool CDebugDraw::IsPersistentMappingSupported()
+{
+	return (gl_version >= 44 || GLEW_ARB_buffer_storage) && (gl_version >= 32 || GLEW_ARB_sync);
+}
+
+void CDebugDraw::Edges(const vec3 *Corners, DWORD Color)
+{
+	for(int i = 0; i < 12; i++)
+	{
+		Line(Corners[BoxEdges[i][0]], Corners[BoxEdges[i][1]], Color);
+	}
+}
+
+// the vertex array keeps the pointers into the buffer, without one they are set for every draw
+
+GLuint CDebugDraw::CreateVertexArray(GLuint Buffer)
+{
+	GLuint VertexArray = 0;
+
+	if(gl_version >= 30 || GLEW_ARB_vertex_array_object)
+	{
+		glGenVertexArrays(1, &VertexArray);
+		glBindVertexArray(VertexArray);
+		glBindBuffer(GL_ARRAY_BUFFER, Buffer);
+
+		SetPointers();
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	return VertexArray;
+}
+
+// the fixed-function path draws with the matrices loaded at the time
+
+void CDebugDraw::Bind(GLuint Buffer, GLuint VertexArray)
+{
+	if(gl_version >= 21)
+	{
+		glUseProgram(*Program);
+		glUniformMatrix4fv(Program->GetUniformLocation(HASH_NAME32("ViewProjection")), 1, GL_FALSE, (GLfloat*)&ViewProjection);
+	}
+
+	if(VertexArray)
+	{
+		glBindVertexArray(VertexArray);
+		return;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, Buffer);
+
+	SetPointers();
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CDebugDraw::Unbind(GLuint VertexArray)
+{
+	if(VertexArray)
+	{
+		glBindVertexArray(0);
+	}
+	else
+	{
+		ResetPointers();
+	}
+
+	if(gl_version >= 21)
+	{
+		glUseProgram(0);
+	}
+}
+
+void CDebugDraw::SetPointers()
+{
+	if(gl_version >= 21)
+	{
+		glEnableVertexAttribArray(PositionAttribute);
+		glVertexAttribPointer(PositionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(CDebugVertex), (void*)offsetof(CDebugVertex, Position));
+
+		glEnableVertexAttribArray(ColorAttribute);
+		glVertexAttribPointer(ColorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CDebugVertex), (void*)offsetof(CDebugVertex, Color));
+	}
+	else
+	{
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(CDebugVertex), (void*)offsetof(CDebugVertex, Color));
+
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, sizeof(CDebugVertex), (void*)offsetof(CDebugVertex, Position));
+	}
+}
+
+// the current color is undefined after drawing with a color array
+
+void CDebugDraw::ResetPointers()
+{
+	if(gl_version >= 21)
+	{
+		glDisableVertexAttribArray(PositionAttribute);
+		glDisableVertexAttribArray(ColorAttribute);
+	}
+	else
+	{
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glDisableClientState(GL_COLOR_ARRAY);
+
+		glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CDebugDraw DebugDraw;
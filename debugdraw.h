@@ -0,0 +1,99 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the vertices a frame may draw, lines and points together, and the frames the ring buffer holds them for
+
+#define DEBUG_DRAW_MAX_VERTICES 65536
+#define DEBUG_DRAW_REGIONS 3
+#define DEBUG_DRAW_POINT_SIZE 4.0f
+
+// 16 bytes, the color is RGBA with red in the lowest byte
+
+struct CDebugVertex
+{
+	vec3 Position;
+	DWORD Color;
+};
+
+inline DWORD DebugColor(float r, float g, float b, float a = 1.0f)
+{
+	return (DWORD)(r * 255.0f + 0.5f) | (DWORD)(g * 255.0f + 0.5f) << 8 | (DWORD)(b * 255.0f + 0.5f) << 16 | (DWORD)(a * 255.0f + 0.5f) << 24;
+}
+
+struct CDebugDrawBatch
+{
+	GLuint Buffer, VertexArray;
+	int LinesCount, PointsCount;
+};
+
+// Vertices and DrawCalls are those drawn since the last Begin, batches included, Dropped and Waits are summed
+
+struct CDebugDrawStats
+{
+	int Vertices, DrawCalls, Dropped, Waits;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// collects lines and points through the frame and draws them in one call per primitive type at Flush; the vertices are
+// copied into the next region of a persistently mapped ring buffer, which is reused when its fence has passed, or into
+// a respecified stream buffer without GL_ARB_buffer_storage; Bake moves the primitives collected so far into a static
+// buffer that Draw draws in one call per type every frame; the shaders need nothing of the fixed-function pipeline, so
+// core and forward-compatible contexts work too, below OpenGL 2.1 the fixed-function pipeline draws the buffers with
+// the matrices it has
+
+class CDebugDraw
+{
+protected:
+	std::vector<CDebugVertex> Lines, Points;
+	std::vector<CDebugDrawBatch> Batches;
+	int ProgramVariant;
+	CShaderProgram *Program;
+	GLint PositionAttribute, ColorAttribute;
+	GLuint Buffer, VertexArray;
+	CDebugVertex *Mapped;
+	GLsync Fences[DEBUG_DRAW_REGIONS];
+	int Region;
+	bool Enabled;
+	mat4x4 ViewProjection;
+	vec3 Right, Up;
+	CDebugDrawStats Stats;
+
+public:
+	CDebugDraw();
+	~CDebugDraw();
+
+	void AddPrograms();
+	bool Init();
+	bool IsEnabled();
+	void Begin(const mat4x4 &View, const mat4x4 &Projection);
+	void Line(const vec3 &a, const vec3 &b, DWORD Color);
+	void Point(const vec3 &Position, DWORD Color);
+	void Box(const vec3 &Min, const vec3 &Max, DWORD Color);
+	void Box(const mat4x4 &Transform, DWORD Color);
+	void Sphere(const vec3 &Center, float Radius, DWORD Color, int Segments = 32);
+	void Frustum(const mat4x4 &ViewProjection, DWORD Color);
+	void Text(const vec3 &Position, float Height, const char *Text, DWORD Color);
+	int Bake();
+	void Draw(int Batch);
+	void Flush();
+	void GetStats(CDebugDrawStats &Stats);
+	void Destroy();
+
+	static bool IsPersistentMappingSupported();
+
+protected:
+	void Edges(const vec3 *Corners, DWORD Color);
+	GLuint CreateVertexArray(GLuint Buffer);
+	void Bind(GLuint Buffer, GLuint VertexArray);
+	void Unbind(GLuint VertexArray);
+	void SetPointers();
+	void ResetPointers();
+};
+
+extern CDebugDraw DebugDraw;
@@ -0,0 +1,129 @@
+#include "frameuniforms.h"
+#include "profiler.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CFrameUniforms::CFrameUniforms()
+{
+	FrameBuffer = ObjectBuffer = 0;
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CFrameUniforms::~CFrameUniforms()
+{
+}
+
+// the buffers stay bound to their binding points, nothing else uses them
+
+bool CFrameUniforms::Init()
+{
+	if(!IsSupported())
+	{
+		return false;
+	}
+
+	glGenBuffers(1, &FrameBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, FrameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(CFrameUniformsData), NULL, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &ObjectBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, ObjectBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(CObjectUniformsData), &Object, GL_DYNAMIC_DRAW);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, FrameBuffer);
+	glBindBufferBase(GL_UNIFORM_BUFFER, OBJECT_UNIFORMS_BINDING, ObjectBuffer);
+
+	return true;
+}
+
+bool CFrameUniforms::IsEnabled()
+{
+	return FrameBuffer != 0;
+}
+
+// the whole buffer is respecified, so the driver can hand out new memory instead of waiting for the last frame
+
+void CFrameUniforms::Update(const mat4x4 &View, const mat4x4 &Projection, const vec3 &CameraPosition)
+{
+	if(FrameBuffer == 0)
+	{
+		return;
+	}
+
+	CFrameUniformsData Frame;
+
+	Frame.View = View;
+	Frame.Projection = Projection;
+	Frame.ViewProjection = Projection * View;
+	Frame.CameraPosition = vec4(CameraPosition, 1.0f);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, FrameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(CFrameUniformsData), &Frame, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	Stats.FrameUploads++;
+}
+
+void CFrameUniforms::SetModel(const mat4x4 &Model)
+{
+	if(ObjectBuffer == 0)
+	{
+		return;
+	}
+
+	if(memcmp(&Object.Model, &Model, sizeof(mat4x4)) == 0)
+	{
+		Stats.SkippedUploads++;
+		return;
+	}
+
+	Object.Model = Model;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, ObjectBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(CObjectUniformsData), &Object, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	Stats.ObjectUploads++;
+}
+
+void CFrameUniforms::GetStats(CFrameUniformsStats &Stats)
+{
+	Stats = this->Stats;
+}
+
+void CFrameUniforms::Destroy()
+{
+	glDeleteBuffers(1, &FrameBuffer);
+	glDeleteBuffers(1, &ObjectBuffer);
+
+	FrameBuffer = ObjectBuffer = 0;
+
+	Object.Model = mat4x4();
+}
+
+bool CFrameUniforms::IsSupported()
+{
+	return gl_version >= 31 || GLEW_ARB_uniform_buffer_object;
+}
+
+// a program without the blocks gets GL_INVALID_INDEX and is left alone
+
+void CFrameUniforms::BindBlocks(GLuint Program)
+{
+	if(!IsSupported())
+	{
+		return;
+	}
+
+	GLuint Frame = glGetUniformBlockIndex(Program, "FrameUniforms");
+	GLuint Object = glGetUniformBlockIndex(Program, "ObjectUniforms");
+
+	if(Frame != GL_INVALID_INDEX) glUniformBlockBinding(Program, Frame, FRAME_UNIFORMS_BINDING);
+	if(Object != GL_INVALID_INDEX) glUniformBlockBinding(Program, Object, OBJECT_UNIFORMS_BINDING);
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CFrameUniforms FrameUniforms;
@@ -0,0 +1,31 @@
+// FrameUniforms and ObjectUniforms are bound to FRAME_UNIFORMS_BINDING and OBJECT_UNIFORMS_BINDING, see frameuniforms.h;
+// without uniform buffers TransformVertex uses the fixed-function matrices
+
+#ifdef GL_ARB_uniform_buffer_object
+
+#extension GL_ARB_uniform_buffer_object : enable
+
+layout(std140) uniform FrameUniforms
+{
+	mat4 View, Projection, ViewProjection;
+	vec4 CameraPosition;
+};
+
+layout(std140) uniform ObjectUniforms
+{
+	mat4 Model;
+};
+
+vec4 TransformVertex(vec4 Vertex)
+{
+	return ViewProjection * (Model * Vertex);
+}
+
+#else
+
+vec4 TransformVertex(vec4 Vertex)
+{
+	return gl_ModelViewProjectionMatrix * Vertex;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the binding points of the FrameUniforms and ObjectUniforms blocks declared in frameuniforms.glsl
+
+#define FRAME_UNIFORMS_BINDING 0
+#define OBJECT_UNIFORMS_BINDING 1
+
+// std140 layout, every member starts at a multiple of 16 bytes
+
+struct CFrameUniformsData
+{
+	mat4x4 View, Projection, ViewProjection;
+	vec4 CameraPosition;
+};
+
+struct CObjectUniformsData
+{
+	mat4x4 Model;
+};
+
+struct CFrameUniformsStats
+{
+	int FrameUploads, ObjectUploads, SkippedUploads;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the view data is uploaded once per frame into a buffer every program reads, the model matrix into a second one only
+// when it changes; programs find the blocks bound by CShaderProgram when they are linked, without uniform buffers the
+// shaders fall back to the fixed-function matrices, which the renderer keeps loading
+
+class CFrameUniforms
+{
+protected:
+	GLuint FrameBuffer, ObjectBuffer;
+	CObjectUniformsData Object;
+	CFrameUniformsStats Stats;
+
+public:
+	CFrameUniforms();
+	~CFrameUniforms();
+
+	bool Init();
+	bool IsEnabled();
+	void Update(const mat4x4 &View, const mat4x4 &Projection, const vec3 &CameraPosition);
+	void SetModel(const mat4x4 &Model);
+	void GetStats(CFrameUniformsStats &Stats);
+	void Destroy();
+
+	static bool IsSupported();
+	static void BindBlocks(GLuint Program);
+};
+
+extern CFrameUniforms FrameUniforms;
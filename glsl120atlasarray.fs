@@ -0,0 +1,11 @@
+#version 120
+#extension GL_EXT_texture_array : require
+
+uniform sampler2DArray Atlas;
+
+varying vec3 TexCoord;
+
+void main()
+{
+	gl_FragColor = texture2DArray(Atlas, TexCoord);
+}
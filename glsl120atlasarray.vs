@@ -0,0 +1,11 @@
+#version 120
+
+#include "frameuniforms.glsl"
+
+varying vec3 TexCoord;
+
+void main()
+{
+	TexCoord = vec3(gl_MultiTexCoord0.st, gl_MultiTexCoord1.s);
+	gl_Position = TransformVertex(gl_Vertex);
+}
@@ -0,0 +1,16 @@
+#version 120
+
+// see debugdraw.h, the color is normalized from 4 unsigned bytes
+
+uniform mat4 ViewProjection;
+
+attribute vec3 Position;
+attribute vec4 Color;
+
+varying vec4 VertexColor;
+
+void main()
+{
+	VertexColor = Color;
+	gl_Position = ViewProjection * vec4(Position, 1.0);
+}
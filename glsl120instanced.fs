@@ -0,0 +1,13 @@
+#version 120
+
+uniform sampler2D Texture;
+
+varying vec3 Normal;
+varying vec2 TexCoord;
+
+void main()
+{
+	float NdotL = max(dot(normalize(Normal), vec3(0.333333, 0.666667, 0.666667)), 0.0);
+
+	gl_FragColor = texture2D(Texture, TexCoord) * (0.25 + 0.75 * NdotL);
+}
@@ -0,0 +1,19 @@
+#version 120
+
+#include "frameuniforms.glsl"
+
+// the rows of the 3x4 model matrix of the instance, see instances.h
+
+attribute vec4 InstanceRow0, InstanceRow1, InstanceRow2;
+
+varying vec3 Normal;
+varying vec2 TexCoord;
+
+void main()
+{
+	vec4 Position = vec4(dot(InstanceRow0, gl_Vertex), dot(InstanceRow1, gl_Vertex), dot(InstanceRow2, gl_Vertex), 1.0);
+
+	Normal = vec3(dot(InstanceRow0.xyz, gl_Normal), dot(InstanceRow1.xyz, gl_Normal), dot(InstanceRow2.xyz, gl_Normal));
+	TexCoord = gl_MultiTexCoord0.st;
+	gl_Position = TransformVertex(Position);
+}
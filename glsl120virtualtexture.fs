@@ -0,0 +1,40 @@
+#version 120
+
+uniform sampler2D PhysicalTexture, PageTable;
+uniform vec2 ImageScale, PhysicalSize;
+uniform float VirtualTiles, TileSize, PaddedTileSize, Border, MaxLevel, LodBias;
+
+varying vec2 TexCoord;
+
+void main()
+{
+	vec2 Virtual = clamp(TexCoord, 0.0, 1.0) * ImageScale;
+
+#ifdef FEEDBACK
+
+	vec2 Texel = Virtual * VirtualTiles * TileSize;
+
+	// rounded like GL_NEAREST_MIPMAP_NEAREST picks the page table level
+
+	float Lod = log2(max(max(length(dFdx(Texel)), length(dFdy(Texel))), 1.0e-8)) + LodBias;
+	float Level = clamp(floor(Lod + 0.5), 0.0, MaxLevel);
+
+	vec2 Tiles = vec2(VirtualTiles / exp2(Level));
+	vec2 Tile = min(floor(Virtual * Tiles), Tiles - 1.0);
+	vec2 High = floor(Tile / 256.0);
+
+	gl_FragColor = vec4(Tile - High * 256.0, High.x + High.y * 16.0, Level) / 255.0;
+
+#else
+
+	// the page table has a texel per tile, the bias makes the level the same as the one the feedback asks for
+
+	vec4 Entry = floor(texture2D(PageTable, Virtual, log2(TileSize)) * 255.0 + 0.5);
+
+	vec2 Tile = Virtual * VirtualTiles / exp2(Entry.b);
+	vec2 Physical = Entry.rg * PaddedTileSize + Border + fract(Tile) * TileSize;
+
+	gl_FragColor = texture2D(PhysicalTexture, Physical / PhysicalSize);
+
+#endif
+}
@@ -0,0 +1,11 @@
+#version 120
+
+#include "frameuniforms.glsl"
+
+varying vec2 TexCoord;
+
+void main()
+{
+	TexCoord = gl_MultiTexCoord0.st;
+	gl_Position = TransformVertex(gl_Vertex);
+}
@@ -0,0 +1,10 @@
+#version 150
+
+in vec4 VertexColor;
+
+out vec4 FragColor;
+
+void main()
+{
+	FragColor = VertexColor;
+}
@@ -0,0 +1,16 @@
+#version 150
+
+// see debugdraw.h, the color is normalized from 4 unsigned bytes
+
+uniform mat4 ViewProjection;
+
+in vec3 Position;
+in vec4 Color;
+
+out vec4 VertexColor;
+
+void main()
+{
+	VertexColor = Color;
+	gl_Position = ViewProjection * vec4(Position, 1.0);
+}
@@ -0,0 +1,131 @@
+#include "platform.h"
+#include "string.h"
+#include "hash.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// xxHash64 (https://github.com/Cyan4973/xxHash), processing 32 bytes per iteration in four independent lanes
+
+static const HASH64 Prime1 = 11400714785074694791ULL;
+static const HASH64 Prime2 = 14029467366897019727ULL;
+static const HASH64 Prime3 = 1609587929392839161ULL;
+static const HASH64 Prime4 = 9650029242287828579ULL;
+static const HASH64 Prime5 = 2870177450012600261ULL;
+
+static inline HASH64 RotateLeft(HASH64 x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline HASH64 Read64(const BYTE *p)
+{
+	HASH64 x;
+	memcpy(&x, p, 8);
+	return x;
+}
+
+static inline HASH64 Read32(const BYTE *p)
+{
+	DWORD x;
+	memcpy(&x, p, 4);
+	return x;
+}
+
+static inline HASH64 Round(HASH64 Accumulator, HASH64 Input)
+{
+	Accumulator += Input * Prime2;
+	Accumulator = RotateLeft(Accumulator, 31);
+	return Accumulator * Prime1;
+}
+
+static inline HASH64 MergeRound(HASH64 Accumulator, HASH64 Value)
+{
+	Accumulator ^= Round(0, Value);
+	return Accumulator * Prime1 + Prime4;
+}
+
+HASH64 Hash64(const void *Data, size_t Size, HASH64 Seed)
+{
+	const BYTE *p = (const BYTE*)Data, *End = p + Size;
+
+	HASH64 Hash;
+
+	if(Size >= 32)
+	{
+		HASH64 v1 = Seed + Prime1 + Prime2, v2 = Seed + Prime2, v3 = Seed, v4 = Seed - Prime1;
+
+		const BYTE *Limit = End - 32;
+
+		do
+		{
+			v1 = Round(v1, Read64(p)); p += 8;
+			v2 = Round(v2, Read64(p)); p += 8;
+			v3 = Round(v3, Read64(p)); p += 8;
+			v4 = Round(v4, Read64(p)); p += 8;
+		}
+		while(p <= Limit);
+
+		Hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+
+		Hash = MergeRound(Hash, v1);
+		Hash = MergeRound(Hash, v2);
+		Hash = MergeRound(Hash, v3);
+		Hash = MergeRound(Hash, v4);
+	}
+	else
+	{
+		Hash = Seed + Prime5;
+	}
+
+	Hash += (HASH64)Size;
+
+	while(p + 8 <= End)
+	{
+		Hash ^= Round(0, Read64(p));
+		Hash = RotateLeft(Hash, 27) * Prime1 + Prime4;
+		p += 8;
+	}
+
+	if(p + 4 <= End)
+	{
+		Hash ^= Read32(p) * Prime1;
+		Hash = RotateLeft(Hash, 23) * Prime2 + Prime3;
+		p += 4;
+	}
+
+	while(p < End)
+	{
+		Hash ^= (*p) * Prime5;
+		Hash = RotateLeft(Hash, 11) * Prime1;
+		p++;
+	}
+
+	Hash ^= Hash >> 33;
+	Hash *= Prime2;
+	Hash ^= Hash >> 29;
+	Hash *= Prime3;
+	Hash ^= Hash >> 32;
+
+	return Hash;
+}
+
+HASH64 HashString64(const char *String, HASH64 Seed)
+{
+	return Hash64(String, strlen(String), Seed);
+}
+
+// the file is mapped, so it is neither copied nor limited to 2 GB
+
+bool HashFile64(const char *FileName, HASH64 *Hash)
+{
+	CMappedFile File;
+
+	if(!File.Open(FileName))
+	{
+		return false;
+	}
+
+	*Hash = Hash64(File.Data, File.Size);
+
+	return true;
+}
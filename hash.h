@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <type_traits>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+typedef unsigned long long HASH64;
+
+HASH64 Hash64(const void *Data, size_t Size, HASH64 Seed = 0);
+HASH64 HashString64(const char *String, HASH64 Seed = 0);
+bool HashFile64(const char *FileName, HASH64 *Hash);
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// FNV-1a, usable in constant expressions for hashing names at compile time
+
+constexpr unsigned int HashName32(const char *Name, unsigned int Hash = 2166136261u)
+{
+	return *Name == 0 ? Hash : HashName32(Name + 1, (Hash ^ (unsigned char)*Name) * 16777619u);
+}
+
+// forces the hash of a literal to be computed by the compiler, for names looked up every frame
+
+#define HASH_NAME32(Name) (std::integral_constant<unsigned int, HashName32(Name)>::value)
@@ -0,0 +1,346 @@
+#include "win32_opengl_glew_freeimage_glm.h"
+#include "benchmark.h"
+#include "microbenchmark.h"
+#include "profiler.h"
+#include "shadercache.h"
+#include "texturecache.h"
+#include "texturestreamer.h"
+#include "threadpool.h"
+
+#ifndef _WIN32
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CWnd::CWnd()
+{
+	Context = NULL;
+	FrameBuffer = NULL;
+
+	Width = Height = 0;
+	Samples = 0;
+}
+
+CWnd::~CWnd()
+{
+}
+
+bool CWnd::Create(const char *WindowName, int Width, int Height, int Frames, float FrameTime)
+{
+	this->WindowName = WindowName;
+
+	this->Width = Width;
+	this->Height = Height;
+
+	this->Frames = Frames;
+	this->FrameTime = FrameTime;
+
+	FullScreen = DeFullScreened = false;
+	MouseGameMode = KeyBoardFocus = MouseFocus = false;
+
+	if((Context = OSMesaCreateContextExt(OSMESA_RGBA, 24, 0, 0, NULL)) == NULL)
+	{
+		ErrorLog.Set("OSMesaCreateContextExt failed!");
+		return false;
+	}
+
+	FrameBuffer = new BYTE[Width * Height * 4];
+
+	if(OSMesaMakeCurrent(Context, FrameBuffer, GL_UNSIGNED_BYTE, Width, Height) == GL_FALSE)
+	{
+		ErrorLog.Set("OSMesaMakeCurrent failed!");
+		return false;
+	}
+
+	if(glewInit() != GLEW_OK)
+	{
+		ErrorLog.Set("glewInit failed!");
+		return false;
+	}
+
+	int major, minor;
+
+	sscanf_s((char*)glGetString(GL_VERSION), "%d.%d", &major, &minor);
+
+	gl_version = major * 10 + minor;
+
+	wgl_context_forward_compatible = false;
+
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &gl_max_texture_size);
+
+	if(GLEW_EXT_texture_filter_anisotropic)
+	{
+		glGetIntegerv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &gl_max_texture_max_anisotropy_ext);
+	}
+
+	PixelFormatCaps.Init();
+
+	Profiler.Init();
+
+	TextureStreamer.Init();
+
+	return OpenGLRenderer.Init();
+}
+
+bool CWnd::SaveScreenShot(char *ScreenShotFileName)
+{
+	CString FileName = ScreenShotFileName;
+
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromFilename(FileName);
+
+	if(fif == FIF_UNKNOWN)
+	{
+		ErrorLog.Append("Error saving file %s! -> fif is FIF_UNKNOWN\r\n", ScreenShotFileName);
+		return false;
+	}
+
+	FIBITMAP *dib = FreeImage_Allocate(Width, Height, 24);
+
+	if(dib == NULL)
+	{
+		ErrorLog.Append("Error saving file %s! -> dib is NULL\r\n", ScreenShotFileName);
+		return false;
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, Width, Height, GL_BGR, GL_UNSIGNED_BYTE, FreeImage_GetBits(dib));
+
+	bool Saved = FreeImage_Save(fif, dib, FileName) == TRUE;
+
+	FreeImage_Unload(dib);
+
+	if(!Saved)
+	{
+		ErrorLog.Append("Error saving file %s! -> FreeImage_Save failed\r\n", ScreenShotFileName);
+	}
+
+	return Saved;
+}
+
+void CWnd::Show(bool /* MouseGameMode */, bool /* Maximized */)
+{
+	OnSize(Width, Height);
+}
+
+void CWnd::MsgLoop()
+{
+	StartFPSCounter();
+
+	for(int Frame = 0; Frame < Frames; Frame++)
+	{
+		OnPaint();
+	}
+
+	glFinish();
+}
+
+void CWnd::Destroy()
+{
+	OpenGLRenderer.Destroy();
+
+	TextureManager.Destroy();
+	TextureStreamer.Destroy();
+
+	Profiler.Destroy();
+
+	if(Context)
+	{
+		OSMesaDestroyContext(Context);
+		Context = NULL;
+	}
+
+	delete [] FrameBuffer;
+	FrameBuffer = NULL;
+}
+
+void CWnd::StartFPSCounter()
+{
+	Start = Begin = GetTime();
+}
+
+void CWnd::OnPaint()
+{
+	static int FPS = 0;
+
+	double End = GetTime();
+
+	Begin = End;
+
+	if(End - Start > 1.0)
+	{
+		printf("%s - %dx%d, FPS: %d - %s\n", WindowName, Width, Height, FPS, (char*)glGetString(GL_RENDERER));
+
+		FPS = 0;
+		Start = End;
+	}
+	else
+	{
+		FPS++;
+	}
+
+	bool Benchmarking = Benchmark.Running;
+
+	if(Benchmarking)
+	{
+		CameraPath.Apply(Benchmark.BeginFrame());
+	}
+
+	OpenGLRenderer.Render(FrameTime);
+
+	Profiler.EndFrame();
+
+	if(Benchmarking)
+	{
+		Benchmark.EndFrame();
+	}
+}
+
+void CWnd::OnSize(int sx, int sy)
+{
+	Width = sx;
+	Height = sy;
+
+	WidthD2 = Width / 2;
+	HeightD2 = Height / 2;
+
+	OpenGLRenderer.Resize(Width, Height);
+}
+
+CWnd Wnd;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+	Benchmark.MarkProcessStart();
+
+	// not in the constructor of Wnd, ModuleDirectory is a global of another file and may not be constructed yet
+
+	char *moduledirectory = new char[4096];
+	GetModuleDirectory(moduledirectory, 4096);
+	ModuleDirectory = moduledirectory;
+	delete [] moduledirectory;
+
+	CCommandLine CommandLine;
+
+	if(!CommandLine.Parse(argc, argv))
+	{
+		DisplayError(ErrorLog);
+		return 1;
+	}
+
+	FreeImage_Initialise();
+
+	if(CommandLine.MicroBenchmarkName)
+	{
+		CString Report;
+
+		bool Error = !RunMicroBenchmarks(CommandLine.MicroBenchmarkName, Report);
+
+		if(!Error)
+		{
+			if(CommandLine.BenchmarkFileName)
+			{
+				Error = !SaveMicroBenchmarkReport(CommandLine.BenchmarkFileName, Report);
+			}
+			else
+			{
+				printf("%s", (char*)Report);
+			}
+		}
+
+		if(Error)
+		{
+			DisplayError(ErrorLog);
+		}
+
+		FreeImage_DeInitialise();
+
+		return Error ? 1 : 0;
+	}
+
+	TextureStreamer.UploadBudget = CommandLine.UploadBudget * 1024;
+	TextureManager.Budget = (long long)CommandLine.TextureBudget * 1024 * 1024;
+
+	TextureCache.Init(CString::Concat({ModuleDirectory, "cache/"}), CommandLine.TextureCompression, CommandLine.TextureCompressionQuality);
+	ShaderCache.Init(CString::Concat({ModuleDirectory, "cache/"}), CommandLine.ShaderCache);
+
+	OpenGLRenderer.VirtualTextureFileName = CommandLine.VirtualTextureFileName;
+	OpenGLRenderer.AtlasFileName = CommandLine.AtlasFileName;
+	OpenGLRenderer.MeshFileName = CommandLine.MeshFileName;
+	OpenGLRenderer.InstancesCount = CommandLine.InstancesCount;
+
+	if(CommandLine.TraceFileName)
+	{
+		Profiler.TraceFileName = CommandLine.TraceFileName;
+		Profiler.Start();
+	}
+
+	int ExitCode = 0;
+
+	if(Wnd.Create("Linux, OSMesa, GLEW, FreeImage, GLM", CommandLine.Width, CommandLine.Height, CommandLine.Frames, CommandLine.FrameTime))
+	{
+		bool Error = false;
+
+		if(CommandLine.BenchmarkFileName)
+		{
+			if(CommandLine.CameraPathFileName)
+			{
+				Error |= !CameraPath.Load(CommandLine.CameraPathFileName);
+			}
+			else
+			{
+				CameraPath.CreateOrbit(CommandLine.Frames);
+			}
+		}
+
+		Error |= !TextureManager.Finish();
+
+		if(!Error)
+		{
+			Wnd.Show();
+
+			if(CommandLine.BenchmarkFileName)
+			{
+				Benchmark.Start(CommandLine.Frames, CommandLine.FrameTime);
+			}
+
+			Wnd.MsgLoop();
+
+			if(CommandLine.BenchmarkFileName)
+			{
+				Error |= !Benchmark.Save(CommandLine.BenchmarkFileName);
+			}
+
+			if(CommandLine.ScreenShotFileName)
+			{
+				Error |= !Wnd.SaveScreenShot(CommandLine.ScreenShotFileName);
+			}
+
+			if(CommandLine.TraceFileName)
+			{
+				Error |= !Profiler.Save(Profiler.TraceFileName);
+			}
+		}
+
+		if(Error)
+		{
+			DisplayError(ErrorLog);
+			ExitCode = 1;
+		}
+	}
+	else
+	{
+		DisplayError(ErrorLog);
+		ExitCode = 1;
+	}
+
+	Wnd.Destroy();
+
+	ThreadPool.Destroy();
+
+	FreeImage_DeInitialise();
+
+	return ExitCode;
+}
+
+#endif
@@ -0,0 +1,371 @@
+#include "instances.h"
+#include "mesh.h"
+#include "profiler.h"
+#include "shaderlibrary.h"
+#include "simd.h"
+#include "threadpool.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CInstances::CInstances()
+{
+	PositionsX = PositionsY = PositionsZ = Scales = Angles = Speeds = NULL;
+	Matrices = VisibleMatrices = NULL;
+	Count = PaddedCount = 0;
+	InstanceBuffer = 0;
+	ProgramVariant = -1;
+	Program = NULL;
+	RowAttributes[0] = RowAttributes[1] = RowAttributes[2] = -1;
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CInstances::~CInstances()
+{
+}
+
+// the variant stays added when Init is called again, the program belongs to ShaderLibrary
+
+void CInstances::AddPrograms()
+{
+	if(ProgramVariant == -1 && IsSupported())
+	{
+		ProgramVariant = ShaderLibrary.Add("glsl120instanced.vs", "glsl120instanced.fs");
+	}
+}
+
+// the padding instances have a scale of 0 and are never uploaded
+
+bool CInstances::Init(int Count)
+{
+	Destroy();
+
+	this->Count = Count;
+
+	PaddedCount = (Count + 3) & ~3;
+
+	PositionsX = new float[PaddedCount];
+	PositionsY = new float[PaddedCount];
+	PositionsZ = new float[PaddedCount];
+	Scales = new float[PaddedCount];
+	Angles = new float[PaddedCount];
+	Speeds = new float[PaddedCount];
+	Matrices = new float[PaddedCount * 12];
+	VisibleMatrices = new float[PaddedCount * 12];
+
+	for(int i = 0; i < PaddedCount; i++)
+	{
+		PositionsX[i] = PositionsY[i] = PositionsZ[i] = Scales[i] = Angles[i] = Speeds[i] = 0.0f;
+	}
+
+	memset(Matrices, 0, PaddedCount * 12 * sizeof(float));
+
+	Culling.Init(Count);
+
+	Stats.Instances = Stats.Visible = Count;
+
+	if(!IsSupported())
+	{
+		return true;
+	}
+
+	AddPrograms();
+
+	Program = ShaderLibrary.Get(ProgramVariant);
+
+	if(Program == NULL)
+	{
+		Destroy();
+		return false;
+	}
+
+	RowAttributes[0] = glGetAttribLocation(*Program, "InstanceRow0");
+	RowAttributes[1] = glGetAttribLocation(*Program, "InstanceRow1");
+	RowAttributes[2] = glGetAttribLocation(*Program, "InstanceRow2");
+
+	glGenBuffers(1, &InstanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, InstanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, Count * 12 * sizeof(float), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+// Angle in radians, Speed in radians per second
+
+void CInstances::Set(int Index, const vec3 &Position, float Scale, float Angle, float Speed)
+{
+	PositionsX[Index] = Position.x;
+	PositionsY[Index] = Position.y;
+	PositionsZ[Index] = Position.z;
+	Scales[Index] = Scale;
+	Angles[Index] = Angle;
+	Speeds[Index] = Speed;
+
+	Culling.SetSphere(Index, Position, Scale * 0.8660254f);
+}
+
+// the box around the bounding sphere
+
+void CInstances::GetBounds(int Index, vec3 &Min, vec3 &Max)
+{
+	vec3 Position = vec3(PositionsX[Index], PositionsY[Index], PositionsZ[Index]);
+	vec3 Extents = vec3(Scales[Index] * 0.8660254f);
+
+	Min = Position - Extents;
+	Max = Position + Extents;
+}
+
+// the bounding spheres hold the unit cube however it turns, so they never change
+
+void CInstances::Cull(const mat4x4 &ViewProjection)
+{
+	double Start = GetTime();
+
+	Stats.Visible = Culling.Cull(ViewProjection);
+
+	Stats.CullTime += GetTime() - Start;
+}
+
+// the angles of all instances advance, the matrices of the visible ones are gathered; the whole buffer is respecified,
+// so the driver can hand out new memory instead of waiting for the last frame
+
+void CInstances::Update(float FrameTime)
+{
+	PROFILE_ZONE("CInstances::Update");
+
+	double Start = GetTime();
+
+	ThreadPool.ParallelFor(PaddedCount / 4, INSTANCES_GRAIN / 4, [&](int Begin, int End)
+	{
+		UpdateMatrices(Begin * 4, End * 4, FrameTime);
+	});
+
+	int VisibleCount = Culling.GetVisibleCount();
+
+	if(VisibleCount < Count)
+	{
+		const int *Visible = Culling.GetVisible();
+
+		ThreadPool.ParallelFor(VisibleCount, INSTANCES_GRAIN, [&](int Begin, int End)
+		{
+			for(int i = Begin; i < End; i++)
+			{
+				memcpy(VisibleMatrices + i * 12, Matrices + Visible[i] * 12, 12 * sizeof(float));
+			}
+		});
+	}
+
+	Stats.UpdateTime += GetTime() - Start;
+
+	if(InstanceBuffer)
+	{
+		Start = GetTime();
+
+		glBindBuffer(GL_ARRAY_BUFFER, InstanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, Count * 12 * sizeof(float), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, VisibleCount * 12 * sizeof(float), VisibleCount < Count ? VisibleMatrices : Matrices);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		Stats.UploadTime += GetTime() - Start;
+	}
+
+	Stats.Frames++;
+}
+
+void CInstances::Draw(CMesh &Mesh)
+{
+	PROFILE_GPU_ZONE("CInstances::Draw");
+
+	double Start = GetTime();
+
+	int VisibleCount = Culling.GetVisibleCount();
+
+	if(VisibleCount == 0)
+	{
+		Stats.DrawCalls = 0;
+	}
+	else if(InstanceBuffer)
+	{
+		glUseProgram(*Program);
+
+		Mesh.Bind();
+
+		glBindBuffer(GL_ARRAY_BUFFER, InstanceBuffer);
+
+		for(int i = 0; i < 3; i++)
+		{
+			if(RowAttributes[i] >= 0)
+			{
+				glEnableVertexAttribArray(RowAttributes[i]);
+				glVertexAttribPointer(RowAttributes[i], 4, GL_FLOAT, GL_FALSE, 12 * sizeof(float), (void*)(i * 4 * sizeof(float)));
+			}
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		SetDivisors(1);
+
+		Mesh.DrawInstanced(VisibleCount);
+
+		SetDivisors(0);
+
+		for(int i = 0; i < 3; i++)
+		{
+			if(RowAttributes[i] >= 0)
+			{
+				glDisableVertexAttribArray(RowAttributes[i]);
+			}
+		}
+
+		Mesh.Unbind();
+
+		glUseProgram(0);
+
+		Stats.DrawCalls = 1;
+	}
+	else
+	{
+		const int *Visible = Culling.GetVisible();
+
+		for(int i = 0; i < VisibleCount; i++)
+		{
+			float Model[16] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+
+			memcpy(Model, Matrices + Visible[i] * 12, 12 * sizeof(float));
+
+			glPushMatrix();
+			glMultTransposeMatrixf(Model);
+
+			Mesh.Draw();
+
+			glPopMatrix();
+		}
+
+		Stats.DrawCalls = VisibleCount;
+	}
+
+	Stats.SubmitTime += GetTime() - Start;
+}
+
+// three rows of 4 floats per instance
+
+const float* CInstances::GetMatrices()
+{
+	return Matrices;
+}
+
+int CInstances::GetCount()
+{
+	return Count;
+}
+
+void CInstances::GetStats(CInstancesStats &Stats)
+{
+	Stats = this->Stats;
+}
+
+void CInstances::Destroy()
+{
+	delete [] PositionsX;
+	delete [] PositionsY;
+	delete [] PositionsZ;
+	delete [] Scales;
+	delete [] Angles;
+	delete [] Speeds;
+	delete [] Matrices;
+	delete [] VisibleMatrices;
+
+	PositionsX = PositionsY = PositionsZ = Scales = Angles = Speeds = NULL;
+	Matrices = VisibleMatrices = NULL;
+	Count = PaddedCount = 0;
+
+	if(InstanceBuffer) glDeleteBuffers(1, &InstanceBuffer);
+
+	InstanceBuffer = 0;
+
+	Culling.Destroy();
+
+	Program = NULL;
+
+	RowAttributes[0] = RowAttributes[1] = RowAttributes[2] = -1;
+
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+bool CInstances::IsSupported()
+{
+	return gl_version >= 33 || (gl_version >= 31 && GLEW_ARB_instanced_arrays);
+}
+
+// four instances at a time, sine and cosine from Taylor series of the half angle, within about 2e-5 of sinf and cosf;
+// the rows are those of translate * rotate y * rotate x * scale
+
+void CInstances::UpdateMatrices(int Begin, int End, float FrameTime)
+{
+	FLOAT4 Step = Float4Set1(FrameTime);
+	FLOAT4 TwoPi = Float4Set1(6.28318531f), InverseTwoPi = Float4Set1(0.159154943f);
+	FLOAT4 Zero = Float4Set1(0.0f), Half = Float4Set1(0.5f), One = Float4Set1(1.0f);
+
+	for(int i = Begin; i < End; i += 4)
+	{
+		FLOAT4 Angle = Float4Add(Float4Load(Angles + i), Float4Mul(Float4Load(Speeds + i), Step));
+
+		Angle = Float4Sub(Angle, Float4Mul(Float4Round(Float4Mul(Angle, InverseTwoPi)), TwoPi));
+
+		Float4Store(Angles + i, Angle);
+
+		FLOAT4 x = Float4Mul(Angle, Half), x2 = Float4Mul(x, x);
+
+		FLOAT4 s = Float4Add(Float4Set1(-1.0f / 5040.0f), Float4Mul(x2, Float4Set1(1.0f / 362880.0f)));
+		s = Float4Add(Float4Set1(1.0f / 120.0f), Float4Mul(x2, s));
+		s = Float4Add(Float4Set1(-1.0f / 6.0f), Float4Mul(x2, s));
+		s = Float4Mul(x, Float4Add(One, Float4Mul(x2, s)));
+
+		FLOAT4 c = Float4Add(Float4Set1(1.0f / 40320.0f), Float4Mul(x2, Float4Set1(-1.0f / 3628800.0f)));
+		c = Float4Add(Float4Set1(-1.0f / 720.0f), Float4Mul(x2, c));
+		c = Float4Add(Float4Set1(1.0f / 24.0f), Float4Mul(x2, c));
+		c = Float4Add(Float4Set1(-0.5f), Float4Mul(x2, c));
+		c = Float4Add(One, Float4Mul(x2, c));
+
+		FLOAT4 Sin = Float4Mul(Float4Add(s, s), c);
+		FLOAT4 Cos = Float4Sub(Float4Mul(c, c), Float4Mul(s, s));
+
+		FLOAT4 Scale = Float4Load(Scales + i);
+		FLOAT4 ScaledSin = Float4Mul(Scale, Sin), ScaledCos = Float4Mul(Scale, Cos);
+
+		FLOAT4 r00 = ScaledCos, r01 = Float4Mul(ScaledSin, Sin), r02 = Float4Mul(ScaledSin, Cos), r03 = Float4Load(PositionsX + i);
+		FLOAT4 r10 = Zero, r11 = ScaledCos, r12 = Float4Sub(Zero, ScaledSin), r13 = Float4Load(PositionsY + i);
+		FLOAT4 r20 = r12, r21 = r02, r22 = Float4Mul(ScaledCos, Cos), r23 = Float4Load(PositionsZ + i);
+
+		Float4Transpose(r00, r01, r02, r03);
+		Float4Transpose(r10, r11, r12, r13);
+		Float4Transpose(r20, r21, r22, r23);
+
+		float *Rows = Matrices + i * 12;
+
+		Float4Store(Rows + 0, r00); Float4Store(Rows + 4, r10); Float4Store(Rows + 8, r20);
+		Float4Store(Rows + 12, r01); Float4Store(Rows + 16, r11); Float4Store(Rows + 20, r21);
+		Float4Store(Rows + 24, r02); Float4Store(Rows + 28, r12); Float4Store(Rows + 32, r22);
+		Float4Store(Rows + 36, r03); Float4Store(Rows + 40, r13); Float4Store(Rows + 44, r23);
+	}
+}
+
+void CInstances::SetDivisors(GLuint Divisor)
+{
+	for(int i = 0; i < 3; i++)
+	{
+		if(RowAttributes[i] < 0)
+		{
+			continue;
+		}
+
+		if(gl_version >= 33)
+		{
+			glVertexAttribDivisor(RowAttributes[i], Divisor);
+		}
+		else
+		{
+			glVertexAttribDivisorARB(RowAttributes[i], Divisor);
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+#include "culling.h"
+
+class CMesh;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// instances per job of the update, a multiple of 4
+
+#define INSTANCES_GRAIN 4096
+
+// the times are summed over Frames, Visible and DrawCalls are those of the last frame
+
+struct CInstancesStats
+{
+	int Instances, Visible, Frames, DrawCalls;
+	double CullTime, UpdateTime, UploadTime, SubmitTime;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// copies of one mesh, each turning about the x and y axes like the cube; the transforms are kept as structure of arrays,
+// padded to a multiple of 4, and turned into the rows of 3x4 model matrices four instances at a time on the thread pool;
+// after Cull only the matrices of the instances whose bounding spheres are in the frustum are gathered and uploaded once
+// per frame into an instance buffer and drawn with one glDrawElementsInstanced call, without instanced arrays every
+// visible instance is drawn on its own with the fixed-function pipeline
+
+class CInstances
+{
+protected:
+	float *PositionsX, *PositionsY, *PositionsZ, *Scales, *Angles, *Speeds;
+	float *Matrices, *VisibleMatrices;
+	int Count, PaddedCount;
+	CCulling Culling;
+	GLuint InstanceBuffer;
+	int ProgramVariant;
+	CShaderProgram *Program;
+	GLint RowAttributes[3];
+	CInstancesStats Stats;
+
+public:
+	CInstances();
+	~CInstances();
+
+	void AddPrograms();
+	bool Init(int Count);
+	void Set(int Index, const vec3 &Position, float Scale, float Angle, float Speed);
+	void GetBounds(int Index, vec3 &Min, vec3 &Max);
+	void Cull(const mat4x4 &ViewProjection);
+	void Update(float FrameTime);
+	void Draw(CMesh &Mesh);
+	const float* GetMatrices();
+	int GetCount();
+	void GetStats(CInstancesStats &Stats);
+	void Destroy();
+
+	static bool IsSupported();
+
+protected:
+	void UpdateMatrices(int Begin, int End, float FrameTime);
+	void SetDivisors(GLuint Divisor);
+};
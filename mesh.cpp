@@ -0,0 +1,781 @@
+#include "mesh.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stddef.h>
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// Forsyth's scores, the last triangle's vertices score a bit less than the next ones so it does not turn into a strip,
+// and vertices with few triangles left are boosted so they do not remain until the end
+
+#define MESH_LAST_TRIANGLE_SCORE 0.75f
+#define MESH_CACHE_DECAY_POWER 1.5f
+#define MESH_VALENCE_BOOST_SCALE 2.0f
+#define MESH_VALENCE_BOOST_POWER 0.5f
+#define MESH_MAX_VALENCE 64
+
+static float CacheScores[MESH_SCORE_CACHE_SIZE], ValenceScores[MESH_MAX_VALENCE];
+
+static void InitScores()
+{
+	if(ValenceScores[1] > 0.0f)
+	{
+		return;
+	}
+
+	for(int Position = 0; Position < MESH_SCORE_CACHE_SIZE; Position++)
+	{
+		CacheScores[Position] = Position < 3 ? MESH_LAST_TRIANGLE_SCORE : powf(1.0f - (Position - 3) / (float)(MESH_SCORE_CACHE_SIZE - 3), MESH_CACHE_DECAY_POWER);
+	}
+
+	ValenceScores[0] = 0.0f;
+
+	for(int Valence = 1; Valence < MESH_MAX_VALENCE; Valence++)
+	{
+		ValenceScores[Valence] = MESH_VALENCE_BOOST_SCALE * powf((float)Valence, -MESH_VALENCE_BOOST_POWER);
+	}
+}
+
+static float GetVertexScore(int CachePosition, int Valence)
+{
+	if(Valence == 0)
+	{
+		return -1.0f;
+	}
+
+	float Score = CachePosition >= 0 ? CacheScores[CachePosition] : 0.0f;
+
+	return Score + ValenceScores[Valence < MESH_MAX_VALENCE ? Valence : MESH_MAX_VALENCE - 1];
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CMesh::CMesh()
+{
+	Vertices = NULL;
+	Indices = NULL;
+	VerticesCount = IndicesCount = 0;
+	VertexBuffer = IndexBuffer = VertexArray = 0;
+	Min = Max = vec3(0.0f, 0.0f, 0.0f);
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CMesh::~CMesh()
+{
+}
+
+void CMesh::Set(const CVertex *Vertices, int VerticesCount, const unsigned int *Indices, int IndicesCount)
+{
+	CVertex *VerticesCopy = new CVertex[VerticesCount];
+	unsigned int *IndicesCopy = new unsigned int[IndicesCount];
+
+	memcpy(VerticesCopy, Vertices, VerticesCount * sizeof(CVertex));
+	memcpy(IndicesCopy, Indices, IndicesCount * sizeof(unsigned int));
+
+	Attach(VerticesCopy, VerticesCount, IndicesCopy, IndicesCount);
+}
+
+void CMesh::Attach(CVertex *Vertices, int VerticesCount, unsigned int *Indices, int IndicesCount)
+{
+	Destroy();
+
+	this->Vertices = Vertices;
+	this->Indices = Indices;
+	this->VerticesCount = VerticesCount;
+	this->IndicesCount = IndicesCount;
+
+	SetBounds(Vertices, VerticesCount);
+
+	int Misses = CountCacheMisses(Indices, IndicesCount, VerticesCount);
+
+	Stats.Vertices = VerticesCount;
+	Stats.Triangles = IndicesCount / 3;
+	Stats.Clusters = 0;
+	Stats.MissesBefore = Stats.MissesAfter = Misses;
+	Stats.ACMRBefore = Stats.ACMRAfter = Stats.Triangles > 0 ? (float)Misses / Stats.Triangles : 0.0f;
+	Stats.ATVRBefore = Stats.ATVRAfter = VerticesCount > 0 ? (float)Misses / VerticesCount : 0.0f;
+	Stats.OptimizeTime = 0.0;
+}
+
+// has to come before Upload
+
+void CMesh::Optimize()
+{
+	PROFILE_ZONE("CMesh::Optimize");
+
+	double Start = GetTime();
+
+	OptimizeVertexCache(Indices, IndicesCount, VerticesCount);
+
+	Stats.Clusters = OptimizeOverdraw(Indices, IndicesCount, Vertices, VerticesCount, MESH_OVERDRAW_THRESHOLD);
+
+	OptimizeVertexFetch(Vertices, VerticesCount, Indices, IndicesCount);
+
+	Stats.OptimizeTime = GetTime() - Start;
+
+	Stats.MissesAfter = CountCacheMisses(Indices, IndicesCount, VerticesCount);
+	Stats.ACMRAfter = Stats.Triangles > 0 ? (float)Stats.MissesAfter / Stats.Triangles : 0.0f;
+	Stats.ATVRAfter = VerticesCount > 0 ? (float)Stats.MissesAfter / VerticesCount : 0.0f;
+}
+
+// the vertex array object records the pointers and the index buffer, without one they are set for every draw; without
+// buffer objects the mesh is drawn from its own copy
+
+void CMesh::Upload()
+{
+	if(gl_version < 15)
+	{
+		return;
+	}
+
+	CreateBuffers(Vertices, Indices);
+}
+
+bool CMesh::Save(const char *FileName)
+{
+	PROFILE_ZONE("CMesh::Save");
+
+	CMeshFileHeader Header;
+
+	memset(&Header, 0, sizeof(Header));
+
+	Header.Magic = MESH_FILE_MAGIC;
+	Header.Version = MESH_FILE_VERSION;
+	Header.VerticesCount = VerticesCount;
+	Header.IndicesCount = IndicesCount;
+
+	memcpy(Header.Min, &Min, sizeof(Header.Min));
+	memcpy(Header.Max, &Max, sizeof(Header.Max));
+
+	FILE *File;
+
+	if(Vertices == NULL || fopen_s(&File, FileName, "wb") != 0)
+	{
+		ErrorLog.Append("Error saving file %s!\r\n", FileName);
+		return false;
+	}
+
+	bool Written = fwrite(&Header, sizeof(Header), 1, File) == 1;
+
+	Written = Written && fwrite(Vertices, sizeof(CVertex), VerticesCount, File) == (size_t)VerticesCount;
+	Written = Written && fwrite(Indices, sizeof(unsigned int), IndicesCount, File) == (size_t)IndicesCount;
+	Written = fclose(File) == 0 && Written;
+
+	if(!Written)
+	{
+		remove(FileName);
+		ErrorLog.Append("Error saving file %s!\r\n", FileName);
+	}
+
+	return Written;
+}
+
+// the file is only checked for its size, the indices are trusted to be in range; without buffer objects the data is
+// copied, as the mesh is drawn from memory then
+
+bool CMesh::Load(const char *FileName)
+{
+	PROFILE_ZONE("CMesh::Load");
+
+	Destroy();
+
+	CMappedFile File;
+
+	if(!File.Open(FileName))
+	{
+		return false;
+	}
+
+	const CMeshFileHeader *Header = (const CMeshFileHeader*)File.Data;
+
+	bool Valid = File.Size >= sizeof(CMeshFileHeader) && Header->Magic == MESH_FILE_MAGIC && Header->Version == MESH_FILE_VERSION;
+
+	Valid = Valid && Header->VerticesCount >= 0 && Header->IndicesCount >= 0 && Header->IndicesCount % 3 == 0;
+	Valid = Valid && File.Size == sizeof(CMeshFileHeader) + (size_t)Header->VerticesCount * sizeof(CVertex) + (size_t)Header->IndicesCount * sizeof(unsigned int);
+
+	if(!Valid)
+	{
+		return false;
+	}
+
+	const CVertex *FileVertices = (const CVertex*)(File.Data + sizeof(CMeshFileHeader));
+	const unsigned int *FileIndices = (const unsigned int*)(FileVertices + Header->VerticesCount);
+
+	if(gl_version < 15)
+	{
+		Set(FileVertices, Header->VerticesCount, FileIndices, Header->IndicesCount);
+		return true;
+	}
+
+	VerticesCount = Header->VerticesCount;
+	IndicesCount = Header->IndicesCount;
+
+	Min = vec3(Header->Min[0], Header->Min[1], Header->Min[2]);
+	Max = vec3(Header->Max[0], Header->Max[1], Header->Max[2]);
+
+	CreateBuffers(FileVertices, FileIndices);
+
+	memset(&Stats, 0, sizeof(Stats));
+
+	Stats.Vertices = VerticesCount;
+	Stats.Triangles = IndicesCount / 3;
+
+	return true;
+}
+
+void CMesh::CreateBuffers(const CVertex *Vertices, const unsigned int *Indices)
+{
+	glGenBuffers(1, &VertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, VerticesCount * sizeof(CVertex), Vertices, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &IndexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndicesCount * sizeof(unsigned int), Indices, GL_STATIC_DRAW);
+
+	if(gl_version >= 30 || GLEW_ARB_vertex_array_object)
+	{
+		glGenVertexArrays(1, &VertexArray);
+		glBindVertexArray(VertexArray);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBuffer);
+
+		SetPointers();
+
+		glBindVertexArray(0);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// between Bind and Unbind the caller may add attributes of its own and draw the mesh more than once
+
+void CMesh::Bind()
+{
+	if(VertexArray)
+	{
+		glBindVertexArray(VertexArray);
+		return;
+	}
+
+	if(VertexBuffer)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBuffer);
+	}
+
+	SetPointers();
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CMesh::Draw()
+{
+	Bind();
+
+	glDrawElements(GL_TRIANGLES, IndicesCount, GL_UNSIGNED_INT, IndexBuffer ? NULL : Indices);
+
+	Unbind();
+}
+
+void CMesh::DrawInstanced(int InstancesCount)
+{
+	glDrawElementsInstanced(GL_TRIANGLES, IndicesCount, GL_UNSIGNED_INT, IndexBuffer ? NULL : Indices, InstancesCount);
+}
+
+// a part of the triangles, between Bind and Unbind; the order Set left them in is kept unless Optimize was called
+
+void CMesh::DrawRange(int FirstIndex, int IndicesCount)
+{
+	glDrawElements(GL_TRIANGLES, IndicesCount, GL_UNSIGNED_INT, IndexBuffer ? (const void*)(FirstIndex * sizeof(unsigned int)) : Indices + FirstIndex);
+}
+
+void CMesh::Unbind()
+{
+	if(VertexArray)
+	{
+		glBindVertexArray(0);
+		return;
+	}
+
+	ResetPointers();
+
+	if(VertexBuffer)
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+}
+
+void CMesh::GetBounds(vec3 &Min, vec3 &Max)
+{
+	Min = this->Min;
+	Max = this->Max;
+}
+
+void CMesh::GetStats(CMeshStats &Stats)
+{
+	Stats = this->Stats;
+}
+
+void CMesh::Destroy()
+{
+	delete [] Vertices;
+	delete [] Indices;
+
+	Vertices = NULL;
+	Indices = NULL;
+	VerticesCount = IndicesCount = 0;
+
+	if(VertexArray) glDeleteVertexArrays(1, &VertexArray);
+	if(VertexBuffer) glDeleteBuffers(1, &VertexBuffer);
+	if(IndexBuffer) glDeleteBuffers(1, &IndexBuffer);
+
+	VertexBuffer = IndexBuffer = VertexArray = 0;
+
+	Min = Max = vec3(0.0f, 0.0f, 0.0f);
+}
+
+// Tom Forsyth's linear-speed vertex cache optimization; the next triangle is the best scoring one using a vertex in the
+// cache, at a dead end the first one left in the input order
+
+void CMesh::OptimizeVertexCache(unsigned int *Indices, int IndicesCount, int VerticesCount)
+{
+	PROFILE_ZONE("CMesh::OptimizeVertexCache");
+
+	int TrianglesCount = IndicesCount / 3;
+
+	if(TrianglesCount == 0)
+	{
+		return;
+	}
+
+	InitScores();
+
+	// the triangles of every vertex, the ones already emitted are swapped past the end of the vertex's list
+
+	int *Valences = new int[VerticesCount];
+	int *Offsets = new int[VerticesCount];
+	int *Adjacency = new int[TrianglesCount * 3];
+
+	memset(Valences, 0, VerticesCount * sizeof(int));
+
+	for(int i = 0; i < TrianglesCount * 3; i++)
+	{
+		Valences[Indices[i]]++;
+	}
+
+	for(int Vertex = 0, Offset = 0; Vertex < VerticesCount; Vertex++)
+	{
+		Offsets[Vertex] = Offset;
+		Offset += Valences[Vertex];
+		Valences[Vertex] = 0;
+	}
+
+	for(int i = 0; i < TrianglesCount * 3; i++)
+	{
+		int Vertex = Indices[i];
+
+		Adjacency[Offsets[Vertex] + Valences[Vertex]++] = i / 3;
+	}
+
+	float *VertexScores = new float[VerticesCount];
+	bool *Emitted = new bool[TrianglesCount];
+	unsigned int *Output = new unsigned int[TrianglesCount * 3];
+
+	for(int Vertex = 0; Vertex < VerticesCount; Vertex++)
+	{
+		VertexScores[Vertex] = GetVertexScore(-1, Valences[Vertex]);
+	}
+
+	memset(Emitted, 0, TrianglesCount * sizeof(bool));
+
+	int Cache[MESH_SCORE_CACHE_SIZE + 3], NewCache[MESH_SCORE_CACHE_SIZE + 3];
+	int CacheCount = 0;
+
+	int Best = -1, Cursor = 0;
+
+	for(int Triangle = 0; Triangle < TrianglesCount; Triangle++)
+	{
+		if(Best == -1)
+		{
+			while(Emitted[Cursor]) Cursor++;
+
+			Best = Cursor;
+		}
+
+		const unsigned int *Triangle3 = Indices + Best * 3;
+
+		memcpy(Output + Triangle * 3, Triangle3, 3 * sizeof(unsigned int));
+
+		Emitted[Best] = true;
+
+		// the triangle leaves the lists of its vertices and they go to the front of the cache
+
+		int NewCacheCount = 0;
+
+		for(int k = 0; k < 3; k++)
+		{
+			int Vertex = Triangle3[k];
+
+			int *Triangles = Adjacency + Offsets[Vertex];
+
+			for(int i = 0; i < Valences[Vertex]; i++)
+			{
+				if(Triangles[i] == Best)
+				{
+					std::swap(Triangles[i], Triangles[Valences[Vertex] - 1]);
+					Valences[Vertex]--;
+					break;
+				}
+			}
+
+			if(std::find(NewCache, NewCache + NewCacheCount, Vertex) == NewCache + NewCacheCount)
+			{
+				NewCache[NewCacheCount++] = Vertex;
+			}
+		}
+
+		for(int i = 0; i < CacheCount; i++)
+		{
+			if(std::find(NewCache, NewCache + NewCacheCount, Cache[i]) == NewCache + NewCacheCount)
+			{
+				NewCache[NewCacheCount++] = Cache[i];
+			}
+		}
+
+		// the vertices pushed out are rescored too, their triangles may still touch the cache
+
+		for(int i = 0; i < NewCacheCount; i++)
+		{
+			int Vertex = NewCache[i];
+
+			VertexScores[Vertex] = GetVertexScore(i < MESH_SCORE_CACHE_SIZE ? i : -1, Valences[Vertex]);
+		}
+
+		CacheCount = std::min(NewCacheCount, MESH_SCORE_CACHE_SIZE);
+
+		memcpy(Cache, NewCache, CacheCount * sizeof(int));
+
+		Best = -1;
+
+		float BestScore = -1.0f;
+
+		for(int i = 0; i < CacheCount; i++)
+		{
+			int Vertex = Cache[i];
+
+			int *Triangles = Adjacency + Offsets[Vertex];
+
+			for(int j = 0; j < Valences[Vertex]; j++)
+			{
+				const unsigned int *Candidate = Indices + Triangles[j] * 3;
+
+				float Score = VertexScores[Candidate[0]] + VertexScores[Candidate[1]] + VertexScores[Candidate[2]];
+
+				if(Score > BestScore)
+				{
+					BestScore = Score;
+					Best = Triangles[j];
+				}
+			}
+		}
+	}
+
+	memcpy(Indices, Output, TrianglesCount * 3 * sizeof(unsigned int));
+
+	delete [] Output;
+	delete [] Emitted;
+	delete [] VertexScores;
+	delete [] Adjacency;
+	delete [] Offsets;
+	delete [] Valences;
+}
+
+// Sander, Nehab and Barczak's cluster sorting: the triangles are cut into clusters where a triangle misses the cache
+// with all its vertices, and further where a cluster started with a cold cache is not worse than Threshold times the
+// order it comes from; the clusters facing away from the center of the mesh are drawn first, as they are the most
+// likely to hide the others
+
+int CMesh::OptimizeOverdraw(unsigned int *Indices, int IndicesCount, const CVertex *Vertices, int VerticesCount, float Threshold)
+{
+	PROFILE_ZONE("CMesh::OptimizeOverdraw");
+
+	int TrianglesCount = IndicesCount / 3;
+
+	if(TrianglesCount == 0)
+	{
+		return 0;
+	}
+
+	// a vertex is in the FIFO cache when it was loaded at most MESH_FIFO_CACHE_SIZE loads ago, a cold cache is a jump
+	// of the time
+
+	int *LoadTimes = new int[VerticesCount];
+	int Time = MESH_FIFO_CACHE_SIZE + 1;
+
+	memset(LoadTimes, 0, VerticesCount * sizeof(int));
+
+	auto CountMisses = [&](int Triangle)
+	{
+		int Misses = 0;
+
+		for(int k = 0; k < 3; k++)
+		{
+			int Vertex = Indices[Triangle * 3 + k];
+
+			if(Time - LoadTimes[Vertex] > MESH_FIFO_CACHE_SIZE)
+			{
+				LoadTimes[Vertex] = Time++;
+				Misses++;
+			}
+		}
+
+		return Misses;
+	};
+
+	std::vector<int> HardClusters, Clusters;
+
+	for(int Triangle = 0; Triangle < TrianglesCount; Triangle++)
+	{
+		if(CountMisses(Triangle) == 3)
+		{
+			HardClusters.push_back(Triangle);
+		}
+	}
+
+	if(HardClusters.empty() || HardClusters[0] != 0)
+	{
+		HardClusters.insert(HardClusters.begin(), 0);
+	}
+
+	HardClusters.push_back(TrianglesCount);
+
+	for(size_t i = 0; i + 1 < HardClusters.size(); i++)
+	{
+		int First = HardClusters[i], End = HardClusters[i + 1];
+
+		Time += MESH_FIFO_CACHE_SIZE + 1;
+
+		int ClusterMisses = 0;
+
+		for(int Triangle = First; Triangle < End; Triangle++)
+		{
+			ClusterMisses += CountMisses(Triangle);
+		}
+
+		float Limit = Threshold * ClusterMisses / (End - First);
+
+		Clusters.push_back(First);
+
+		Time += MESH_FIFO_CACHE_SIZE + 1;
+
+		int Start = First, Misses = 0;
+
+		for(int Triangle = First; Triangle < End - 1; Triangle++)
+		{
+			Misses += CountMisses(Triangle);
+
+			if(Misses <= Limit * (Triangle - Start + 1))
+			{
+				Clusters.push_back(Triangle + 1);
+
+				Time += MESH_FIFO_CACHE_SIZE + 1;
+
+				Start = Triangle + 1;
+				Misses = 0;
+			}
+		}
+	}
+
+	delete [] LoadTimes;
+
+	int ClustersCount = (int)Clusters.size();
+
+	Clusters.push_back(TrianglesCount);
+
+	// the centroids and normals are weighted by the area of the triangles
+
+	std::vector<vec3> Centroids(ClustersCount), Normals(ClustersCount);
+	std::vector<float> Keys(ClustersCount);
+
+	vec3 MeshCentroid(0.0f, 0.0f, 0.0f);
+	float MeshArea = 0.0f;
+
+	for(int Cluster = 0; Cluster < ClustersCount; Cluster++)
+	{
+		vec3 Centroid(0.0f, 0.0f, 0.0f), Normal(0.0f, 0.0f, 0.0f);
+		float Area = 0.0f;
+
+		for(int Triangle = Clusters[Cluster]; Triangle < Clusters[Cluster + 1]; Triangle++)
+		{
+			const vec3 &a = Vertices[Indices[Triangle * 3 + 0]].Position;
+			const vec3 &b = Vertices[Indices[Triangle * 3 + 1]].Position;
+			const vec3 &c = Vertices[Indices[Triangle * 3 + 2]].Position;
+
+			vec3 TriangleNormal = cross(b - a, c - a);
+
+			float TriangleArea = length(TriangleNormal);
+
+			Centroid = Centroid + (a + b + c) * (TriangleArea / 3.0f);
+			Normal = Normal + TriangleNormal;
+			Area += TriangleArea;
+		}
+
+		MeshCentroid = MeshCentroid + Centroid;
+		MeshArea += Area;
+
+		Centroids[Cluster] = Area > 0.0f ? Centroid / Area : Centroid;
+		Normals[Cluster] = Normal;
+	}
+
+	if(MeshArea > 0.0f)
+	{
+		MeshCentroid = MeshCentroid / MeshArea;
+	}
+
+	std::vector<int> Order(ClustersCount);
+
+	for(int Cluster = 0; Cluster < ClustersCount; Cluster++)
+	{
+		float NormalLength = length(Normals[Cluster]);
+
+		Keys[Cluster] = NormalLength > 0.0f ? dot(Centroids[Cluster] - MeshCentroid, Normals[Cluster]) / NormalLength : 0.0f;
+		Order[Cluster] = Cluster;
+	}
+
+	std::stable_sort(Order.begin(), Order.end(), [&Keys](int a, int b)
+	{
+		return Keys[a] > Keys[b];
+	});
+
+	unsigned int *Output = new unsigned int[TrianglesCount * 3], *Next = Output;
+
+	for(int i = 0; i < ClustersCount; i++)
+	{
+		int Cluster = Order[i];
+
+		int Count = (Clusters[Cluster + 1] - Clusters[Cluster]) * 3;
+
+		memcpy(Next, Indices + Clusters[Cluster] * 3, Count * sizeof(unsigned int));
+
+		Next += Count;
+	}
+
+	memcpy(Indices, Output, TrianglesCount * 3 * sizeof(unsigned int));
+
+	delete [] Output;
+
+	return ClustersCount;
+}
+
+// the vertices are stored in the order the indices first use them, the unused ones go last
+
+void CMesh::OptimizeVertexFetch(CVertex *Vertices, int VerticesCount, unsigned int *Indices, int IndicesCount)
+{
+	PROFILE_ZONE("CMesh::OptimizeVertexFetch");
+
+	int *Remap = new int[VerticesCount];
+
+	for(int Vertex = 0; Vertex < VerticesCount; Vertex++)
+	{
+		Remap[Vertex] = -1;
+	}
+
+	CVertex *Output = new CVertex[VerticesCount];
+
+	int Next = 0;
+
+	for(int i = 0; i < IndicesCount; i++)
+	{
+		int Vertex = Indices[i];
+
+		if(Remap[Vertex] == -1)
+		{
+			Remap[Vertex] = Next;
+			Output[Next++] = Vertices[Vertex];
+		}
+
+		Indices[i] = Remap[Vertex];
+	}
+
+	for(int Vertex = 0; Vertex < VerticesCount; Vertex++)
+	{
+		if(Remap[Vertex] == -1)
+		{
+			Output[Next++] = Vertices[Vertex];
+		}
+	}
+
+	memcpy(Vertices, Output, VerticesCount * sizeof(CVertex));
+
+	delete [] Output;
+	delete [] Remap;
+}
+
+// the misses of a FIFO post-transform cache; per triangle that is the ACMR, 0.5 at best for large regular meshes, per
+// vertex the ATVR, 1.0 at best
+
+int CMesh::CountCacheMisses(const unsigned int *Indices, int IndicesCount, int VerticesCount, int CacheSize)
+{
+	int *LoadTimes = new int[VerticesCount];
+	int Time = CacheSize + 1, Misses = 0;
+
+	memset(LoadTimes, 0, VerticesCount * sizeof(int));
+
+	for(int i = 0; i < IndicesCount; i++)
+	{
+		int Vertex = Indices[i];
+
+		if(Time - LoadTimes[Vertex] > CacheSize)
+		{
+			LoadTimes[Vertex] = Time++;
+			Misses++;
+		}
+	}
+
+	delete [] LoadTimes;
+
+	return Misses;
+}
+
+void CMesh::SetBounds(const CVertex *Vertices, int VerticesCount)
+{
+	if(VerticesCount == 0)
+	{
+		Min = Max = vec3(0.0f, 0.0f, 0.0f);
+		return;
+	}
+
+	Min = Max = Vertices[0].Position;
+
+	for(int i = 1; i < VerticesCount; i++)
+	{
+		Min = min(Min, Vertices[i].Position);
+		Max = max(Max, Vertices[i].Position);
+	}
+}
+
+void CMesh::SetPointers()
+{
+	const BYTE *Base = VertexBuffer ? NULL : (const BYTE*)Vertices;
+
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(CVertex), Base + offsetof(CVertex, TexCoord));
+
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(GL_FLOAT, sizeof(CVertex), Base + offsetof(CVertex, Normal));
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(CVertex), Base + offsetof(CVertex, Position));
+}
+
+void CMesh::ResetPointers()
+{
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
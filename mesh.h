@@ -0,0 +1,93 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the cache Forsyth's scores are computed for, and the FIFO cache the misses are counted with, about the size of the
+// post-transform caches of current hardware
+
+#define MESH_SCORE_CACHE_SIZE 32
+#define MESH_FIFO_CACHE_SIZE 16
+
+// clusters may have up to this times the misses of the order the vertex cache optimization left them in
+
+#define MESH_OVERDRAW_THRESHOLD 1.05f
+
+#define MESH_FILE_MAGIC 0x4853454D // MESH
+#define MESH_FILE_VERSION 1
+
+// 32 bytes, two vertices per 64 byte cache line and none across two
+
+struct CVertex
+{
+	vec3 Position;
+	vec3 Normal;
+	vec2 TexCoord;
+};
+
+struct CMeshStats
+{
+	int Vertices, Triangles, Clusters;
+	int MissesBefore, MissesAfter;
+	float ACMRBefore, ACMRAfter, ATVRBefore, ATVRAfter;
+	double OptimizeTime;
+};
+
+// the vertices follow the 48 byte header and the indices the vertices, so both are aligned when the file is mapped
+
+struct CMeshFileHeader
+{
+	DWORD Magic, Version;
+	int VerticesCount, IndicesCount;
+	float Min[3], Max[3];
+	DWORD Reserved[2];
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// an indexed triangle list kept in a vertex and an index buffer, with the attribute pointers recorded in a vertex array
+// object where there is one; Optimize orders the triangles for the post-transform vertex cache and then the clusters
+// of them front to back to cut overdraw, and the vertices in the order they are first used; Attach takes arrays
+// allocated with new [] without copying them; Load uploads the buffers straight from the mapped file and keeps no copy
+
+class CMesh
+{
+protected:
+	CVertex *Vertices;
+	unsigned int *Indices;
+	int VerticesCount, IndicesCount;
+	GLuint VertexBuffer, IndexBuffer, VertexArray;
+	vec3 Min, Max;
+	CMeshStats Stats;
+
+public:
+	CMesh();
+	~CMesh();
+
+	void Set(const CVertex *Vertices, int VerticesCount, const unsigned int *Indices, int IndicesCount);
+	void Attach(CVertex *Vertices, int VerticesCount, unsigned int *Indices, int IndicesCount);
+	void Optimize();
+	void Upload();
+	bool Save(const char *FileName);
+	bool Load(const char *FileName);
+	void Bind();
+	void Draw();
+	void DrawInstanced(int InstancesCount);
+	void DrawRange(int FirstIndex, int IndicesCount);
+	void Unbind();
+	void GetBounds(vec3 &Min, vec3 &Max);
+	void GetStats(CMeshStats &Stats);
+	void Destroy();
+
+	static void OptimizeVertexCache(unsigned int *Indices, int IndicesCount, int VerticesCount);
+	static int OptimizeOverdraw(unsigned int *Indices, int IndicesCount, const CVertex *Vertices, int VerticesCount, float Threshold);
+	static void OptimizeVertexFetch(CVertex *Vertices, int VerticesCount, unsigned int *Indices, int IndicesCount);
+	static int CountCacheMisses(const unsigned int *Indices, int IndicesCount, int VerticesCount, int CacheSize = MESH_FIFO_CACHE_SIZE);
+
+protected:
+	void CreateBuffers(const CVertex *Vertices, const unsigned int *Indices);
+	void SetBounds(const CVertex *Vertices, int VerticesCount);
+	void SetPointers();
+	void ResetPointers();
+};
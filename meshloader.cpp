@@ -0,0 +1,1310 @@
+#include "meshloader.h"
+#include "profiler.h"
+#include "threadpool.h"
+
+#include <atomic>
+#include <math.h>
+#include <string>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static inline bool IsBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool IsDigit(char c)
+{
+	return (unsigned char)(c - '0') < 10;
+}
+
+// eight ASCII digits are checked and converted at once within a 64 bit register, the most significant digit is the first
+// byte in memory
+
+static inline bool IsEightDigits(unsigned long long Chars)
+{
+	return ((Chars & 0xF0F0F0F0F0F0F0F0ull) | (((Chars + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+static inline unsigned int ParseEightDigits(unsigned long long Chars)
+{
+	Chars -= 0x3030303030303030ull;
+	Chars = Chars * 10 + (Chars >> 8);
+	Chars = ((Chars & 0x000000FF000000FFull) * 0x000F424000000064ull + ((Chars >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull) >> 32;
+
+	return (unsigned int)Chars;
+}
+
+// up to 19 significant digits are kept, the power of ten is exact up to 1e22, so nearly every float in a mesh file is
+// rounded correctly; returns NULL when there is no number
+
+static const double PowersOf10[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const char* ParseFloat(const char *Text, const char *End, float &Value)
+{
+	while(Text < End && IsBlank(*Text)) Text++;
+
+	bool Negative = false;
+
+	if(Text < End && (*Text == '-' || *Text == '+'))
+	{
+		Negative = *Text++ == '-';
+	}
+
+	unsigned long long Mantissa = 0;
+	int Exponent = 0, Digits = 0;
+	bool Fraction = false;
+
+	const char *First = Text;
+
+	while(true)
+	{
+		unsigned long long Chars;
+
+		while(Digits <= 11 && End - Text >= 8 && (memcpy(&Chars, Text, 8), IsEightDigits(Chars)))
+		{
+			Mantissa = Mantissa * 100000000 + ParseEightDigits(Chars);
+			Digits += Mantissa > 0 ? 8 : 0;
+			Exponent -= Fraction ? 8 : 0;
+			Text += 8;
+		}
+
+		while(Text < End && IsDigit(*Text))
+		{
+			if(Digits < 19)
+			{
+				Mantissa = Mantissa * 10 + (*Text - '0');
+				Digits += Mantissa > 0 ? 1 : 0;
+				Exponent -= Fraction ? 1 : 0;
+			}
+			else if(!Fraction)
+			{
+				Exponent++;
+			}
+
+			Text++;
+		}
+
+		if(Fraction || Text >= End || *Text != '.')
+		{
+			break;
+		}
+
+		Fraction = true;
+		Text++;
+	}
+
+	if(Text == First || (Text == First + 1 && *First == '.'))
+	{
+		return NULL;
+	}
+
+	if(Text < End && (*Text == 'e' || *Text == 'E'))
+	{
+		Text++;
+
+		bool NegativeExponent = false;
+
+		if(Text < End && (*Text == '-' || *Text == '+'))
+		{
+			NegativeExponent = *Text++ == '-';
+		}
+
+		int Power = 0;
+
+		while(Text < End && IsDigit(*Text))
+		{
+			if(Power < 10000) Power = Power * 10 + (*Text - '0');
+			Text++;
+		}
+
+		Exponent += NegativeExponent ? -Power : Power;
+	}
+
+	double Result = (double)Mantissa;
+
+	if(Exponent < 0)
+	{
+		Result = Exponent >= -22 ? Result / PowersOf10[-Exponent] : Result * pow(10.0, Exponent);
+	}
+	else if(Exponent > 0)
+	{
+		Result = Exponent <= 22 ? Result * PowersOf10[Exponent] : Result * pow(10.0, Exponent);
+	}
+
+	Value = (float)(Negative ? -Result : Result);
+
+	return Text;
+}
+
+static const char* ParseInt(const char *Text, const char *End, int &Value)
+{
+	while(Text < End && IsBlank(*Text)) Text++;
+
+	bool Negative = false;
+
+	if(Text < End && (*Text == '-' || *Text == '+'))
+	{
+		Negative = *Text++ == '-';
+	}
+
+	const char *First = Text;
+
+	long long Result = 0;
+
+	while(Text < End && IsDigit(*Text))
+	{
+		if(Result < 0x7FFFFFFF) Result = Result * 10 + (*Text - '0');
+		Text++;
+	}
+
+	if(Text == First || Result > 0x7FFFFFFF)
+	{
+		return NULL;
+	}
+
+	Value = (int)(Negative ? -Result : Result);
+
+	return Text;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the indices of a corner are 1-based while parsing, 0 where the corner has none and negative for indices relative to
+// the end of the list, which are only known once the chunks before are counted; after resolving they are 0-based and
+// -1 where there is none
+
+#define OBJ_RELATIVE (1 << 30)
+
+struct CObjCorner
+{
+	int Position, TexCoord, Normal;
+
+	bool operator == (const CObjCorner &Corner) const
+	{
+		return Position == Corner.Position && TexCoord == Corner.TexCoord && Normal == Corner.Normal;
+	}
+};
+
+static inline unsigned int HashCorner(const CObjCorner &Corner)
+{
+	unsigned long long Hash = (unsigned int)Corner.Position * 0x9E3779B97F4A7C15ull;
+
+	Hash ^= (unsigned int)Corner.TexCoord * 0xC2B2AE3D27D4EB4Full;
+	Hash ^= (unsigned int)Corner.Normal * 0x165667B19E3779F9ull;
+	Hash ^= Hash >> 32;
+	Hash *= 0xD6E8FEB86659FD93ull;
+	Hash ^= Hash >> 32;
+
+	return (unsigned int)Hash;
+}
+
+// open addressing with linear probing on the low bits of the hash, the merge partitions use the high bits
+
+class CCornerTable
+{
+protected:
+	std::vector<int> Slots;
+	unsigned int Mask;
+
+public:
+	void Init(size_t Capacity)
+	{
+		size_t Size = 16;
+
+		while(Size < Capacity * 2) Size <<= 1;
+
+		Slots.assign(Size, -1);
+		Mask = (unsigned int)Size - 1;
+	}
+
+	// the slot holding the index of the corner, or the empty one it goes to
+
+	int& Find(const CObjCorner *Corners, const CObjCorner &Corner, unsigned int Hash)
+	{
+		unsigned int Slot = Hash & Mask;
+
+		while(Slots[Slot] != -1 && !(Corners[Slots[Slot]] == Corner))
+		{
+			Slot = (Slot + 1) & Mask;
+		}
+
+		return Slots[Slot];
+	}
+
+	bool IsFull(size_t Count)
+	{
+		return Count * 2 > Slots.size();
+	}
+
+	void Grow(const std::vector<unsigned int> &Hashes)
+	{
+		Init(Hashes.size() * 2);
+
+		for(size_t i = 0; i < Hashes.size(); i++)
+		{
+			unsigned int Slot = Hashes[i] & Mask;
+
+			while(Slots[Slot] != -1) Slot = (Slot + 1) & Mask;
+
+			Slots[Slot] = (int)i;
+		}
+	}
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+struct CObjChunk
+{
+	std::vector<vec3> Positions, Normals;
+	std::vector<vec2> TexCoords;
+	std::vector<CObjCorner> Corners;
+	std::vector<unsigned int> Hashes, Indices;
+	int PositionsBase, TexCoordsBase, NormalsBase, IndicesBase;
+	const char *Error;
+
+	void Parse(const char *Text, const char *End);
+	bool Resolve(int PositionsCount, int TexCoordsCount, int NormalsCount);
+};
+
+// faces are split into fans and their corners replaced by the index of the first equal one in the chunk; v, vt, vn and f
+// are read, everything else is skipped
+
+void CObjChunk::Parse(const char *Text, const char *End)
+{
+	CCornerTable Table;
+
+	Table.Init((End - Text) / 32);
+
+	std::vector<unsigned int> Face;
+
+	Error = NULL;
+
+	while(Text < End)
+	{
+		const char *LineEnd = (const char*)memchr(Text, '\n', End - Text);
+
+		if(LineEnd == NULL) LineEnd = End;
+
+		while(Text < LineEnd && IsBlank(*Text)) Text++;
+
+		const char *Line = Text;
+
+		if(LineEnd - Text >= 2 && Text[0] == 'v' && IsBlank(Text[1]))
+		{
+			vec3 Position;
+
+			Text = ParseFloat(Text + 2, LineEnd, Position.x);
+			if(Text) Text = ParseFloat(Text, LineEnd, Position.y);
+			if(Text) Text = ParseFloat(Text, LineEnd, Position.z);
+
+			Positions.push_back(Position);
+		}
+		else if(LineEnd - Text >= 3 && Text[0] == 'v' && Text[1] == 't' && IsBlank(Text[2]))
+		{
+			vec2 TexCoord(0.0f, 0.0f);
+
+			Text = ParseFloat(Text + 3, LineEnd, TexCoord.x);
+
+			// the second coordinate may be missing for 1D textures
+
+			if(Text)
+			{
+				const char *Second = ParseFloat(Text, LineEnd, TexCoord.y);
+
+				if(Second) Text = Second;
+			}
+
+			TexCoords.push_back(TexCoord);
+		}
+		else if(LineEnd - Text >= 3 && Text[0] == 'v' && Text[1] == 'n' && IsBlank(Text[2]))
+		{
+			vec3 Normal;
+
+			Text = ParseFloat(Text + 3, LineEnd, Normal.x);
+			if(Text) Text = ParseFloat(Text, LineEnd, Normal.y);
+			if(Text) Text = ParseFloat(Text, LineEnd, Normal.z);
+
+			Normals.push_back(Normal);
+		}
+		else if(LineEnd - Text >= 2 && Text[0] == 'f' && IsBlank(Text[1]))
+		{
+			Text++;
+
+			Face.clear();
+
+			while(Text)
+			{
+				while(Text < LineEnd && IsBlank(*Text)) Text++;
+
+				if(Text >= LineEnd)
+				{
+					break;
+				}
+
+				// position, position/texcoord, position//normal or position/texcoord/normal
+
+				int Values[3] = {0, 0, 0}, Counts[3] = {(int)Positions.size(), (int)TexCoords.size(), (int)Normals.size()};
+
+				for(int i = 0; i < 3 && Text; i++)
+				{
+					if(i > 0)
+					{
+						if(Text >= LineEnd || *Text != '/') break;
+
+						Text++;
+
+						if(i == 1 && Text < LineEnd && *Text == '/') continue;
+					}
+
+					Text = ParseInt(Text, LineEnd, Values[i]);
+
+					if(Text && Values[i] == 0) Text = NULL;
+
+					if(Text && Values[i] < 0) Values[i] = Counts[i] + Values[i] - OBJ_RELATIVE;
+				}
+
+				if(Text == NULL || (Text < LineEnd && !IsBlank(*Text)))
+				{
+					Text = NULL;
+					break;
+				}
+
+				CObjCorner Corner = {Values[0], Values[1], Values[2]};
+
+				unsigned int Hash = HashCorner(Corner);
+
+				int &Slot = Table.Find(Corners.data(), Corner, Hash);
+
+				if(Slot == -1)
+				{
+					Slot = (int)Corners.size();
+
+					Corners.push_back(Corner);
+					Hashes.push_back(Hash);
+
+					if(Table.IsFull(Corners.size()))
+					{
+						Table.Grow(Hashes);
+					}
+
+					Face.push_back((unsigned int)Corners.size() - 1);
+				}
+				else
+				{
+					Face.push_back(Slot);
+				}
+			}
+
+			if(Text && Face.size() < 3)
+			{
+				Text = NULL;
+			}
+
+			for(size_t i = 2; Text && i < Face.size(); i++)
+			{
+				Indices.push_back(Face[0]);
+				Indices.push_back(Face[i - 1]);
+				Indices.push_back(Face[i]);
+			}
+		}
+
+		if(Text == NULL)
+		{
+			Error = Line;
+			return;
+		}
+
+		Text = LineEnd + 1;
+	}
+}
+
+// relative indices are made absolute with the counts of the chunks before, the hashes are of the resolved corners
+
+bool CObjChunk::Resolve(int PositionsCount, int TexCoordsCount, int NormalsCount)
+{
+	int Bases[3] = {PositionsBase, TexCoordsBase, NormalsBase}, Counts[3] = {PositionsCount, TexCoordsCount, NormalsCount};
+
+	for(size_t i = 0; i < Corners.size(); i++)
+	{
+		int *Values = &Corners[i].Position;
+
+		for(int k = 0; k < 3; k++)
+		{
+			if(Values[k] > 0)
+			{
+				Values[k]--;
+			}
+			else if(Values[k] < 0)
+			{
+				Values[k] = Bases[k] + Values[k] + OBJ_RELATIVE;
+			}
+			else
+			{
+				Values[k] = -1;
+				continue;
+			}
+
+			if(Values[k] < 0 || Values[k] >= Counts[k])
+			{
+				return false;
+			}
+		}
+
+		Hashes[i] = HashCorner(Corners[i]);
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+enum PLY_TYPE
+{
+	PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_TYPES
+};
+
+static const char *PlyTypeNames[PLY_TYPES][2] =
+{
+	{"char", "int8"}, {"uchar", "uint8"}, {"short", "int16"}, {"ushort", "uint16"}, {"int", "int32"}, {"uint", "uint32"}, {"float", "float32"}, {"double", "float64"}
+};
+
+static const int PlyTypeSizes[PLY_TYPES] = {1, 1, 2, 2, 4, 4, 4, 8};
+
+// the vertex properties are stored at their float offset in CVertex, the face index list at 0
+
+static const char *PlyVertexProperties[][2] =
+{
+	{"x", "x"}, {"y", "y"}, {"z", "z"}, {"nx", "nx"}, {"ny", "ny"}, {"nz", "nz"}, {"u", "s"}, {"v", "t"}, {"texture_u", "texture_s"}, {"texture_v", "texture_t"}
+};
+
+struct CPlyProperty
+{
+	int Type, CountType, Target;
+};
+
+struct CPlyElement
+{
+	std::string Name;
+	int Count, Size;
+	std::vector<CPlyProperty> Properties;
+};
+
+static int GetPlyType(const char *Name)
+{
+	for(int Type = 0; Type < PLY_TYPES; Type++)
+	{
+		if(strcmp(Name, PlyTypeNames[Type][0]) == 0 || strcmp(Name, PlyTypeNames[Type][1]) == 0)
+		{
+			return Type;
+		}
+	}
+
+	return -1;
+}
+
+static inline double ReadPlyValue(const BYTE *Data, int Type)
+{
+	switch(Type)
+	{
+		case PLY_INT8: return *(const signed char*)Data;
+		case PLY_UINT8: return *Data;
+		case PLY_INT16: { short Value; memcpy(&Value, Data, 2); return Value; }
+		case PLY_UINT16: { unsigned short Value; memcpy(&Value, Data, 2); return Value; }
+		case PLY_INT32: { int Value; memcpy(&Value, Data, 4); return Value; }
+		case PLY_UINT32: { unsigned int Value; memcpy(&Value, Data, 4); return Value; }
+		case PLY_FLOAT32: { float Value; memcpy(&Value, Data, 4); return Value; }
+		default: { double Value; memcpy(&Value, Data, 8); return Value; }
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CMeshLoader::CMeshLoader()
+{
+	FileName = NULL;
+	Workers = 1;
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CMeshLoader::~CMeshLoader()
+{
+}
+
+bool CMeshLoader::Load(const char *FileName, CMesh &Mesh, int Workers)
+{
+	PROFILE_ZONE("CMeshLoader::Load");
+
+	double Start = GetTime();
+
+	memset(&Stats, 0, sizeof(Stats));
+
+	ThreadPool.Start();
+
+	this->FileName = FileName;
+	this->Workers = Workers > 0 ? Workers : ThreadPool.GetThreadsCount() + 1;
+
+	CMappedFile File;
+
+	if(!File.Open(FileName))
+	{
+		ErrorLog.Append("Error loading file %s!\r\n", FileName);
+		return false;
+	}
+
+	File.Prefetch();
+
+	Stats.Bytes = File.Size;
+	Stats.Workers = this->Workers;
+
+	const char *Extension = strrchr(FileName, '.');
+
+	bool Loaded;
+
+	if(strcmp(Extension, ".obj") == 0 || strcmp(Extension, ".OBJ") == 0)
+	{
+		Loaded = LoadOBJ((const char*)File.Data, File.Size, Mesh);
+	}
+	else
+	{
+		Loaded = LoadPLY((const char*)File.Data, File.Size, Mesh);
+	}
+
+	Stats.TotalTime = GetTime() - Start;
+
+	return Loaded;
+}
+
+void CMeshLoader::GetStats(CMeshLoaderStats &Stats)
+{
+	Stats = this->Stats;
+}
+
+bool CMeshLoader::IsSupported(const char *FileName)
+{
+	const char *Extension = strrchr(FileName, '.');
+
+	if(Extension == NULL)
+	{
+		return false;
+	}
+
+	return strcmp(Extension, ".obj") == 0 || strcmp(Extension, ".OBJ") == 0 || strcmp(Extension, ".ply") == 0 || strcmp(Extension, ".PLY") == 0;
+}
+
+// the chunks are parsed in parallel; the attribute lists are concatenated and the corners of every chunk resolved, then
+// every partition deduplicates the corners whose hash falls into it across all chunks, and the vertex indices are the
+// partition's offset plus the index within it
+
+bool CMeshLoader::LoadOBJ(const char *Text, size_t Size, CMesh &Mesh)
+{
+	double Start = GetTime();
+
+	std::vector<const char*> Bounds;
+
+	SplitLines(Text, Size, Bounds);
+
+	int ChunksCount = (int)Bounds.size() - 1;
+
+	std::vector<CObjChunk> Chunks(ChunksCount);
+
+	Run(ChunksCount, [&](int Chunk)
+	{
+		Chunks[Chunk].Parse(Bounds[Chunk], Bounds[Chunk + 1]);
+	});
+
+	Stats.Chunks = ChunksCount;
+	Stats.ParseTime = GetTime() - Start;
+
+	Start = GetTime();
+
+	int PositionsCount = 0, TexCoordsCount = 0, NormalsCount = 0, IndicesCount = 0;
+
+	for(int i = 0; i < ChunksCount; i++)
+	{
+		CObjChunk &Chunk = Chunks[i];
+
+		if(Chunk.Error)
+		{
+			const char *LineEnd = (const char*)memchr(Chunk.Error, '\n', Text + Size - Chunk.Error);
+
+			std::string Line(Chunk.Error, LineEnd ? LineEnd : Text + Size);
+
+			ErrorLog.Append("Error loading file %s! -> invalid line at byte %lld: %s\r\n", FileName, (long long)(Chunk.Error - Text), Line.c_str());
+			return false;
+		}
+
+		Chunk.PositionsBase = PositionsCount;
+		Chunk.TexCoordsBase = TexCoordsCount;
+		Chunk.NormalsBase = NormalsCount;
+		Chunk.IndicesBase = IndicesCount;
+
+		PositionsCount += (int)Chunk.Positions.size();
+		TexCoordsCount += (int)Chunk.TexCoords.size();
+		NormalsCount += (int)Chunk.Normals.size();
+		IndicesCount += (int)Chunk.Indices.size();
+	}
+
+	if(IndicesCount == 0)
+	{
+		ErrorLog.Append("Error loading file %s! -> no faces\r\n", FileName);
+		return false;
+	}
+
+	std::vector<vec3> Positions(PositionsCount), Normals(NormalsCount);
+	std::vector<vec2> TexCoords(TexCoordsCount);
+
+	std::atomic<bool> Invalid(false);
+
+	Run(ChunksCount, [&](int i)
+	{
+		CObjChunk &Chunk = Chunks[i];
+
+		std::copy(Chunk.Positions.begin(), Chunk.Positions.end(), Positions.begin() + Chunk.PositionsBase);
+		std::copy(Chunk.TexCoords.begin(), Chunk.TexCoords.end(), TexCoords.begin() + Chunk.TexCoordsBase);
+		std::copy(Chunk.Normals.begin(), Chunk.Normals.end(), Normals.begin() + Chunk.NormalsBase);
+
+		std::vector<vec3>().swap(Chunk.Positions);
+		std::vector<vec2>().swap(Chunk.TexCoords);
+		std::vector<vec3>().swap(Chunk.Normals);
+
+		if(!Chunk.Resolve(PositionsCount, TexCoordsCount, NormalsCount))
+		{
+			Invalid = true;
+		}
+	});
+
+	if(Invalid)
+	{
+		ErrorLog.Append("Error loading file %s! -> face index out of range\r\n", FileName);
+		return false;
+	}
+
+	// the partition is taken from the high bits of the hash, the tables probe with the low ones
+
+	int PartitionsCount = Workers;
+
+	std::vector<std::vector<CObjCorner>> Partitions(PartitionsCount);
+	std::vector<std::vector<int>> Remaps(ChunksCount);
+	std::vector<int> Offsets(PartitionsCount + 1);
+
+	for(int i = 0; i < ChunksCount; i++)
+	{
+		Remaps[i].resize(Chunks[i].Corners.size());
+	}
+
+	Run(PartitionsCount, [&](int Partition)
+	{
+		size_t Count = 0;
+
+		for(int i = 0; i < ChunksCount; i++)
+		{
+			for(size_t j = 0; j < Chunks[i].Hashes.size(); j++)
+			{
+				Count += (int)(((unsigned long long)Chunks[i].Hashes[j] * PartitionsCount) >> 32) == Partition ? 1 : 0;
+			}
+		}
+
+		std::vector<CObjCorner> &Corners = Partitions[Partition];
+
+		Corners.reserve(Count);
+
+		CCornerTable Table;
+
+		Table.Init(Count);
+
+		for(int i = 0; i < ChunksCount; i++)
+		{
+			CObjChunk &Chunk = Chunks[i];
+
+			for(size_t j = 0; j < Chunk.Corners.size(); j++)
+			{
+				if((int)(((unsigned long long)Chunk.Hashes[j] * PartitionsCount) >> 32) != Partition)
+				{
+					continue;
+				}
+
+				int &Slot = Table.Find(Corners.data(), Chunk.Corners[j], Chunk.Hashes[j]);
+
+				if(Slot == -1)
+				{
+					Slot = (int)Corners.size();
+					Corners.push_back(Chunk.Corners[j]);
+				}
+
+				Remaps[i][j] = Slot;
+			}
+		}
+	});
+
+	Offsets[0] = 0;
+
+	for(int Partition = 0; Partition < PartitionsCount; Partition++)
+	{
+		Offsets[Partition + 1] = Offsets[Partition] + (int)Partitions[Partition].size();
+	}
+
+	int VerticesCount = Offsets[PartitionsCount];
+
+	CVertex *Vertices = new CVertex[VerticesCount];
+	unsigned int *Indices = new unsigned int[IndicesCount];
+
+	std::atomic<bool> MissingNormals(false);
+
+	Run(PartitionsCount, [&](int Partition)
+	{
+		std::vector<CObjCorner> &Corners = Partitions[Partition];
+
+		CVertex *Vertex = Vertices + Offsets[Partition];
+
+		for(size_t i = 0; i < Corners.size(); i++, Vertex++)
+		{
+			Vertex->Position = Positions[Corners[i].Position];
+			Vertex->Normal = Corners[i].Normal >= 0 ? Normals[Corners[i].Normal] : vec3(0.0f, 0.0f, 0.0f);
+			Vertex->TexCoord = Corners[i].TexCoord >= 0 ? TexCoords[Corners[i].TexCoord] : vec2(0.0f, 0.0f);
+
+			if(Corners[i].Normal < 0) MissingNormals = true;
+		}
+
+		std::vector<CObjCorner>().swap(Corners);
+	});
+
+	Run(ChunksCount, [&](int i)
+	{
+		CObjChunk &Chunk = Chunks[i];
+
+		std::vector<int> &Remap = Remaps[i];
+
+		for(size_t j = 0; j < Remap.size(); j++)
+		{
+			Remap[j] += Offsets[((unsigned long long)Chunk.Hashes[j] * PartitionsCount) >> 32];
+		}
+
+		for(size_t j = 0; j < Chunk.Indices.size(); j++)
+		{
+			Indices[Chunk.IndicesBase + j] = Remap[Chunk.Indices[j]];
+		}
+	});
+
+	if(MissingNormals)
+	{
+		ComputeNormals(Vertices, VerticesCount, Indices, IndicesCount);
+	}
+
+	Stats.MergeTime = GetTime() - Start;
+	Stats.Vertices = VerticesCount;
+	Stats.Triangles = IndicesCount / 3;
+
+	Mesh.Attach(Vertices, VerticesCount, Indices, IndicesCount);
+
+	return true;
+}
+
+// the header is read line by line; the vertices of a binary file are converted in runs on the thread pool, the lines
+// of an ASCII one are counted first and the runs of them parsed in parallel, the faces of a binary file are read on
+// this thread as they have no fixed size
+
+bool CMeshLoader::LoadPLY(const char *Text, size_t Size, CMesh &Mesh)
+{
+	double Start = GetTime();
+
+	const char *End = Text + Size, *Line = Text;
+
+	std::vector<CPlyElement> Elements;
+
+	bool Ascii = false, Header = true, Valid = Size > 4 && strncmp(Text, "ply", 3) == 0;
+
+	while(Valid && Header)
+	{
+		const char *LineEnd = (const char*)memchr(Line, '\n', End - Line);
+
+		if(LineEnd == NULL)
+		{
+			Valid = false;
+			break;
+		}
+
+		std::string HeaderLine(Line, LineEnd);
+
+		Line = LineEnd + 1;
+
+		char Words[4][64];
+
+		int WordsCount = sscanf(HeaderLine.c_str(), "%63s %63s %63s %63s", Words[0], Words[1], Words[2], Words[3]);
+
+		if(WordsCount <= 0)
+		{
+			continue;
+		}
+
+		if(strcmp(Words[0], "end_header") == 0)
+		{
+			Header = false;
+		}
+		else if(strcmp(Words[0], "format") == 0 && WordsCount >= 2)
+		{
+			Ascii = strcmp(Words[1], "ascii") == 0;
+			Valid = Ascii || strcmp(Words[1], "binary_little_endian") == 0;
+		}
+		else if(strcmp(Words[0], "element") == 0 && WordsCount >= 3)
+		{
+			CPlyElement Element;
+
+			Element.Name = Words[1];
+			Element.Count = atoi(Words[2]);
+			Element.Size = 0;
+
+			Valid = Element.Count >= 0;
+
+			Elements.push_back(Element);
+		}
+		else if(strcmp(Words[0], "property") == 0 && WordsCount >= 3 && !Elements.empty())
+		{
+			CPlyElement &Element = Elements.back();
+
+			CPlyProperty Property;
+
+			bool List = strcmp(Words[1], "list") == 0 && WordsCount >= 4;
+
+			Property.CountType = List ? GetPlyType(Words[2]) : -1;
+			Property.Type = GetPlyType(Words[List ? 3 : 1]);
+			Property.Target = -1;
+
+			const char *Name = HeaderLine.c_str() + HeaderLine.find_last_of(" \t\r", HeaderLine.find_last_not_of(" \t\r")) + 1;
+
+			std::string PropertyName(Name, strcspn(Name, " \t\r"));
+
+			if(List)
+			{
+				Valid = Property.CountType >= 0 && Property.Type >= 0;
+
+				if(Element.Name == "face" && (PropertyName == "vertex_indices" || PropertyName == "vertex_index"))
+				{
+					Property.Target = 0;
+				}
+
+				Element.Size = -1;
+			}
+			else
+			{
+				Valid = Property.Type >= 0;
+
+				for(int i = 0; Valid && Element.Name == "vertex" && i < (int)(sizeof(PlyVertexProperties) / sizeof(PlyVertexProperties[0])); i++)
+				{
+					if(PropertyName == PlyVertexProperties[i][0] || PropertyName == PlyVertexProperties[i][1])
+					{
+						Property.Target = i < 8 ? i : i - 2;
+					}
+				}
+
+				if(Valid && Element.Size >= 0) Element.Size += PlyTypeSizes[Property.Type];
+			}
+
+			Element.Properties.push_back(Property);
+		}
+	}
+
+	CPlyElement *VertexElement = NULL, *FaceElement = NULL;
+
+	for(size_t i = 0; i < Elements.size(); i++)
+	{
+		if(Elements[i].Name == "vertex") VertexElement = &Elements[i];
+		if(Elements[i].Name == "face") FaceElement = &Elements[i];
+	}
+
+	if(!Valid || VertexElement == NULL || FaceElement == NULL || VertexElement->Size < 0)
+	{
+		ErrorLog.Append("Error loading file %s! -> not a PLY file with vertices and faces, or not ASCII or binary little endian\r\n", FileName);
+		return false;
+	}
+
+	bool HasNormals = false;
+
+	for(size_t i = 0; i < VertexElement->Properties.size(); i++)
+	{
+		HasNormals |= VertexElement->Properties[i].Target >= 3 && VertexElement->Properties[i].Target <= 5;
+	}
+
+	int VerticesCount = VertexElement->Count;
+
+	CVertex *Vertices = new CVertex[VerticesCount];
+
+	for(int i = 0; i < VerticesCount; i++)
+	{
+		Vertices[i].Position = Vertices[i].Normal = vec3(0.0f, 0.0f, 0.0f);
+		Vertices[i].TexCoord = vec2(0.0f, 0.0f);
+	}
+
+	std::vector<unsigned int> Indices;
+
+	std::atomic<bool> Invalid(false);
+
+	const char *Data = Line;
+
+	for(size_t e = 0; e < Elements.size() && !Invalid; e++)
+	{
+		CPlyElement &Element = Elements[e];
+
+		std::vector<const char*> Runs;
+
+		if(Ascii)
+		{
+			Data = SkipLines(Data, End, Element.Count, Runs);
+
+			if(Data == NULL)
+			{
+				Invalid = true;
+				break;
+			}
+		}
+		else if(&Element != FaceElement)
+		{
+			if(Element.Size < 0 || (size_t)(End - Data) / (Element.Size > 0 ? Element.Size : 1) < (size_t)Element.Count)
+			{
+				Invalid = true;
+				break;
+			}
+
+			for(int i = 0; i < Element.Count; i += MESH_LOADER_ELEMENTS_GRAIN)
+			{
+				Runs.push_back(Data + (size_t)i * Element.Size);
+			}
+
+			Data += (size_t)Element.Count * Element.Size;
+
+			Runs.push_back(Data);
+		}
+
+		int RunsCount = (int)Runs.size() - 1;
+
+		if(&Element == VertexElement || &Element == FaceElement)
+		{
+			Stats.Chunks += RunsCount > 0 ? RunsCount : 0;
+		}
+
+		if(&Element == VertexElement)
+		{
+			Run(RunsCount, [&](int i)
+			{
+				float *Vertex = (float*)(Vertices + (size_t)i * MESH_LOADER_ELEMENTS_GRAIN);
+
+				const char *Text = Runs[i];
+
+				for(; Text < Runs[i + 1]; Vertex += sizeof(CVertex) / sizeof(float))
+				{
+					for(size_t p = 0; p < Element.Properties.size(); p++)
+					{
+						const CPlyProperty &Property = Element.Properties[p];
+
+						float Value;
+
+						if(Ascii)
+						{
+							Text = ParseFloat(Text, Runs[i + 1], Value);
+
+							if(Text == NULL)
+							{
+								Invalid = true;
+								return;
+							}
+						}
+						else
+						{
+							Value = (float)ReadPlyValue((const BYTE*)Text, Property.Type);
+
+							Text += PlyTypeSizes[Property.Type];
+						}
+
+						if(Property.Target >= 0) Vertex[Property.Target] = Value;
+					}
+
+					if(Ascii)
+					{
+						const char *LineEnd = (const char*)memchr(Text, '\n', Runs[i + 1] - Text);
+
+						Text = LineEnd ? LineEnd + 1 : Runs[i + 1];
+					}
+				}
+			});
+		}
+		else if(&Element == FaceElement && Ascii)
+		{
+			std::vector<std::vector<unsigned int>> RunIndices(RunsCount);
+
+			Run(RunsCount, [&](int i)
+			{
+				std::vector<unsigned int> &Triangles = RunIndices[i];
+
+				const char *Text = Runs[i];
+
+				while(Text && Text < Runs[i + 1])
+				{
+					for(size_t p = 0; Text && p < Element.Properties.size(); p++)
+					{
+						const CPlyProperty &Property = Element.Properties[p];
+
+						int Count = 1, First = 0, Previous = 0, Index = 0;
+
+						if(Property.CountType >= 0)
+						{
+							Text = ParseInt(Text, Runs[i + 1], Count);
+						}
+
+						for(int c = 0; Text && c < Count; c++)
+						{
+							if(Property.Target != 0)
+							{
+								float Value;
+								Text = ParseFloat(Text, Runs[i + 1], Value);
+								continue;
+							}
+
+							Text = ParseInt(Text, Runs[i + 1], Index);
+
+							if(Text && (Index < 0 || Index >= VerticesCount))
+							{
+								Text = NULL;
+							}
+							else if(c == 0)
+							{
+								First = Index;
+							}
+							else if(c >= 2)
+							{
+								Triangles.push_back(First);
+								Triangles.push_back(Previous);
+								Triangles.push_back(Index);
+							}
+
+							Previous = Index;
+						}
+					}
+
+					if(Text)
+					{
+						const char *LineEnd = (const char*)memchr(Text, '\n', Runs[i + 1] - Text);
+
+						Text = LineEnd ? LineEnd + 1 : Runs[i + 1];
+					}
+				}
+
+				if(Text == NULL) Invalid = true;
+			});
+
+			size_t Count = 0;
+
+			for(int i = 0; i < RunsCount; i++) Count += RunIndices[i].size();
+
+			Indices.reserve(Count);
+
+			for(int i = 0; i < RunsCount; i++) Indices.insert(Indices.end(), RunIndices[i].begin(), RunIndices[i].end());
+		}
+		else if(&Element == FaceElement)
+		{
+			const BYTE *Face = (const BYTE*)Data, *FacesEnd = (const BYTE*)End;
+
+			for(int f = 0; f < Element.Count && !Invalid; f++)
+			{
+				for(size_t p = 0; p < Element.Properties.size() && !Invalid; p++)
+				{
+					const CPlyProperty &Property = Element.Properties[p];
+
+					int Count = 1;
+
+					if(Property.CountType >= 0)
+					{
+						if(Face + PlyTypeSizes[Property.CountType] > FacesEnd)
+						{
+							Invalid = true;
+							break;
+						}
+
+						Count = (int)ReadPlyValue(Face, Property.CountType);
+
+						Face += PlyTypeSizes[Property.CountType];
+					}
+
+					if(Count < 0 || (size_t)(FacesEnd - Face) < (size_t)Count * PlyTypeSizes[Property.Type])
+					{
+						Invalid = true;
+						break;
+					}
+
+					if(Property.Target == 0)
+					{
+						unsigned int First = 0, Previous = 0;
+
+						for(int c = 0; c < Count; c++)
+						{
+							double Index = ReadPlyValue(Face + c * PlyTypeSizes[Property.Type], Property.Type);
+
+							if(Index < 0.0 || Index >= VerticesCount)
+							{
+								Invalid = true;
+								break;
+							}
+
+							if(c == 0) First = (unsigned int)Index;
+
+							if(c >= 2)
+							{
+								Indices.push_back(First);
+								Indices.push_back(Previous);
+								Indices.push_back((unsigned int)Index);
+							}
+
+							Previous = (unsigned int)Index;
+						}
+					}
+
+					Face += Count * PlyTypeSizes[Property.Type];
+				}
+			}
+
+			Data = (const char*)Face;
+		}
+	}
+
+	Stats.ParseTime = GetTime() - Start;
+
+	if(Invalid || Indices.empty())
+	{
+		ErrorLog.Append("Error loading file %s! -> invalid or missing %s\r\n", FileName, Indices.empty() && !Invalid ? "faces" : "data");
+		delete [] Vertices;
+		return false;
+	}
+
+	Start = GetTime();
+
+	int IndicesCount = (int)Indices.size();
+
+	unsigned int *MeshIndices = new unsigned int[IndicesCount];
+
+	memcpy(MeshIndices, Indices.data(), IndicesCount * sizeof(unsigned int));
+
+	if(!HasNormals)
+	{
+		ComputeNormals(Vertices, VerticesCount, MeshIndices, IndicesCount);
+	}
+
+	Stats.MergeTime = GetTime() - Start;
+	Stats.Vertices = VerticesCount;
+	Stats.Triangles = IndicesCount / 3;
+
+	Mesh.Attach(Vertices, VerticesCount, MeshIndices, IndicesCount);
+
+	return true;
+}
+
+// the workers pull the items one by one, the caller is one of them
+
+void CMeshLoader::Run(int Count, std::function<void(int Index)> Function)
+{
+	std::atomic<int> Next(0);
+
+	ThreadPool.ParallelFor(Workers < Count ? Workers : Count, 1, [&](int /* Begin */, int /* End */)
+	{
+		int Index;
+
+		while((Index = Next++) < Count)
+		{
+			Function(Index);
+		}
+	});
+}
+
+// Chunks gets the start of every chunk and the end of the text
+
+void CMeshLoader::SplitLines(const char *Text, size_t Size, std::vector<const char*> &Chunks)
+{
+	const char *End = Text + Size;
+
+	Chunks.push_back(Text);
+
+	while(End - Chunks.back() > MESH_LOADER_CHUNK_SIZE)
+	{
+		const char *LineEnd = (const char*)memchr(Chunks.back() + MESH_LOADER_CHUNK_SIZE, '\n', End - Chunks.back() - MESH_LOADER_CHUNK_SIZE);
+
+		if(LineEnd == NULL || LineEnd + 1 == End)
+		{
+			break;
+		}
+
+		Chunks.push_back(LineEnd + 1);
+	}
+
+	Chunks.push_back(End);
+}
+
+// Chunks gets the start of every MESH_LOADER_ELEMENTS_GRAIN lines and the end of the last; returns NULL when the text
+// ends before
+
+const char* CMeshLoader::SkipLines(const char *Text, const char *End, int Count, std::vector<const char*> &Chunks)
+{
+	for(int i = 0; i < Count; i++)
+	{
+		if(i % MESH_LOADER_ELEMENTS_GRAIN == 0)
+		{
+			Chunks.push_back(Text);
+		}
+
+		const char *LineEnd = (const char*)memchr(Text, '\n', End - Text);
+
+		if(LineEnd == NULL)
+		{
+			if(i + 1 < Count || Text == End) return NULL;
+
+			LineEnd = End - 1;
+		}
+
+		Text = LineEnd + 1;
+	}
+
+	Chunks.push_back(Text);
+
+	return Text;
+}
+
+// area weighted, only for the vertices left without a normal
+
+void CMeshLoader::ComputeNormals(CVertex *Vertices, int VerticesCount, const unsigned int *Indices, int IndicesCount)
+{
+	PROFILE_ZONE("CMeshLoader::ComputeNormals");
+
+	vec3 *Normals = new vec3[VerticesCount];
+
+	for(int i = 0; i < VerticesCount; i++)
+	{
+		Normals[i] = vec3(0.0f, 0.0f, 0.0f);
+	}
+
+	for(int i = 0; i < IndicesCount; i += 3)
+	{
+		const vec3 &a = Vertices[Indices[i + 0]].Position;
+		const vec3 &b = Vertices[Indices[i + 1]].Position;
+		const vec3 &c = Vertices[Indices[i + 2]].Position;
+
+		vec3 Normal = cross(b - a, c - a);
+
+		Normals[Indices[i + 0]] = Normals[Indices[i + 0]] + Normal;
+		Normals[Indices[i + 1]] = Normals[Indices[i + 1]] + Normal;
+		Normals[Indices[i + 2]] = Normals[Indices[i + 2]] + Normal;
+	}
+
+	for(int i = 0; i < VerticesCount; i++)
+	{
+		vec3 &Normal = Vertices[i].Normal;
+
+		if(Normal.x == 0.0f && Normal.y == 0.0f && Normal.z == 0.0f)
+		{
+			float Length = length(Normals[i]);
+
+			Normal = Length > 0.0f ? Normals[i] / Length : vec3(0.0f, 0.0f, 1.0f);
+		}
+	}
+
+	delete [] Normals;
+}
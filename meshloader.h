@@ -0,0 +1,53 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <functional>
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// OBJ text is cut into chunks of about this size at line ends, PLY vertices and faces into runs of this many
+
+#define MESH_LOADER_CHUNK_SIZE (1 << 20)
+#define MESH_LOADER_ELEMENTS_GRAIN 65536
+
+struct CMeshLoaderStats
+{
+	long long Bytes;
+	int Vertices, Triangles, Chunks, Workers;
+	double ParseTime, MergeTime, TotalTime;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// loads OBJ and PLY, ASCII or binary little endian, from a mapped file; the chunks are parsed on the thread pool, OBJ
+// corners are deduplicated per chunk and the chunks merged at the end, in parallel by the hash of the corner; faces
+// with more than 3 corners are split into fans, the normals are computed where the file has none; Workers limits the
+// threads taking part, the caller included, 0 is all of them
+
+class CMeshLoader
+{
+protected:
+	const char *FileName;
+	int Workers;
+	CMeshLoaderStats Stats;
+
+public:
+	CMeshLoader();
+	~CMeshLoader();
+
+	bool Load(const char *FileName, CMesh &Mesh, int Workers = 0);
+	void GetStats(CMeshLoaderStats &Stats);
+
+	static bool IsSupported(const char *FileName);
+
+protected:
+	bool LoadOBJ(const char *Text, size_t Size, CMesh &Mesh);
+	bool LoadPLY(const char *Text, size_t Size, CMesh &Mesh);
+	void Run(int Count, std::function<void(int Index)> Function);
+
+	static void SplitLines(const char *Text, size_t Size, std::vector<const char*> &Chunks);
+	static const char* SkipLines(const char *Text, const char *End, int Count, std::vector<const char*> &Chunks);
+	static void ComputeNormals(CVertex *Vertices, int VerticesCount, const unsigned int *Indices, int IndicesCount);
+};
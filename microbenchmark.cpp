@@ -0,0 +1,1553 @@
+#include "microbenchmark.h"
+#include "blockcompress.h"
+#include "bvh.h"
+#include "culling.h"
+#include "hash.h"
+#include "instances.h"
+#include "mesh.h"
+#include "meshloader.h"
+#include "resample.h"
+#include "scenegraph.h"
+#include "simd.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static CMicroBenchmark MicroBenchmarks[] =
+{
+	{"strings", BenchmarkStrings},
+	{"mipmaps", BenchmarkMipmaps},
+	{"pixelformats", BenchmarkPixelFormats},
+	{"resample", BenchmarkResample},
+	{"blockcompression", BenchmarkBlockCompression},
+	{"containers", BenchmarkContainers},
+	{"meshes", BenchmarkMeshes},
+	{"meshloader", BenchmarkMeshLoader},
+	{"instances", BenchmarkInstances},
+	{"culling", BenchmarkCulling},
+	{"bvh", BenchmarkBVH},
+	{"scenegraph", BenchmarkSceneGraph},
+};
+
+bool RunMicroBenchmarks(char *Name, CString &Report)
+{
+	bool Found = false, Error = false;
+
+	// a micro benchmark that fails a check appends to ErrorLog, the others still run
+
+	for(int i = 0; i < (int)(sizeof(MicroBenchmarks) / sizeof(CMicroBenchmark)); i++)
+	{
+		if(strcmp(Name, "all") == 0 || strcmp(Name, MicroBenchmarks[i].Name) == 0)
+		{
+			Error |= !MicroBenchmarks[i].Function(Report);
+			Found = true;
+		}
+	}
+
+	if(!Found)
+	{
+		ErrorLog.Set("Unknown micro benchmark %s!", Name);
+	}
+
+	return Found && !Error;
+}
+
+bool SaveMicroBenchmarkReport(char *FileName, CString &Report)
+{
+	FILE *File;
+
+	if(fopen_s(&File, FileName, "wt") != 0)
+	{
+		ErrorLog.Append("Error saving file %s!\r\n", FileName);
+		return false;
+	}
+
+	fwrite((char*)Report, 1, Report.GetLength(), File);
+	fclose(File);
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the CString implementation before the small string optimization, kept as the baseline
+
+class CLegacyString
+{
+protected:
+	char *String;
+
+public:
+	CLegacyString() { String = new char[1]; String[0] = 0; }
+	CLegacyString(const char *DefaultString) { String = NULL; Set("%s", DefaultString); }
+	CLegacyString(const CLegacyString &DefaultString) { String = NULL; Set("%s", DefaultString.String); }
+	~CLegacyString() { delete [] String; }
+
+	operator char* () { return String; }
+
+	CLegacyString& operator += (const char *NewString) { Append("%s", NewString); return *this; }
+
+	friend CLegacyString operator + (const CLegacyString &String1, const char *String2)
+	{
+		CLegacyString String = String1;
+		String += String2;
+		return String;
+	}
+
+	void Append(const char *Format, ...)
+	{
+		va_list ArgList, ArgListCopy;
+
+		va_start(ArgList, Format);
+		va_copy(ArgListCopy, ArgList);
+
+		int AppendixLength = vsnprintf(NULL, 0, Format, ArgListCopy);
+		char *Appendix = new char[AppendixLength + 1];
+		vsnprintf(Appendix, AppendixLength + 1, Format, ArgList);
+
+		va_end(ArgListCopy);
+		va_end(ArgList);
+
+		char *OldString = String;
+		int OldStringLength = (int)strlen(String);
+
+		int StringLength = OldStringLength + AppendixLength;
+		String = new char[StringLength + 1];
+
+		memcpy(String, OldString, OldStringLength);
+		memcpy(String + OldStringLength, Appendix, AppendixLength + 1);
+
+		delete [] OldString;
+		delete [] Appendix;
+	}
+
+	void Set(const char *Format, ...)
+	{
+		va_list ArgList, ArgListCopy;
+
+		va_start(ArgList, Format);
+		va_copy(ArgListCopy, ArgList);
+
+		delete [] String;
+
+		int StringLength = vsnprintf(NULL, 0, Format, ArgListCopy);
+		String = new char[StringLength + 1];
+		vsnprintf(String, StringLength + 1, Format, ArgList);
+
+		va_end(ArgListCopy);
+		va_end(ArgList);
+	}
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+template <class T> static void BenchmarkErrorLog(int Lines)
+{
+	T Log;
+
+	for(int i = 0; i < Lines; i++)
+	{
+		Log.Append("Error compiling shader %s!\r\n", "glsl120shader.vs");
+	}
+}
+
+template <class T> static void BenchmarkTitle(int Titles)
+{
+	for(int i = 0; i < Titles; i++)
+	{
+		T Text = "Win32, OpenGL, GLEW, FreeImage, GLM";
+
+		Text.Append(" - %dx%d", 800, 600);
+		Text.Append(", ATF %dx", 16);
+		Text.Append(", MSAA %dx", 4);
+		Text.Append(", FPS: %d", i);
+		Text.Append(" - %s", "llvmpipe (LLVM 15.0.7, 256 bits)");
+	}
+}
+
+template <class T> static void BenchmarkPath(int Paths)
+{
+	T Directory = "/opt/render/bin/";
+
+	for(int i = 0; i < Paths; i++)
+	{
+		T FileName = Directory + "golddiag.jpg";
+	}
+}
+
+static void BenchmarkLegacyErrorText(int Errors)
+{
+	CLegacyString ErrorLog, FileName = "/opt/render/bin/textures/golddiag.jpg";
+
+	for(int i = 0; i < Errors; i++)
+	{
+		CLegacyString ErrorText = "Error loading file " + FileName + "! ->";
+		ErrorLog.Append("%s", (char*)(ErrorText + "fif is FIF_UNKNOWN" + "\r\n"));
+	}
+}
+
+static void BenchmarkErrorText(int Errors)
+{
+	CString ErrorLog, FileName = "/opt/render/bin/textures/golddiag.jpg";
+
+	for(int i = 0; i < Errors; i++)
+	{
+		CString ErrorText = CString::Concat({"Error loading file ", FileName, "! ->"});
+		ErrorLog.AppendStrings({ErrorText, "fif is FIF_UNKNOWN", "\r\n"});
+	}
+}
+
+static void ReportComparison(CString &Report, const char *Name, double LegacyTime, double Time)
+{
+	Report.Append("strings.%s: legacy %.3f ms, current %.3f ms, %.2fx\n", Name, LegacyTime * 1000.0, Time * 1000.0, LegacyTime / Time);
+}
+
+bool BenchmarkStrings(CString &Report)
+{
+	ReportComparison(Report, "error_log_10000_lines", MeasureBestTime([]{ BenchmarkErrorLog<CLegacyString>(10000); }), MeasureBestTime([]{ BenchmarkErrorLog<CString>(10000); }));
+	ReportComparison(Report, "title_100000", MeasureBestTime([]{ BenchmarkTitle<CLegacyString>(100000); }), MeasureBestTime([]{ BenchmarkTitle<CString>(100000); }));
+	ReportComparison(Report, "error_text_10000", MeasureBestTime([]{ BenchmarkLegacyErrorText(10000); }), MeasureBestTime([]{ BenchmarkErrorText(10000); }));
+	ReportComparison(Report, "path_1000000", MeasureBestTime([]{ BenchmarkPath<CLegacyString>(1000000); }), MeasureBestTime([]{ BenchmarkPath<CString>(1000000); }));
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static HASH64 HashMipmapChain(CMipmapChain &Mipmaps)
+{
+	HASH64 Hash = 0;
+
+	for(int i = 1; i < Mipmaps.LevelsCount; i++)
+	{
+		Hash = Hash64(Mipmaps.Levels[i].Data, Mipmaps.Levels[i].Pitch * Mipmaps.Levels[i].Height, Hash);
+	}
+
+	return Hash;
+}
+
+static HASH64 ReportMipmaps(CString &Report, const char *Name, BYTE *Image, int Size, MIPMAP_FILTER Filter, bool sRGB, bool PreserveAlphaCoverage)
+{
+	CMipmapChain Mipmaps;
+
+	double Time = MeasureBestTime([&]{ Mipmaps.Generate(Image, Size, Size, Size * 4, 4, Filter, sRGB, PreserveAlphaCoverage); });
+
+	HASH64 Hash = HashMipmapChain(Mipmaps);
+
+	Report.Append("mipmaps.%s_%d: %.3f ms, %.1f MPixels/s, hash %016llx\n", Name, Size, Time * 1000.0, Size * Size / Time / 1.0e6, Hash);
+
+	return Hash;
+}
+
+// known results, so a broken filter fails the micro benchmark instead of only changing a printed hash
+
+static bool CheckMipmapLevel(const char *Name, const CMipmapLevel &Level, const BYTE *Expected)
+{
+	for(int x = 0; x < Level.Width; x++)
+	{
+		const BYTE *Pixel = Level.Data + x * 4, *ExpectedPixel = Expected + x * 4;
+
+		if(memcmp(Pixel, ExpectedPixel, 4) != 0)
+		{
+			ErrorLog.Append("Mipmap check %s failed, pixel %d is %d %d %d %d instead of %d %d %d %d!\r\n", Name, x, Pixel[0], Pixel[1], Pixel[2], Pixel[3], ExpectedPixel[0], ExpectedPixel[1], ExpectedPixel[2], ExpectedPixel[3]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// 16x2 pixels of the same 2x2 quad, so the SIMD kernels filter whole vectors; (0 + 255 + 1 + 2 + 2) >> 2 = 65 and so on
+
+static bool CheckMipmapBox(const char *Name)
+{
+	static const BYTE Quad[4][4] = {{0, 10, 100, 255}, {255, 20, 101, 0}, {1, 30, 102, 255}, {2, 41, 103, 0}};
+
+	BYTE Image[16 * 2 * 4], Expected[8 * 4];
+
+	for(int x = 0; x < 16; x++)
+	{
+		memcpy(Image + x * 4, Quad[x & 1], 4);
+		memcpy(Image + (16 + x) * 4, Quad[2 + (x & 1)], 4);
+	}
+
+	for(int x = 0; x < 8; x++)
+	{
+		Expected[x * 4 + 0] = 65;
+		Expected[x * 4 + 1] = 25;
+		Expected[x * 4 + 2] = 102;
+		Expected[x * 4 + 3] = 128;
+	}
+
+	CMipmapChain Mipmaps;
+
+	Mipmaps.Generate(Image, 16, 2, 16 * 4, 4, MIPMAP_FILTER_BOX, false, false);
+
+	return CheckMipmapLevel(Name, Mipmaps.Levels[1], Expected);
+}
+
+// black and white average to 0.5 in linear space, which is 188 in sRGB and not 128; alpha stays linear
+
+static bool CheckMipmapBoxSRGB()
+{
+	BYTE Image[2 * 2 * 4] = {0, 0, 0, 0, 255, 255, 255, 255, 0, 0, 0, 0, 255, 255, 255, 255}, Expected[4] = {188, 188, 188, 128};
+
+	CMipmapChain Mipmaps;
+
+	Mipmaps.Generate(Image, 2, 2, 2 * 4, 4, MIPMAP_FILTER_BOX, true, false);
+
+	return CheckMipmapLevel("box_srgb", Mipmaps.Levels[1], Expected);
+}
+
+// a bright pixel on grey, the negative lobes darken the neighbours where the box filter would give 128 191 128 128
+
+static bool CheckMipmapKaiser()
+{
+	BYTE Image[8 * 4], Expected[4 * 4];
+
+	for(int x = 0; x < 8; x++)
+	{
+		Image[x * 4 + 0] = Image[x * 4 + 1] = Image[x * 4 + 2] = x == 3 ? 255 : 128;
+		Image[x * 4 + 3] = 255;
+	}
+
+	static const BYTE Color[4] = {123, 184, 143, 126};
+
+	for(int x = 0; x < 4; x++)
+	{
+		Expected[x * 4 + 0] = Expected[x * 4 + 1] = Expected[x * 4 + 2] = Color[x];
+		Expected[x * 4 + 3] = 255;
+	}
+
+	CMipmapChain Mipmaps;
+
+	Mipmaps.Generate(Image, 8, 1, 8 * 4, 4, MIPMAP_FILTER_KAISER, false, false);
+
+	return CheckMipmapLevel("kaiser_linear", Mipmaps.Levels[1], Expected);
+}
+
+static float GetMipmapAlphaCoverage(const CMipmapLevel &Level)
+{
+	int Covered = 0;
+
+	for(int y = 0; y < Level.Height; y++)
+	{
+		for(int x = 0; x < Level.Width; x++)
+		{
+			if(Level.Data[y * Level.Pitch + x * 4 + 3] > 127) Covered++;
+		}
+	}
+
+	return (float)Covered / (Level.Width * Level.Height);
+}
+
+// a sparse alpha tested image, a quarter of the pixels opaque; the box filtered 8x8 level loses most of its coverage,
+// with the coverage preserved every level down to 8x8 has to stay close to that of level 0
+
+static bool CheckMipmapAlphaCoverage(CString &Report)
+{
+	const int Size = 64;
+
+	BYTE *Image = new BYTE[Size * Size * 4];
+
+	unsigned int Random = 12345;
+
+	for(int i = 0; i < Size * Size; i++)
+	{
+		Random = Random * 1664525 + 1013904223;
+
+		Image[i * 4 + 0] = Image[i * 4 + 1] = Image[i * 4 + 2] = 128;
+		Image[i * 4 + 3] = (Random >> 24) < 64 ? 255 : 0;
+	}
+
+	CMipmapChain Box, Preserved;
+
+	Box.Generate(Image, Size, Size, Size * 4, 4, MIPMAP_FILTER_BOX, false, false);
+	Preserved.Generate(Image, Size, Size, Size * 4, 4, MIPMAP_FILTER_KAISER, false, true);
+
+	float Coverage = GetMipmapAlphaCoverage(Box.Levels[0]), BoxCoverage = GetMipmapAlphaCoverage(Box.Levels[3]);
+
+	Report.Append("mipmaps.alpha_coverage_%d: level 0 %.3f, box level 3 %.3f, preserved", Size, Coverage, BoxCoverage);
+
+	bool Checked = Coverage > 0.2f && Coverage < 0.3f && BoxCoverage < Coverage * 0.5f;
+
+	for(int i = 1; i <= 3; i++)
+	{
+		float LevelCoverage = GetMipmapAlphaCoverage(Preserved.Levels[i]);
+
+		Report.Append(" %.3f", LevelCoverage);
+
+		// the scale is found on a histogram of 8 bit alpha, an 8x8 level cannot get closer than 1 / 64
+
+		if(fabs(LevelCoverage - Coverage) > 1.5f / 64.0f) Checked = false;
+	}
+
+	Report.Append("\n");
+
+	if(!Checked)
+	{
+		ErrorLog.Append("Mipmap check alpha_coverage failed, see mipmaps.alpha_coverage_%d!\r\n", Size);
+	}
+
+	delete [] Image;
+
+	return Checked;
+}
+
+bool BenchmarkMipmaps(CString &Report)
+{
+	ThreadPool.Start();
+
+	const int Size = 2048;
+
+	BYTE *Image = new BYTE[Size * Size * 4];
+
+	unsigned int Random = 12345;
+
+	for(int y = 0; y < Size; y++)
+	{
+		for(int x = 0; x < Size; x++)
+		{
+			BYTE *Pixel = Image + (y * Size + x) * 4;
+
+			Random = Random * 1664525 + 1013904223;
+
+			Pixel[0] = (BYTE)(x * 255 / Size);
+			Pixel[1] = (BYTE)(y * 255 / Size);
+			Pixel[2] = (BYTE)(Random >> 24);
+			Pixel[3] = ((x / 16 + y / 16) & 1) ? 255 : (BYTE)((x * y) & 255);
+		}
+	}
+
+	Report.Append("mipmaps.threads: %d\n", ThreadPool.GetThreadsCount() + 1);
+
+	CCPUFeatures Features = CPUFeatures;
+
+	CPUFeatures.SSE2 = CPUFeatures.AVX2 = CPUFeatures.NEON = false;
+
+	bool Checked = CheckMipmapBox("box_linear_scalar");
+
+	HASH64 Scalar = ReportMipmaps(Report, "box_linear_scalar", Image, Size, MIPMAP_FILTER_BOX, false, false);
+
+	bool Identical = true;
+
+	if(Features.SSE2)
+	{
+		CPUFeatures.SSE2 = true;
+		Checked &= CheckMipmapBox("box_linear_sse2");
+		Identical &= ReportMipmaps(Report, "box_linear_sse2", Image, Size, MIPMAP_FILTER_BOX, false, false) == Scalar;
+	}
+
+	if(Features.AVX2)
+	{
+		CPUFeatures.AVX2 = true;
+		Checked &= CheckMipmapBox("box_linear_avx2");
+		Identical &= ReportMipmaps(Report, "box_linear_avx2", Image, Size, MIPMAP_FILTER_BOX, false, false) == Scalar;
+	}
+
+	if(Features.NEON)
+	{
+		CPUFeatures.NEON = true;
+		Checked &= CheckMipmapBox("box_linear_neon");
+		Identical &= ReportMipmaps(Report, "box_linear_neon", Image, Size, MIPMAP_FILTER_BOX, false, false) == Scalar;
+	}
+
+	CPUFeatures = Features;
+
+	Report.Append("mipmaps.box_linear_kernels_identical: %s\n", Identical ? "yes" : "NO");
+
+	if(!Identical)
+	{
+		ErrorLog.Append("Mipmap check box_linear failed, the SIMD kernels do not match the scalar one!\r\n");
+		Checked = false;
+	}
+
+	Checked &= CheckMipmapBoxSRGB();
+	Checked &= CheckMipmapKaiser();
+	Checked &= CheckMipmapAlphaCoverage(Report);
+
+	ReportMipmaps(Report, "box_srgb", Image, Size, MIPMAP_FILTER_BOX, true, false);
+	ReportMipmaps(Report, "kaiser_srgb", Image, Size, MIPMAP_FILTER_KAISER, true, false);
+	ReportMipmaps(Report, "kaiser_srgb_alpha_coverage", Image, Size, MIPMAP_FILTER_KAISER, true, true);
+
+	delete [] Image;
+
+	return Checked;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static void ReportSwapRedBlue(CString &Report, const char *Name, BYTE *Image, int Size, int BytesPerPixel)
+{
+	double Time = MeasureBestTime([&]{ SwapRedBlue(Image, Size, Size, Size * BytesPerPixel, BytesPerPixel); });
+
+	Report.Append("pixelformats.swap_red_blue_%d_%s_%d: %.3f ms, %.1f MPixels/s\n", BytesPerPixel * 8, Name, Size, Time * 1000.0, Size * Size / Time / 1.0e6);
+}
+
+static void ReportIsOpaque(CString &Report, const char *Name, BYTE *Image, int Size)
+{
+	bool Opaque = false;
+
+	double Time = MeasureBestTime([&]{ Opaque = IsOpaque(Image, Size, Size, Size * 4); });
+
+	Report.Append("pixelformats.is_opaque_%s_%d: %.3f ms, %.1f MPixels/s, %s\n", Name, Size, Time * 1000.0, Size * Size / Time / 1.0e6, Opaque ? "opaque" : "transparent");
+}
+
+bool BenchmarkPixelFormats(CString &Report)
+{
+	ThreadPool.Start();
+
+	const int Size = 4096;
+
+	BYTE *Image = new BYTE[Size * Size * 4];
+
+	memset(Image, 255, Size * Size * 4);
+
+	Report.Append("pixelformats.threads: %d\n", ThreadPool.GetThreadsCount() + 1);
+
+	CCPUFeatures Features = CPUFeatures;
+
+	for(int BytesPerPixel = 3; BytesPerPixel <= 4; BytesPerPixel++)
+	{
+		CPUFeatures.SSSE3 = CPUFeatures.AVX2 = CPUFeatures.NEON = false;
+
+		ReportSwapRedBlue(Report, "scalar", Image, Size, BytesPerPixel);
+
+		if(Features.SSSE3)
+		{
+			CPUFeatures.SSSE3 = true;
+			ReportSwapRedBlue(Report, "ssse3", Image, Size, BytesPerPixel);
+		}
+
+		if(Features.AVX2 && BytesPerPixel == 4)
+		{
+			CPUFeatures.AVX2 = true;
+			ReportSwapRedBlue(Report, "avx2", Image, Size, BytesPerPixel);
+		}
+
+		if(Features.NEON)
+		{
+			CPUFeatures.NEON = true;
+			ReportSwapRedBlue(Report, "neon", Image, Size, BytesPerPixel);
+		}
+
+		CPUFeatures = Features;
+	}
+
+	// the worst case, every pixel has to be read
+
+	CPUFeatures.SSE2 = CPUFeatures.AVX2 = false;
+
+	ReportIsOpaque(Report, "scalar", Image, Size);
+
+	if(Features.SSE2)
+	{
+		CPUFeatures.SSE2 = true;
+		ReportIsOpaque(Report, "sse2", Image, Size);
+	}
+
+	if(Features.AVX2)
+	{
+		CPUFeatures.AVX2 = true;
+		ReportIsOpaque(Report, "avx2", Image, Size);
+	}
+
+	CPUFeatures = Features;
+
+	delete [] Image;
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static void ReportResample(CString &Report, const char *Name, FIBITMAP *dib, int Width, int Height, RESAMPLE_FILTER Filter, FREE_IMAGE_FILTER FreeImageFilter)
+{
+	int SourceWidth = FreeImage_GetWidth(dib), SourceHeight = FreeImage_GetHeight(dib);
+	int Pitch = (Width * 3 + 3) & ~3;
+
+	BYTE *Destination = new BYTE[Pitch * Height];
+
+	FIBITMAP *rdib = NULL;
+
+	double FreeImageTime = MeasureBestTime([&]{ if(rdib) FreeImage_Unload(rdib); rdib = FreeImage_Rescale(dib, Width, Height, FreeImageFilter); }, 2);
+	double Time = MeasureBestTime([&]{ ResampleImage(FreeImage_GetBits(dib), SourceWidth, SourceHeight, FreeImage_GetPitch(dib), Destination, Width, Height, Pitch, 3, Filter); });
+
+	// the edges and the rounding differ slightly, the PSNR against FreeImage shows the results match otherwise
+
+	double SquaredError = 0.0;
+
+	if(rdib)
+	{
+		for(int y = 0; y < Height; y++)
+		{
+			BYTE *Row = Destination + y * Pitch, *FreeImageRow = FreeImage_GetScanLine(rdib, y);
+
+			for(int x = 0; x < Width * 3; x++)
+			{
+				double Difference = Row[x] - FreeImageRow[x];
+				SquaredError += Difference * Difference;
+			}
+		}
+
+		FreeImage_Unload(rdib);
+	}
+
+	double MSE = SquaredError / ((double)Width * Height * 3);
+	double PSNR = MSE > 0.0 ? 10.0 * log10(255.0 * 255.0 / MSE) : 99.0;
+
+	Report.Append("resample.%s_%dx%d_to_%dx%d: FreeImage %.3f ms, current %.3f ms, %.2fx, PSNR %.1f dB\n", Name, SourceWidth, SourceHeight, Width, Height, FreeImageTime * 1000.0, Time * 1000.0, FreeImageTime / Time, PSNR);
+
+	delete [] Destination;
+}
+
+bool BenchmarkResample(CString &Report)
+{
+	ThreadPool.Start();
+
+	Report.Append("resample.threads: %d\n", ThreadPool.GetThreadsCount() + 1);
+
+	// 4K and 8K, and the power of two sizes they are rounded to without GLEW_ARB_texture_non_power_of_two
+
+	static const int Sizes[2][4] = {{3840, 2160, 4096, 2048}, {7680, 4320, 8192, 4096}};
+
+	for(int i = 0; i < 2; i++)
+	{
+		int SourceWidth = Sizes[i][0], SourceHeight = Sizes[i][1];
+
+		FIBITMAP *dib = FreeImage_Allocate(SourceWidth, SourceHeight, 24);
+
+		if(dib == NULL)
+		{
+			continue;
+		}
+
+		unsigned int Random = 12345;
+
+		for(int y = 0; y < SourceHeight; y++)
+		{
+			BYTE *Pixel = FreeImage_GetScanLine(dib, y);
+
+			for(int x = 0; x < SourceWidth; x++, Pixel += 3)
+			{
+				Random = Random * 1664525 + 1013904223;
+
+				Pixel[0] = (BYTE)(x * 255 / SourceWidth);
+				Pixel[1] = (BYTE)(128.0 + 127.0 * sin(x * 0.05) * cos(y * 0.03));
+				Pixel[2] = (BYTE)(Random >> 24);
+			}
+		}
+
+		ReportResample(Report, "box", dib, SourceWidth / 2, SourceHeight / 2, RESAMPLE_FILTER_BOX, FILTER_BOX);
+		ReportResample(Report, "bilinear", dib, SourceWidth / 2, SourceHeight / 2, RESAMPLE_FILTER_BILINEAR, FILTER_BILINEAR);
+		ReportResample(Report, "bicubic", dib, SourceWidth / 2, SourceHeight / 2, RESAMPLE_FILTER_BICUBIC, FILTER_BICUBIC);
+		ReportResample(Report, "lanczos3", dib, SourceWidth / 2, SourceHeight / 2, RESAMPLE_FILTER_LANCZOS3, FILTER_LANCZOS3);
+
+		ReportResample(Report, "bicubic_pot", dib, Sizes[i][2], Sizes[i][3], RESAMPLE_FILTER_BICUBIC, FILTER_BICUBIC);
+
+		FreeImage_Unload(dib);
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static void ReportBlockCompression(CString &Report, const char *Name, const BYTE *Image, int Size, BC_FORMAT Format, int Channels, BC_QUALITY Quality)
+{
+	static const char *Qualities[] = {"fast", "normal", "high"};
+
+	int BlocksSize = (Size / 4) * (Size / 4) * GetBlockSize(Format);
+
+	BYTE *Blocks = new BYTE[BlocksSize];
+	BYTE *Decoded = new BYTE[Size * Size * 4];
+
+	double Time = MeasureBestTime([&]{ EncodeBlocks(Image, Size, Size, Size * 4, 4, false, Format, Quality, Blocks); }, Quality == BC_QUALITY_HIGH ? 2 : 5);
+
+	DecodeBlocks(Blocks, Size, Size, Format, Decoded, Size * 4);
+
+	// only the channels the format keeps are compared
+
+	double SquaredError = 0.0;
+
+	for(int i = 0; i < Size * Size; i++)
+	{
+		for(int c = 0; c < Channels; c++)
+		{
+			double Difference = Image[i * 4 + c] - Decoded[i * 4 + c];
+			SquaredError += Difference * Difference;
+		}
+	}
+
+	double MSE = SquaredError / ((double)Size * Size * Channels);
+	double PSNR = MSE > 0.0 ? 10.0 * log10(255.0 * 255.0 / MSE) : 99.0;
+
+	Report.Append("blockcompression.%s_%s_%dx%d: %.3f ms, %.1f MPixels/s, PSNR %.2f dB, %d bytes, %.1f%% of RGBA8\n", Name, Qualities[Quality], Size, Size, Time * 1000.0, Size * Size / Time / 1.0e6, PSNR, BlocksSize, BlocksSize * 100.0 / (Size * Size * 4));
+
+	delete [] Decoded;
+	delete [] Blocks;
+}
+
+bool BenchmarkBlockCompression(CString &Report)
+{
+	ThreadPool.Start();
+
+	Report.Append("blockcompression.threads: %d\n", ThreadPool.GetThreadsCount() + 1);
+
+	// smooth gradients, a high frequency pattern, noise and an alpha ramp with hard edges; BC4 keeps only the first
+	// channel, a gradient it stores without loss, so it gets the pattern with noise on its own
+
+	int Size = 1024;
+
+	BYTE *Image = new BYTE[Size * Size * 4], *GreyImage = new BYTE[Size * Size * 4];
+
+	unsigned int Random = 12345;
+
+	for(int y = 0; y < Size; y++)
+	{
+		for(int x = 0; x < Size; x++)
+		{
+			BYTE *Pixel = Image + (y * Size + x) * 4;
+
+			Random = Random * 1664525 + 1013904223;
+
+			Pixel[0] = (BYTE)(x * 255 / Size);
+			Pixel[1] = (BYTE)(128.0 + 127.0 * sin(x * 0.05) * cos(y * 0.03));
+			Pixel[2] = (BYTE)((y * 255 / Size + (Random >> 28)) & 255);
+			Pixel[3] = (BYTE)((x / 64 + y / 64) % 2 == 0 ? 255 : y * 255 / Size);
+
+			BYTE *GreyPixel = GreyImage + (y * Size + x) * 4;
+
+			GreyPixel[0] = GreyPixel[1] = GreyPixel[2] = (BYTE)(Pixel[1] * 3 / 4 + (Random >> 26));
+			GreyPixel[3] = 255;
+		}
+	}
+
+	for(int Quality = BC_QUALITY_FAST; Quality <= BC_QUALITY_HIGH; Quality++)
+	{
+		ReportBlockCompression(Report, "bc1", Image, Size, BC_FORMAT_BC1, 3, (BC_QUALITY)Quality);
+		ReportBlockCompression(Report, "bc3", Image, Size, BC_FORMAT_BC3, 4, (BC_QUALITY)Quality);
+		ReportBlockCompression(Report, "bc4", GreyImage, Size, BC_FORMAT_BC4, 1, (BC_QUALITY)Quality);
+		ReportBlockCompression(Report, "bc5", Image, Size, BC_FORMAT_BC5, 2, (BC_QUALITY)Quality);
+		ReportBlockCompression(Report, "bc7", Image, Size, BC_FORMAT_BC7, 4, (BC_QUALITY)Quality);
+	}
+
+	delete [] Image;
+	delete [] GreyImage;
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static void ReportContainer(CString &Report, const char *Name, int Width, int Height, const char *FileName, double Time)
+{
+	FILE *File;
+	long long Size = 0;
+
+	if(fopen_s(&File, FileName, "rb") == 0)
+	{
+		fseek(File, 0, SEEK_END);
+		Size = ftell(File);
+		fclose(File);
+	}
+
+	Report.Append("containers.%s_%dx%d: %.3f ms, %lld bytes\n", Name, Width, Height, Time * 1000.0, Size);
+}
+
+// the files stay in the OS cache, so these are warm startup times; for cold ones drop the cache between runs of
+// -benchmark and compare startup_ms
+
+bool BenchmarkContainers(CString &Report)
+{
+	ThreadPool.Start();
+
+	int Size = 2048;
+
+	FIBITMAP *dib = FreeImage_Allocate(Size, Size, 24);
+
+	if(dib == NULL)
+	{
+		ErrorLog.Append("Error allocating image!\r\n");
+		return false;
+	}
+
+	unsigned int Random = 12345;
+
+	for(int y = 0; y < Size; y++)
+	{
+		BYTE *Pixel = FreeImage_GetScanLine(dib, y);
+
+		for(int x = 0; x < Size; x++, Pixel += 3)
+		{
+			Random = Random * 1664525 + 1013904223;
+
+			Pixel[0] = (BYTE)(x * 255 / Size);
+			Pixel[1] = (BYTE)(128.0 + 127.0 * sin(x * 0.05) * cos(y * 0.03));
+			Pixel[2] = (BYTE)((y * 255 / Size + (Random >> 28)) & 255);
+		}
+	}
+
+	CString PNGFileName = ModuleDirectory + "microbenchmark.png";
+	CString JPEGFileName = ModuleDirectory + "microbenchmark.jpg";
+	CString DDSFileName = ModuleDirectory + "microbenchmark.dds";
+
+	FreeImage_Save(FIF_PNG, dib, PNGFileName, PNG_DEFAULT);
+	FreeImage_Save(FIF_JPEG, dib, JPEGFileName, JPEG_QUALITYGOOD);
+
+	CMipmapChain Mipmaps;
+	CCompressedMipmapChain Compressed;
+
+	Mipmaps.Generate(FreeImage_GetBits(dib), Size, Size, FreeImage_GetPitch(dib), 3, MIPMAP_FILTER_BOX, false, false);
+	Compressed.Encode(Mipmaps, 3, FI_RGBA_RED == 2, BC_FORMAT_BC1, BC_QUALITY_FAST);
+	Compressed.SaveDDS(DDSFileName);
+
+	Mipmaps.Destroy();
+	Compressed.Destroy();
+
+	FreeImage_Unload(dib);
+
+	// the source formats still need their mipmaps after this, the container has them already
+
+	double PNGTime = MeasureBestTime([&]{ FIBITMAP *ldib = FreeImage_Load(FIF_PNG, PNGFileName); if(ldib) FreeImage_Unload(ldib); }, 3);
+	double JPEGTime = MeasureBestTime([&]{ FIBITMAP *ldib = FreeImage_Load(FIF_JPEG, JPEGFileName); if(ldib) FreeImage_Unload(ldib); }, 3);
+	double DDSTime = MeasureBestTime([&]{ CCompressedMipmapChain Chain; Chain.Load(DDSFileName); });
+
+	ReportContainer(Report, "png", Size, Size, PNGFileName, PNGTime);
+	ReportContainer(Report, "jpeg", Size, Size, JPEGFileName, JPEGTime);
+	ReportContainer(Report, "dds_bc1_mipmapped", Size, Size, DDSFileName, DDSTime);
+
+	remove(PNGFileName);
+	remove(JPEGFileName);
+	remove(DDSFileName);
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static void ReportMesh(CString &Report, const char *Name, const CVertex *Vertices, int VerticesCount, const unsigned int *Indices, int IndicesCount)
+{
+	CMesh Mesh;
+	CMeshStats Stats;
+
+	double BestTime = 1.0e30;
+
+	for(int i = 0; i < 3; i++)
+	{
+		Mesh.Set(Vertices, VerticesCount, Indices, IndicesCount);
+		Mesh.Optimize();
+		Mesh.GetStats(Stats);
+
+		if(Stats.OptimizeTime < BestTime) BestTime = Stats.OptimizeTime;
+	}
+
+	Mesh.Destroy();
+
+	Report.Append("meshes.%s: %d triangles, %d vertices, misses %d -> %d, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %d clusters, %.3f ms, %.1f MTriangles/s\n", Name, Stats.Triangles, Stats.Vertices, Stats.MissesBefore, Stats.MissesAfter, Stats.ACMRBefore, Stats.ACMRAfter, Stats.ATVRBefore, Stats.ATVRAfter, Stats.Clusters, BestTime * 1000.0, Stats.Triangles / BestTime / 1.0e6);
+}
+
+// a height field in the row order of a grid, and shuffled like a mesh welded from unrelated pieces; the misses are
+// counted in a MESH_FIFO_CACHE_SIZE entry FIFO cache
+
+bool BenchmarkMeshes(CString &Report)
+{
+	int Size = 256, Side = Size + 1;
+
+	int VerticesCount = Side * Side, IndicesCount = Size * Size * 6;
+
+	CVertex *Vertices = new CVertex[VerticesCount];
+	unsigned int *Indices = new unsigned int[IndicesCount];
+
+	for(int y = 0; y < Side; y++)
+	{
+		for(int x = 0; x < Side; x++)
+		{
+			CVertex &Vertex = Vertices[y * Side + x];
+
+			Vertex.Position = vec3(x / (float)Size - 0.5f, 0.1f * sinf(x * 0.1f) * cosf(y * 0.1f), y / (float)Size - 0.5f);
+			Vertex.Normal = vec3(0.0f, 1.0f, 0.0f);
+			Vertex.TexCoord = vec2(x / (float)Size, y / (float)Size);
+		}
+	}
+
+	unsigned int *Index = Indices;
+
+	for(int y = 0; y < Size; y++)
+	{
+		for(int x = 0; x < Size; x++)
+		{
+			unsigned int Corner = y * Side + x;
+
+			*Index++ = Corner; *Index++ = Corner + Side; *Index++ = Corner + Side + 1;
+			*Index++ = Corner; *Index++ = Corner + Side + 1; *Index++ = Corner + 1;
+		}
+	}
+
+	CString Name;
+
+	Name.Set("grid_rows_%dx%d", Size, Size);
+
+	ReportMesh(Report, Name, Vertices, VerticesCount, Indices, IndicesCount);
+
+	unsigned int Random = 12345;
+
+	for(int Triangle = IndicesCount / 3 - 1; Triangle > 0; Triangle--)
+	{
+		Random = Random * 1664525 + 1013904223;
+
+		int Other = (Random >> 8) % (Triangle + 1);
+
+		for(int k = 0; k < 3; k++)
+		{
+			std::swap(Indices[Triangle * 3 + k], Indices[Other * 3 + k]);
+		}
+	}
+
+	Name.Set("grid_shuffled_%dx%d", Size, Size);
+
+	ReportMesh(Report, Name, Vertices, VerticesCount, Indices, IndicesCount);
+
+	delete [] Indices;
+	delete [] Vertices;
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static void ReportMeshLoader(CString &Report, const char *Name, const char *FileName)
+{
+	int ThreadsCount = ThreadPool.GetThreadsCount() + 1;
+
+	for(int Workers = 1; ; Workers = Workers * 2 < ThreadsCount ? Workers * 2 : ThreadsCount)
+	{
+		CMeshLoader MeshLoader;
+		CMeshLoaderStats Stats;
+		CMesh Mesh;
+
+		double BestTime = MeasureBestTime([&]{ MeshLoader.Load(FileName, Mesh, Workers); Mesh.Destroy(); }, 3);
+
+		MeshLoader.GetStats(Stats);
+
+		Report.Append("meshloader.%s_%d_workers: %lld bytes, %d vertices, %d triangles, %d chunks, parse %.3f ms, merge %.3f ms, %.3f ms, %.1f MB/s\n", Name, Workers, Stats.Bytes, Stats.Vertices, Stats.Triangles, Stats.Chunks, Stats.ParseTime * 1000.0, Stats.MergeTime * 1000.0, BestTime * 1000.0, Stats.Bytes / BestTime / 1.0e6);
+
+		if(Workers == ThreadsCount)
+		{
+			break;
+		}
+	}
+}
+
+// the same height field as OBJ with shared texcoords and normals, as ASCII and binary PLY and as a .mesh file, loaded
+// with 1, 2, 4 ... workers up to the threads of the pool
+
+bool BenchmarkMeshLoader(CString &Report)
+{
+	ThreadPool.Start();
+
+	Report.Append("meshloader.threads: %d\n", ThreadPool.GetThreadsCount() + 1);
+
+	int Size = 512, Side = Size + 1;
+
+	CString OBJFileName = ModuleDirectory + "microbenchmark.obj";
+	CString ASCIIPLYFileName = ModuleDirectory + "microbenchmark_ascii.ply";
+	CString BinaryPLYFileName = ModuleDirectory + "microbenchmark_binary.ply";
+	CString MeshFileName = ModuleDirectory + "microbenchmark.mesh";
+
+	FILE *OBJ, *ASCIIPLY, *BinaryPLY;
+
+	if(fopen_s(&OBJ, OBJFileName, "wb") != 0)
+	{
+		ErrorLog.Append("Error saving file %s!\r\n", (char*)OBJFileName);
+		return false;
+	}
+
+	if(fopen_s(&ASCIIPLY, ASCIIPLYFileName, "wb") != 0)
+	{
+		ErrorLog.Append("Error saving file %s!\r\n", (char*)ASCIIPLYFileName);
+		fclose(OBJ);
+		return false;
+	}
+
+	if(fopen_s(&BinaryPLY, BinaryPLYFileName, "wb") != 0)
+	{
+		ErrorLog.Append("Error saving file %s!\r\n", (char*)BinaryPLYFileName);
+		fclose(OBJ);
+		fclose(ASCIIPLY);
+		return false;
+	}
+
+	const char *PLYHeader = "ply\nformat %s 1.0\nelement vertex %d\nproperty float x\nproperty float y\nproperty float z\nproperty float nx\nproperty float ny\nproperty float nz\nproperty float s\nproperty float t\nelement face %d\nproperty list uchar int vertex_indices\nend_header\n";
+
+	fprintf(ASCIIPLY, PLYHeader, "ascii", Side * Side, Size * Size);
+	fprintf(BinaryPLY, PLYHeader, "binary_little_endian", Side * Side, Size * Size);
+
+	for(int y = 0; y < Side; y++)
+	{
+		for(int x = 0; x < Side; x++)
+		{
+			CVertex Vertex;
+
+			Vertex.Position = vec3(x / (float)Size - 0.5f, 0.1f * sinf(x * 0.1f) * cosf(y * 0.1f), y / (float)Size - 0.5f);
+			Vertex.Normal = normalize(vec3(-0.01f * cosf(x * 0.1f) * cosf(y * 0.1f) * Size, 1.0f, 0.01f * sinf(x * 0.1f) * sinf(y * 0.1f) * Size));
+			Vertex.TexCoord = vec2(x / (float)Size, y / (float)Size);
+
+			fprintf(OBJ, "v %f %f %f\nvn %f %f %f\nvt %f %f\n", Vertex.Position.x, Vertex.Position.y, Vertex.Position.z, Vertex.Normal.x, Vertex.Normal.y, Vertex.Normal.z, Vertex.TexCoord.x, Vertex.TexCoord.y);
+			fprintf(ASCIIPLY, "%f %f %f %f %f %f %f %f\n", Vertex.Position.x, Vertex.Position.y, Vertex.Position.z, Vertex.Normal.x, Vertex.Normal.y, Vertex.Normal.z, Vertex.TexCoord.x, Vertex.TexCoord.y);
+			fwrite(&Vertex, sizeof(CVertex), 1, BinaryPLY);
+		}
+	}
+
+	for(int y = 0; y < Size; y++)
+	{
+		for(int x = 0; x < Size; x++)
+		{
+			int Corners[4] = {y * Side + x, (y + 1) * Side + x, (y + 1) * Side + x + 1, y * Side + x + 1};
+
+			fprintf(OBJ, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", Corners[0] + 1, Corners[0] + 1, Corners[0] + 1, Corners[1] + 1, Corners[1] + 1, Corners[1] + 1, Corners[2] + 1, Corners[2] + 1, Corners[2] + 1, Corners[3] + 1, Corners[3] + 1, Corners[3] + 1);
+			fprintf(ASCIIPLY, "4 %d %d %d %d\n", Corners[0], Corners[1], Corners[2], Corners[3]);
+
+			BYTE Count = 4;
+
+			fwrite(&Count, 1, 1, BinaryPLY);
+			fwrite(Corners, sizeof(int), 4, BinaryPLY);
+		}
+	}
+
+	fclose(OBJ);
+	fclose(ASCIIPLY);
+	fclose(BinaryPLY);
+
+	ReportMeshLoader(Report, "obj", OBJFileName);
+	ReportMeshLoader(Report, "ply_ascii", ASCIIPLYFileName);
+	ReportMeshLoader(Report, "ply_binary", BinaryPLYFileName);
+
+	CMeshLoader MeshLoader;
+	CMesh Mesh;
+
+	if(MeshLoader.Load(OBJFileName, Mesh) && Mesh.Save(MeshFileName))
+	{
+		FILE *File;
+		long long Bytes = 0;
+
+		if(fopen_s(&File, MeshFileName, "rb") == 0)
+		{
+			fseek(File, 0, SEEK_END);
+			Bytes = ftell(File);
+			fclose(File);
+		}
+
+		double Time = MeasureBestTime([&]{ Mesh.Load(MeshFileName); }, 3);
+
+		Report.Append("meshloader.mesh: %lld bytes, %.3f ms, %.1f MB/s\n", Bytes, Time * 1000.0, Bytes / Time / 1.0e6);
+	}
+
+	Mesh.Destroy();
+
+	remove(OBJFileName);
+	remove(ASCIIPLYFileName);
+	remove(BinaryPLYFileName);
+	remove(MeshFileName);
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+struct CScalarInstance
+{
+	vec3 Position;
+	float Scale, Angle, Speed;
+};
+
+// what one glMultMatrixf per object computes, one instance at a time with sinf and cosf on this thread
+
+static void UpdateScalarInstances(CScalarInstance *Instances, int Count, float FrameTime, float *Matrices)
+{
+	for(int i = 0; i < Count; i++, Matrices += 12)
+	{
+		CScalarInstance &Instance = Instances[i];
+
+		Instance.Angle = fmodf(Instance.Angle + Instance.Speed * FrameTime, 6.28318531f);
+
+		float s = sinf(Instance.Angle), c = cosf(Instance.Angle);
+		float Sin = s * Instance.Scale, Cos = c * Instance.Scale;
+
+		Matrices[0] = Cos; Matrices[1] = Sin * s; Matrices[2] = Sin * c; Matrices[3] = Instance.Position.x;
+		Matrices[4] = 0.0f; Matrices[5] = Cos; Matrices[6] = -Sin; Matrices[7] = Instance.Position.y;
+		Matrices[8] = -Sin; Matrices[9] = Sin * c; Matrices[10] = Cos * c; Matrices[11] = Instance.Position.z;
+	}
+}
+
+// the largest difference to the scalar matrices is reported after the first update
+
+bool BenchmarkInstances(CString &Report)
+{
+	ThreadPool.Start();
+
+	Report.Append("instances.threads: %d\n", ThreadPool.GetThreadsCount() + 1);
+
+	static const int Counts[] = {1, 100, 10000, 100000};
+
+	for(int c = 0; c < (int)(sizeof(Counts) / sizeof(Counts[0])); c++)
+	{
+		int Count = Counts[c];
+
+		CInstances Instances;
+		CScalarInstance *ScalarInstances = new CScalarInstance[Count];
+		float *ScalarMatrices = new float[Count * 12];
+
+		Instances.Init(Count);
+
+		unsigned int Random = 12345;
+
+		for(int i = 0; i < Count; i++)
+		{
+			CScalarInstance &Instance = ScalarInstances[i];
+
+			Random = Random * 1664525 + 1013904223;
+
+			Instance.Position = vec3((float)(i % 64), (float)(i / 64 % 64), (float)(i / 4096));
+			Instance.Scale = 1.0f;
+			Instance.Angle = (Random >> 8) / 16777216.0f * 6.28318531f - 3.14159265f;
+			Instance.Speed = 0.19634954f;
+
+			Instances.Set(i, Instance.Position, Instance.Scale, Instance.Angle, Instance.Speed);
+		}
+
+		Instances.Update(0.016f);
+		UpdateScalarInstances(ScalarInstances, Count, 0.016f, ScalarMatrices);
+
+		const float *Matrices = Instances.GetMatrices();
+
+		float MaxError = 0.0f;
+
+		for(int i = 0; i < Count * 12; i++)
+		{
+			MaxError = std::max(MaxError, fabsf(Matrices[i] - ScalarMatrices[i]));
+		}
+
+		double ScalarTime = MeasureBestTime([&]{ UpdateScalarInstances(ScalarInstances, Count, 0.016f, ScalarMatrices); });
+		double Time = MeasureBestTime([&]{ Instances.Update(0.016f); });
+
+		Report.Append("instances.update_%d: scalar %.3f ms, simd %.3f ms, %.2fx, %.1f MInstances/s, max error %.7f\n", Count, ScalarTime * 1000.0, Time * 1000.0, ScalarTime / Time, Count / Time / 1.0e6, MaxError);
+
+		Instances.Destroy();
+
+		delete [] ScalarMatrices;
+		delete [] ScalarInstances;
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// a million boxes and spheres scattered through a cube of 200 units, seen from outside of it; every kernel has to find
+// the same visible list as the scalar one
+
+bool BenchmarkCulling(CString &Report)
+{
+	ThreadPool.Start();
+
+	Report.Append("culling.threads: %d\n", ThreadPool.GetThreadsCount() + 1);
+
+	int Count = 1000000;
+
+	CCulling Culling;
+
+	Culling.Init(Count);
+
+	unsigned int Random = 12345;
+
+	for(int i = 0; i < Count; i++)
+	{
+		float v[4];
+
+		for(int j = 0; j < 4; j++)
+		{
+			Random = Random * 1664525 + 1013904223;
+			v[j] = (Random >> 8) / 16777216.0f;
+		}
+
+		vec3 Center = vec3(v[0], v[1], v[2]) * 200.0f - vec3(100.0f, 100.0f, 100.0f);
+		float Size = 0.25f + v[3] * 2.0f;
+
+		if(i & 1)
+		{
+			Culling.SetSphere(i, Center, Size);
+		}
+		else
+		{
+			Culling.SetBox(i, Center - vec3(Size, Size * 0.5f, Size), Center + vec3(Size, Size * 0.5f, Size));
+		}
+	}
+
+	mat4x4 View = translate(mat4x4(), vec3(0.0f, 0.0f, -150.0f)) * rotate(mat4x4(), 30.0f, vec3(0.0f, 1.0f, 0.0f));
+	mat4x4 ViewProjection = perspective(45.0f, 16.0f / 9.0f, 0.125f, 512.0f) * View;
+
+	CCPUFeatures Features = CPUFeatures;
+
+	static const char *Names[] = {"scalar", "sse2", "avx2", "neon"};
+	bool Available[] = {true, Features.SSE2, Features.AVX2, Features.NEON};
+
+	int *ScalarVisible = NULL, ScalarVisibleCount = 0;
+	double ScalarTime = 0.0;
+	bool Identical = true;
+
+	for(int k = 0; k < 4; k++)
+	{
+		if(!Available[k])
+		{
+			continue;
+		}
+
+		CPUFeatures.SSE2 = k == 1;
+		CPUFeatures.AVX2 = k == 2;
+		CPUFeatures.NEON = k == 3;
+
+		double Time = MeasureBestTime([&]{ Culling.Cull(ViewProjection); });
+
+		int VisibleCount = Culling.GetVisibleCount();
+
+		if(k == 0)
+		{
+			ScalarVisible = new int[VisibleCount > 0 ? VisibleCount : 1];
+			ScalarVisibleCount = VisibleCount;
+			ScalarTime = Time;
+
+			memcpy(ScalarVisible, Culling.GetVisible(), VisibleCount * sizeof(int));
+		}
+		else
+		{
+			Identical &= VisibleCount == ScalarVisibleCount && memcmp(ScalarVisible, Culling.GetVisible(), VisibleCount * sizeof(int)) == 0;
+		}
+
+		Report.Append("culling.%s: %d objects, %d visible, %.3f ms, %.2fx, %.1f MObjects/s\n", Names[k], Count, VisibleCount, Time * 1000.0, ScalarTime / Time, Count / Time / 1.0e6);
+	}
+
+	CPUFeatures = Features;
+
+	Report.Append("culling.kernels_identical: %s\n", Identical ? "yes" : "NO");
+
+	if(!Identical)
+	{
+		ErrorLog.Append("Culling check failed, the SIMD kernels do not find the visible objects of the scalar one!\r\n");
+	}
+
+	delete [] ScalarVisible;
+
+	Culling.Destroy();
+
+	return Identical;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static float RandomFloat(unsigned int &Random)
+{
+	Random = Random * 1664525 + 1013904223;
+
+	return (Random >> 8) / 16777216.0f;
+}
+
+// random boxes in a cube of 200 units, rays from a sphere around it to points within it; the first 1000 rays and
+// nearest queries of the smaller scene are checked against testing every box
+
+bool BenchmarkBVH(CString &Report)
+{
+	ThreadPool.Start();
+
+	Report.Append("bvh.threads: %d\n", ThreadPool.GetThreadsCount() + 1);
+
+	static const int Counts[] = {100000, 1000000};
+
+	bool Checked = true;
+
+	for(int c = 0; c < (int)(sizeof(Counts) / sizeof(Counts[0])); c++)
+	{
+		int Count = Counts[c];
+
+		vec3 *Mins = new vec3[Count], *Maxs = new vec3[Count];
+
+		unsigned int Random = 12345;
+
+		for(int i = 0; i < Count; i++)
+		{
+			vec3 Center = vec3(RandomFloat(Random), RandomFloat(Random), RandomFloat(Random)) * 200.0f - vec3(100.0f);
+			vec3 Size = vec3(RandomFloat(Random), RandomFloat(Random), RandomFloat(Random)) * 1.5f + vec3(0.1f);
+
+			Mins[i] = Center - Size;
+			Maxs[i] = Center + Size;
+		}
+
+		CBVH BVH;
+
+		double BuildTime = MeasureBestTime([&]{ BVH.Build(Mins, Maxs, Count); }, 3);
+
+		CBVHStats Stats;
+
+		BVH.GetStats(Stats);
+
+		Report.Append("bvh.build_%d: %.3f ms, %d nodes, %d leaves, depth %d\n", Count, BuildTime * 1000.0, Stats.Nodes, Stats.Leaves, Stats.Depth);
+
+		double RefitTime = MeasureBestTime([&]{ BVH.Refit(); });
+
+		Report.Append("bvh.refit_%d: %.3f ms\n", Count, RefitTime * 1000.0);
+
+		int RaysCount = 1000000;
+
+		vec3 *Origins = new vec3[RaysCount], *Directions = new vec3[RaysCount];
+
+		for(int i = 0; i < RaysCount; i++)
+		{
+			vec3 Origin = vec3(RandomFloat(Random), RandomFloat(Random), RandomFloat(Random)) * 2.0f - vec3(1.0f);
+
+			Origins[i] = normalize(Origin + vec3(0.0f, 0.0f, 0.001f)) * 300.0f;
+			Directions[i] = normalize(vec3(RandomFloat(Random), RandomFloat(Random), RandomFloat(Random)) * 200.0f - vec3(100.0f) - Origins[i]);
+		}
+
+		int Hits = 0;
+
+		double RayTime = MeasureBestTime([&]
+		{
+			Hits = 0;
+
+			for(int i = 0; i < RaysCount; i++)
+			{
+				float Distance;
+
+				Hits += BVH.RayCast(Origins[i], Directions[i], FLT_MAX, Distance) >= 0 ? 1 : 0;
+			}
+		}, 3);
+
+		double ParallelRayTime = MeasureBestTime([&]
+		{
+			ThreadPool.ParallelFor(RaysCount, 16384, [&](int Begin, int End)
+			{
+				for(int i = Begin; i < End; i++)
+				{
+					float Distance;
+
+					BVH.RayCast(Origins[i], Directions[i], FLT_MAX, Distance);
+				}
+			});
+		}, 3);
+
+		Report.Append("bvh.rays_%d: %d rays, %d hits, %.1f MRays/s, %.1f MRays/s on all threads\n", Count, RaysCount, Hits, RaysCount / RayTime / 1.0e6, RaysCount / ParallelRayTime / 1.0e6);
+
+		int NearestCount = 100000;
+
+		double NearestTime = MeasureBestTime([&]
+		{
+			for(int i = 0; i < NearestCount; i++)
+			{
+				float Distance;
+
+				BVH.Nearest(Origins[i] * 0.5f, FLT_MAX, Distance);
+			}
+		}, 3);
+
+		Report.Append("bvh.nearest_%d: %.2f MQueries/s\n", Count, NearestCount / NearestTime / 1.0e6);
+
+		mat4x4 ViewProjection = perspective(45.0f, 16.0f / 9.0f, 0.125f, 512.0f) * translate(mat4x4(), vec3(0.0f, 0.0f, -150.0f));
+
+		CFrustum Frustum;
+
+		Frustum.Set(ViewProjection);
+
+		int *Objects = new int[Count], ObjectsCount = 0, ExpectedCount = 0;
+
+		double FrustumTime = MeasureBestTime([&]{ ObjectsCount = BVH.FrustumQuery(Frustum, Objects); });
+
+		for(int i = 0; i < Count; i++)
+		{
+			ExpectedCount += Frustum.IsVisible((Mins[i] + Maxs[i]) * 0.5f, (Maxs[i] - Mins[i]) * 0.5f, 0.0f) ? 1 : 0;
+		}
+
+		Report.Append("bvh.frustum_%d: %d objects, %.3f ms, %s\n", Count, ObjectsCount, FrustumTime * 1000.0, ObjectsCount == ExpectedCount ? "matches" : "DIFFERS");
+
+		if(ObjectsCount != ExpectedCount)
+		{
+			ErrorLog.Append("BVH check failed, the frustum query of %d boxes finds %d objects instead of %d!\r\n", Count, ObjectsCount, ExpectedCount);
+			Checked = false;
+		}
+
+		if(c == 0)
+		{
+			bool Identical = true;
+
+			for(int i = 0; i < 1000; i++)
+			{
+				float Distance, ExpectedDistance = FLT_MAX, NearestDistance, ExpectedNearestDistance = FLT_MAX;
+
+				BVH.RayCast(Origins[i], Directions[i], FLT_MAX, Distance);
+				BVH.Nearest(Origins[i] * 0.5f, FLT_MAX, NearestDistance);
+
+				vec3 InverseDirection(1.0f / Directions[i].x, 1.0f / Directions[i].y, 1.0f / Directions[i].z), Point = Origins[i] * 0.5f;
+
+				for(int j = 0; j < Count; j++)
+				{
+					vec3 t1 = (Mins[j] - Origins[i]) * InverseDirection, t2 = (Maxs[j] - Origins[i]) * InverseDirection;
+
+					float Near = std::max(std::max(std::min(t1.x, t2.x), std::min(t1.y, t2.y)), std::max(std::min(t1.z, t2.z), 0.0f));
+					float Far = std::min(std::min(std::max(t1.x, t2.x), std::max(t1.y, t2.y)), std::max(t1.z, t2.z));
+
+					if(Near <= Far && Near < ExpectedDistance) ExpectedDistance = Near;
+
+					vec3 d = max(max(Mins[j] - Point, Point - Maxs[j]), vec3(0.0f));
+
+					ExpectedNearestDistance = std::min(ExpectedNearestDistance, sqrtf(dot(d, d)));
+				}
+
+				Identical &= Distance == ExpectedDistance && NearestDistance == ExpectedNearestDistance;
+			}
+
+			Report.Append("bvh.matches_brute_force: %s\n", Identical ? "yes" : "NO");
+
+			if(!Identical)
+			{
+				ErrorLog.Append("BVH check failed, the rays or nearest queries of %d boxes do not match testing every box!\r\n", Count);
+				Checked = false;
+			}
+		}
+
+		BVH.Destroy();
+
+		delete [] Objects;
+		delete [] Origins;
+		delete [] Directions;
+		delete [] Mins;
+		delete [] Maxs;
+	}
+
+	return Checked;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// a random tree of a million nodes, each a small turn and offset from its parent; the world matrices after moving some
+// nodes are checked against recomputing every node from its parent in the order they were added
+
+bool BenchmarkSceneGraph(CString &Report)
+{
+	ThreadPool.Start();
+
+	Report.Append("scenegraph.threads: %d\n", ThreadPool.GetThreadsCount() + 1);
+
+	int Count = 1000000;
+
+	mat4x4 *Locals = new mat4x4[Count];
+	int *Parents = new int[Count];
+
+	unsigned int Random = 12345;
+
+	for(int i = 0; i < Count; i++)
+	{
+		Random = Random * 1664525 + 1013904223;
+
+		Parents[i] = i > 0 ? (int)((Random >> 8) % i) : -1;
+		Locals[i] = translate(mat4x4(), vec3(RandomFloat(Random), RandomFloat(Random), RandomFloat(Random)) - vec3(0.5f)) * rotate(mat4x4(), RandomFloat(Random) * 10.0f, vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	CSceneGraph Graph;
+
+	for(int i = 0; i < Count; i++)
+	{
+		Graph.Add(Parents[i], Locals[i]);
+	}
+
+	double Start = GetTime();
+
+	Graph.Update();
+
+	double SortTime = GetTime() - Start;
+
+	CSceneGraphStats Stats;
+
+	Graph.GetStats(Stats);
+
+	Report.Append("scenegraph.sort_and_update_%d: %.3f ms, %d levels\n", Count, SortTime * 1000.0, Stats.Levels);
+
+	double StaticTime = MeasureBestTime([&]{ Graph.Update(); });
+
+	Report.Append("scenegraph.static_%d: %.6f ms, %d updated\n", Count, StaticTime * 1000.0, Graph.Update());
+
+	int Updated = 0;
+
+	double AllTime = MeasureBestTime([&]
+	{
+		for(int i = 0; i < Count; i++)
+		{
+			Graph.SetLocal(i, Locals[i]);
+		}
+
+		Updated = Graph.Update();
+	}, 3);
+
+	Report.Append("scenegraph.all_%d: %.3f ms, %d updated\n", Count, AllTime * 1000.0, Updated);
+
+	double RootTime = MeasureBestTime([&]
+	{
+		Graph.SetLocal(0, Locals[0]);
+
+		Updated = Graph.Update();
+	}, 3);
+
+	Report.Append("scenegraph.root_%d: %.3f ms, %d updated\n", Count, RootTime * 1000.0, Updated);
+
+	// the leaves are most of the nodes, the moved ones are spread over the tree
+
+	int MovedCount = 1000;
+
+	double MovedTime = MeasureBestTime([&]
+	{
+		unsigned int MovedRandom = 54321;
+
+		for(int i = 0; i < MovedCount; i++)
+		{
+			MovedRandom = MovedRandom * 1664525 + 1013904223;
+
+			int Node = (MovedRandom >> 8) % Count;
+
+			Locals[Node] = Locals[Node] * rotate(mat4x4(), 1.0f, vec3(1.0f, 0.0f, 0.0f));
+
+			Graph.SetLocal(Node, Locals[Node]);
+		}
+
+		Updated = Graph.Update();
+	}, 3);
+
+	Report.Append("scenegraph.moved_%d_of_%d: %.3f ms, %d updated\n", MovedCount, Count, MovedTime * 1000.0, Updated);
+
+	mat4x4 *Worlds = new mat4x4[Count];
+
+	bool Identical = true;
+
+	for(int i = 0; i < Count; i++)
+	{
+		Worlds[i] = Parents[i] >= 0 ? Worlds[Parents[i]] * Locals[i] : Locals[i];
+
+		Identical &= memcmp(&Worlds[i], &Graph.GetWorld(i), sizeof(mat4x4)) == 0;
+	}
+
+	Report.Append("scenegraph.matches_full_update: %s\n", Identical ? "yes" : "NO");
+
+	if(!Identical)
+	{
+		ErrorLog.Append("Scene graph check failed, the world matrices after the incremental updates differ from a full update!\r\n");
+	}
+
+	Graph.Destroy();
+
+	delete [] Worlds;
+	delete [] Locals;
+	delete [] Parents;
+
+	return Identical;
+}
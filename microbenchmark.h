@@ -0,0 +1,49 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+typedef bool (*MICRO_BENCHMARK_FUNCTION)(CString &Report);
+
+struct CMicroBenchmark
+{
+	const char *Name;
+	MICRO_BENCHMARK_FUNCTION Function;
+};
+
+bool RunMicroBenchmarks(char *Name, CString &Report);
+bool SaveMicroBenchmarkReport(char *FileName, CString &Report);
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+template <class T> double MeasureBestTime(T Function, int Repeats = 5)
+{
+	double BestTime = 1.0e30;
+
+	for(int i = 0; i < Repeats; i++)
+	{
+		double Start = GetTime();
+		Function();
+		double Time = GetTime() - Start;
+
+		if(Time < BestTime) BestTime = Time;
+	}
+
+	return BestTime;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+bool BenchmarkStrings(CString &Report);
+bool BenchmarkMipmaps(CString &Report);
+bool BenchmarkPixelFormats(CString &Report);
+bool BenchmarkResample(CString &Report);
+bool BenchmarkBlockCompression(CString &Report);
+bool BenchmarkContainers(CString &Report);
+bool BenchmarkMeshes(CString &Report);
+bool BenchmarkMeshLoader(CString &Report);
+bool BenchmarkInstances(CString &Report);
+bool BenchmarkCulling(CString &Report);
+bool BenchmarkBVH(CString &Report);
+bool BenchmarkSceneGraph(CString &Report);
@@ -0,0 +1,599 @@
+#include "mipmap.h"
+#include "simd.h"
+#include "threadpool.h"
+
+#include "string.h"
+
+#include <math.h>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+#define MIPMAP_KAISER_TAPS 8
+
+struct CMipmapTables
+{
+	float SRGBToLinear[256], UNormToFloat[256];
+	WORD SRGBToLinear16[256];
+	BYTE LinearToSRGB[4096];
+
+	CMipmapTables()
+	{
+		for(int i = 0; i < 256; i++)
+		{
+			double c = i / 255.0;
+			double l = c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+
+			SRGBToLinear[i] = (float)l;
+			UNormToFloat[i] = (float)c;
+			SRGBToLinear16[i] = (WORD)(l * 65535.0 + 0.5);
+		}
+
+		for(int i = 0; i < 4096; i++)
+		{
+			double l = i / 4095.0;
+			double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+
+			LinearToSRGB[i] = (BYTE)(c * 255.0 + 0.5);
+		}
+	}
+};
+
+static const CMipmapTables& GetTables()
+{
+	static CMipmapTables Tables;
+
+	return Tables;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static void BoxRowScalar(const BYTE *Row0, const BYTE *Row1, BYTE *Destination, int SourceWidth, int Begin, int End, int Channels)
+{
+	for(int x = Begin; x < End; x++)
+	{
+		int x0 = x * 2 * Channels;
+		int x1 = (x * 2 + 1 < SourceWidth ? x * 2 + 1 : SourceWidth - 1) * Channels;
+
+		for(int c = 0; c < Channels; c++)
+		{
+			Destination[x * Channels + c] = (BYTE)((Row0[x0 + c] + Row0[x1 + c] + Row1[x0 + c] + Row1[x1 + c] + 2) >> 2);
+		}
+	}
+}
+
+static void BoxRowSRGB(const BYTE *Row0, const BYTE *Row1, BYTE *Destination, int SourceWidth, int Width, int Channels, const CMipmapTables &Tables)
+{
+	int ColorChannels = Channels < 4 ? Channels : 3;
+
+	for(int x = 0; x < Width; x++)
+	{
+		int x0 = x * 2 * Channels;
+		int x1 = (x * 2 + 1 < SourceWidth ? x * 2 + 1 : SourceWidth - 1) * Channels;
+
+		for(int c = 0; c < ColorChannels; c++)
+		{
+			int Sum = Tables.SRGBToLinear16[Row0[x0 + c]] + Tables.SRGBToLinear16[Row0[x1 + c]] + Tables.SRGBToLinear16[Row1[x0 + c]] + Tables.SRGBToLinear16[Row1[x1 + c]];
+
+			Destination[x * Channels + c] = Tables.LinearToSRGB[((Sum + 2) >> 2) >> 4];
+		}
+
+		if(Channels == 4)
+		{
+			Destination[x * 4 + 3] = (BYTE)((Row0[x0 + 3] + Row0[x1 + 3] + Row1[x0 + 3] + Row1[x1 + 3] + 2) >> 2);
+		}
+	}
+}
+
+#if defined(SIMD_X86)
+
+SIMD_TARGET("sse2") static void BoxRowSSE2(const BYTE *Row0, const BYTE *Row1, BYTE *Destination, int SourceWidth, int Width)
+{
+	__m128i Zero = _mm_setzero_si128(), Two = _mm_set1_epi16(2);
+
+	int x = 0;
+
+	for(; x + 4 <= Width; x += 4)
+	{
+		__m128i a0 = _mm_loadu_si128((const __m128i*)(Row0 + x * 8));
+		__m128i a1 = _mm_loadu_si128((const __m128i*)(Row0 + x * 8 + 16));
+		__m128i b0 = _mm_loadu_si128((const __m128i*)(Row1 + x * 8));
+		__m128i b1 = _mm_loadu_si128((const __m128i*)(Row1 + x * 8 + 16));
+
+		// vertical sums of the source pixels 0 1, 2 3, 4 5 and 6 7 widened to 16 bits per channel
+
+		__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, Zero), _mm_unpacklo_epi8(b0, Zero));
+		__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, Zero), _mm_unpackhi_epi8(b0, Zero));
+		__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, Zero), _mm_unpacklo_epi8(b1, Zero));
+		__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, Zero), _mm_unpackhi_epi8(b1, Zero));
+
+		__m128i d0 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+		__m128i d1 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+
+		d0 = _mm_srli_epi16(_mm_add_epi16(d0, Two), 2);
+		d1 = _mm_srli_epi16(_mm_add_epi16(d1, Two), 2);
+
+		_mm_storeu_si128((__m128i*)(Destination + x * 4), _mm_packus_epi16(d0, d1));
+	}
+
+	BoxRowScalar(Row0, Row1, Destination, SourceWidth, x, Width, 4);
+}
+
+SIMD_TARGET("avx2") static void BoxRowAVX2(const BYTE *Row0, const BYTE *Row1, BYTE *Destination, int SourceWidth, int Width)
+{
+	__m256i Zero = _mm256_setzero_si256(), Two = _mm256_set1_epi16(2);
+
+	int x = 0;
+
+	for(; x + 8 <= Width; x += 8)
+	{
+		__m256i a0 = _mm256_loadu_si256((const __m256i*)(Row0 + x * 8));
+		__m256i a1 = _mm256_loadu_si256((const __m256i*)(Row0 + x * 8 + 32));
+		__m256i b0 = _mm256_loadu_si256((const __m256i*)(Row1 + x * 8));
+		__m256i b1 = _mm256_loadu_si256((const __m256i*)(Row1 + x * 8 + 32));
+
+		// the unpacks work within 128 bit lanes, so the packed result holds destination pixels 0 1 4 5 2 3 6 7
+
+		__m256i s0 = _mm256_add_epi16(_mm256_unpacklo_epi8(a0, Zero), _mm256_unpacklo_epi8(b0, Zero));
+		__m256i s1 = _mm256_add_epi16(_mm256_unpackhi_epi8(a0, Zero), _mm256_unpackhi_epi8(b0, Zero));
+		__m256i s2 = _mm256_add_epi16(_mm256_unpacklo_epi8(a1, Zero), _mm256_unpacklo_epi8(b1, Zero));
+		__m256i s3 = _mm256_add_epi16(_mm256_unpackhi_epi8(a1, Zero), _mm256_unpackhi_epi8(b1, Zero));
+
+		__m256i d0 = _mm256_add_epi16(_mm256_unpacklo_epi64(s0, s1), _mm256_unpackhi_epi64(s0, s1));
+		__m256i d1 = _mm256_add_epi16(_mm256_unpacklo_epi64(s2, s3), _mm256_unpackhi_epi64(s2, s3));
+
+		d0 = _mm256_srli_epi16(_mm256_add_epi16(d0, Two), 2);
+		d1 = _mm256_srli_epi16(_mm256_add_epi16(d1, Two), 2);
+
+		__m256i Packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(d0, d1), _MM_SHUFFLE(3, 1, 2, 0));
+
+		_mm256_storeu_si256((__m256i*)(Destination + x * 4), Packed);
+	}
+
+	BoxRowScalar(Row0, Row1, Destination, SourceWidth, x, Width, 4);
+}
+
+#elif defined(SIMD_NEON)
+
+static void BoxRowNEON(const BYTE *Row0, const BYTE *Row1, BYTE *Destination, int SourceWidth, int Width)
+{
+	int x = 0;
+
+	for(; x + 2 <= Width; x += 2)
+	{
+		uint8x16_t a = vld1q_u8(Row0 + x * 8), b = vld1q_u8(Row1 + x * 8);
+
+		uint16x8_t s0 = vaddl_u8(vget_low_u8(a), vget_low_u8(b));
+		uint16x8_t s1 = vaddl_u8(vget_high_u8(a), vget_high_u8(b));
+
+		uint16x8_t d = vcombine_u16(vadd_u16(vget_low_u16(s0), vget_high_u16(s0)), vadd_u16(vget_low_u16(s1), vget_high_u16(s1)));
+
+		vst1_u8(Destination + x * 4, vrshrn_n_u16(d, 2));
+	}
+
+	BoxRowScalar(Row0, Row1, Destination, SourceWidth, x, Width, 4);
+}
+
+#endif
+
+static void GenerateLevelBox(const CMipmapLevel &Source, CMipmapLevel &Level, int Channels, bool sRGB, const CMipmapTables &Tables)
+{
+	ThreadPool.ParallelFor(Level.Height, 32, [&](int Begin, int End)
+	{
+		for(int y = Begin; y < End; y++)
+		{
+			const BYTE *Row0 = Source.Data + y * 2 * Source.Pitch;
+			const BYTE *Row1 = Source.Data + (y * 2 + 1 < Source.Height ? y * 2 + 1 : Source.Height - 1) * Source.Pitch;
+
+			BYTE *Destination = Level.Data + y * Level.Pitch;
+
+			if(sRGB)
+			{
+				BoxRowSRGB(Row0, Row1, Destination, Source.Width, Level.Width, Channels, Tables);
+			}
+			else if(Channels == 4 && Source.Width >= 2)
+			{
+#if defined(SIMD_X86)
+				if(CPUFeatures.AVX2) BoxRowAVX2(Row0, Row1, Destination, Source.Width, Level.Width);
+				else if(CPUFeatures.SSE2) BoxRowSSE2(Row0, Row1, Destination, Source.Width, Level.Width);
+				else BoxRowScalar(Row0, Row1, Destination, Source.Width, 0, Level.Width, 4);
+#elif defined(SIMD_NEON)
+				if(CPUFeatures.NEON) BoxRowNEON(Row0, Row1, Destination, Source.Width, Level.Width);
+				else BoxRowScalar(Row0, Row1, Destination, Source.Width, 0, Level.Width, 4);
+#else
+				BoxRowScalar(Row0, Row1, Destination, Source.Width, 0, Level.Width, 4);
+#endif
+			}
+			else
+			{
+				BoxRowScalar(Row0, Row1, Destination, Source.Width, 0, Level.Width, Channels);
+			}
+		}
+	});
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static double BesselI0(double x)
+{
+	double Sum = 1.0, Term = 1.0;
+
+	for(int k = 1; k < 32; k++)
+	{
+		Term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		Sum += Term;
+
+		if(Term < Sum * 1.0e-12) break;
+	}
+
+	return Sum;
+}
+
+// windowed sinc with a support of 2 destination pixels on each side, alpha 4 keeps ringing low without blurring much
+
+static double KaiserSinc(double d)
+{
+	if(fabs(d) >= 2.0)
+	{
+		return 0.0;
+	}
+
+	double Sinc = d == 0.0 ? 1.0 : sin(3.14159265358979 * d) / (3.14159265358979 * d);
+	double t = d / 2.0;
+
+	return Sinc * BesselI0(4.0 * sqrt(1.0 - t * t)) / BesselI0(4.0);
+}
+
+static void ComputeKaiserTaps(int SourceSize, int Size, int *First, float *Weights)
+{
+	double Scale = (double)SourceSize / Size;
+
+	for(int i = 0; i < Size; i++)
+	{
+		double Center = (i + 0.5) * Scale;
+
+		First[i] = (int)floor(Center - MIPMAP_KAISER_TAPS / 2 + 0.5);
+
+		double Sum = 0.0, TapWeights[MIPMAP_KAISER_TAPS];
+
+		for(int k = 0; k < MIPMAP_KAISER_TAPS; k++)
+		{
+			TapWeights[k] = KaiserSinc((First[i] + k + 0.5 - Center) / Scale);
+			Sum += TapWeights[k];
+		}
+
+		for(int k = 0; k < MIPMAP_KAISER_TAPS; k++)
+		{
+			Weights[i * MIPMAP_KAISER_TAPS + k] = (float)(TapWeights[k] / Sum);
+		}
+	}
+}
+
+static void DecodeRow(const BYTE *Source, float *Row, int Width, int Channels, bool sRGB, const CMipmapTables &Tables)
+{
+	const float *Color = sRGB ? Tables.SRGBToLinear : Tables.UNormToFloat;
+
+	int ColorChannels = Channels < 4 ? Channels : 3;
+
+	for(int x = 0; x < Width; x++, Source += Channels, Row += 4)
+	{
+		for(int c = 0; c < 3; c++)
+		{
+			Row[c] = c < ColorChannels ? Color[Source[c]] : 0.0f;
+		}
+
+		Row[3] = Channels == 4 ? Tables.UNormToFloat[Source[3]] : 1.0f;
+	}
+}
+
+static void FilterRow(const float *Row, int SourceWidth, float *Destination, int Width, const int *First, const float *Weights)
+{
+	for(int x = 0; x < Width; x++, Weights += MIPMAP_KAISER_TAPS)
+	{
+		FLOAT4 Sum = Float4Set1(0.0f);
+
+		if(First[x] >= 0 && First[x] + MIPMAP_KAISER_TAPS <= SourceWidth)
+		{
+			const float *Pixel = Row + First[x] * 4;
+
+			for(int k = 0; k < MIPMAP_KAISER_TAPS; k++)
+			{
+				Sum = Float4Add(Sum, Float4Mul(Float4Load(Pixel + k * 4), Float4Set1(Weights[k])));
+			}
+		}
+		else
+		{
+			for(int k = 0; k < MIPMAP_KAISER_TAPS; k++)
+			{
+				int i = First[x] + k;
+
+				if(i < 0) i = 0;
+				if(i > SourceWidth - 1) i = SourceWidth - 1;
+
+				Sum = Float4Add(Sum, Float4Mul(Float4Load(Row + i * 4), Float4Set1(Weights[k])));
+			}
+		}
+
+		Float4Store(Destination + x * 4, Sum);
+	}
+}
+
+static void EncodeRow(const float *Row, BYTE *Destination, int Width, int Channels, bool sRGB, const CMipmapTables &Tables)
+{
+	FLOAT4 Zero = Float4Set1(0.0f), One = Float4Set1(1.0f);
+
+	int ColorChannels = Channels < 4 ? Channels : 3;
+
+	float Pixel[4];
+
+	for(int x = 0; x < Width; x++, Row += 4, Destination += Channels)
+	{
+		Float4Store(Pixel, Float4Min(Float4Max(Float4Load(Row), Zero), One));
+
+		for(int c = 0; c < ColorChannels; c++)
+		{
+			Destination[c] = sRGB ? Tables.LinearToSRGB[(int)(Pixel[c] * 4095.0f + 0.5f)] : (BYTE)(Pixel[c] * 255.0f + 0.5f);
+		}
+
+		if(Channels == 4)
+		{
+			Destination[3] = (BYTE)(Pixel[3] * 255.0f + 0.5f);
+		}
+	}
+}
+
+static void GenerateLevelKaiser(const CMipmapLevel &Source, CMipmapLevel &Level, int Channels, bool sRGB, const CMipmapTables &Tables)
+{
+	int *FirstX = new int[Level.Width], *FirstY = new int[Level.Height];
+	float *WeightsX = new float[Level.Width * MIPMAP_KAISER_TAPS], *WeightsY = new float[Level.Height * MIPMAP_KAISER_TAPS];
+
+	ComputeKaiserTaps(Source.Width, Level.Width, FirstX, WeightsX);
+	ComputeKaiserTaps(Source.Height, Level.Height, FirstY, WeightsY);
+
+	// each band filters the source rows it needs horizontally into a small buffer, then filters that vertically
+
+	ThreadPool.ParallelFor(Level.Height, 16, [&](int Begin, int End)
+	{
+		int FirstRow = FirstY[Begin], Rows = FirstY[End - 1] + MIPMAP_KAISER_TAPS - FirstRow;
+		int RowSize = Level.Width * 4;
+
+		float *Row = new float[Source.Width * 4];
+		float *Filtered = new float[Rows * RowSize];
+		float *Sum = new float[RowSize];
+
+		for(int r = 0; r < Rows; r++)
+		{
+			int y = FirstRow + r;
+
+			if(y < 0) y = 0;
+			if(y > Source.Height - 1) y = Source.Height - 1;
+
+			DecodeRow(Source.Data + y * Source.Pitch, Row, Source.Width, Channels, sRGB, Tables);
+			FilterRow(Row, Source.Width, Filtered + r * RowSize, Level.Width, FirstX, WeightsX);
+		}
+
+		for(int y = Begin; y < End; y++)
+		{
+			const float *Weights = WeightsY + y * MIPMAP_KAISER_TAPS;
+			const float *Taps = Filtered + (FirstY[y] - FirstRow) * RowSize;
+
+			for(int i = 0; i < RowSize; i += 4)
+			{
+				FLOAT4 Accumulator = Float4Set1(0.0f);
+
+				for(int k = 0; k < MIPMAP_KAISER_TAPS; k++)
+				{
+					Accumulator = Float4Add(Accumulator, Float4Mul(Float4Load(Taps + k * RowSize + i), Float4Set1(Weights[k])));
+				}
+
+				Float4Store(Sum + i, Accumulator);
+			}
+
+			EncodeRow(Sum, Level.Data + y * Level.Pitch, Level.Width, Channels, sRGB, Tables);
+		}
+
+		delete [] Row;
+		delete [] Filtered;
+		delete [] Sum;
+	});
+
+	delete [] FirstX;
+	delete [] FirstY;
+	delete [] WeightsX;
+	delete [] WeightsY;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// alpha tested geometry thins out in the smaller mips, so alpha is scaled until the share of pixels passing the
+// alpha test matches level 0 (Castaño, "Computing Alpha Mipmaps")
+
+static void GetAlphaHistogram(const CMipmapLevel &Level, int *Histogram)
+{
+	memset(Histogram, 0, 256 * sizeof(int));
+
+	for(int y = 0; y < Level.Height; y++)
+	{
+		const BYTE *Pixel = Level.Data + y * Level.Pitch + 3;
+
+		for(int x = 0; x < Level.Width; x++, Pixel += 4)
+		{
+			Histogram[*Pixel]++;
+		}
+	}
+}
+
+static float GetAlphaCoverage(const int *Histogram, int Pixels, float Scale, float Reference)
+{
+	int Covered = 0;
+
+	for(int a = 0; a < 256; a++)
+	{
+		if(a * Scale > Reference * 255.0f) Covered += Histogram[a];
+	}
+
+	return (float)Covered / Pixels;
+}
+
+static void ScaleAlphaToCoverage(CMipmapLevel &Level, float Coverage, float Reference)
+{
+	int Histogram[256];
+
+	GetAlphaHistogram(Level, Histogram);
+
+	int Pixels = Level.Width * Level.Height;
+
+	float LevelCoverage = GetAlphaCoverage(Histogram, Pixels, 1.0f, Reference);
+
+	if(LevelCoverage == Coverage)
+	{
+		return;
+	}
+
+	// the smallest scale reaching the coverage when it is too low, the largest one not exceeding it when it is too high
+
+	bool Grow = LevelCoverage < Coverage;
+
+	float Low = Grow ? 1.0f : 0.0f, High = Grow ? 4.0f : 1.0f;
+
+	for(int i = 0; i < 16; i++)
+	{
+		float Scale = (Low + High) * 0.5f;
+
+		LevelCoverage = GetAlphaCoverage(Histogram, Pixels, Scale, Reference);
+
+		if(Grow ? LevelCoverage >= Coverage : LevelCoverage > Coverage) High = Scale;
+		else Low = Scale;
+	}
+
+	float Scale = Grow ? High : Low;
+
+	BYTE Alpha[256];
+
+	for(int a = 0; a < 256; a++)
+	{
+		float Scaled = a * Scale + 0.5f;
+
+		Alpha[a] = Scaled > 255.0f ? 255 : (BYTE)Scaled;
+	}
+
+	for(int y = 0; y < Level.Height; y++)
+	{
+		BYTE *Pixel = Level.Data + y * Level.Pitch + 3;
+
+		for(int x = 0; x < Level.Width; x++, Pixel += 4)
+		{
+			*Pixel = Alpha[*Pixel];
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CMipmapChain::CMipmapChain()
+{
+	Levels = NULL;
+	LevelsCount = 0;
+}
+
+CMipmapChain::~CMipmapChain()
+{
+	Destroy();
+}
+
+bool CMipmapChain::Generate(BYTE *Data, int Width, int Height, int Pitch, int Channels, MIPMAP_FILTER Filter, bool sRGB, bool PreserveAlphaCoverage, float AlphaReference)
+{
+	Destroy();
+
+	if(Data == NULL || Width <= 0 || Height <= 0 || Channels < 1 || Channels > 4)
+	{
+		return false;
+	}
+
+	const CMipmapTables &Tables = GetTables();
+
+	LevelsCount = GetLevelsCount(Width, Height);
+	Levels = new CMipmapLevel[LevelsCount];
+
+	Levels[0].Data = Data;
+	Levels[0].Width = Width;
+	Levels[0].Height = Height;
+	Levels[0].Pitch = Pitch;
+
+	PreserveAlphaCoverage = PreserveAlphaCoverage && Channels == 4;
+
+	float Coverage = 0.0f;
+
+	if(PreserveAlphaCoverage)
+	{
+		int Histogram[256];
+
+		GetAlphaHistogram(Levels[0], Histogram);
+
+		Coverage = GetAlphaCoverage(Histogram, Width * Height, 1.0f, AlphaReference);
+	}
+
+	for(int i = 1; i < LevelsCount; i++)
+	{
+		CMipmapLevel &Source = Levels[i - 1], &Level = Levels[i];
+
+		Level.Width = Source.Width > 1 ? Source.Width / 2 : 1;
+		Level.Height = Source.Height > 1 ? Source.Height / 2 : 1;
+		Level.Pitch = (Level.Width * Channels + 3) & ~3;
+		Level.Data = new BYTE[Level.Pitch * Level.Height];
+
+		if(Filter == MIPMAP_FILTER_KAISER)
+		{
+			GenerateLevelKaiser(Source, Level, Channels, sRGB, Tables);
+		}
+		else
+		{
+			GenerateLevelBox(Source, Level, Channels, sRGB, Tables);
+		}
+
+		if(PreserveAlphaCoverage)
+		{
+			ScaleAlphaToCoverage(Level, Coverage, AlphaReference);
+		}
+	}
+
+	return true;
+}
+
+void CMipmapChain::SetBaseLevel(BYTE *Data, int Width, int Height, int Pitch)
+{
+	Destroy();
+
+	LevelsCount = 1;
+	Levels = new CMipmapLevel[1];
+
+	Levels[0].Data = Data;
+	Levels[0].Width = Width;
+	Levels[0].Height = Height;
+	Levels[0].Pitch = Pitch;
+}
+
+void CMipmapChain::Destroy()
+{
+	for(int i = 1; i < LevelsCount; i++)
+	{
+		delete [] Levels[i].Data;
+	}
+
+	delete [] Levels;
+
+	Levels = NULL;
+	LevelsCount = 0;
+}
+
+int CMipmapChain::GetLevelsCount(int Width, int Height)
+{
+	int Size = Width > Height ? Width : Height, LevelsCount = 1;
+
+	while(Size > 1)
+	{
+		Size /= 2;
+		LevelsCount++;
+	}
+
+	return LevelsCount;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "platform.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+enum MIPMAP_FILTER
+{
+	MIPMAP_FILTER_BOX,
+	MIPMAP_FILTER_KAISER
+};
+
+struct CMipmapLevel
+{
+	BYTE *Data;
+	int Width, Height, Pitch;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// builds the complete mip chain of an 8 bit per channel image with 1 to 4 channels on the CPU, the results do not
+// depend on the driver; level 0 points to the source data, the other levels are owned by the chain and their rows
+// are padded to 4 bytes to match the default GL_UNPACK_ALIGNMENT
+
+class CMipmapChain
+{
+public:
+	CMipmapLevel *Levels;
+	int LevelsCount;
+
+public:
+	CMipmapChain();
+	~CMipmapChain();
+
+	bool Generate(BYTE *Data, int Width, int Height, int Pitch, int Channels, MIPMAP_FILTER Filter, bool sRGB, bool PreserveAlphaCoverage, float AlphaReference = 0.5f);
+	void SetBaseLevel(BYTE *Data, int Width, int Height, int Pitch);
+	void Destroy();
+
+	static int GetLevelsCount(int Width, int Height);
+};
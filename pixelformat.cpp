@@ -0,0 +1,713 @@
+#include "win32_opengl_glew_freeimage_glm.h"
+#include "pixelformat.h"
+#include "simd.h"
+#include "threadpool.h"
+
+#include <atomic>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CPixelFormatCaps::CPixelFormatCaps()
+{
+	BGR = TextureRG = TextureSwizzle = Luminance = TextureFloat = RGB565 = S3TC = S3TCsRGB = RGTC = BPTC = false;
+}
+
+void CPixelFormatCaps::Init()
+{
+	BGR = gl_version >= 12;
+	TextureRG = gl_version >= 30 || GLEW_ARB_texture_rg;
+	TextureSwizzle = gl_version >= 33 || GLEW_ARB_texture_swizzle || GLEW_EXT_texture_swizzle;
+	Luminance = !wgl_context_forward_compatible;
+	TextureFloat = gl_version >= 30 || GLEW_ARB_texture_float;
+	RGB565 = gl_version >= 41 || GLEW_ARB_ES2_compatibility;
+	S3TC = GLEW_EXT_texture_compression_s3tc;
+	S3TCsRGB = S3TC && GLEW_EXT_texture_sRGB;
+	RGTC = gl_version >= 30 || GLEW_ARB_texture_compression_rgtc;
+	BPTC = gl_version >= 42 || GLEW_ARB_texture_compression_bptc;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// rows are converted in bands of about 256 KB, small enough to spread even a 512x512 image over the workers
+
+static int GetRowsGrain(int Width, int BytesPerPixel)
+{
+	int Grain = (256 * 1024) / (Width * BytesPerPixel + 1);
+
+	return Grain > 1 ? Grain : 1;
+}
+
+static void SwapRedBlueRow24(BYTE *Row, int Begin, int End)
+{
+	for(int x = Begin; x < End; x++)
+	{
+		BYTE Temp = Row[x * 3];
+		Row[x * 3] = Row[x * 3 + 2];
+		Row[x * 3 + 2] = Temp;
+	}
+}
+
+static void SwapRedBlueRow32(BYTE *Row, int Begin, int End)
+{
+	DWORD *Pixels = (DWORD*)Row;
+
+	for(int x = Begin; x < End; x++)
+	{
+		DWORD Pixel = Pixels[x];
+
+		Pixels[x] = (Pixel & 0xFF00FF00) | ((Pixel & 0x000000FF) << 16) | ((Pixel & 0x00FF0000) >> 16);
+	}
+}
+
+#if defined(SIMD_X86)
+
+// 48 bytes hold 16 pixels, 2 of them straddle the 16 byte registers, all 3 loads come before the stores so that
+// the stores never have to be forwarded
+
+SIMD_TARGET("ssse3") static void SwapRedBlueRow24SSSE3(BYTE *Row, int Width)
+{
+	__m128i ShuffleA = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, -1);
+	__m128i ShuffleBA = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1);
+	__m128i ShuffleB = _mm_setr_epi8(0, -1, 4, 3, 2, 7, 6, 5, 10, 9, 8, 13, 12, 11, -1, 15);
+	__m128i ShuffleAB = _mm_setr_epi8(-1, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	__m128i ShuffleCB = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, -1);
+	__m128i ShuffleC = _mm_setr_epi8(-1, 3, 2, 1, 6, 5, 4, 9, 8, 7, 12, 11, 10, 15, 14, 13);
+	__m128i ShuffleBC = _mm_setr_epi8(14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	int x = 0;
+
+	for(; x + 16 <= Width; x += 16)
+	{
+		__m128i *Pixels = (__m128i*)(Row + x * 3);
+
+		__m128i A = _mm_loadu_si128(Pixels);
+		__m128i B = _mm_loadu_si128(Pixels + 1);
+		__m128i C = _mm_loadu_si128(Pixels + 2);
+
+		_mm_storeu_si128(Pixels, _mm_or_si128(_mm_shuffle_epi8(A, ShuffleA), _mm_shuffle_epi8(B, ShuffleBA)));
+		_mm_storeu_si128(Pixels + 1, _mm_or_si128(_mm_shuffle_epi8(B, ShuffleB), _mm_or_si128(_mm_shuffle_epi8(A, ShuffleAB), _mm_shuffle_epi8(C, ShuffleCB))));
+		_mm_storeu_si128(Pixels + 2, _mm_or_si128(_mm_shuffle_epi8(C, ShuffleC), _mm_shuffle_epi8(B, ShuffleBC)));
+	}
+
+	SwapRedBlueRow24(Row, x, Width);
+}
+
+SIMD_TARGET("ssse3") static void SwapRedBlueRow32SSSE3(BYTE *Row, int Width)
+{
+	__m128i Shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	int x = 0;
+
+	for(; x + 4 <= Width; x += 4)
+	{
+		__m128i Pixels = _mm_loadu_si128((__m128i*)(Row + x * 4));
+		_mm_storeu_si128((__m128i*)(Row + x * 4), _mm_shuffle_epi8(Pixels, Shuffle));
+	}
+
+	SwapRedBlueRow32(Row, x, Width);
+}
+
+SIMD_TARGET("avx2") static void SwapRedBlueRow32AVX2(BYTE *Row, int Width)
+{
+	__m256i Shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	int x = 0;
+
+	for(; x + 8 <= Width; x += 8)
+	{
+		__m256i Pixels = _mm256_loadu_si256((__m256i*)(Row + x * 4));
+		_mm256_storeu_si256((__m256i*)(Row + x * 4), _mm256_shuffle_epi8(Pixels, Shuffle));
+	}
+
+	SwapRedBlueRow32(Row, x, Width);
+}
+
+#elif defined(SIMD_NEON)
+
+static void SwapRedBlueRow24NEON(BYTE *Row, int Width)
+{
+	int x = 0;
+
+	for(; x + 16 <= Width; x += 16)
+	{
+		uint8x16x3_t Pixels = vld3q_u8(Row + x * 3);
+		uint8x16_t Temp = Pixels.val[0];
+		Pixels.val[0] = Pixels.val[2];
+		Pixels.val[2] = Temp;
+		vst3q_u8(Row + x * 3, Pixels);
+	}
+
+	SwapRedBlueRow24(Row, x, Width);
+}
+
+static void SwapRedBlueRow32NEON(BYTE *Row, int Width)
+{
+	int x = 0;
+
+	for(; x + 16 <= Width; x += 16)
+	{
+		uint8x16x4_t Pixels = vld4q_u8(Row + x * 4);
+		uint8x16_t Temp = Pixels.val[0];
+		Pixels.val[0] = Pixels.val[2];
+		Pixels.val[2] = Temp;
+		vst4q_u8(Row + x * 4, Pixels);
+	}
+
+	SwapRedBlueRow32(Row, x, Width);
+}
+
+#endif
+
+static void SwapRedBlueRow(BYTE *Row, int Width, int BytesPerPixel)
+{
+#if defined(SIMD_X86)
+	if(BytesPerPixel == 4 && CPUFeatures.AVX2) { SwapRedBlueRow32AVX2(Row, Width); return; }
+	if(BytesPerPixel == 4 && CPUFeatures.SSSE3) { SwapRedBlueRow32SSSE3(Row, Width); return; }
+	if(BytesPerPixel == 3 && CPUFeatures.SSSE3) { SwapRedBlueRow24SSSE3(Row, Width); return; }
+#elif defined(SIMD_NEON)
+	if(BytesPerPixel == 4 && CPUFeatures.NEON) { SwapRedBlueRow32NEON(Row, Width); return; }
+	if(BytesPerPixel == 3 && CPUFeatures.NEON) { SwapRedBlueRow24NEON(Row, Width); return; }
+#endif
+
+	if(BytesPerPixel == 4) SwapRedBlueRow32(Row, 0, Width);
+	else SwapRedBlueRow24(Row, 0, Width);
+}
+
+void SwapRedBlue(BYTE *Data, int Width, int Height, int Pitch, int BytesPerPixel)
+{
+	ThreadPool.ParallelFor(Height, GetRowsGrain(Width, BytesPerPixel), [=](int Begin, int End)
+	{
+		for(int y = Begin; y < End; y++)
+		{
+			SwapRedBlueRow(Data + y * Pitch, Width, BytesPerPixel);
+		}
+	});
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static bool IsOpaqueRow(const BYTE *Row, int Begin, int End)
+{
+	BYTE Alpha = 255;
+
+	for(int x = Begin; x < End; x++)
+	{
+		Alpha &= Row[x * 4 + 3];
+	}
+
+	return Alpha == 255;
+}
+
+#if defined(SIMD_X86)
+
+SIMD_TARGET("sse2") static bool IsOpaqueRowSSE2(const BYTE *Row, int Width)
+{
+	__m128i Alpha = _mm_set1_epi32(0xFF000000), And = _mm_set1_epi32(-1);
+
+	int x = 0;
+
+	for(; x + 4 <= Width; x += 4)
+	{
+		And = _mm_and_si128(And, _mm_loadu_si128((__m128i*)(Row + x * 4)));
+	}
+
+	return _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(And, Alpha), Alpha)) == 0xFFFF && IsOpaqueRow(Row, x, Width);
+}
+
+SIMD_TARGET("avx2") static bool IsOpaqueRowAVX2(const BYTE *Row, int Width)
+{
+	__m256i Alpha = _mm256_set1_epi32(0xFF000000), And = _mm256_set1_epi32(-1);
+
+	int x = 0;
+
+	for(; x + 8 <= Width; x += 8)
+	{
+		And = _mm256_and_si256(And, _mm256_loadu_si256((__m256i*)(Row + x * 4)));
+	}
+
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(And, Alpha), Alpha)) == -1 && IsOpaqueRow(Row, x, Width);
+}
+
+#endif
+
+bool IsOpaque(const BYTE *Data, int Width, int Height, int Pitch)
+{
+	std::atomic<bool> Opaque(true);
+
+	ThreadPool.ParallelFor(Height, GetRowsGrain(Width, 4), [&](int Begin, int End)
+	{
+		for(int y = Begin; y < End && Opaque; y++)
+		{
+			const BYTE *Row = Data + y * Pitch;
+
+#if defined(SIMD_X86)
+			bool RowOpaque = CPUFeatures.AVX2 ? IsOpaqueRowAVX2(Row, Width) : CPUFeatures.SSE2 ? IsOpaqueRowSSE2(Row, Width) : IsOpaqueRow(Row, 0, Width);
+#else
+			bool RowOpaque = IsOpaqueRow(Row, 0, Width);
+#endif
+
+			if(!RowOpaque) Opaque = false;
+		}
+	});
+
+	return Opaque;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// 5 and 6 bit channels are widened by replicating their high bits, so 0 maps to 0 and the maximum to 255
+
+static void Expand16Row(const WORD *Source, BYTE *Destination, int Begin, int End, bool R565, bool BGR)
+{
+	for(int x = Begin; x < End; x++)
+	{
+		WORD Pixel = Source[x];
+
+		int r = R565 ? Pixel >> 11 : (Pixel >> 10) & 31;
+		int g = R565 ? (Pixel >> 5) & 63 : (Pixel >> 5) & 31;
+		int b = Pixel & 31;
+
+		r = (r << 3) | (r >> 2);
+		g = R565 ? (g << 2) | (g >> 4) : (g << 3) | (g >> 2);
+		b = (b << 3) | (b >> 2);
+
+		BYTE *Texel = Destination + x * 4;
+
+		Texel[0] = (BYTE)(BGR ? b : r);
+		Texel[1] = (BYTE)g;
+		Texel[2] = (BYTE)(BGR ? r : b);
+		Texel[3] = 255;
+	}
+}
+
+#if defined(SIMD_X86)
+
+SIMD_TARGET("sse2") static void Expand16RowSSE2(const WORD *Source, BYTE *Destination, int Width, bool R565, bool BGR)
+{
+	__m128i Mask5 = _mm_set1_epi16(31), Mask6 = _mm_set1_epi16(63), Alpha = _mm_set1_epi16((short)0xFF00);
+
+	int x = 0;
+
+	for(; x + 8 <= Width; x += 8)
+	{
+		__m128i Pixels = _mm_loadu_si128((__m128i*)(Source + x));
+		__m128i r, g, b;
+
+		if(R565)
+		{
+			r = _mm_srli_epi16(Pixels, 11);
+			g = _mm_and_si128(_mm_srli_epi16(Pixels, 5), Mask6);
+			g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+		}
+		else
+		{
+			r = _mm_and_si128(_mm_srli_epi16(Pixels, 10), Mask5);
+			g = _mm_and_si128(_mm_srli_epi16(Pixels, 5), Mask5);
+			g = _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2));
+		}
+
+		b = _mm_and_si128(Pixels, Mask5);
+
+		r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+		b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+		// 16 bit lanes of the first two and of the last two bytes of each texel, interleaved into 32 bit texels
+
+		__m128i Low = _mm_or_si128(BGR ? b : r, _mm_slli_epi16(g, 8));
+		__m128i High = _mm_or_si128(BGR ? r : b, Alpha);
+
+		_mm_storeu_si128((__m128i*)(Destination + x * 4), _mm_unpacklo_epi16(Low, High));
+		_mm_storeu_si128((__m128i*)(Destination + x * 4 + 16), _mm_unpackhi_epi16(Low, High));
+	}
+
+	Expand16Row(Source, Destination, x, Width, R565, BGR);
+}
+
+#endif
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CPixelConverter::CPixelConverter()
+{
+	cdib = NULL;
+	Data = Buffer = NULL;
+	Width = Height = Pitch = 0;
+	memset(&PixelFormat, 0, sizeof(PixelFormat));
+}
+
+CPixelConverter::~CPixelConverter()
+{
+	Destroy();
+}
+
+bool CPixelConverter::Convert(FIBITMAP *dib, const CPixelFormatCaps &Caps, CString &Errors)
+{
+	Destroy();
+
+	FREE_IMAGE_TYPE Type = FreeImage_GetImageType(dib);
+
+	// types without a matching texture format are scaled to 8 bit grey, float colors without float textures are tone mapped
+
+	bool Standard = Type == FIT_INT16 || Type == FIT_UINT32 || Type == FIT_INT32 || Type == FIT_DOUBLE || Type == FIT_COMPLEX || (Type == FIT_FLOAT && !Caps.TextureFloat);
+	bool ToneMap = (Type == FIT_RGBF || Type == FIT_RGBAF) && !Caps.TextureFloat;
+
+	if(Standard || ToneMap)
+	{
+		cdib = Standard ? FreeImage_ConvertToStandardType(dib, TRUE) : FreeImage_ToneMapping(dib, FITMO_DRAGO03);
+
+		if(cdib == NULL)
+		{
+			Errors.Append("Converting image type %d failed", Type);
+			return false;
+		}
+
+		dib = cdib;
+		Type = FreeImage_GetImageType(dib);
+	}
+
+	Width = FreeImage_GetWidth(dib);
+	Height = FreeImage_GetHeight(dib);
+	Pitch = FreeImage_GetPitch(dib);
+	Data = FreeImage_GetBits(dib);
+
+	memset(&PixelFormat, 0, sizeof(PixelFormat));
+
+	PixelFormat.Opaque = true;
+
+	bool Converted = true;
+
+	switch(Type)
+	{
+		case FIT_BITMAP:
+			Converted = ConvertBitmap(Caps, dib);
+			break;
+
+		case FIT_UINT16:
+			SetGreyFormat(Caps, GL_R16, GL_LUMINANCE16, GL_UNSIGNED_SHORT, 2);
+			break;
+
+		case FIT_FLOAT:
+			SetGreyFormat(Caps, GL_R32F, GL_LUMINANCE32F_ARB, GL_FLOAT, 4);
+			break;
+
+		case FIT_RGB16:
+			SetFormat(GL_RGB16, GL_RGB, GL_UNSIGNED_SHORT, 0, 6);
+			break;
+
+		case FIT_RGBA16:
+			SetFormat(GL_RGBA16, GL_RGBA, GL_UNSIGNED_SHORT, 0, 8);
+			PixelFormat.Opaque = false;
+			break;
+
+		case FIT_RGBF:
+			SetFormat(GL_RGB32F, GL_RGB, GL_FLOAT, 0, 12);
+			break;
+
+		case FIT_RGBAF:
+			SetFormat(GL_RGBA32F, GL_RGBA, GL_FLOAT, 0, 16);
+			PixelFormat.Opaque = false;
+			break;
+
+		default:
+			Converted = false;
+	}
+
+	if(!Converted)
+	{
+		Errors.Append("Unsupported image type %d with %d bits per pixel", Type, FreeImage_GetBPP(dib));
+		Destroy();
+		return false;
+	}
+
+	return true;
+}
+
+// only for 8 bit per channel formats, the rows are replaced by rows of the new size in a new buffer
+
+bool CPixelConverter::Resample(int Width, int Height, RESAMPLE_FILTER Filter)
+{
+	if(PixelFormat.Channels == 0 || Data == NULL)
+	{
+		return false;
+	}
+
+	int NewPitch = (Width * PixelFormat.BytesPerPixel + 3) & ~3;
+	BYTE *NewBuffer = new BYTE[NewPitch * Height];
+
+	if(!ResampleImage(Data, this->Width, this->Height, Pitch, NewBuffer, Width, Height, NewPitch, PixelFormat.Channels, Filter))
+	{
+		delete [] NewBuffer;
+		return false;
+	}
+
+	if(cdib)
+	{
+		FreeImage_Unload(cdib);
+		cdib = NULL;
+	}
+
+	delete [] Buffer;
+
+	Data = Buffer = NewBuffer;
+	this->Width = Width;
+	this->Height = Height;
+	Pitch = NewPitch;
+
+	return true;
+}
+
+void CPixelConverter::Destroy()
+{
+	if(cdib)
+	{
+		FreeImage_Unload(cdib);
+	}
+
+	delete [] Buffer;
+
+	cdib = NULL;
+	Data = Buffer = NULL;
+	Width = Height = Pitch = 0;
+}
+
+bool CPixelConverter::ConvertBitmap(const CPixelFormatCaps &Caps, FIBITMAP *dib)
+{
+	int BPP = FreeImage_GetBPP(dib);
+
+	if(BPP == 1 || BPP == 4 || BPP == 8)
+	{
+		ConvertPalettized(Caps, dib);
+		return true;
+	}
+
+	if(BPP == 16)
+	{
+		Convert16Bits(Caps, dib);
+		return true;
+	}
+
+	if(BPP == 24)
+	{
+		SetFormat(GL_RGB8, Caps.BGR ? GL_BGR : GL_RGB, GL_UNSIGNED_BYTE, 3, 3);
+	}
+	else if(BPP == 32)
+	{
+		PixelFormat.Opaque = IsOpaque(Data, Width, Height, Pitch);
+
+		SetFormat(PixelFormat.Opaque ? GL_RGB8 : GL_RGBA8, Caps.BGR ? GL_BGRA : GL_RGBA, GL_UNSIGNED_BYTE, 4, 4);
+	}
+	else
+	{
+		return false;
+	}
+
+	if(!Caps.BGR)
+	{
+		SwapRedBlue(Data, Width, Height, Pitch, BPP / 8);
+	}
+
+	return true;
+}
+
+void CPixelConverter::ConvertPalettized(const CPixelFormatCaps &Caps, FIBITMAP *dib)
+{
+	int BPP = FreeImage_GetBPP(dib);
+
+	RGBQUAD *Palette = FreeImage_GetPalette(dib);
+	int Colors = FreeImage_GetColorsUsed(dib);
+
+	BYTE *Transparency = FreeImage_IsTransparent(dib) ? FreeImage_GetTransparencyTable(dib) : NULL;
+	int TransparencyCount = Transparency ? FreeImage_GetTransparencyCount(dib) : 0;
+
+	bool Grey = true, Identity = BPP == 8 && Colors == 256;
+
+	for(int i = 0; i < Colors; i++)
+	{
+		Grey &= Palette[i].rgbRed == Palette[i].rgbGreen && Palette[i].rgbGreen == Palette[i].rgbBlue;
+		Identity &= Palette[i].rgbRed == i;
+	}
+
+	for(int i = 0; i < TransparencyCount; i++)
+	{
+		PixelFormat.Opaque &= Transparency[i] == 255;
+	}
+
+	// 8 bit grey images come with an identity ramp as palette and are used as they are
+
+	int Channels;
+
+	if(Grey && PixelFormat.Opaque && ((Caps.TextureRG && Caps.TextureSwizzle) || Caps.Luminance))
+	{
+		SetGreyFormat(Caps, GL_R8, GL_LUMINANCE8, GL_UNSIGNED_BYTE, 1);
+		Channels = 1;
+
+		if(Identity) return;
+	}
+	else
+	{
+		Channels = PixelFormat.Opaque ? 3 : 4;
+
+		SetFormat(PixelFormat.Opaque ? GL_RGB8 : GL_RGBA8, Caps.BGR ? (Channels == 3 ? GL_BGR : GL_BGRA) : (Channels == 3 ? GL_RGB : GL_RGBA), GL_UNSIGNED_BYTE, Channels, Channels);
+	}
+
+	BYTE Table[256][4];
+
+	memset(Table, 0, sizeof(Table));
+
+	for(int i = 0; i < Colors && i < 256; i++)
+	{
+		if(Channels == 1)
+		{
+			Table[i][0] = Palette[i].rgbRed;
+			continue;
+		}
+
+		Table[i][0] = Caps.BGR ? Palette[i].rgbBlue : Palette[i].rgbRed;
+		Table[i][1] = Palette[i].rgbGreen;
+		Table[i][2] = Caps.BGR ? Palette[i].rgbRed : Palette[i].rgbBlue;
+		Table[i][3] = i < TransparencyCount ? Transparency[i] : 255;
+	}
+
+	BYTE *Source = Data;
+	int SourcePitch = Pitch;
+
+	AllocateBuffer(Channels);
+
+	ThreadPool.ParallelFor(Height, GetRowsGrain(Width, Channels), [&](int Begin, int End)
+	{
+		for(int y = Begin; y < End; y++)
+		{
+			const BYTE *Indices = Source + y * SourcePitch;
+			BYTE *Destination = Data + y * Pitch;
+
+			for(int x = 0; x < Width; x++, Destination += Channels)
+			{
+				int Index;
+
+				if(BPP == 8) Index = Indices[x];
+				else if(BPP == 4) Index = (Indices[x >> 1] >> ((x & 1) ? 0 : 4)) & 15;
+				else Index = (Indices[x >> 3] >> (7 - (x & 7))) & 1;
+
+				for(int c = 0; c < Channels; c++)
+				{
+					Destination[c] = Table[Index][c];
+				}
+			}
+		}
+	});
+}
+
+void CPixelConverter::Convert16Bits(const CPixelFormatCaps &Caps, FIBITMAP *dib)
+{
+	bool R565 = FreeImage_GetGreenMask(dib) == FI16_565_GREEN_MASK;
+	bool BGR = Caps.BGR;
+
+	SetFormat(R565 ? (Caps.RGB565 ? GL_RGB565 : GL_RGB8) : GL_RGB5, BGR ? GL_BGRA : GL_RGBA, GL_UNSIGNED_BYTE, 4, 4);
+
+	BYTE *Source = Data;
+	int SourcePitch = Pitch;
+
+	AllocateBuffer(4);
+
+	ThreadPool.ParallelFor(Height, GetRowsGrain(Width, 4), [&](int Begin, int End)
+	{
+		for(int y = Begin; y < End; y++)
+		{
+			const WORD *Pixels = (const WORD*)(Source + y * SourcePitch);
+			BYTE *Destination = Data + y * Pitch;
+
+#if defined(SIMD_X86)
+			if(CPUFeatures.SSE2) Expand16RowSSE2(Pixels, Destination, Width, R565, BGR);
+			else Expand16Row(Pixels, Destination, 0, Width, R565, BGR);
+#else
+			Expand16Row(Pixels, Destination, 0, Width, R565, BGR);
+#endif
+		}
+	});
+}
+
+// single channel data is read as (r, r, r, 1) either through the swizzle or the legacy luminance formats, without
+// both it is expanded to three channels
+
+void CPixelConverter::SetGreyFormat(const CPixelFormatCaps &Caps, GLenum R, GLenum Luminance, GLenum Type, int BytesPerPixel)
+{
+	int Channels = Type == GL_UNSIGNED_BYTE ? 1 : 0;
+
+	if(Caps.TextureRG && Caps.TextureSwizzle)
+	{
+		SetFormat(R, GL_RED, Type, Channels, BytesPerPixel);
+		PixelFormat.Grey = true;
+		return;
+	}
+
+	if(Caps.Luminance)
+	{
+		SetFormat(Luminance, GL_LUMINANCE, Type, Channels, BytesPerPixel);
+		return;
+	}
+
+	GLenum InternalFormat = Type == GL_FLOAT ? GL_RGB32F : Type == GL_UNSIGNED_SHORT ? GL_RGB16 : GL_RGB8;
+
+	SetFormat(InternalFormat, GL_RGB, Type, Channels * 3, BytesPerPixel * 3);
+
+	BYTE *Source = Data;
+	int SourcePitch = Pitch;
+
+	AllocateBuffer(BytesPerPixel * 3);
+
+	ThreadPool.ParallelFor(Height, GetRowsGrain(Width, BytesPerPixel * 3), [&](int Begin, int End)
+	{
+		for(int y = Begin; y < End; y++)
+		{
+			const BYTE *Texel = Source + y * SourcePitch;
+			BYTE *Destination = Data + y * Pitch;
+
+			for(int x = 0; x < Width; x++, Texel += BytesPerPixel)
+			{
+				for(int c = 0; c < 3; c++, Destination += BytesPerPixel)
+				{
+					memcpy(Destination, Texel, BytesPerPixel);
+				}
+			}
+		}
+	});
+}
+
+void CPixelConverter::SetFormat(GLenum InternalFormat, GLenum Format, GLenum Type, int Channels, int BytesPerPixel)
+{
+	PixelFormat.InternalFormat = InternalFormat;
+	PixelFormat.Format = Format;
+	PixelFormat.Type = Type;
+	PixelFormat.Channels = Channels;
+	PixelFormat.BytesPerPixel = BytesPerPixel;
+}
+
+void CPixelConverter::AllocateBuffer(int BytesPerPixel)
+{
+	Pitch = (Width * BytesPerPixel + 3) & ~3;
+	Buffer = new BYTE[Pitch * Height];
+	Data = Buffer;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+int GetInternalFormatBits(GLenum InternalFormat)
+{
+	switch(InternalFormat)
+	{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT: case GL_COMPRESSED_RED_RGTC1: return 4;
+		case GL_R8: case GL_LUMINANCE8: case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: case GL_COMPRESSED_RG_RGTC2: case GL_COMPRESSED_RGBA_BPTC_UNORM: case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM: return 8;
+		case GL_R16: case GL_LUMINANCE16: case GL_RGB5: case GL_RGB565: return 16;
+		case GL_R32F: case GL_LUMINANCE32F_ARB: return 32;
+		case GL_RGB16: case GL_RGBA16: return 64;
+		case GL_RGB32F: case GL_RGBA32F: return 128;
+	}
+
+	// GPUs pad 24 bit texels to 32 bits
+
+	return 32;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CPixelFormatCaps PixelFormatCaps;
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "platform.h"
+#include "resample.h"
+#include "string.h"
+
+#include <GL/glew.h>
+#include <FreeImage.h>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CPixelFormatCaps
+{
+public:
+	bool BGR, TextureRG, TextureSwizzle, Luminance, TextureFloat, RGB565, S3TC, S3TCsRGB, RGTC, BPTC;
+
+public:
+	CPixelFormatCaps();
+
+	void Init();
+};
+
+extern CPixelFormatCaps PixelFormatCaps;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the upload layout of an image; Channels counts 8 bit channels and is 0 for 16 bit and float data, Grey single channel
+// textures have to be sampled as (r, r, r, 1) through GL_TEXTURE_SWIZZLE_RGBA
+
+struct CPixelFormat
+{
+	GLenum InternalFormat, Format, Type;
+	int Channels, BytesPerPixel;
+	bool Grey, Opaque;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// converts any FreeImage bitmap into rows glTexImage2D can take, picking the narrowest internal format that keeps the
+// data; 8, 24 and 32 bit and 16 bit per channel and float images are used in place, the rest goes to a new buffer,
+// cdib holds the bitmap FreeImage converts types without a texture format to
+
+class CPixelConverter
+{
+public:
+	FIBITMAP *cdib;
+	BYTE *Data, *Buffer;
+	int Width, Height, Pitch;
+	CPixelFormat PixelFormat;
+
+public:
+	CPixelConverter();
+	~CPixelConverter();
+
+	bool Convert(FIBITMAP *dib, const CPixelFormatCaps &Caps, CString &Errors);
+	bool Resample(int Width, int Height, RESAMPLE_FILTER Filter);
+	void Destroy();
+
+protected:
+	bool ConvertBitmap(const CPixelFormatCaps &Caps, FIBITMAP *dib);
+	void ConvertPalettized(const CPixelFormatCaps &Caps, FIBITMAP *dib);
+	void Convert16Bits(const CPixelFormatCaps &Caps, FIBITMAP *dib);
+	void SetGreyFormat(const CPixelFormatCaps &Caps, GLenum R, GLenum Luminance, GLenum Type, int BytesPerPixel);
+	void SetFormat(GLenum InternalFormat, GLenum Format, GLenum Type, int Channels, int BytesPerPixel);
+	void AllocateBuffer(int BytesPerPixel);
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+void SwapRedBlue(BYTE *Data, int Width, int Height, int Pitch, int BytesPerPixel);
+bool IsOpaque(const BYTE *Data, int Width, int Height, int Pitch);
+int GetInternalFormatBits(GLenum InternalFormat);
@@ -0,0 +1,218 @@
+#include "platform.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+double GetTime()
+{
+#ifdef _WIN32
+
+	static LARGE_INTEGER Frequency = {0};
+
+	if(Frequency.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&Frequency);
+	}
+
+	LARGE_INTEGER Counter;
+
+	QueryPerformanceCounter(&Counter);
+
+	return (double)Counter.QuadPart / (double)Frequency.QuadPart;
+
+#else
+
+	timespec Time;
+
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+
+	return (double)Time.tv_sec + (double)Time.tv_nsec * 0.000000001;
+
+#endif
+}
+
+void GetModuleDirectory(char *ModuleDirectory, int Size)
+{
+#ifdef _WIN32
+
+	GetModuleFileName(GetModuleHandle(NULL), ModuleDirectory, Size);
+
+	char *Separator = strrchr(ModuleDirectory, '\\');
+
+#else
+
+	int Length = (int)readlink("/proc/self/exe", ModuleDirectory, Size - 1);
+
+	ModuleDirectory[Length > 0 ? Length : 0] = 0;
+
+	char *Separator = strrchr(ModuleDirectory, '/');
+
+#endif
+
+	if(Separator)
+	{
+		*(Separator + 1) = 0;
+	}
+	else
+	{
+		ModuleDirectory[0] = 0;
+	}
+}
+
+// true if the directory exists afterwards
+
+bool MakeDirectory(const char *Directory)
+{
+#ifdef _WIN32
+
+	return CreateDirectory(Directory, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+
+#else
+
+	return mkdir(Directory, 0755) == 0 || errno == EEXIST;
+
+#endif
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CMappedFile::CMappedFile()
+{
+	Data = NULL;
+	Size = 0;
+
+#ifdef _WIN32
+	File = INVALID_HANDLE_VALUE;
+	Mapping = NULL;
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+bool CMappedFile::Open(const char *FileName)
+{
+	Close();
+
+#ifdef _WIN32
+
+	File = CreateFile(FileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	LARGE_INTEGER FileSize;
+
+	if(File == INVALID_HANDLE_VALUE || !GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	Mapping = CreateFileMapping(File, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if(Mapping != NULL)
+	{
+		Data = (const BYTE*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+
+	if(Data == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	Size = (size_t)FileSize.QuadPart;
+
+#else
+
+	int File = open(FileName, O_RDONLY);
+
+	if(File == -1)
+	{
+		return false;
+	}
+
+	struct stat Stat;
+
+	if(fstat(File, &Stat) == 0 && Stat.st_size > 0)
+	{
+		void *Mapped = mmap(NULL, (size_t)Stat.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+
+		if(Mapped != MAP_FAILED)
+		{
+			Data = (const BYTE*)Mapped;
+			Size = (size_t)Stat.st_size;
+		}
+	}
+
+	// the mapping keeps its own reference to the file
+
+	close(File);
+
+	if(Data == NULL)
+	{
+		return false;
+	}
+
+#endif
+
+	return true;
+}
+
+// faults the pages in on the calling thread so whoever reads Data later does not wait for the disk, the range is
+// clamped to the file
+
+void CMappedFile::Prefetch(size_t Offset, size_t Size)
+{
+	if(Offset >= this->Size)
+	{
+		return;
+	}
+
+	if(Size > this->Size - Offset)
+	{
+		Size = this->Size - Offset;
+	}
+
+#ifndef _WIN32
+	size_t Page = Offset & ~(size_t)4095;
+	madvise((void*)(Data + Page), Size + Offset - Page, MADV_WILLNEED);
+#endif
+
+	volatile BYTE Sum = 0;
+
+	for(size_t i = 0; i < Size; i += 4096)
+	{
+		Sum = (BYTE)(Sum + Data[Offset + i]);
+	}
+
+	Sum = (BYTE)(Sum + Data[Offset + Size - 1]);
+}
+
+void CMappedFile::Close()
+{
+#ifdef _WIN32
+
+	if(Data) UnmapViewOfFile(Data);
+	if(Mapping) CloseHandle(Mapping);
+	if(File != INVALID_HANDLE_VALUE) CloseHandle(File);
+
+	File = INVALID_HANDLE_VALUE;
+	Mapping = NULL;
+
+#else
+
+	if(Data) munmap((void*)Data, Size);
+
+#endif
+
+	Data = NULL;
+	Size = 0;
+}
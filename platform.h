@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#else
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+typedef int32_t BOOL;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef unsigned int UINT;
+
+#define VK_SPACE 0x20
+#define VK_ESCAPE 0x1B
+#define VK_F1 0x70
+#define VK_F2 0x71
+#define VK_F3 0x72
+#define VK_F4 0x73
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+inline int fopen_s(FILE **File, const char *FileName, const char *Mode)
+{
+	*File = fopen(FileName, Mode);
+	return *File == NULL ? errno : 0;
+}
+
+#define sscanf_s sscanf
+
+#endif
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+double GetTime();
+void GetModuleDirectory(char *ModuleDirectory, int Size);
+bool MakeDirectory(const char *Directory);
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// a read only view of a whole file, Data stays valid until Close
+
+class CMappedFile
+{
+public:
+	const BYTE *Data;
+	size_t Size;
+
+#ifdef _WIN32
+protected:
+	HANDLE File, Mapping;
+#endif
+
+public:
+	CMappedFile();
+	~CMappedFile();
+
+	bool Open(const char *FileName);
+	void Prefetch(size_t Offset = 0, size_t Size = (size_t)-1);
+	void Close();
+};
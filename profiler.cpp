@@ -0,0 +1,324 @@
+#include "profiler.h"
+
+#include <atomic>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static std::atomic<int> NextThreadID(1);
+static thread_local int ThreadID = 0, ThreadDepth = 0;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CProfiler::CProfiler()
+{
+	StartTime = GPUTimeBase = 0.0;
+	TimeStamps = TimeElapsed = false;
+	GPUDepth = 0;
+	MaxEvents = 1 << 20;
+
+	Enabled = false;
+	Generation = 0;
+}
+
+CProfiler::~CProfiler()
+{
+}
+
+void CProfiler::Init()
+{
+	TimeStamps = GLEW_ARB_timer_query != 0;
+	TimeElapsed = TimeStamps || GLEW_EXT_timer_query != 0;
+
+	if(TimeStamps)
+	{
+		GLint64 GPUTime = 0;
+		glGetInteger64v(GL_TIMESTAMP, &GPUTime);
+		GPUTimeBase = GetTime() - (double)GPUTime * 0.000000001;
+	}
+}
+
+void CProfiler::Start()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	Events.clear();
+	Generation++;
+
+	StartTime = GetTime();
+
+	Enabled = true;
+}
+
+void CProfiler::Stop()
+{
+	Enabled = false;
+}
+
+void CProfiler::EndFrame()
+{
+	if(GPUQueries.size() > 0 && GPUDepth == 0)
+	{
+		ResolveGPUQueries(false);
+	}
+}
+
+bool CProfiler::Save(char *FileName)
+{
+	if(GPUDepth == 0)
+	{
+		ResolveGPUQueries(true);
+	}
+
+	FILE *File;
+
+	if(fopen_s(&File, FileName, "wt") != 0)
+	{
+		ErrorLog.Append("Error saving file %s!\r\n", FileName);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	fprintf(File, "{\"traceEvents\":[\n");
+	fprintf(File, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}");
+
+	for(size_t i = 0; i < Events.size(); i++)
+	{
+		CProfilerEvent &Event = Events[i];
+
+		if(Event.Duration < 0.0) continue;
+
+		fprintf(File, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", Event.Name, Event.ThreadID, (Event.Begin - StartTime) * 1000000.0, Event.Duration * 1000000.0);
+	}
+
+	fprintf(File, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	fclose(File);
+
+	Events.clear();
+	Generation++;
+
+	StartTime = GetTime();
+
+	return true;
+}
+
+void CProfiler::Destroy()
+{
+	Enabled = false;
+
+	for(size_t i = 0; i < GPUQueries.size(); i++)
+	{
+		glDeleteQueries(TimeStamps ? 2 : 1, GPUQueries[i].Queries);
+	}
+
+	if(FreeQueries.size() > 0)
+	{
+		glDeleteQueries((GLsizei)FreeQueries.size(), &FreeQueries[0]);
+	}
+
+	GPUQueries.clear();
+	FreeQueries.clear();
+}
+
+int CProfiler::BeginZone(const char *Name)
+{
+	if(!Enabled) return -1;
+
+	if(ThreadID == 0)
+	{
+		ThreadID = NextThreadID++;
+	}
+
+	CProfilerEvent Event;
+
+	Event.Name = Name;
+	Event.Begin = GetTime();
+	Event.Duration = -1.0;
+	Event.ThreadID = ThreadID;
+	Event.Depth = ThreadDepth++;
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	if((int)Events.size() >= MaxEvents)
+	{
+		ThreadDepth--;
+		return -1;
+	}
+
+	Events.push_back(Event);
+
+	return (int)Events.size() - 1;
+}
+
+void CProfiler::EndZone(int Zone, int Generation)
+{
+	double End = GetTime();
+
+	ThreadDepth--;
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	if(Generation == this->Generation && Zone < (int)Events.size())
+	{
+		Events[Zone].Duration = End - Events[Zone].Begin;
+	}
+}
+
+int CProfiler::BeginGPUZone(const char *Name)
+{
+	if(!Enabled || !TimeElapsed) return -1;
+
+	// GL_TIME_ELAPSED queries cannot be nested, only timestamps can
+
+	if(!TimeStamps && GPUDepth > 0) return -1;
+
+	CProfilerGPUQuery GPUQuery;
+
+	GPUQuery.Name = Name;
+	GPUQuery.Queries[0] = GetQuery();
+	GPUQuery.Queries[1] = TimeStamps ? GetQuery() : 0;
+	GPUQuery.CPUBegin = GetTime();
+	GPUQuery.Depth = GPUDepth++;
+	GPUQuery.Ended = false;
+
+	if(TimeStamps)
+	{
+		glQueryCounter(GPUQuery.Queries[0], GL_TIMESTAMP);
+	}
+	else
+	{
+		glBeginQuery(GL_TIME_ELAPSED_EXT, GPUQuery.Queries[0]);
+	}
+
+	GPUQueries.push_back(GPUQuery);
+
+	return (int)GPUQueries.size() - 1;
+}
+
+void CProfiler::EndGPUZone(int Zone)
+{
+	if(Zone >= (int)GPUQueries.size() || GPUQueries[Zone].Ended) return;
+
+	CProfilerGPUQuery &GPUQuery = GPUQueries[Zone];
+
+	if(TimeStamps)
+	{
+		glQueryCounter(GPUQuery.Queries[1], GL_TIMESTAMP);
+	}
+	else
+	{
+		glEndQuery(GL_TIME_ELAPSED_EXT);
+	}
+
+	GPUQuery.Ended = true;
+
+	GPUDepth--;
+}
+
+GLuint CProfiler::GetQuery()
+{
+	GLuint Query;
+
+	if(FreeQueries.size() > 0)
+	{
+		Query = FreeQueries.back();
+		FreeQueries.pop_back();
+	}
+	else
+	{
+		glGenQueries(1, &Query);
+	}
+
+	return Query;
+}
+
+void CProfiler::ResolveGPUQueries(bool Wait)
+{
+	size_t Pending = 0;
+
+	for(size_t i = 0; i < GPUQueries.size(); i++)
+	{
+		CProfilerGPUQuery &GPUQuery = GPUQueries[i];
+
+		GLuint LastQuery = GPUQuery.Queries[TimeStamps ? 1 : 0];
+		GLint Available = GL_FALSE;
+
+		if(GPUQuery.Ended && !Wait)
+		{
+			glGetQueryObjectiv(LastQuery, GL_QUERY_RESULT_AVAILABLE, &Available);
+		}
+
+		if(!GPUQuery.Ended || (!Wait && Available == GL_FALSE))
+		{
+			GPUQueries[Pending++] = GPUQuery;
+			continue;
+		}
+
+		CProfilerEvent Event;
+
+		Event.Name = GPUQuery.Name;
+		Event.ThreadID = 0;
+		Event.Depth = GPUQuery.Depth;
+
+		if(TimeStamps)
+		{
+			GLuint64 Begin = 0, End = 0;
+
+			glGetQueryObjectui64v(GPUQuery.Queries[0], GL_QUERY_RESULT, &Begin);
+			glGetQueryObjectui64v(GPUQuery.Queries[1], GL_QUERY_RESULT, &End);
+
+			Event.Begin = GPUTimeBase + (double)Begin * 0.000000001;
+			Event.Duration = (double)(End - Begin) * 0.000000001;
+
+			FreeQueries.push_back(GPUQuery.Queries[1]);
+		}
+		else
+		{
+			GLuint64EXT Elapsed = 0;
+
+			glGetQueryObjectui64vEXT(GPUQuery.Queries[0], GL_QUERY_RESULT, &Elapsed);
+
+			Event.Begin = GPUQuery.CPUBegin;
+			Event.Duration = (double)Elapsed * 0.000000001;
+		}
+
+		FreeQueries.push_back(GPUQuery.Queries[0]);
+
+		if(Enabled || Wait)
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+
+			if((int)Events.size() < MaxEvents)
+			{
+				Events.push_back(Event);
+			}
+		}
+	}
+
+	GPUQueries.resize(Pending);
+}
+
+CProfiler Profiler;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CProfilerScope::CProfilerScope(const char *Name, bool GPU)
+{
+	Generation = Profiler.Generation;
+	Zone = Profiler.BeginZone(Name);
+	GPUZone = GPU && Zone != -1 ? Profiler.BeginGPUZone(Name) : -1;
+}
+
+CProfilerScope::~CProfilerScope()
+{
+	if(GPUZone != -1)
+	{
+		Profiler.EndGPUZone(GPUZone);
+	}
+
+	if(Zone != -1)
+	{
+		Profiler.EndZone(Zone, Generation);
+	}
+}
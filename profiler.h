@@ -0,0 +1,84 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+#include <mutex>
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+struct CProfilerEvent
+{
+	const char *Name;
+	double Begin, Duration;
+	int ThreadID, Depth;
+};
+
+struct CProfilerGPUQuery
+{
+	const char *Name;
+	GLuint Queries[2];
+	double CPUBegin;
+	int Depth;
+	bool Ended;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CProfiler
+{
+protected:
+	std::mutex Mutex;
+	std::vector<CProfilerEvent> Events;
+	std::vector<CProfilerGPUQuery> GPUQueries;
+	std::vector<GLuint> FreeQueries;
+	double StartTime, GPUTimeBase;
+	bool TimeStamps, TimeElapsed;
+	int GPUDepth, MaxEvents;
+
+public:
+	bool Enabled;
+	int Generation;
+	CString TraceFileName;
+
+public:
+	CProfiler();
+	~CProfiler();
+
+	void Init();
+	void Start();
+	void Stop();
+	void EndFrame();
+	bool Save(char *FileName);
+	void Destroy();
+
+	int BeginZone(const char *Name);
+	void EndZone(int Zone, int Generation);
+	int BeginGPUZone(const char *Name);
+	void EndGPUZone(int Zone);
+
+protected:
+	GLuint GetQuery();
+	void ResolveGPUQueries(bool Wait);
+	int GetThreadID();
+};
+
+extern CProfiler Profiler;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CProfilerScope
+{
+protected:
+	int Zone, GPUZone, Generation;
+
+public:
+	CProfilerScope(const char *Name, bool GPU = false);
+	~CProfilerScope();
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#define PROFILE_ZONE(Name) CProfilerScope PROFILE_CONCAT(ProfilerScope, __LINE__)(Name)
+#define PROFILE_GPU_ZONE(Name) CProfilerScope PROFILE_CONCAT(ProfilerScope, __LINE__)(Name, true)
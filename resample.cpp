@@ -0,0 +1,509 @@
+#include "resample.h"
+#include "simd.h"
+#include "threadpool.h"
+
+#include "string.h"
+
+#include <math.h>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the contributions to each destination pixel along one axis; every destination pixel reads the same number of taps,
+// windows that would cross the edge are shifted inside and padded with zero weights, so the filter loops never clamp
+
+class CResampleWeights
+{
+public:
+	int Taps;
+	int *First;
+	float *Weights;
+
+public:
+	CResampleWeights();
+	~CResampleWeights();
+
+	void Compute(int SourceSize, int Size, RESAMPLE_FILTER Filter);
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+static double GetFilterSupport(RESAMPLE_FILTER Filter)
+{
+	switch(Filter)
+	{
+		case RESAMPLE_FILTER_BOX: return 0.5;
+		case RESAMPLE_FILTER_BILINEAR: return 1.0;
+		case RESAMPLE_FILTER_BICUBIC: return 2.0;
+		case RESAMPLE_FILTER_LANCZOS3: return 3.0;
+	}
+
+	return 1.0;
+}
+
+static double Sinc(double x)
+{
+	if(x == 0.0)
+	{
+		return 1.0;
+	}
+
+	x *= 3.14159265358979;
+
+	return sin(x) / x;
+}
+
+static double GetFilterWeight(RESAMPLE_FILTER Filter, double x)
+{
+	x = fabs(x);
+
+	switch(Filter)
+	{
+		case RESAMPLE_FILTER_BOX:
+			return x < 0.5 ? 1.0 : x == 0.5 ? 0.5 : 0.0;
+
+		case RESAMPLE_FILTER_BILINEAR:
+			return x < 1.0 ? 1.0 - x : 0.0;
+
+		case RESAMPLE_FILTER_BICUBIC:
+		{
+			const double B = 1.0 / 3.0, C = 1.0 / 3.0;
+
+			if(x < 1.0) return ((12.0 - 9.0 * B - 6.0 * C) * x * x * x + (-18.0 + 12.0 * B + 6.0 * C) * x * x + (6.0 - 2.0 * B)) / 6.0;
+			if(x < 2.0) return ((-B - 6.0 * C) * x * x * x + (6.0 * B + 30.0 * C) * x * x + (-12.0 * B - 48.0 * C) * x + (8.0 * B + 24.0 * C)) / 6.0;
+
+			return 0.0;
+		}
+
+		case RESAMPLE_FILTER_LANCZOS3:
+			return x < 3.0 ? Sinc(x) * Sinc(x / 3.0) : 0.0;
+	}
+
+	return 0.0;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CResampleWeights::CResampleWeights()
+{
+	Taps = 0;
+	First = NULL;
+	Weights = NULL;
+}
+
+CResampleWeights::~CResampleWeights()
+{
+	delete [] First;
+	delete [] Weights;
+}
+
+void CResampleWeights::Compute(int SourceSize, int Size, RESAMPLE_FILTER Filter)
+{
+	First = new int[Size];
+
+	if(Size == SourceSize)
+	{
+		Taps = 1;
+		Weights = new float[Size];
+
+		for(int i = 0; i < Size; i++)
+		{
+			First[i] = i;
+			Weights[i] = 1.0f;
+		}
+
+		return;
+	}
+
+	double Scale = (double)SourceSize / Size;
+	double FilterScale = Scale > 1.0 ? Scale : 1.0;
+	double Support = GetFilterSupport(Filter) * FilterScale;
+
+	int *Begin = new int[Size], *End = new int[Size];
+
+	Taps = 1;
+
+	for(int i = 0; i < Size; i++)
+	{
+		double Center = (i + 0.5) * Scale;
+
+		Begin[i] = (int)floor(Center - Support + 0.5);
+		End[i] = (int)floor(Center + Support + 0.5);
+
+		if(Begin[i] < 0) Begin[i] = 0;
+		if(End[i] > SourceSize) End[i] = SourceSize;
+		if(End[i] <= Begin[i]) End[i] = Begin[i] + 1;
+
+		if(End[i] - Begin[i] > Taps) Taps = End[i] - Begin[i];
+	}
+
+	Weights = new float[Size * Taps];
+
+	memset(Weights, 0, Size * Taps * sizeof(float));
+
+	for(int i = 0; i < Size; i++)
+	{
+		double Center = (i + 0.5) * Scale;
+
+		First[i] = Begin[i] < SourceSize - Taps ? Begin[i] : SourceSize - Taps;
+
+		float *TapWeights = Weights + i * Taps;
+
+		double Sum = 0.0;
+
+		for(int j = Begin[i]; j < End[i]; j++)
+		{
+			double Weight = GetFilterWeight(Filter, (j + 0.5 - Center) / FilterScale);
+
+			TapWeights[j - First[i]] = (float)Weight;
+			Sum += Weight;
+		}
+
+		if(Sum != 0.0)
+		{
+			for(int k = 0; k < Taps; k++)
+			{
+				TapWeights[k] = (float)(TapWeights[k] / Sum);
+			}
+		}
+		else
+		{
+			TapWeights[Begin[i] - First[i]] = 1.0f;
+		}
+	}
+
+	delete [] Begin;
+	delete [] End;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// rows are kept as 4 floats per pixel whatever the number of channels, 3 channel pixels are read and written 4 bytes at
+// a time and the extra byte belongs to the next pixel, so only the last pixel of a row needs the byte by byte path
+
+static void DecodeRow(const BYTE *Source, float *Row, int Width, int Channels)
+{
+	int x = 0;
+
+	if(Channels == 4)
+	{
+		for(; x < Width; x++)
+		{
+			Float4Store(Row + x * 4, Float4LoadBytes(Source + x * 4));
+		}
+	}
+	else if(Channels == 3)
+	{
+		for(; x < Width - 1; x++)
+		{
+			Float4Store(Row + x * 4, Float4LoadBytes(Source + x * 3));
+		}
+	}
+
+	for(; x < Width; x++)
+	{
+		for(int c = 0; c < 4; c++)
+		{
+			Row[x * 4 + c] = c < Channels ? Source[x * Channels + c] : 0.0f;
+		}
+	}
+}
+
+static void EncodeRow(const float *Row, BYTE *Destination, int Width, int Channels)
+{
+	int x = 0;
+
+	if(Channels == 4)
+	{
+		for(; x < Width; x++)
+		{
+			Float4StoreBytes(Destination + x * 4, Float4Load(Row + x * 4));
+		}
+	}
+	else if(Channels == 3)
+	{
+		for(; x < Width - 1; x++)
+		{
+			Float4StoreBytes(Destination + x * 3, Float4Load(Row + x * 4));
+		}
+	}
+
+	for(; x < Width; x++)
+	{
+		BYTE Pixel[4];
+
+		Float4StoreBytes(Pixel, Float4Load(Row + x * 4));
+
+		for(int c = 0; c < Channels; c++)
+		{
+			Destination[x * Channels + c] = Pixel[c];
+		}
+	}
+}
+
+// a multiply-add depends on the previous one through the sum, so 4 destination pixels are filtered at once to keep
+// 4 independent sums in flight instead of waiting for each add
+
+static void FilterRow(const float *Row, float *Destination, int Width, const CResampleWeights &WeightsX)
+{
+	int Taps = WeightsX.Taps;
+
+	int x = 0;
+
+	for(; x + 4 <= Width; x += 4)
+	{
+		const float *Pixel0 = Row + WeightsX.First[x] * 4, *Pixel1 = Row + WeightsX.First[x + 1] * 4;
+		const float *Pixel2 = Row + WeightsX.First[x + 2] * 4, *Pixel3 = Row + WeightsX.First[x + 3] * 4;
+		const float *Weights = WeightsX.Weights + x * Taps;
+
+		FLOAT4 Sum0 = Float4Set1(0.0f), Sum1 = Sum0, Sum2 = Sum0, Sum3 = Sum0;
+
+		for(int k = 0; k < Taps; k++)
+		{
+			Sum0 = Float4Add(Sum0, Float4Mul(Float4Load(Pixel0 + k * 4), Float4Set1(Weights[k])));
+			Sum1 = Float4Add(Sum1, Float4Mul(Float4Load(Pixel1 + k * 4), Float4Set1(Weights[Taps + k])));
+			Sum2 = Float4Add(Sum2, Float4Mul(Float4Load(Pixel2 + k * 4), Float4Set1(Weights[Taps * 2 + k])));
+			Sum3 = Float4Add(Sum3, Float4Mul(Float4Load(Pixel3 + k * 4), Float4Set1(Weights[Taps * 3 + k])));
+		}
+
+		Float4Store(Destination + x * 4, Sum0);
+		Float4Store(Destination + x * 4 + 4, Sum1);
+		Float4Store(Destination + x * 4 + 8, Sum2);
+		Float4Store(Destination + x * 4 + 12, Sum3);
+	}
+
+	for(; x < Width; x++)
+	{
+		const float *Pixel = Row + WeightsX.First[x] * 4;
+		const float *Weights = WeightsX.Weights + x * Taps;
+
+		FLOAT4 Sum = Float4Set1(0.0f);
+
+		for(int k = 0; k < Taps; k++)
+		{
+			Sum = Float4Add(Sum, Float4Mul(Float4Load(Pixel + k * 4), Float4Set1(Weights[k])));
+		}
+
+		Float4Store(Destination + x * 4, Sum);
+	}
+}
+
+static void FilterColumns(const float **Rows, const float *Weights, int Taps, float *Destination, int RowSize)
+{
+	int i = 0;
+
+	for(; i + 16 <= RowSize; i += 16)
+	{
+		FLOAT4 Sum0 = Float4Set1(0.0f), Sum1 = Sum0, Sum2 = Sum0, Sum3 = Sum0;
+
+		for(int k = 0; k < Taps; k++)
+		{
+			FLOAT4 Weight = Float4Set1(Weights[k]);
+
+			Sum0 = Float4Add(Sum0, Float4Mul(Float4Load(Rows[k] + i), Weight));
+			Sum1 = Float4Add(Sum1, Float4Mul(Float4Load(Rows[k] + i + 4), Weight));
+			Sum2 = Float4Add(Sum2, Float4Mul(Float4Load(Rows[k] + i + 8), Weight));
+			Sum3 = Float4Add(Sum3, Float4Mul(Float4Load(Rows[k] + i + 12), Weight));
+		}
+
+		Float4Store(Destination + i, Sum0);
+		Float4Store(Destination + i + 4, Sum1);
+		Float4Store(Destination + i + 8, Sum2);
+		Float4Store(Destination + i + 12, Sum3);
+	}
+
+	for(; i < RowSize; i += 4)
+	{
+		FLOAT4 Sum = Float4Set1(0.0f);
+
+		for(int k = 0; k < Taps; k++)
+		{
+			Sum = Float4Add(Sum, Float4Mul(Float4Load(Rows[k] + i), Float4Set1(Weights[k])));
+		}
+
+		Float4Store(Destination + i, Sum);
+	}
+}
+
+#if defined(SIMD_X86)
+
+// two taps of a destination pixel per register, the halves are added at the end
+
+SIMD_TARGET("avx2,fma") static __m256 LoadWeightPair(const float *Weights)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(Weights[0])), _mm_set1_ps(Weights[1]), 1);
+}
+
+SIMD_TARGET("avx2,fma") static __m128 AddHalves(__m256 Sum)
+{
+	return _mm_add_ps(_mm256_castps256_ps128(Sum), _mm256_extractf128_ps(Sum, 1));
+}
+
+SIMD_TARGET("avx2,fma") static void FilterRowAVX2(const float *Row, float *Destination, int Width, const CResampleWeights &WeightsX)
+{
+	int Taps = WeightsX.Taps, Pairs = Taps / 2;
+
+	int x = 0;
+
+	for(; x + 4 <= Width; x += 4)
+	{
+		const float *Pixel0 = Row + WeightsX.First[x] * 4, *Pixel1 = Row + WeightsX.First[x + 1] * 4;
+		const float *Pixel2 = Row + WeightsX.First[x + 2] * 4, *Pixel3 = Row + WeightsX.First[x + 3] * 4;
+		const float *Weights = WeightsX.Weights + x * Taps;
+
+		__m256 Sum0 = _mm256_setzero_ps(), Sum1 = Sum0, Sum2 = Sum0, Sum3 = Sum0;
+
+		for(int k = 0; k < Pairs * 2; k += 2)
+		{
+			Sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(Pixel0 + k * 4), LoadWeightPair(Weights + k), Sum0);
+			Sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(Pixel1 + k * 4), LoadWeightPair(Weights + Taps + k), Sum1);
+			Sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(Pixel2 + k * 4), LoadWeightPair(Weights + Taps * 2 + k), Sum2);
+			Sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(Pixel3 + k * 4), LoadWeightPair(Weights + Taps * 3 + k), Sum3);
+		}
+
+		__m128 Result0 = AddHalves(Sum0), Result1 = AddHalves(Sum1), Result2 = AddHalves(Sum2), Result3 = AddHalves(Sum3);
+
+		if(Taps & 1)
+		{
+			int k = Taps - 1;
+
+			Result0 = _mm_fmadd_ps(_mm_loadu_ps(Pixel0 + k * 4), _mm_set1_ps(Weights[k]), Result0);
+			Result1 = _mm_fmadd_ps(_mm_loadu_ps(Pixel1 + k * 4), _mm_set1_ps(Weights[Taps + k]), Result1);
+			Result2 = _mm_fmadd_ps(_mm_loadu_ps(Pixel2 + k * 4), _mm_set1_ps(Weights[Taps * 2 + k]), Result2);
+			Result3 = _mm_fmadd_ps(_mm_loadu_ps(Pixel3 + k * 4), _mm_set1_ps(Weights[Taps * 3 + k]), Result3);
+		}
+
+		_mm_storeu_ps(Destination + x * 4, Result0);
+		_mm_storeu_ps(Destination + x * 4 + 4, Result1);
+		_mm_storeu_ps(Destination + x * 4 + 8, Result2);
+		_mm_storeu_ps(Destination + x * 4 + 12, Result3);
+	}
+
+	for(; x < Width; x++)
+	{
+		const float *Pixel = Row + WeightsX.First[x] * 4;
+		const float *Weights = WeightsX.Weights + x * Taps;
+
+		__m128 Sum = _mm_setzero_ps();
+
+		for(int k = 0; k < Taps; k++)
+		{
+			Sum = _mm_fmadd_ps(_mm_loadu_ps(Pixel + k * 4), _mm_set1_ps(Weights[k]), Sum);
+		}
+
+		_mm_storeu_ps(Destination + x * 4, Sum);
+	}
+}
+
+SIMD_TARGET("avx2,fma") static void FilterColumnsAVX2(const float **Rows, const float *Weights, int Taps, float *Destination, int RowSize)
+{
+	int i = 0;
+
+	for(; i + 32 <= RowSize; i += 32)
+	{
+		__m256 Sum0 = _mm256_setzero_ps(), Sum1 = Sum0, Sum2 = Sum0, Sum3 = Sum0;
+
+		for(int k = 0; k < Taps; k++)
+		{
+			__m256 Weight = _mm256_set1_ps(Weights[k]);
+
+			Sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(Rows[k] + i), Weight, Sum0);
+			Sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(Rows[k] + i + 8), Weight, Sum1);
+			Sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(Rows[k] + i + 16), Weight, Sum2);
+			Sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(Rows[k] + i + 24), Weight, Sum3);
+		}
+
+		_mm256_storeu_ps(Destination + i, Sum0);
+		_mm256_storeu_ps(Destination + i + 8, Sum1);
+		_mm256_storeu_ps(Destination + i + 16, Sum2);
+		_mm256_storeu_ps(Destination + i + 24, Sum3);
+	}
+
+	for(; i < RowSize; i += 4)
+	{
+		__m128 Sum = _mm_setzero_ps();
+
+		for(int k = 0; k < Taps; k++)
+		{
+			Sum = _mm_fmadd_ps(_mm_loadu_ps(Rows[k] + i), _mm_set1_ps(Weights[k]), Sum);
+		}
+
+		_mm_storeu_ps(Destination + i, Sum);
+	}
+}
+
+#endif
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+bool ResampleImage(const BYTE *Source, int SourceWidth, int SourceHeight, int SourcePitch, BYTE *Destination, int Width, int Height, int Pitch, int Channels, RESAMPLE_FILTER Filter)
+{
+	if(Source == NULL || Destination == NULL || SourceWidth <= 0 || SourceHeight <= 0 || Width <= 0 || Height <= 0 || Channels < 1 || Channels > 4)
+	{
+		return false;
+	}
+
+	CResampleWeights WeightsX, WeightsY;
+
+	WeightsX.Compute(SourceWidth, Width, Filter);
+	WeightsY.Compute(SourceHeight, Height, Filter);
+
+	int Taps = WeightsY.Taps;
+
+	bool AVX2 = CPUFeatures.AVX2 && CPUFeatures.FMA;
+
+	// each band keeps the horizontally filtered source rows its next destination row needs in a ring of Taps rows,
+	// the windows only move down so every source row of a band is decoded and filtered once
+
+	ThreadPool.ParallelFor(Height, 32, [&](int Begin, int End)
+	{
+		int RowSize = Width * 4;
+
+		float *Row = new float[SourceWidth * 4];
+		float *Ring = new float[Taps * RowSize];
+		float *Sum = new float[RowSize];
+		const float **Rows = new const float*[Taps];
+
+		int NextRow = WeightsY.First[Begin];
+
+		for(int y = Begin; y < End; y++)
+		{
+			int First = WeightsY.First[y];
+
+			if(NextRow < First) NextRow = First;
+
+			for(; NextRow < First + Taps; NextRow++)
+			{
+				DecodeRow(Source + NextRow * SourcePitch, Row, SourceWidth, Channels);
+
+#if defined(SIMD_X86)
+				if(AVX2)
+				{
+					FilterRowAVX2(Row, Ring + (NextRow % Taps) * RowSize, Width, WeightsX);
+					continue;
+				}
+#endif
+
+				FilterRow(Row, Ring + (NextRow % Taps) * RowSize, Width, WeightsX);
+			}
+
+			for(int k = 0; k < Taps; k++)
+			{
+				Rows[k] = Ring + ((First + k) % Taps) * RowSize;
+			}
+
+#if defined(SIMD_X86)
+			if(AVX2) FilterColumnsAVX2(Rows, WeightsY.Weights + y * Taps, Taps, Sum, RowSize);
+			else
+#endif
+			FilterColumns(Rows, WeightsY.Weights + y * Taps, Taps, Sum, RowSize);
+			EncodeRow(Sum, Destination + y * Pitch, Width, Channels);
+		}
+
+		delete [] Row;
+		delete [] Ring;
+		delete [] Sum;
+		delete [] Rows;
+	});
+
+	return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "platform.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+enum RESAMPLE_FILTER
+{
+	RESAMPLE_FILTER_BOX,
+	RESAMPLE_FILTER_BILINEAR,
+	RESAMPLE_FILTER_BICUBIC,
+	RESAMPLE_FILTER_LANCZOS3
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// scales an 8 bit per channel image with 1 to 4 channels to any size, separable with the weights of each axis computed
+// once, the bands of destination rows are spread over the thread pool; the filters are widened when minifying so every
+// source pixel contributes, bicubic is Mitchell-Netravali (B = C = 1/3) like FILTER_BICUBIC of FreeImage
+
+bool ResampleImage(const BYTE *Source, int SourceWidth, int SourceHeight, int SourcePitch, BYTE *Destination, int Width, int Height, int Pitch, int Channels, RESAMPLE_FILTER Filter);
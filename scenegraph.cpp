@@ -0,0 +1,382 @@
+#include "scenegraph.h"
+#include "profiler.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+template <class T> static void Grow(T *&Array, int Count, int MaxCount)
+{
+	T *NewArray = new T[MaxCount];
+
+	if(Count > 0)
+	{
+		memcpy(NewArray, Array, sizeof(T) * Count);
+	}
+
+	delete [] Array;
+
+	Array = NewArray;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CSceneGraph::CSceneGraph()
+{
+	Parents = Slots = NULL;
+	Locals = Worlds = NULL;
+	Dirty = NULL;
+	Count = MaxCount = 0;
+	SlotParents = Depths = FirstChildren = NULL;
+	LevelStarts = MarkedMins = MarkedMaxs = NULL;
+	LevelsCount = 0;
+	FirstMarkedLevel = 0;
+	LastMarkedLevel = -1;
+	Sorted = true;
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CSceneGraph::~CSceneGraph()
+{
+	Destroy();
+}
+
+// a parent has to be added before its children, so there are no cycles; the new node is put behind the sorted ones and
+// the levels are sorted again by the next Update
+
+int CSceneGraph::Add(int Parent, const mat4x4 &Local)
+{
+	if(Parent < -1 || Parent >= Count)
+	{
+		ErrorLog.Append("Error adding scene graph node, parent %d does not exist!\r\n", Parent);
+		return -1;
+	}
+
+	if(Count == MaxCount)
+	{
+		MaxCount = MaxCount > 0 ? MaxCount * 2 : 64;
+
+		Grow(Parents, Count, MaxCount);
+		Grow(Slots, Count, MaxCount);
+		Grow(Locals, Count, MaxCount);
+		Grow(Worlds, Count, MaxCount);
+		Grow(Dirty, Count, MaxCount);
+	}
+
+	Parents[Count] = Parent;
+	Slots[Count] = Count;
+	Locals[Count] = Worlds[Count] = Local;
+	Dirty[Count] = 1;
+
+	Sorted = false;
+
+	Stats.Nodes = ++Count;
+
+	return Count - 1;
+}
+
+// a node that is already dirty is already marked
+
+void CSceneGraph::SetLocal(int Node, const mat4x4 &Local)
+{
+	int Slot = Slots[Node];
+
+	Locals[Slot] = Local;
+
+	if(Dirty[Slot] || !Sorted)
+	{
+		Dirty[Slot] = 1;
+		return;
+	}
+
+	Dirty[Slot] = 1;
+
+	int Level = Depths[Slot];
+
+	MarkedMins[Level] = std::min(MarkedMins[Level], Slot);
+	MarkedMaxs[Level] = std::max(MarkedMaxs[Level], Slot + 1);
+
+	FirstMarkedLevel = std::min(FirstMarkedLevel, Level);
+	LastMarkedLevel = std::max(LastMarkedLevel, Level);
+}
+
+const mat4x4& CSceneGraph::GetLocal(int Node)
+{
+	return Locals[Slots[Node]];
+}
+
+// valid after the Update that follows the last SetLocal of the node or of one above it
+
+const mat4x4& CSceneGraph::GetWorld(int Node)
+{
+	return Worlds[Slots[Node]];
+}
+
+int CSceneGraph::GetParent(int Node)
+{
+	return Parents[Node];
+}
+
+// a node of a level is recomputed when it was marked or its parent was recomputed, the dirty flags of the parents are
+// only cleared after the last level
+
+int CSceneGraph::Update()
+{
+	PROFILE_ZONE("CSceneGraph::Update");
+
+	double Start = GetTime();
+
+	if(!Sorted)
+	{
+		Sort();
+	}
+
+	int Updated = 0, ParentsBegin = 0, ParentsEnd = 0, ClearBegin = Count, ClearEnd = 0;
+
+	for(int Level = FirstMarkedLevel; Level < LevelsCount; Level++)
+	{
+		int Begin = FirstChildren[ParentsBegin], End = FirstChildren[ParentsEnd];
+
+		if(MarkedMins[Level] < MarkedMaxs[Level])
+		{
+			bool Children = Begin < End;
+
+			Begin = Children ? std::min(Begin, MarkedMins[Level]) : MarkedMins[Level];
+			End = Children ? std::max(End, MarkedMaxs[Level]) : MarkedMaxs[Level];
+
+			MarkedMins[Level] = Count;
+			MarkedMaxs[Level] = 0;
+		}
+
+		if(Begin >= End)
+		{
+			if(Level >= LastMarkedLevel)
+			{
+				break;
+			}
+
+			ParentsBegin = ParentsEnd = 0;
+
+			continue;
+		}
+
+		std::atomic<int> LevelUpdated(0);
+
+		ThreadPool.ParallelFor(End - Begin, SCENEGRAPH_GRAIN, [&](int ChunkBegin, int ChunkEnd)
+		{
+			int ChunkUpdated = 0;
+
+			for(int i = Begin + ChunkBegin; i < Begin + ChunkEnd; i++)
+			{
+				int Parent = SlotParents[i];
+
+				if(Parent >= 0 && Dirty[Parent])
+				{
+					Dirty[i] = 1;
+				}
+
+				if(Dirty[i])
+				{
+					Worlds[i] = Parent >= 0 ? Worlds[Parent] * Locals[i] : Locals[i];
+
+					ChunkUpdated++;
+				}
+			}
+
+			LevelUpdated += ChunkUpdated;
+		});
+
+		Updated += LevelUpdated;
+
+		ClearBegin = std::min(ClearBegin, Begin);
+		ClearEnd = std::max(ClearEnd, End);
+
+		if(LevelUpdated > 0)
+		{
+			ParentsBegin = Begin;
+			ParentsEnd = End;
+		}
+		else
+		{
+			ParentsBegin = ParentsEnd = 0;
+		}
+	}
+
+	if(ClearBegin < ClearEnd)
+	{
+		memset(Dirty + ClearBegin, 0, ClearEnd - ClearBegin);
+	}
+
+	FirstMarkedLevel = LevelsCount;
+	LastMarkedLevel = -1;
+
+	Stats.Updated = Updated;
+	Stats.Updates++;
+	Stats.UpdateTime += GetTime() - Start;
+
+	return Updated;
+}
+
+int CSceneGraph::GetCount()
+{
+	return Count;
+}
+
+void CSceneGraph::GetStats(CSceneGraphStats &Stats)
+{
+	Stats = this->Stats;
+}
+
+void CSceneGraph::Destroy()
+{
+	delete [] Parents;
+	delete [] Slots;
+	delete [] Locals;
+	delete [] Worlds;
+	delete [] Dirty;
+	delete [] SlotParents;
+	delete [] Depths;
+	delete [] FirstChildren;
+	delete [] LevelStarts;
+	delete [] MarkedMins;
+	delete [] MarkedMaxs;
+
+	Parents = Slots = NULL;
+	Locals = Worlds = NULL;
+	Dirty = NULL;
+	Count = MaxCount = 0;
+	SlotParents = Depths = FirstChildren = NULL;
+	LevelStarts = MarkedMins = MarkedMaxs = NULL;
+	LevelsCount = 0;
+	FirstMarkedLevel = 0;
+	LastMarkedLevel = -1;
+	Sorted = true;
+
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+// the roots come first in the order they were added, then the children of every node in that order, which sorts the
+// nodes by depth and keeps the children of consecutive nodes consecutive; the matrices move with their nodes and every
+// node is marked, so the first Update recomputes them all
+
+void CSceneGraph::Sort()
+{
+	int *ChildStarts = new int[Count + 1], *Cursors = new int[Count + 1], *Children = new int[Count + 1], *Order = new int[Count + 1];
+
+	memset(ChildStarts, 0, sizeof(int) * (Count + 1));
+
+	for(int Node = 0; Node < Count; Node++)
+	{
+		if(Parents[Node] >= 0)
+		{
+			ChildStarts[Parents[Node] + 1]++;
+		}
+	}
+
+	for(int Node = 0; Node < Count; Node++)
+	{
+		ChildStarts[Node + 1] += ChildStarts[Node];
+	}
+
+	memcpy(Cursors, ChildStarts, sizeof(int) * (Count + 1));
+
+	int OrderCount = 0;
+
+	for(int Node = 0; Node < Count; Node++)
+	{
+		if(Parents[Node] >= 0)
+		{
+			Children[Cursors[Parents[Node]]++] = Node;
+		}
+		else
+		{
+			Order[OrderCount++] = Node;
+		}
+	}
+
+	mat4x4 *NewLocals = new mat4x4[MaxCount], *NewWorlds = new mat4x4[MaxCount];
+
+	delete [] SlotParents;
+	delete [] Depths;
+	delete [] FirstChildren;
+
+	SlotParents = new int[Count + 1];
+	Depths = new int[Count + 1];
+	FirstChildren = new int[Count + 1];
+
+	// a parent always has its new slot before its children are reached
+
+	for(int Slot = 0; Slot < Count; Slot++)
+	{
+		int Node = Order[Slot], Parent = Parents[Node];
+
+		NewLocals[Slot] = Locals[Slots[Node]];
+		NewWorlds[Slot] = Worlds[Slots[Node]];
+
+		Slots[Node] = Slot;
+
+		SlotParents[Slot] = Parent >= 0 ? Slots[Parent] : -1;
+		Depths[Slot] = Parent >= 0 ? Depths[Slots[Parent]] + 1 : 0;
+		FirstChildren[Slot] = OrderCount;
+
+		for(int Child = ChildStarts[Node]; Child < ChildStarts[Node + 1]; Child++)
+		{
+			Order[OrderCount++] = Children[Child];
+		}
+	}
+
+	FirstChildren[Count] = Count;
+
+	delete [] Locals;
+	delete [] Worlds;
+
+	Locals = NewLocals;
+	Worlds = NewWorlds;
+
+	delete [] ChildStarts;
+	delete [] Cursors;
+	delete [] Children;
+	delete [] Order;
+
+	LevelsCount = Count > 0 ? Depths[Count - 1] + 1 : 0;
+
+	delete [] LevelStarts;
+	delete [] MarkedMins;
+	delete [] MarkedMaxs;
+
+	LevelStarts = new int[LevelsCount + 1];
+	MarkedMins = new int[LevelsCount + 1];
+	MarkedMaxs = new int[LevelsCount + 1];
+
+	for(int Slot = 0, Level = 0; Level <= LevelsCount; Level++)
+	{
+		while(Slot < Count && Depths[Slot] < Level)
+		{
+			Slot++;
+		}
+
+		LevelStarts[Level] = Slot;
+	}
+
+	for(int Level = 0; Level < LevelsCount; Level++)
+	{
+		MarkedMins[Level] = LevelStarts[Level];
+		MarkedMaxs[Level] = LevelStarts[Level + 1];
+	}
+
+	memset(Dirty, 1, Count);
+
+	FirstMarkedLevel = 0;
+	LastMarkedLevel = LevelsCount - 1;
+
+	Sorted = true;
+
+	Stats.Levels = LevelsCount;
+	Stats.Sorts++;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CSceneGraph SceneGraph;
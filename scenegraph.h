@@ -0,0 +1,59 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// nodes of a level per job of the update
+
+#define SCENEGRAPH_GRAIN 4096
+
+// Updated is that of the last Update, the time is summed over Updates
+
+struct CSceneGraphStats
+{
+	int Nodes, Levels, Updated, Updates, Sorts;
+	double UpdateTime;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// a hierarchy of transforms kept as flat arrays; Add returns a node that stays valid, the nodes are sorted into levels by
+// their depth, breadth first, so every level comes after the one of its parents and the children of a range of nodes
+// are a range of the next level; SetLocal marks a node dirty and Update walks the levels from the first marked one,
+// recomputing the world matrices of the marked nodes and of those whose parents were recomputed, a level in chunks on
+// the thread pool; only the range of a level below the recomputed nodes of the level above and its own marked nodes
+// are looked at, so when nothing was marked Update returns at once
+
+class CSceneGraph
+{
+protected:
+	int *Parents, *Slots;
+	mat4x4 *Locals, *Worlds;
+	unsigned char *Dirty;
+	int Count, MaxCount;
+	int *SlotParents, *Depths, *FirstChildren;
+	int *LevelStarts, *MarkedMins, *MarkedMaxs, LevelsCount;
+	int FirstMarkedLevel, LastMarkedLevel;
+	bool Sorted;
+	CSceneGraphStats Stats;
+
+public:
+	CSceneGraph();
+	~CSceneGraph();
+
+	int Add(int Parent, const mat4x4 &Local);
+	void SetLocal(int Node, const mat4x4 &Local);
+	const mat4x4& GetLocal(int Node);
+	const mat4x4& GetWorld(int Node);
+	int GetParent(int Node);
+	int Update();
+	int GetCount();
+	void GetStats(CSceneGraphStats &Stats);
+	void Destroy();
+
+protected:
+	void Sort();
+};
+
+extern CSceneGraph SceneGraph;
@@ -0,0 +1,191 @@
+#include "win32_opengl_glew_freeimage_glm.h"
+#include "shadercache.h"
+#include "profiler.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+#define SHADER_CACHE_MAGIC 0x42534C47 // GLSB
+#define SHADER_CACHE_VERSION 1
+
+struct CShaderCacheHeader
+{
+	DWORD Magic, Version;
+	HASH64 Key;
+	GLenum Format;
+	GLint Size;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CShaderCache::CShaderCache()
+{
+	Enabled = false;
+	DriverHash = 0;
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CShaderCache::~CShaderCache()
+{
+}
+
+void CShaderCache::Init(const char *Directory, bool Enabled)
+{
+	this->Directory = Directory;
+	this->Enabled = Enabled;
+
+	MakeDirectory(Directory);
+}
+
+// a driver may support the extension and still offer no binary format
+
+bool CShaderCache::IsEnabled()
+{
+	if(!Enabled || !(gl_version >= 41 || GLEW_ARB_get_program_binary))
+	{
+		return false;
+	}
+
+	GLint FormatsCount = 0;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &FormatsCount);
+
+	return FormatsCount > 0;
+}
+
+// the sources are hashed as they are passed to the driver, the driver strings are hashed once
+
+HASH64 CShaderCache::GetKey(const BYTE **Sources, const size_t *Sizes, int Count)
+{
+	if(DriverHash == 0)
+	{
+		GLenum Names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+
+		DriverHash = SHADER_CACHE_VERSION;
+
+		for(int i = 0; i < 3; i++)
+		{
+			const char *String = (const char*)glGetString(Names[i]);
+
+			DriverHash = HashString64(String ? String : "", DriverHash);
+		}
+	}
+
+	HASH64 Key = DriverHash;
+
+	for(int i = 0; i < Count; i++)
+	{
+		Key = Hash64(&Sizes[i], sizeof(size_t), Key);
+		Key = Hash64(Sources[i], Sizes[i], Key);
+	}
+
+	return Key;
+}
+
+bool CShaderCache::Load(HASH64 Key, GLuint Program)
+{
+	PROFILE_ZONE("CShaderCache::Load");
+
+	double Start = GetTime();
+
+	CMappedFile File;
+
+	if(!File.Open(GetFileName(Key)))
+	{
+		Stats.Misses++;
+		return false;
+	}
+
+	const CShaderCacheHeader *Header = (const CShaderCacheHeader*)File.Data;
+
+	bool Valid = File.Size >= sizeof(CShaderCacheHeader) && Header->Magic == SHADER_CACHE_MAGIC && Header->Version == SHADER_CACHE_VERSION;
+
+	Valid = Valid && Header->Key == Key && Header->Size > 0 && File.Size == sizeof(CShaderCacheHeader) + Header->Size;
+
+	if(Valid)
+	{
+		glProgramBinary(Program, Header->Format, File.Data + sizeof(CShaderCacheHeader), Header->Size);
+
+		GLint Param = 0;
+		glGetProgramiv(Program, GL_LINK_STATUS, &Param);
+
+		Valid = Param == GL_TRUE;
+	}
+
+	File.Close();
+
+	if(!Valid)
+	{
+		Stats.Rejected++;
+		return false;
+	}
+
+	Stats.Hits++;
+	Stats.LoadTime += GetTime() - Start;
+
+	return true;
+}
+
+bool CShaderCache::Save(HASH64 Key, GLuint Program)
+{
+	PROFILE_ZONE("CShaderCache::Save");
+
+	CShaderCacheHeader Header = {SHADER_CACHE_MAGIC, SHADER_CACHE_VERSION, Key, 0, 0};
+
+	glGetProgramiv(Program, GL_PROGRAM_BINARY_LENGTH, &Header.Size);
+
+	if(Header.Size <= 0)
+	{
+		return false;
+	}
+
+	BYTE *Binary = new BYTE[Header.Size];
+
+	glGetProgramBinary(Program, Header.Size, &Header.Size, &Header.Format, Binary);
+
+	CString FileName = GetFileName(Key);
+
+	FILE *File;
+
+	bool Written = Header.Size > 0 && fopen_s(&File, FileName, "wb") == 0;
+
+	if(Written)
+	{
+		Written = fwrite(&Header, sizeof(Header), 1, File) == 1 && fwrite(Binary, 1, Header.Size, File) == (size_t)Header.Size;
+
+		Written = fclose(File) == 0 && Written;
+
+		if(!Written)
+		{
+			remove(FileName);
+		}
+	}
+
+	delete [] Binary;
+
+	if(Written) Stats.Writes++;
+
+	return Written;
+}
+
+void CShaderCache::CountBuild(double Time)
+{
+	Stats.BuildTime += Time;
+}
+
+void CShaderCache::GetStats(CShaderCacheStats &Stats)
+{
+	Stats = this->Stats;
+}
+
+CString CShaderCache::GetFileName(HASH64 Key)
+{
+	CString FileName;
+
+	FileName.Set("%s%016llx.glbin", (char*)Directory, Key);
+
+	return FileName;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CShaderCache ShaderCache;
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "platform.h"
+#include "string.h"
+#include "hash.h"
+
+#include <GL/glew.h>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+struct CShaderCacheStats
+{
+	int Hits, Misses, Rejected, Writes;
+	double LoadTime, BuildTime;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// linked programs are kept as the driver's binaries in files named after a hash of the shader sources and of the
+// vendor, renderer and version strings; a binary the driver does not take any more is rejected and the program is
+// compiled and saved again
+
+class CShaderCache
+{
+protected:
+	CString Directory;
+	bool Enabled;
+	HASH64 DriverHash;
+	CShaderCacheStats Stats;
+
+public:
+	CShaderCache();
+	~CShaderCache();
+
+	void Init(const char *Directory, bool Enabled);
+	bool IsEnabled();
+	HASH64 GetKey(const BYTE **Sources, const size_t *Sizes, int Count);
+	bool Load(HASH64 Key, GLuint Program);
+	bool Save(HASH64 Key, GLuint Program);
+	void CountBuild(double Time);
+	void GetStats(CShaderCacheStats &Stats);
+
+protected:
+	CString GetFileName(HASH64 Key);
+};
+
+extern CShaderCache ShaderCache;
@@ -0,0 +1,394 @@
+#include "shaderlibrary.h"
+#include "profiler.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CShaderPreprocessor::CShaderPreprocessor()
+{
+}
+
+CShaderPreprocessor::~CShaderPreprocessor()
+{
+}
+
+bool CShaderPreprocessor::Expand(const char *FileName, const char *Defines, std::string &Source, std::vector<std::string> &FileNames)
+{
+	PROFILE_ZONE("CShaderPreprocessor::Expand");
+
+	Source.clear();
+	FileNames.clear();
+
+	return Include(FileName, Defines, 0, Source, FileNames);
+}
+
+void CShaderPreprocessor::Clear()
+{
+	Files.clear();
+}
+
+const std::string* CShaderPreprocessor::Read(const char *FileName)
+{
+	auto Found = Files.find(FileName);
+
+	if(Found != Files.end())
+	{
+		return &Found->second;
+	}
+
+	CMappedFile File;
+
+	if(!File.Open(CString::Concat({ModuleDirectory, FileName})))
+	{
+		ErrorLog.Append("Error loading file %s%s!\r\n", (char*)ModuleDirectory, FileName);
+		return NULL;
+	}
+
+	std::string &Text = Files[FileName];
+
+	Text.assign((const char*)File.Data, File.Size);
+
+	return &Text;
+}
+
+// the defines go to the first file only, after the #version line or at the top when there is none
+
+bool CShaderPreprocessor::Include(const char *FileName, const char *Defines, int Depth, std::string &Source, std::vector<std::string> &FileNames)
+{
+	if(Depth > SHADER_MAX_INCLUDE_DEPTH)
+	{
+		ErrorLog.Append("Error including file %s! -> too deeply nested, or included by itself\r\n", FileName);
+		return false;
+	}
+
+	const std::string *File = Read(FileName);
+
+	if(File == NULL)
+	{
+		return false;
+	}
+
+	int Index = (int)FileNames.size();
+
+	FileNames.push_back(FileName);
+
+	if(Depth > 0)
+	{
+		Source += "#line 1 " + std::to_string(Index) + "\n";
+	}
+
+	size_t First = File->find_first_not_of(" \t\r\n");
+
+	bool Version = First != std::string::npos && File->compare(First, 8, "#version") == 0;
+
+	if(Depth == 0 && !Version && Defines)
+	{
+		AppendDefines(Defines, Source);
+
+		Source += "#line 1 0\n";
+	}
+
+	const char *Text = File->c_str();
+
+	int Line = 0;
+
+	while(*Text)
+	{
+		const char *End = strchr(Text, '\n');
+
+		End = End ? End + 1 : Text + strlen(Text);
+
+		Line++;
+
+		const char *Directive = Text;
+
+		while(*Directive == ' ' || *Directive == '\t') Directive++;
+
+		if(strncmp(Directive, "#include", 8) == 0)
+		{
+			const char *FirstQuote = strchr(Directive + 8, '"'), *LastQuote = FirstQuote && FirstQuote < End ? strchr(FirstQuote + 1, '"') : NULL;
+
+			if(LastQuote == NULL || LastQuote >= End)
+			{
+				ErrorLog.Append("Error parsing file %s, line %d! -> #include needs a file name in quotes\r\n", FileName, Line);
+				return false;
+			}
+
+			std::string IncludeFileName(FirstQuote + 1, LastQuote);
+
+			if(!Include(IncludeFileName.c_str(), NULL, Depth + 1, Source, FileNames))
+			{
+				return false;
+			}
+
+			Source += "#line " + std::to_string(Line + 1) + " " + std::to_string(Index) + "\n";
+		}
+		else
+		{
+			Source.append(Text, End);
+
+			if(*(End - 1) != '\n')
+			{
+				Source += "\n";
+			}
+
+			if(Depth == 0 && Version && Defines && strncmp(Directive, "#version", 8) == 0)
+			{
+				AppendDefines(Defines, Source);
+
+				Source += "#line " + std::to_string(Line + 1) + " 0\n";
+			}
+		}
+
+		Text = End;
+	}
+
+	return true;
+}
+
+// "NAME=VALUE" becomes #define NAME VALUE
+
+void CShaderPreprocessor::AppendDefines(const char *Defines, std::string &Source)
+{
+	while(*Defines)
+	{
+		while(*Defines == ' ') Defines++;
+
+		const char *End = Defines;
+
+		while(*End && *End != ' ') End++;
+
+		if(End > Defines)
+		{
+			std::string Definition(Defines, End);
+
+			size_t Equals = Definition.find('=');
+
+			if(Equals != std::string::npos)
+			{
+				Definition[Equals] = ' ';
+			}
+
+			Source += "#define " + Definition + "\n";
+		}
+
+		Defines = End;
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CShaderLibrary::CShaderLibrary()
+{
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CShaderLibrary::~CShaderLibrary()
+{
+}
+
+// lets the driver use as many compiler threads as it likes
+
+void CShaderLibrary::Init()
+{
+	if(GLEW_KHR_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+	else if(GLEW_ARB_parallel_shader_compile)
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	}
+}
+
+int CShaderLibrary::Add(const char *VertexShaderFileName, const char *FragmentShaderFileName, const char *Defines)
+{
+	CVariant Variant;
+
+	Variant.VertexShaderFileName = VertexShaderFileName;
+	Variant.FragmentShaderFileName = FragmentShaderFileName;
+	Variant.Defines = Defines ? Defines : "";
+	Variant.Program = -1;
+
+	Variants.push_back(Variant);
+
+	Stats.Variants++;
+
+	return (int)Variants.size() - 1;
+}
+
+// starts every variant added since the last call
+
+bool CShaderLibrary::Compile()
+{
+	PROFILE_ZONE("CShaderLibrary::Compile");
+
+	bool Error = false;
+
+	for(size_t i = 0; i < Variants.size(); i++)
+	{
+		if(Variants[i].Program == -1)
+		{
+			Error |= !Start(Variants[i]);
+		}
+	}
+
+	return !Error;
+}
+
+CShaderProgram* CShaderLibrary::Get(int Variant)
+{
+	if(Variant < 0 || Variant >= (int)Variants.size())
+	{
+		return NULL;
+	}
+
+	if(Variants[Variant].Program == -1)
+	{
+		Compile();
+	}
+
+	if(Variants[Variant].Program < 0)
+	{
+		return NULL;
+	}
+
+	CProgram &Program = Programs[Variants[Variant].Program];
+
+	if(!Program.Finished)
+	{
+		double Start = GetTime();
+
+		End(Program);
+
+		Stats.WaitTime += GetTime() - Start;
+	}
+
+	return Program.Failed ? NULL : Program.Program;
+}
+
+// without parallel compilation the driver compiles when asked for the status, so one program is finished per call
+
+void CShaderLibrary::Update()
+{
+	bool Parallel = CShaderProgram::IsParallelCompileSupported();
+
+	for(size_t i = 0; i < Programs.size(); i++)
+	{
+		if(Programs[i].Finished || !Programs[i].Program->IsReady())
+		{
+			continue;
+		}
+
+		End(Programs[i]);
+
+		if(!Parallel) break;
+	}
+}
+
+bool CShaderLibrary::Finish()
+{
+	PROFILE_ZONE("CShaderLibrary::Finish");
+
+	bool Error = !Compile();
+
+	for(size_t i = 0; i < Programs.size(); i++)
+	{
+		if(!Programs[i].Finished)
+		{
+			Error |= !End(Programs[i]);
+		}
+	}
+
+	return !Error;
+}
+
+void CShaderLibrary::GetStats(CShaderLibraryStats &Stats)
+{
+	Stats = this->Stats;
+}
+
+void CShaderLibrary::Destroy()
+{
+	for(size_t i = 0; i < Programs.size(); i++)
+	{
+		Programs[i].Program->Delete();
+		delete Programs[i].Program;
+	}
+
+	Programs.clear();
+	Variants.clear();
+	Preprocessor.Clear();
+}
+
+// the sources are expanded on this thread, the driver compiles them on its own
+
+bool CShaderLibrary::Start(CVariant &Variant)
+{
+	std::string VertexShaderSource, FragmentShaderSource;
+	std::vector<std::string> FileNames;
+
+	const char *Defines = Variant.Defines[0] ? (char*)Variant.Defines : NULL;
+
+	if(!Preprocessor.Expand(Variant.VertexShaderFileName, Defines, VertexShaderSource, FileNames) || !Preprocessor.Expand(Variant.FragmentShaderFileName, Defines, FragmentShaderSource, FileNames))
+	{
+		Variant.Program = -2;
+		Stats.Failed++;
+		return false;
+	}
+
+	HASH64 Hash = HashString64(FragmentShaderSource.c_str(), HashString64(VertexShaderSource.c_str()));
+
+	for(size_t i = 0; i < Programs.size(); i++)
+	{
+		if(Programs[i].Hash == Hash)
+		{
+			Variant.Program = (int)i;
+			Stats.Duplicates++;
+			return true;
+		}
+	}
+
+	CString Name = CString::Concat({Variant.VertexShaderFileName, ", ", Variant.FragmentShaderFileName});
+
+	if(Defines)
+	{
+		Name.AppendStrings({" [", Defines, "]"});
+	}
+
+	CProgram Program;
+
+	Program.Program = new CShaderProgram();
+	Program.Hash = Hash;
+	Program.Program->Begin(Name, VertexShaderSource.c_str(), (int)VertexShaderSource.size(), FragmentShaderSource.c_str(), (int)FragmentShaderSource.size());
+	Program.Finished = false;
+	Program.Failed = false;
+
+	Programs.push_back(Program);
+
+	Variant.Program = (int)Programs.size() - 1;
+
+	Stats.Programs++;
+
+	return true;
+}
+
+bool CShaderLibrary::End(CProgram &Program)
+{
+	Program.Finished = true;
+	Program.Failed = !Program.Program->End();
+
+	if(Program.Failed)
+	{
+		Stats.Failed++;
+	}
+	else
+	{
+		Stats.Ready++;
+	}
+
+	return !Program.Failed;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CShaderLibrary ShaderLibrary;
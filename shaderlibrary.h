@@ -0,0 +1,90 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+#define SHADER_MAX_INCLUDE_DEPTH 16
+
+// expands #include "file" lines recursively and puts the defines, "NAME" or "NAME=VALUE" separated by spaces, right
+// after the #version line; #line directives keep the line numbers of the errors, the source string number is the index
+// of the file in FileNames; every file is read once
+
+class CShaderPreprocessor
+{
+protected:
+	std::unordered_map<std::string, std::string> Files;
+
+public:
+	CShaderPreprocessor();
+	~CShaderPreprocessor();
+
+	bool Expand(const char *FileName, const char *Defines, std::string &Source, std::vector<std::string> &FileNames);
+	void Clear();
+
+protected:
+	const std::string* Read(const char *FileName);
+	bool Include(const char *FileName, const char *Defines, int Depth, std::string &Source, std::vector<std::string> &FileNames);
+
+	static void AppendDefines(const char *Defines, std::string &Source);
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+struct CShaderLibraryStats
+{
+	int Variants, Programs, Duplicates, Ready, Failed;
+	double WaitTime;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// variants are added up front and started together by Compile, variants with the same expanded sources share a
+// program; Get waits for one program only, Update finishes the others as the driver completes them, without blocking
+// when GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile is there
+
+class CShaderLibrary
+{
+protected:
+	struct CVariant
+	{
+		CString VertexShaderFileName, FragmentShaderFileName, Defines;
+		int Program;
+	};
+
+	struct CProgram
+	{
+		CShaderProgram *Program;
+		HASH64 Hash;
+		bool Finished, Failed;
+	};
+
+protected:
+	CShaderPreprocessor Preprocessor;
+	std::vector<CVariant> Variants;
+	std::vector<CProgram> Programs;
+	CShaderLibraryStats Stats;
+
+public:
+	CShaderLibrary();
+	~CShaderLibrary();
+
+	void Init();
+	int Add(const char *VertexShaderFileName, const char *FragmentShaderFileName, const char *Defines = NULL);
+	bool Compile();
+	CShaderProgram* Get(int Variant);
+	void Update();
+	bool Finish();
+	void GetStats(CShaderLibraryStats &Stats);
+	void Destroy();
+
+protected:
+	bool Start(CVariant &Variant);
+	bool End(CProgram &Program);
+};
+
+extern CShaderLibrary ShaderLibrary;
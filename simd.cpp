@@ -0,0 +1,83 @@
+#include "simd.h"
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CCPUFeatures::CCPUFeatures()
+{
+	Detect();
+}
+
+void CCPUFeatures::Detect()
+{
+	SSE2 = SSSE3 = SSE41 = AVX = AVX2 = FMA = NEON = false;
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+
+	int Info[4];
+
+	__cpuid(Info, 0);
+
+	int MaxFunction = Info[0];
+
+	__cpuid(Info, 1);
+
+	SSE2 = (Info[3] & (1 << 26)) != 0;
+	SSSE3 = (Info[2] & (1 << 9)) != 0;
+	SSE41 = (Info[2] & (1 << 19)) != 0;
+	FMA = (Info[2] & (1 << 12)) != 0;
+
+	bool OSXSAVE = (Info[2] & (1 << 27)) != 0;
+
+	// the OS has to save the upper halves of the ymm registers on context switches
+
+	if(OSXSAVE && (Info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6)
+	{
+		AVX = true;
+
+		if(MaxFunction >= 7)
+		{
+			__cpuidex(Info, 7, 0);
+
+			AVX2 = (Info[1] & (1 << 5)) != 0;
+		}
+	}
+
+	FMA = FMA && AVX;
+
+#elif defined(SIMD_X86)
+
+	__builtin_cpu_init();
+
+	SSE2 = __builtin_cpu_supports("sse2") != 0;
+	SSSE3 = __builtin_cpu_supports("ssse3") != 0;
+	SSE41 = __builtin_cpu_supports("sse4.1") != 0;
+	AVX = __builtin_cpu_supports("avx") != 0;
+	AVX2 = __builtin_cpu_supports("avx2") != 0;
+	FMA = __builtin_cpu_supports("fma") != 0;
+
+#elif defined(SIMD_NEON)
+
+	NEON = true;
+
+#endif
+}
+
+const char* CCPUFeatures::GetBestInstructionSet()
+{
+	if(AVX2) return "AVX2";
+	if(AVX) return "AVX";
+	if(SSE41) return "SSE4.1";
+	if(SSSE3) return "SSSE3";
+	if(SSE2) return "SSE2";
+	if(NEON) return "NEON";
+
+	return "scalar";
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CCPUFeatures CPUFeatures;
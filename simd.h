@@ -0,0 +1,146 @@
+#pragma once
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+// MSVC accepts intrinsics of any instruction set in any function, gcc and clang need them enabled per function
+
+#if defined(SIMD_X86) && !defined(_MSC_VER)
+#define SIMD_TARGET(Features) __attribute__((target(Features)))
+#else
+#define SIMD_TARGET(Features)
+#endif
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// four floats in one register, SSE is part of every x86-64 CPU and NEON of every ARM64 CPU; Float4LoadBytes reads 4 bytes,
+// Float4StoreBytes rounds, saturates to 0 - 255 and writes 4 bytes; Float4Round rounds to the nearest integer, for values
+// within the int range; Float4Transpose turns four rows into four columns
+
+#if defined(SIMD_X86)
+
+typedef __m128 FLOAT4;
+
+inline FLOAT4 Float4Load(const float *p) { return _mm_loadu_ps(p); }
+inline void Float4Store(float *p, FLOAT4 v) { _mm_storeu_ps(p, v); }
+inline FLOAT4 Float4Set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+inline FLOAT4 Float4Set1(float x) { return _mm_set1_ps(x); }
+inline FLOAT4 Float4Add(FLOAT4 a, FLOAT4 b) { return _mm_add_ps(a, b); }
+inline FLOAT4 Float4Sub(FLOAT4 a, FLOAT4 b) { return _mm_sub_ps(a, b); }
+inline FLOAT4 Float4Mul(FLOAT4 a, FLOAT4 b) { return _mm_mul_ps(a, b); }
+inline FLOAT4 Float4Min(FLOAT4 a, FLOAT4 b) { return _mm_min_ps(a, b); }
+inline FLOAT4 Float4Max(FLOAT4 a, FLOAT4 b) { return _mm_max_ps(a, b); }
+inline FLOAT4 Float4Round(FLOAT4 a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+inline void Float4Transpose(FLOAT4 &a, FLOAT4 &b, FLOAT4 &c, FLOAT4 &d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+
+inline FLOAT4 Float4LoadBytes(const unsigned char *p)
+{
+	int i;
+	memcpy(&i, p, 4);
+
+	__m128i Zero = _mm_setzero_si128();
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(i), Zero), Zero));
+}
+
+inline void Float4StoreBytes(unsigned char *p, FLOAT4 v)
+{
+	__m128i i = _mm_cvtps_epi32(v);
+	i = _mm_packs_epi32(i, i);
+
+	int r = _mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+	memcpy(p, &r, 4);
+}
+
+#elif defined(SIMD_NEON)
+
+typedef float32x4_t FLOAT4;
+
+inline FLOAT4 Float4Load(const float *p) { return vld1q_f32(p); }
+inline void Float4Store(float *p, FLOAT4 v) { vst1q_f32(p, v); }
+inline FLOAT4 Float4Set(float x, float y, float z, float w) { float v[4] = {x, y, z, w}; return vld1q_f32(v); }
+inline FLOAT4 Float4Set1(float x) { return vdupq_n_f32(x); }
+inline FLOAT4 Float4Add(FLOAT4 a, FLOAT4 b) { return vaddq_f32(a, b); }
+inline FLOAT4 Float4Sub(FLOAT4 a, FLOAT4 b) { return vsubq_f32(a, b); }
+inline FLOAT4 Float4Mul(FLOAT4 a, FLOAT4 b) { return vmulq_f32(a, b); }
+inline FLOAT4 Float4Min(FLOAT4 a, FLOAT4 b) { return vminq_f32(a, b); }
+inline FLOAT4 Float4Max(FLOAT4 a, FLOAT4 b) { return vmaxq_f32(a, b); }
+inline FLOAT4 Float4Round(FLOAT4 a) { return vcvtq_f32_s32(vcvtnq_s32_f32(a)); }
+
+inline void Float4Transpose(FLOAT4 &a, FLOAT4 &b, FLOAT4 &c, FLOAT4 &d)
+{
+	float32x4x2_t ab = vtrnq_f32(a, b), cd = vtrnq_f32(c, d);
+
+	a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+	b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+	c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+	d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+inline FLOAT4 Float4LoadBytes(const unsigned char *p)
+{
+	uint32_t i;
+	memcpy(&i, p, 4);
+
+	uint8x8_t b = vreinterpret_u8_u32(vdup_n_u32(i));
+	return vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(b))));
+}
+
+inline void Float4StoreBytes(unsigned char *p, FLOAT4 v)
+{
+	uint16x4_t h = vqmovn_u32(vcvtq_u32_f32(vaddq_f32(v, vdupq_n_f32(0.5f))));
+	uint32_t i = vget_lane_u32(vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(h, h))), 0);
+	memcpy(p, &i, 4);
+}
+
+#else
+
+struct FLOAT4 { float v[4]; };
+
+inline FLOAT4 Float4Load(const float *p) { FLOAT4 r = {{p[0], p[1], p[2], p[3]}}; return r; }
+inline void Float4Store(float *p, FLOAT4 v) { p[0] = v.v[0]; p[1] = v.v[1]; p[2] = v.v[2]; p[3] = v.v[3]; }
+inline FLOAT4 Float4Set(float x, float y, float z, float w) { FLOAT4 r = {{x, y, z, w}}; return r; }
+inline FLOAT4 Float4Set1(float x) { FLOAT4 r = {{x, x, x, x}}; return r; }
+inline FLOAT4 Float4Add(FLOAT4 a, FLOAT4 b) { for(int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+inline FLOAT4 Float4Sub(FLOAT4 a, FLOAT4 b) { for(int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+inline FLOAT4 Float4Mul(FLOAT4 a, FLOAT4 b) { for(int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+inline FLOAT4 Float4Min(FLOAT4 a, FLOAT4 b) { for(int i = 0; i < 4; i++) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline FLOAT4 Float4Max(FLOAT4 a, FLOAT4 b) { for(int i = 0; i < 4; i++) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+
+inline FLOAT4 Float4LoadBytes(const unsigned char *p) { FLOAT4 r = {{(float)p[0], (float)p[1], (float)p[2], (float)p[3]}}; return r; }
+inline void Float4StoreBytes(unsigned char *p, FLOAT4 v) { for(int i = 0; i < 4; i++) p[i] = v.v[i] <= 0.0f ? 0 : v.v[i] >= 255.0f ? 255 : (unsigned char)(v.v[i] + 0.5f); }
+inline FLOAT4 Float4Round(FLOAT4 a) { for(int i = 0; i < 4; i++) a.v[i] = (float)(int)(a.v[i] + (a.v[i] < 0.0f ? -0.5f : 0.5f)); return a; }
+
+inline void Float4Transpose(FLOAT4 &a, FLOAT4 &b, FLOAT4 &c, FLOAT4 &d)
+{
+	FLOAT4 r[4] = {a, b, c, d};
+
+	for(int i = 0; i < 4; i++)
+	{
+		a.v[i] = r[i].v[0]; b.v[i] = r[i].v[1]; c.v[i] = r[i].v[2]; d.v[i] = r[i].v[3];
+	}
+}
+
+#endif
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CCPUFeatures
+{
+public:
+	bool SSE2, SSSE3, SSE41, AVX, AVX2, FMA, NEON;
+
+public:
+	CCPUFeatures();
+
+	void Detect();
+	const char* GetBestInstructionSet();
+};
+
+extern CCPUFeatures CPUFeatures;
@@ -1,30 +1,68 @@
+#include "platform.h"
 #include "string.h"
 
+#include <utility>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CStringView::CStringView(const char *String)
+{
+	this->String = String;
+	Length = (int)strlen(String);
+}
+
+CStringView::CStringView(const char *String, int Length)
+{
+	this->String = String;
+	this->Length = Length;
+}
+
+CStringView::CStringView(const CString &String)
+{
+	this->String = String.String;
+	Length = String.Length;
+}
+
 // ----------------------------------------------------------------------------------------------------------------------------
 
 CString::CString()
 {
-	String = NULL;
+	String = SmallString;
+	Capacity = CSTRING_SMALL_STRING_SIZE;
 	Empty();
 }
 
 CString::CString(const char *DefaultString)
 {
-	String = NULL;
+	String = SmallString;
+	Capacity = CSTRING_SMALL_STRING_SIZE;
 	Empty();
-	Set(DefaultString);
+	AppendString(DefaultString, (int)strlen(DefaultString));
 }
 
 CString::CString(const CString &DefaultString)
 {
-	String = NULL;
+	String = SmallString;
+	Capacity = CSTRING_SMALL_STRING_SIZE;
 	Empty();
-	Set(DefaultString.String);
+	AppendString(DefaultString.String, DefaultString.Length);
+}
+
+CString::CString(CString &&DefaultString)
+{
+	String = SmallString;
+	Capacity = CSTRING_SMALL_STRING_SIZE;
+	Length = 0;
+
+	*this = std::move(DefaultString);
 }
 
 CString::~CString()
 {
-	delete [] String;
+	if(String != SmallString)
+	{
+		delete [] String;
+	}
 }
 
 CString::operator char* ()
@@ -34,46 +72,115 @@ CString::operator char* ()
 
 CString& CString::operator = (const char *NewString)
 {
-	if(String != NewString) Set(NewString);
+	if(String != NewString)
+	{
+		Empty();
+		AppendString(NewString, (int)strlen(NewString));
+	}
+
 	return *this;
 }
 
 CString& CString::operator = (const CString &NewString)
 {
-	if(this != &NewString) Set(NewString.String);
+	if(this != &NewString)
+	{
+		Empty();
+		AppendString(NewString.String, NewString.Length);
+	}
+
+	return *this;
+}
+
+CString& CString::operator = (CString &&NewString)
+{
+	if(this == &NewString)
+	{
+		return *this;
+	}
+
+	if(NewString.String == NewString.SmallString)
+	{
+		Empty();
+		AppendString(NewString.String, NewString.Length);
+	}
+	else
+	{
+		if(String != SmallString)
+		{
+			delete [] String;
+		}
+
+		String = NewString.String;
+		Length = NewString.Length;
+		Capacity = NewString.Capacity;
+
+		NewString.String = NewString.SmallString;
+		NewString.Capacity = CSTRING_SMALL_STRING_SIZE;
+	}
+
+	NewString.Empty();
+
 	return *this;
 }
 
 CString& CString::operator += (const char *NewString)
 {
-	Append(NewString);
+	AppendString(NewString, (int)strlen(NewString));
 	return *this;
 }
 
 CString& CString::operator += (const CString &NewString)
 {
-	Append(NewString.String);
+	AppendString(NewString.String, NewString.Length);
 	return *this;
 }
 
 CString operator + (const CString &String1, const char *String2)
 {
-	CString String = String1;
-	String += String2;
+	int String2Length = (int)strlen(String2);
+	CString String;
+	String.Reserve(String1.Length + String2Length);
+	String.AppendString(String1.String, String1.Length);
+	String.AppendString(String2, String2Length);
 	return String;
 }
 
 CString operator + (const char *String1, const CString &String2)
 {
-	CString String = String1;
-	String += String2;
+	int String1Length = (int)strlen(String1);
+	CString String;
+	String.Reserve(String1Length + String2.Length);
+	String.AppendString(String1, String1Length);
+	String.AppendString(String2.String, String2.Length);
 	return String;
 }
 
 CString operator + (const CString &String1, const CString &String2)
 {
-	CString String = String1;
-	String += String2;
+	CString String;
+	String.Reserve(String1.Length + String2.Length);
+	String.AppendString(String1.String, String1.Length);
+	String.AppendString(String2.String, String2.Length);
+	return String;
+}
+
+CString operator + (CString &&String1, const char *String2)
+{
+	String1.AppendString(String2, (int)strlen(String2));
+	return std::move(String1);
+}
+
+CString operator + (CString &&String1, const CString &String2)
+{
+	String1.AppendString(String2.String, String2.Length);
+	return std::move(String1);
+}
+
+CString CString::Concat(std::initializer_list<CStringView> Strings)
+{
+	CString String;
+	String.AppendStrings(Strings);
 	return String;
 }
 
@@ -83,21 +190,74 @@ void CString::Append(const char *Format, ...)
 
 	va_start(ArgList, Format);
 
-	int AppendixLength = _vscprintf(Format, ArgList);
-	char *Appendix = new char[AppendixLength + 1];
-	vsprintf_s(Appendix, AppendixLength + 1, Format, ArgList);
+	AppendV(Format, ArgList);
+
+	va_end(ArgList);
+}
+
+void CString::AppendV(const char *Format, va_list ArgList)
+{
+	FormatV(Format, ArgList, false);
+}
+
+void CString::AppendString(const char *NewString, int NewStringLength)
+{
+	if(Length + NewStringLength >= Capacity)
+	{
+		// NewString may point into this string, so it has to stay valid until copied
+
+		char *OldString = String;
+		bool OldStringIsSmall = OldString == SmallString;
+
+		int NewCapacity = Capacity * 2;
+
+		if(NewCapacity < Length + NewStringLength + 1)
+		{
+			NewCapacity = Length + NewStringLength + 1;
+		}
+
+		String = new char[NewCapacity];
+		memcpy(String, OldString, Length);
+		memcpy(String + Length, NewString, NewStringLength);
+
+		Capacity = NewCapacity;
+
+		if(!OldStringIsSmall)
+		{
+			delete [] OldString;
+		}
+	}
+	else
+	{
+		memmove(String + Length, NewString, NewStringLength);
+	}
 
-	char *OldString = String;
-	int OldStringLength = (int)strlen(String);
+	Length += NewStringLength;
+	String[Length] = 0;
+}
+
+void CString::AppendStrings(std::initializer_list<CStringView> Strings)
+{
+	int StringsLength = 0;
+
+	for(const CStringView &View : Strings)
+	{
+		if(View.String >= String && View.String < String + Capacity)
+		{
+			CString Copy = Concat(Strings);
+			AppendString(Copy.String, Copy.Length);
+			return;
+		}
+
+		StringsLength += View.Length;
+	}
 
-	int StringLength = OldStringLength + AppendixLength;
-	String = new char[StringLength + 1];
-	
-	strcpy_s(String, StringLength + 1, OldString);
-	strcat_s(String, StringLength + 1, Appendix);
+	Reserve(Length + StringsLength);
 
-	delete [] OldString;
-	delete [] Appendix;
+	for(const CStringView &View : Strings)
+	{
+		AppendString(View.String, View.Length);
+	}
 }
 
 void CString::Set(const char *Format, ...)
@@ -106,16 +266,87 @@ void CString::Set(const char *Format, ...)
 
 	va_start(ArgList, Format);
 
-	delete [] String;
+	FormatV(Format, ArgList, true);
 
-	int StringLength = _vscprintf(Format, ArgList);
-	String = new char[StringLength + 1];
-	vsprintf_s(String, StringLength + 1, Format, ArgList);
+	va_end(ArgList);
 }
 
 void CString::Empty()
 {
-	delete [] String;
-	String = new char[1];
+	Length = 0;
 	String[0] = 0;
 }
+
+int CString::GetLength() const
+{
+	return Length;
+}
+
+// a %s argument may point into this string, which growing it would free, so the text is formatted into a buffer of
+// its own and appended by AppendString; Set only drops the old text after formatting
+
+void CString::FormatV(const char *Format, va_list ArgList, bool Replace)
+{
+	char Buffer[CSTRING_FORMAT_BUFFER_SIZE];
+
+	va_list ArgListCopy;
+
+	va_copy(ArgListCopy, ArgList);
+
+	int FormattedLength = vsnprintf(Buffer, sizeof(Buffer), Format, ArgListCopy);
+
+	va_end(ArgListCopy);
+
+	if(Replace)
+	{
+		Length = 0;
+	}
+
+	if(FormattedLength < 0)
+	{
+		String[Length] = 0;
+		return;
+	}
+
+	if(FormattedLength < (int)sizeof(Buffer))
+	{
+		AppendString(Buffer, FormattedLength);
+		return;
+	}
+
+	char *LongBuffer = new char[FormattedLength + 1];
+
+	vsnprintf(LongBuffer, FormattedLength + 1, Format, ArgList);
+
+	AppendString(LongBuffer, FormattedLength);
+
+	delete [] LongBuffer;
+}
+
+void CString::Reserve(int NewCapacity)
+{
+	if(NewCapacity < Capacity)
+	{
+		return;
+	}
+
+	if(NewCapacity < Capacity * 2)
+	{
+		NewCapacity = Capacity * 2;
+	}
+	else
+	{
+		NewCapacity++;
+	}
+
+	char *NewString = new char[NewCapacity];
+	memcpy(NewString, String, Length + 1);
+
+	if(String != SmallString)
+	{
+		delete [] String;
+	}
+
+	String = NewString;
+	Capacity = NewCapacity;
+}
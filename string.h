@@ -1,18 +1,51 @@
+#pragma once
+
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 
+#include <initializer_list>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+#define CSTRING_SMALL_STRING_SIZE 128
+
+// Append and Set format into a stack buffer of this size and only allocate for longer text
+
+#define CSTRING_FORMAT_BUFFER_SIZE 1024
+
+class CString;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CStringView
+{
+public:
+	const char *String;
+	int Length;
+
+public:
+	CStringView(const char *String);
+	CStringView(const char *String, int Length);
+	CStringView(const CString &String);
+};
+
 // ----------------------------------------------------------------------------------------------------------------------------
 
 class CString
 {
+	friend class CStringView;
+
 protected:
 	char *String;
+	int Length, Capacity;
+	char SmallString[CSTRING_SMALL_STRING_SIZE];
 
 public:
 	CString();
 	CString(const char *DefaultString);
 	CString(const CString &DefaultString);
+	CString(CString &&DefaultString);
 
 	~CString();
 
@@ -20,14 +53,27 @@ public:
 
 	CString& operator = (const char *NewString);
 	CString& operator = (const CString &NewString);
+	CString& operator = (CString &&NewString);
 	CString& operator += (const char *NewString);
 	CString& operator += (const CString &NewString);
 
 	friend CString operator + (const CString &String1, const char *String2);
 	friend CString operator + (const char *String1, const CString &String2);
 	friend CString operator + (const CString &String1, const CString &String2);
+	friend CString operator + (CString &&String1, const char *String2);
+	friend CString operator + (CString &&String1, const CString &String2);
+
+	static CString Concat(std::initializer_list<CStringView> Strings);
 
 	void Append(const char *Format, ...);
+	void AppendV(const char *Format, va_list ArgList);
+	void AppendString(const char *NewString, int NewStringLength);
+	void AppendStrings(std::initializer_list<CStringView> Strings);
 	void Set(const char *Format, ...);
 	void Empty();
+	int GetLength() const;
+	void Reserve(int NewCapacity);
+
+protected:
+	void FormatV(const char *Format, va_list ArgList, bool Replace);
 };
@@ -0,0 +1,581 @@
+#include "textureatlas.h"
+#include "profiler.h"
+#include "shaderlibrary.h"
+
+#include <algorithm>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CRectPacker::CRectPacker()
+{
+	Width = Height = 0;
+	UsedArea = 0;
+}
+
+CRectPacker::~CRectPacker()
+{
+}
+
+void CRectPacker::Init(int Width, int Height)
+{
+	this->Width = Width;
+	this->Height = Height;
+
+	FreeRects.clear();
+	FreeRects.push_back({0, 0, Width, Height});
+
+	UsedArea = 0;
+}
+
+// the free rectangle that leaves the shortest side is taken, the longer leftover side breaks ties
+
+bool CRectPacker::Insert(int Width, int Height, CAtlasRect &Rect)
+{
+	int BestShortSide = 0x7FFFFFFF, BestLongSide = 0x7FFFFFFF, Best = -1;
+
+	for(int i = 0; i < (int)FreeRects.size(); i++)
+	{
+		CAtlasRect &Free = FreeRects[i];
+
+		if(Free.Width < Width || Free.Height < Height)
+		{
+			continue;
+		}
+
+		int dx = Free.Width - Width, dy = Free.Height - Height;
+		int ShortSide = std::min(dx, dy), LongSide = std::max(dx, dy);
+
+		if(ShortSide < BestShortSide || (ShortSide == BestShortSide && LongSide < BestLongSide))
+		{
+			BestShortSide = ShortSide;
+			BestLongSide = LongSide;
+			Best = i;
+		}
+	}
+
+	if(Best == -1)
+	{
+		return false;
+	}
+
+	Rect = {FreeRects[Best].x, FreeRects[Best].y, Width, Height};
+
+	Split(Rect);
+	Prune();
+
+	UsedArea += (long long)Width * Height;
+
+	return true;
+}
+
+long long CRectPacker::GetUsedArea()
+{
+	return UsedArea;
+}
+
+// every free rectangle the used one overlaps is replaced by up to four maximal rectangles around it
+
+void CRectPacker::Split(const CAtlasRect &Used)
+{
+	std::vector<CAtlasRect> Split;
+
+	for(size_t i = 0; i < FreeRects.size(); i++)
+	{
+		CAtlasRect &Free = FreeRects[i];
+
+		if(Used.x >= Free.x + Free.Width || Used.x + Used.Width <= Free.x || Used.y >= Free.y + Free.Height || Used.y + Used.Height <= Free.y)
+		{
+			Split.push_back(Free);
+			continue;
+		}
+
+		if(Used.x > Free.x)
+		{
+			Split.push_back({Free.x, Free.y, Used.x - Free.x, Free.Height});
+		}
+
+		if(Used.x + Used.Width < Free.x + Free.Width)
+		{
+			Split.push_back({Used.x + Used.Width, Free.y, Free.x + Free.Width - Used.x - Used.Width, Free.Height});
+		}
+
+		if(Used.y > Free.y)
+		{
+			Split.push_back({Free.x, Free.y, Free.Width, Used.y - Free.y});
+		}
+
+		if(Used.y + Used.Height < Free.y + Free.Height)
+		{
+			Split.push_back({Free.x, Used.y + Used.Height, Free.Width, Free.y + Free.Height - Used.y - Used.Height});
+		}
+	}
+
+	FreeRects.swap(Split);
+}
+
+// free rectangles inside other free rectangles are dropped
+
+void CRectPacker::Prune()
+{
+	auto Contains = [](const CAtlasRect &a, const CAtlasRect &b)
+	{
+		return b.x >= a.x && b.y >= a.y && b.x + b.Width <= a.x + a.Width && b.y + b.Height <= a.y + a.Height;
+	};
+
+	for(int i = 0; i < (int)FreeRects.size(); i++)
+	{
+		for(int j = i + 1; j < (int)FreeRects.size(); j++)
+		{
+			if(Contains(FreeRects[j], FreeRects[i]))
+			{
+				FreeRects.erase(FreeRects.begin() + i--);
+				break;
+			}
+
+			if(Contains(FreeRects[i], FreeRects[j]))
+			{
+				FreeRects.erase(FreeRects.begin() + j--);
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CTextureAtlas::CTextureAtlas()
+{
+	ArrayProgramVariant = -1;
+
+	SetDefaults();
+}
+
+CTextureAtlas::~CTextureAtlas()
+{
+}
+
+// only the array textures need a shader, the variant stays added when the atlas is built again
+
+void CTextureAtlas::AddPrograms()
+{
+	if(ArrayProgramVariant == -1 && IsArraySupported())
+	{
+		ArrayProgramVariant = ShaderLibrary.Add("glsl120atlasarray.vs", "glsl120atlasarray.fs");
+	}
+}
+
+// the file lists an image file name per line, relative to the module directory like the textures
+
+bool CTextureAtlas::Load(const char *FileName)
+{
+	CString PathName = CString::Concat({ModuleDirectory, FileName});
+
+	FILE *File;
+
+	if(fopen_s(&File, PathName, "rt") != 0)
+	{
+		ErrorLog.Append("Error loading file %s!\r\n", (char*)PathName);
+		return false;
+	}
+
+	std::vector<CString> Names;
+
+	char Line[256];
+
+	while(fgets(Line, 256, File) != NULL)
+	{
+		size_t Length = strlen(Line);
+
+		while(Length > 0 && (Line[Length - 1] == '\r' || Line[Length - 1] == '\n' || Line[Length - 1] == ' '))
+		{
+			Line[--Length] = 0;
+		}
+
+		if(Length == 0 || Line[0] == '#') continue;
+
+		Names.push_back(CString(Line));
+	}
+
+	fclose(File);
+
+	if(Names.size() == 0)
+	{
+		ErrorLog.Append("Error loading file %s! -> no images listed\r\n", (char*)PathName);
+		return false;
+	}
+
+	std::vector<const char*> FileNames;
+
+	for(size_t i = 0; i < Names.size(); i++)
+	{
+		FileNames.push_back(Names[i]);
+	}
+
+	return Build(FileNames.data(), (int)FileNames.size());
+}
+
+// the largest images are packed first, each goes to the first page with room for it
+
+bool CTextureAtlas::Build(const char **FileNames, int Count)
+{
+	PROFILE_ZONE("CTextureAtlas::Build");
+
+	Destroy();
+
+	Array = IsArraySupported();
+
+	PageSize = std::min(TEXTURE_ATLAS_PAGE_SIZE, gl_max_texture_size);
+
+	if(Array)
+	{
+		AddPrograms();
+
+		if((ArrayProgram = ShaderLibrary.Get(ArrayProgramVariant)) == NULL)
+		{
+			return false;
+		}
+	}
+
+	FIBITMAP **dibs = new FIBITMAP*[Count];
+
+	memset(dibs, 0, sizeof(FIBITMAP*) * Count);
+
+	bool Error = false;
+
+	for(int i = 0; i < Count; i++)
+	{
+		CString FileName = CString::Concat({ModuleDirectory, FileNames[i]});
+		CString ErrorText = CString::Concat({"Error loading file ", FileName, "! ->"});
+
+		FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(FileName);
+
+		if(fif == FIF_UNKNOWN)
+		{
+			fif = FreeImage_GetFIFFromFilename(FileName);
+		}
+
+		FIBITMAP *dib = NULL;
+
+		if(fif != FIF_UNKNOWN && FreeImage_FIFSupportsReading(fif))
+		{
+			dib = FreeImage_Load(fif, FileName);
+		}
+
+		if(dib == NULL)
+		{
+			ErrorLog.AppendStrings({ErrorText, "dib is NULL", "\r\n"});
+			Error = true;
+			break;
+		}
+
+		// every page is BGRA, so is every image
+
+		dibs[i] = FreeImage_ConvertTo32Bits(dib);
+
+		FreeImage_Unload(dib);
+
+		if(dibs[i] == NULL)
+		{
+			ErrorLog.AppendStrings({ErrorText, "FreeImage_ConvertTo32Bits failed", "\r\n"});
+			Error = true;
+			break;
+		}
+
+		int Width = FreeImage_GetWidth(dibs[i]), Height = FreeImage_GetHeight(dibs[i]);
+
+		if(Width == 0 || Height == 0 || Width > PageSize - TEXTURE_ATLAS_PADDING * 2 || Height > PageSize - TEXTURE_ATLAS_PADDING * 2)
+		{
+			ErrorLog.AppendStrings({ErrorText, "the image does not fit into an atlas page", "\r\n"});
+			Error = true;
+			break;
+		}
+	}
+
+	std::vector<CRectPacker> Packers;
+	std::vector<BYTE*> Pages;
+
+	if(!Error)
+	{
+		Regions = new CAtlasRegion[Count];
+		RegionsCount = Count;
+
+		std::vector<int> Order(Count);
+
+		for(int i = 0; i < Count; i++)
+		{
+			Order[i] = i;
+		}
+
+		std::sort(Order.begin(), Order.end(), [dibs](int a, int b)
+		{
+			int aWidth = FreeImage_GetWidth(dibs[a]), aHeight = FreeImage_GetHeight(dibs[a]);
+			int bWidth = FreeImage_GetWidth(dibs[b]), bHeight = FreeImage_GetHeight(dibs[b]);
+
+			int aSide = std::max(aWidth, aHeight), bSide = std::max(bWidth, bHeight);
+
+			return aSide != bSide ? aSide > bSide : aWidth * aHeight > bWidth * bHeight;
+		});
+
+		for(int i = 0; i < Count; i++)
+		{
+			FIBITMAP *dib = dibs[Order[i]];
+
+			int Width = FreeImage_GetWidth(dib), Height = FreeImage_GetHeight(dib);
+
+			int PaddedWidth = (Width + TEXTURE_ATLAS_PADDING * 3 - 1) / TEXTURE_ATLAS_PADDING * TEXTURE_ATLAS_PADDING;
+			int PaddedHeight = (Height + TEXTURE_ATLAS_PADDING * 3 - 1) / TEXTURE_ATLAS_PADDING * TEXTURE_ATLAS_PADDING;
+
+			CAtlasRect Rect;
+
+			size_t Page = 0;
+
+			while(Page < Packers.size() && !Packers[Page].Insert(PaddedWidth, PaddedHeight, Rect))
+			{
+				Page++;
+			}
+
+			if(Page == Packers.size())
+			{
+				Packers.push_back(CRectPacker());
+				Packers[Page].Init(PageSize, PageSize);
+				Packers[Page].Insert(PaddedWidth, PaddedHeight, Rect);
+
+				BYTE *Data = new BYTE[PageSize * PageSize * 4];
+				memset(Data, 0, PageSize * PageSize * 4);
+				Pages.push_back(Data);
+			}
+
+			CopyPadded(dib, Pages[Page], PageSize, Rect.x, Rect.y);
+
+			CAtlasRegion &Region = Regions[Order[i]];
+
+			Region.Page = (int)Page;
+			Region.Width = Width;
+			Region.Height = Height;
+			Region.Scale = vec2((float)Width / PageSize, (float)Height / PageSize);
+			Region.Offset = vec2((float)(Rect.x + TEXTURE_ATLAS_PADDING) / PageSize, (float)(Rect.y + TEXTURE_ATLAS_PADDING) / PageSize);
+
+			Stats.ImagePixels += (long long)Width * Height;
+		}
+
+		PagesCount = (int)Pages.size();
+
+		if(Array)
+		{
+			GLint MaxLayers = 0;
+
+			glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &MaxLayers);
+
+			if(PagesCount > MaxLayers) Array = false;
+		}
+
+		Error |= !Upload(Pages.data());
+	}
+
+	for(size_t i = 0; i < Pages.size(); i++)
+	{
+		delete [] Pages[i];
+	}
+
+	for(int i = 0; i < Count; i++)
+	{
+		if(dibs[i]) FreeImage_Unload(dibs[i]);
+	}
+
+	delete [] dibs;
+
+	if(Error)
+	{
+		Destroy();
+		return false;
+	}
+
+	Stats.Images = Count;
+	Stats.Pages = PagesCount;
+	Stats.Binds = Array ? 1 : PagesCount;
+	Stats.UnbatchedBinds = Count;
+	Stats.PagePixels = (long long)PagesCount * PageSize * PageSize;
+	Stats.Efficiency = (float)((double)Stats.ImagePixels / Stats.PagePixels);
+
+	return true;
+}
+
+int CTextureAtlas::GetRegionsCount()
+{
+	return RegionsCount;
+}
+
+const CAtlasRegion& CTextureAtlas::GetRegion(int Image)
+{
+	return Regions[Image];
+}
+
+bool CTextureAtlas::IsArray()
+{
+	return Array;
+}
+
+int CTextureAtlas::GetPagesCount()
+{
+	return PagesCount;
+}
+
+// the third coordinate is the layer of the array texture and is ignored with separate pages
+
+void CTextureAtlas::RemapTexCoords(int Image, const vec2 *TexCoords, int Count, vec3 *Remapped)
+{
+	CAtlasRegion &Region = Regions[Image];
+
+	for(int i = 0; i < Count; i++)
+	{
+		Remapped[i] = vec3(Region.Offset + TexCoords[i] * Region.Scale, (float)Region.Page);
+	}
+}
+
+void CTextureAtlas::Bind(int Page)
+{
+	if(Array)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, Textures[0]);
+		glUseProgram(*ArrayProgram);
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_2D, Textures[Page]);
+	}
+}
+
+void CTextureAtlas::Unbind()
+{
+	if(Array)
+	{
+		glUseProgram(0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+}
+
+void CTextureAtlas::GetStats(CTextureAtlasStats &Stats)
+{
+	Stats = this->Stats;
+}
+
+void CTextureAtlas::Destroy()
+{
+	if(Textures)
+	{
+		glDeleteTextures(Array ? 1 : PagesCount, Textures);
+		delete [] Textures;
+	}
+
+	delete [] Regions;
+
+	SetDefaults();
+}
+
+bool CTextureAtlas::IsArraySupported()
+{
+	return gl_version >= 30 || (gl_version >= 21 && GLEW_EXT_texture_array);
+}
+
+bool CTextureAtlas::Upload(BYTE **Pages)
+{
+	CMipmapChain *Mipmaps = new CMipmapChain[PagesCount];
+
+	for(int Page = 0; Page < PagesCount; Page++)
+	{
+		if(!Mipmaps[Page].Generate(Pages[Page], PageSize, PageSize, PageSize * 4, 4, MIPMAP_FILTER_KAISER, true, false))
+		{
+			ErrorLog.Append("CTextureAtlas::Upload -> Mipmaps.Generate failed!\r\n");
+			delete [] Mipmaps;
+			return false;
+		}
+	}
+
+	int LevelsCount = std::min(TEXTURE_ATLAS_LEVELS, Mipmaps[0].LevelsCount);
+
+	GLenum Target = Array ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+
+	Textures = new GLuint[PagesCount];
+	memset(Textures, 0, sizeof(GLuint) * PagesCount);
+
+	glGenTextures(Array ? 1 : PagesCount, Textures);
+
+	for(int Page = 0; Page < PagesCount; Page++)
+	{
+		if(Page == 0 || !Array)
+		{
+			glBindTexture(Target, Textures[Page]);
+
+			glTexParameteri(Target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(Target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(Target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(Target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(Target, GL_TEXTURE_MAX_LEVEL, LevelsCount - 1);
+
+			if(Array)
+			{
+				for(int Level = 0; Level < LevelsCount; Level++)
+				{
+					CMipmapLevel &MipmapLevel = Mipmaps[0].Levels[Level];
+
+					glTexImage3D(GL_TEXTURE_2D_ARRAY, Level, GL_RGBA8, MipmapLevel.Width, MipmapLevel.Height, PagesCount, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+				}
+			}
+		}
+
+		for(int Level = 0; Level < LevelsCount; Level++)
+		{
+			CMipmapLevel &MipmapLevel = Mipmaps[Page].Levels[Level];
+
+			if(Array)
+			{
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, Level, 0, 0, Page, MipmapLevel.Width, MipmapLevel.Height, 1, GL_BGRA, GL_UNSIGNED_BYTE, MipmapLevel.Data);
+			}
+			else
+			{
+				glTexImage2D(GL_TEXTURE_2D, Level, GL_RGBA8, MipmapLevel.Width, MipmapLevel.Height, 0, GL_BGRA, GL_UNSIGNED_BYTE, MipmapLevel.Data);
+			}
+		}
+	}
+
+	glBindTexture(Target, 0);
+
+	delete [] Mipmaps;
+
+	return true;
+}
+
+void CTextureAtlas::SetDefaults()
+{
+	Textures = NULL;
+	PagesCount = PageSize = 0;
+	Array = false;
+	ArrayProgram = NULL;
+	Regions = NULL;
+	RegionsCount = 0;
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+// the image goes to x + padding, y + padding, the padding repeats its edge pixels
+
+void CTextureAtlas::CopyPadded(FIBITMAP *dib, BYTE *Page, int PageSize, int x, int y)
+{
+	int Width = FreeImage_GetWidth(dib), Height = FreeImage_GetHeight(dib);
+
+	for(int Row = -TEXTURE_ATLAS_PADDING; Row < Height + TEXTURE_ATLAS_PADDING; Row++)
+	{
+		DWORD *Source = (DWORD*)FreeImage_GetScanLine(dib, std::min(std::max(Row, 0), Height - 1));
+		DWORD *Destination = (DWORD*)(Page + ((size_t)(y + TEXTURE_ATLAS_PADDING + Row) * PageSize + x) * 4);
+
+		for(int Column = 0; Column < TEXTURE_ATLAS_PADDING; Column++)
+		{
+			Destination[Column] = Source[0];
+			Destination[TEXTURE_ATLAS_PADDING + Width + Column] = Source[Width - 1];
+		}
+
+		memcpy(Destination + TEXTURE_ATLAS_PADDING, Source, Width * 4);
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+#define TEXTURE_ATLAS_PAGE_SIZE 2048
+#define TEXTURE_ATLAS_PADDING 8
+#define TEXTURE_ATLAS_LEVELS 4
+
+struct CAtlasRect
+{
+	int x, y, Width, Height;
+};
+
+// MaxRects with the best short side fit; the free rectangles overlap, every one is as large as it can be
+
+class CRectPacker
+{
+protected:
+	int Width, Height;
+	std::vector<CAtlasRect> FreeRects;
+	long long UsedArea;
+
+public:
+	CRectPacker();
+	~CRectPacker();
+
+	void Init(int Width, int Height);
+	bool Insert(int Width, int Height, CAtlasRect &Rect);
+	long long GetUsedArea();
+
+protected:
+	void Split(const CAtlasRect &Used);
+	void Prune();
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// a region maps the texture coordinates of an image, which have to stay within 0 to 1, to its place in a page
+
+struct CAtlasRegion
+{
+	int Page, Width, Height;
+	vec2 Scale, Offset;
+};
+
+struct CTextureAtlasStats
+{
+	int Images, Pages, Binds, UnbatchedBinds;
+	long long ImagePixels, PagePixels;
+	float Efficiency;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// packs many small images into pages that are bound once for all objects using them; the pages are the layers of one
+// array texture when texture arrays are supported, separate textures otherwise; every image is surrounded by
+// TEXTURE_ATLAS_PADDING copies of its edge pixels and starts at a multiple of it, so the first TEXTURE_ATLAS_LEVELS
+// mip levels do not bleed and the rest are not used
+
+class CTextureAtlas
+{
+protected:
+	GLuint *Textures;
+	int PagesCount, PageSize;
+	bool Array;
+	int ArrayProgramVariant;
+	CShaderProgram *ArrayProgram;
+	CAtlasRegion *Regions;
+	int RegionsCount;
+	CTextureAtlasStats Stats;
+
+public:
+	CTextureAtlas();
+	~CTextureAtlas();
+
+	void AddPrograms();
+	bool Load(const char *FileName);
+	bool Build(const char **FileNames, int Count);
+	int GetRegionsCount();
+	const CAtlasRegion& GetRegion(int Image);
+	bool IsArray();
+	int GetPagesCount();
+	void RemapTexCoords(int Image, const vec2 *TexCoords, int Count, vec3 *Remapped);
+	void Bind(int Page);
+	void Unbind();
+	void GetStats(CTextureAtlasStats &Stats);
+	void Destroy();
+
+	static bool IsArraySupported();
+
+protected:
+	bool Upload(BYTE **Pages);
+	void SetDefaults();
+
+	static void CopyPadded(FIBITMAP *dib, BYTE *Page, int PageSize, int x, int y);
+};
@@ -0,0 +1,195 @@
+#include "win32_opengl_glew_freeimage_glm.h"
+#include "texturecache.h"
+#include "profiler.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// bump when the encoder or the mipmap generation changes the output
+
+#define TEXTURE_CACHE_VERSION 2
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CTextureCache::CTextureCache()
+{
+	Enabled = false;
+	Quality = BC_QUALITY_NORMAL;
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CTextureCache::~CTextureCache()
+{
+}
+
+void CTextureCache::Init(const char *Directory, bool Enabled, BC_QUALITY Quality)
+{
+	this->Directory = Directory;
+	this->Enabled = Enabled;
+	this->Quality = Quality;
+
+	// virtual texture pyramids are kept here even when nothing is compressed; without the directory the textures are
+	// still compressed, only encoded again next time
+
+	MakeDirectory(Directory);
+}
+
+bool CTextureCache::IsEnabled()
+{
+	return Enabled && (PixelFormatCaps.S3TC || PixelFormatCaps.RGTC || PixelFormatCaps.BPTC);
+}
+
+BC_QUALITY CTextureCache::GetQuality()
+{
+	return Quality;
+}
+
+bool CTextureCache::GetKey(const char *FileName, HASH64 &Key)
+{
+	PROFILE_ZONE("CTextureCache::GetKey");
+
+	HASH64 ContentHash;
+
+	if(!HashFile64(FileName, &ContentHash))
+	{
+		return false;
+	}
+
+	Key = GetKey(ContentHash);
+
+	return true;
+}
+
+// the size limits and the caps decide the level 0 size and the block format
+
+HASH64 CTextureCache::GetKey(HASH64 ContentHash)
+{
+	int Settings[] =
+	{
+		TEXTURE_CACHE_VERSION,
+		gl_max_texture_size,
+		GLEW_ARB_texture_non_power_of_two ? 1 : 0,
+		PixelFormatCaps.S3TC,
+		PixelFormatCaps.RGTC,
+		PixelFormatCaps.BPTC,
+		PixelFormatCaps.TextureSwizzle,
+		Quality
+	};
+
+	return Hash64(Settings, sizeof(Settings), ContentHash);
+}
+
+// grey goes to BC4 and is swizzled like R8, opaque to BC1 and the rest to BC3, BC7 replaces both at high quality or when
+// it is all there is; 16 bit per channel and float data and level 0 sizes off the 4x4 grid stay uncompressed
+
+BC_FORMAT CTextureCache::GetFormat(const CPixelFormat &PixelFormat, int Width, int Height, const CPixelFormatCaps &Caps)
+{
+	if(!Enabled || PixelFormat.Channels == 0 || PixelFormat.Type != GL_UNSIGNED_BYTE || Width % 4 != 0 || Height % 4 != 0)
+	{
+		return BC_FORMAT_NONE;
+	}
+
+	bool BC7 = Caps.BPTC && (Quality == BC_QUALITY_HIGH || !Caps.S3TC);
+
+	if(PixelFormat.Channels == 1 && Caps.RGTC && Caps.TextureSwizzle)
+	{
+		return BC_FORMAT_BC4;
+	}
+
+	if(PixelFormat.Channels < 4 || PixelFormat.Opaque)
+	{
+		return BC7 ? BC_FORMAT_BC7 : Caps.S3TC ? BC_FORMAT_BC1 : BC_FORMAT_NONE;
+	}
+
+	return BC7 ? BC_FORMAT_BC7 : Caps.S3TC ? BC_FORMAT_BC3 : BC_FORMAT_NONE;
+}
+
+bool CTextureCache::Load(HASH64 Key, CCompressedMipmapChain &Compressed)
+{
+	PROFILE_ZONE("CTextureCache::Load");
+
+	bool Loaded = Compressed.Load(GetFileName(Key));
+
+	if(Loaded)
+	{
+		CountBytes(Compressed);
+	}
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	if(Loaded) Stats.Hits++; else Stats.Misses++;
+
+	return Loaded;
+}
+
+bool CTextureCache::Encode(HASH64 Key, const CMipmapChain &Mipmaps, const CPixelFormat &PixelFormat, BC_FORMAT Format, CCompressedMipmapChain &Compressed)
+{
+	PROFILE_ZONE("CTextureCache::Encode");
+
+	bool BGR = PixelFormat.Format == GL_BGR || PixelFormat.Format == GL_BGRA;
+
+	double Start = GetTime();
+
+	if(!Compressed.Encode(Mipmaps, PixelFormat.Channels, BGR, Format, Quality))
+	{
+		return false;
+	}
+
+	// BC7 and BC1 hold opaque images as well, so a cache hit cannot tell from the format
+
+	Compressed.Opaque = PixelFormat.Opaque || PixelFormat.Channels < 4;
+
+	double EncodeTime = GetTime() - Start;
+
+	bool Written = Compressed.SaveDDS(GetFileName(Key));
+
+	CountBytes(Compressed);
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	Stats.Encoded++;
+	Stats.EncodeTime += EncodeTime;
+
+	for(int i = 0; i < Compressed.LevelsCount; i++)
+	{
+		Stats.EncodedPixels += (long long)Compressed.Levels[i].Width * Compressed.Levels[i].Height;
+	}
+
+	if(Written) Stats.Writes++;
+
+	return true;
+}
+
+void CTextureCache::GetStats(CTextureCacheStats &Stats)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	Stats = this->Stats;
+}
+
+CString CTextureCache::GetFileName(HASH64 Key, const char *Extension)
+{
+	CString FileName;
+
+	FileName.Set("%s%016llx.%s", (char*)Directory, Key, Extension);
+
+	return FileName;
+}
+
+void CTextureCache::CountBytes(const CCompressedMipmapChain &Compressed)
+{
+	long long UncompressedBytes = 0;
+
+	for(int i = 0; i < Compressed.LevelsCount; i++)
+	{
+		UncompressedBytes += (long long)Compressed.Levels[i].Width * Compressed.Levels[i].Height * 4;
+	}
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	Stats.UncompressedBytes += UncompressedBytes;
+	Stats.CompressedBytes += Compressed.Size;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CTextureCache TextureCache;
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "platform.h"
+#include "string.h"
+#include "hash.h"
+#include "blockcompress.h"
+#include "pixelformat.h"
+
+#include <mutex>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// bytes are counted for every texture served compressed, Uncompressed as if the levels were RGBA8
+
+struct CTextureCacheStats
+{
+	int Hits, Misses, Writes, Encoded;
+	double EncodeTime;
+	long long EncodedPixels, UncompressedBytes, CompressedBytes;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// block-compressed mip chains are kept as DDS files named after a hash of the source file contents and of everything
+// the encoded result depends on, so a texture is decoded, mipmapped and encoded once and later runs only read the
+// blocks; safe to call from the texture streamer threads
+
+class CTextureCache
+{
+protected:
+	std::mutex Mutex;
+	CString Directory;
+	bool Enabled;
+	BC_QUALITY Quality;
+	CTextureCacheStats Stats;
+
+public:
+	CTextureCache();
+	~CTextureCache();
+
+	void Init(const char *Directory, bool Enabled, BC_QUALITY Quality);
+	bool IsEnabled();
+	BC_QUALITY GetQuality();
+	bool GetKey(const char *FileName, HASH64 &Key);
+	HASH64 GetKey(HASH64 ContentHash);
+	BC_FORMAT GetFormat(const CPixelFormat &PixelFormat, int Width, int Height, const CPixelFormatCaps &Caps);
+	bool Load(HASH64 Key, CCompressedMipmapChain &Compressed);
+	bool Encode(HASH64 Key, const CMipmapChain &Mipmaps, const CPixelFormat &PixelFormat, BC_FORMAT Format, CCompressedMipmapChain &Compressed);
+	void GetStats(CTextureCacheStats &Stats);
+	CString GetFileName(HASH64 Key, const char *Extension = "dds");
+
+protected:
+	void CountBytes(const CCompressedMipmapChain &Compressed);
+};
+
+extern CTextureCache TextureCache;
@@ -0,0 +1,487 @@
+#include "win32_opengl_glew_freeimage_glm.h"
+#include "texturemanager.h"
+#include "texturestreamer.h"
+#include "threadpool.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CTextureEntry
+{
+public:
+	CTexture Texture;
+	CString FileName;
+	HASH64 ContentHash;
+	bool Hashed;
+	CTextureEntry *Shared;
+	int References, LastUsed, SkipLevels;
+	long long ExpectedBytes;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CTextureHashRequest
+{
+public:
+	CTextureEntry *Entry;
+	CString FileName;
+	HASH64 ContentHash;
+	bool Success;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CTextureHandle::CTextureHandle()
+{
+	Entry = NULL;
+}
+
+CTextureHandle::CTextureHandle(CTextureEntry *Entry)
+{
+	this->Entry = Entry;
+
+	if(Entry) TextureManager.AddReference(Entry);
+}
+
+CTextureHandle::CTextureHandle(const CTextureHandle &Handle)
+{
+	Entry = Handle.Entry;
+
+	if(Entry) TextureManager.AddReference(Entry);
+}
+
+CTextureHandle::CTextureHandle(CTextureHandle &&Handle)
+{
+	Entry = Handle.Entry;
+	Handle.Entry = NULL;
+}
+
+CTextureHandle::~CTextureHandle()
+{
+	Release();
+}
+
+CTextureHandle& CTextureHandle::operator = (const CTextureHandle &Handle)
+{
+	if(Entry != Handle.Entry)
+	{
+		if(Handle.Entry) TextureManager.AddReference(Handle.Entry);
+
+		Release();
+
+		Entry = Handle.Entry;
+	}
+
+	return *this;
+}
+
+CTextureHandle& CTextureHandle::operator = (CTextureHandle &&Handle)
+{
+	if(this != &Handle)
+	{
+		Release();
+
+		Entry = Handle.Entry;
+		Handle.Entry = NULL;
+	}
+
+	return *this;
+}
+
+CTextureHandle::operator GLuint ()
+{
+	if(Entry == NULL)
+	{
+		return 0;
+	}
+
+	CTextureEntry *Owner = Entry->Shared ? Entry->Shared : Entry;
+
+	TextureManager.Use(Owner);
+
+	return (GLuint)Owner->Texture;
+}
+
+bool CTextureHandle::IsValid()
+{
+	return Entry != NULL;
+}
+
+CTexture* CTextureHandle::GetTexture()
+{
+	if(Entry == NULL)
+	{
+		return NULL;
+	}
+
+	return Entry->Shared ? &Entry->Shared->Texture : &Entry->Texture;
+}
+
+void CTextureHandle::Release()
+{
+	if(Entry)
+	{
+		TextureManager.Release(Entry);
+		Entry = NULL;
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CTextureManager::CTextureManager()
+{
+	memset(&Stats, 0, sizeof(Stats));
+	Frame = 0;
+	Hashing = 0;
+
+	Budget = 0;
+}
+
+CTextureManager::~CTextureManager()
+{
+}
+
+CTextureHandle CTextureManager::LoadTexture2D(const char *Texture2DFileName)
+{
+	PROFILE_ZONE("CTextureManager::LoadTexture2D");
+
+	std::string Path = Texture2DFileName;
+
+	auto Found = Paths.find(Path);
+
+	if(Found != Paths.end())
+	{
+		Stats.PathHits++;
+		return CTextureHandle(Found->second);
+	}
+
+	CTextureEntry *Entry = new CTextureEntry();
+
+	Entry->FileName = Texture2DFileName;
+	Entry->ContentHash = 0;
+	Entry->Hashed = false;
+	Entry->Shared = NULL;
+	Entry->References = 0;
+	Entry->LastUsed = Frame;
+	Entry->SkipLevels = 0;
+	Entry->ExpectedBytes = 0;
+
+	TextureStreamer.ShowPlaceholder(&Entry->Texture);
+
+	CTextureHashRequest *Request = new CTextureHashRequest();
+
+	Request->Entry = Entry;
+	Request->FileName = CString::Concat({ModuleDirectory, Texture2DFileName});
+	Request->ContentHash = 0;
+	Request->Success = false;
+
+	HashRequests.push_back(Request);
+
+	Hashing++;
+
+	ThreadPool.Submit([this, Request]()
+	{
+		Request->Success = HashFile64(Request->FileName, &Request->ContentHash);
+
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		Hashed.push_back(Request);
+		Hashing--;
+
+		Condition.notify_all();
+	});
+
+	Paths[Path] = Entry;
+
+	return CTextureHandle(Entry);
+}
+
+// a level less quarters the size of a texture, the mipmaps included
+
+void CTextureManager::Update()
+{
+	PROFILE_ZONE("CTextureManager::Update");
+
+	Frame++;
+
+	UpdateHashes();
+
+	if(Budget <= 0)
+	{
+		return;
+	}
+
+	std::vector<CTextureEntry*> Entries;
+
+	long long Resident = 0;
+
+	for(auto &Content : Contents)
+	{
+		CTextureEntry *Entry = Content.second;
+
+		if(TextureStreamer.IsLoading(&Entry->Texture))
+		{
+			Resident += std::max(Entry->ExpectedBytes, Entry->Texture.GetResidentBytes());
+		}
+		else
+		{
+			Resident += Entry->Texture.GetResidentBytes();
+			Entries.push_back(Entry);
+		}
+	}
+
+	if(Resident > Budget)
+	{
+		std::sort(Entries.begin(), Entries.end(), [](CTextureEntry *a, CTextureEntry *b){ return a->LastUsed < b->LastUsed; });
+
+		for(size_t i = 0; i < Entries.size() && Resident > Budget; i++)
+		{
+			CTextureEntry *Entry = Entries[i];
+
+			if(Entry->Texture.GetLevelsCount() <= TEXTURE_MANAGER_MIN_LEVELS)
+			{
+				continue;
+			}
+
+			long long Bytes = Entry->Texture.GetResidentBytes();
+
+			if(Restream(Entry, Entry->SkipLevels + 1, Bytes / 4))
+			{
+				Resident -= Bytes * 3 / 4;
+
+				Stats.Demotions++;
+				Stats.DemotedBytes += Bytes * 3 / 4;
+			}
+		}
+	}
+	else
+	{
+		std::sort(Entries.begin(), Entries.end(), [](CTextureEntry *a, CTextureEntry *b){ return a->LastUsed > b->LastUsed; });
+
+		for(size_t i = 0; i < Entries.size() && Entries[i]->LastUsed >= Frame - 1; i++)
+		{
+			CTextureEntry *Entry = Entries[i];
+
+			if(Entry->SkipLevels == 0)
+			{
+				continue;
+			}
+
+			long long Bytes = Entry->Texture.GetResidentBytes();
+
+			if(Resident + Bytes * 3 > Budget)
+			{
+				break;
+			}
+
+			if(Restream(Entry, Entry->SkipLevels - 1, Bytes * 4))
+			{
+				Resident += Bytes * 3;
+
+				Stats.Promotions++;
+			}
+		}
+	}
+}
+
+// waits for the files being hashed and the textures being streamed, false if any of them failed
+
+bool CTextureManager::Finish()
+{
+	PROFILE_ZONE("CTextureManager::Finish");
+
+	int Failed = Stats.Failed;
+
+	{
+		std::unique_lock<std::mutex> Lock(Mutex);
+		Condition.wait(Lock, [this]{ return Hashing == 0; });
+	}
+
+	UpdateHashes();
+
+	bool Streamed = TextureStreamer.Finish();
+
+	return Streamed && Stats.Failed == Failed;
+}
+
+void CTextureManager::GetStats(CTextureManagerStats &Stats)
+{
+	Stats = this->Stats;
+
+	Stats.Budget = Budget;
+
+	Stats.Textures = (int)Contents.size();
+	Stats.References = 0;
+	Stats.ResidentBytes = 0;
+
+	for(auto &Content : Contents)
+	{
+		Stats.References += Content.second->References;
+		Stats.ResidentBytes += Content.second->Texture.GetResidentBytes();
+	}
+}
+
+void CTextureManager::Destroy()
+{
+	{
+		std::unique_lock<std::mutex> Lock(Mutex);
+		Condition.wait(Lock, [this]{ return Hashing == 0; });
+	}
+
+	for(size_t i = 0; i < HashRequests.size(); i++)
+	{
+		delete HashRequests[i];
+	}
+
+	HashRequests.clear();
+	Hashed.clear();
+
+	std::vector<CTextureEntry*> Entries;
+
+	for(auto &Path : Paths)
+	{
+		if(std::find(Entries.begin(), Entries.end(), Path.second) == Entries.end())
+		{
+			Entries.push_back(Path.second);
+		}
+	}
+
+	for(size_t i = 0; i < Entries.size(); i++)
+	{
+		Entries[i]->Texture.Delete();
+		delete Entries[i];
+	}
+
+	Paths.clear();
+	Contents.clear();
+}
+
+void CTextureManager::AddReference(CTextureEntry *Entry)
+{
+	Entry->References++;
+}
+
+void CTextureManager::Release(CTextureEntry *Entry)
+{
+	if(--Entry->References > 0)
+	{
+		return;
+	}
+
+	for(auto Path = Paths.begin(); Path != Paths.end();)
+	{
+		if(Path->second == Entry)
+		{
+			Path = Paths.erase(Path);
+		}
+		else
+		{
+			Path++;
+		}
+	}
+
+	if(Entry->Shared)
+	{
+		Release(Entry->Shared);
+	}
+	else if(Entry->Hashed)
+	{
+		Contents.erase(Entry->ContentHash);
+	}
+	else
+	{
+		for(size_t i = 0; i < HashRequests.size(); i++)
+		{
+			if(HashRequests[i]->Entry == Entry)
+			{
+				HashRequests[i]->Entry = NULL;
+			}
+		}
+	}
+
+	Entry->Texture.Delete();
+
+	delete Entry;
+}
+
+void CTextureManager::Use(CTextureEntry *Entry)
+{
+	Entry->LastUsed = Frame;
+}
+
+// a file hashed to the contents of a texture already there refers to it, the placeholder it showed is not a texture of its own
+
+void CTextureManager::UpdateHashes()
+{
+	std::deque<CTextureHashRequest*> Requests;
+
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Requests.swap(Hashed);
+	}
+
+	for(size_t i = 0; i < Requests.size(); i++)
+	{
+		CTextureHashRequest *Request = Requests[i];
+		CTextureEntry *Entry = Request->Entry;
+
+		HashRequests.erase(std::find(HashRequests.begin(), HashRequests.end(), Request));
+
+		if(Entry == NULL)
+		{
+			delete Request;
+			continue;
+		}
+
+		if(!Request->Success)
+		{
+			ErrorLog.Append("Error loading file %s!\r\n", (char*)Request->FileName);
+			Stats.Failed++;
+		}
+		else
+		{
+			Entry->ContentHash = Request->ContentHash;
+
+			auto Content = Contents.find(Entry->ContentHash);
+
+			if(Content != Contents.end())
+			{
+				Entry->Shared = Content->second;
+				AddReference(Entry->Shared);
+				Stats.ContentHits++;
+			}
+			else if(TextureStreamer.LoadTexture2D(&Entry->Texture, Entry->FileName, 0, &Entry->ContentHash))
+			{
+				Entry->Hashed = true;
+				Contents[Entry->ContentHash] = Entry;
+				Stats.Misses++;
+			}
+			else
+			{
+				Stats.Failed++;
+			}
+		}
+
+		delete Request;
+	}
+}
+
+bool CTextureManager::Restream(CTextureEntry *Entry, int SkipLevels, long long ExpectedBytes)
+{
+	if(!TextureStreamer.LoadTexture2D(&Entry->Texture, Entry->FileName, SkipLevels, &Entry->ContentHash))
+	{
+		return false;
+	}
+
+	Entry->SkipLevels = SkipLevels;
+	Entry->ExpectedBytes = ExpectedBytes;
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CTextureManager TextureManager;
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "platform.h"
+#include "string.h"
+#include "hash.h"
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+#define TEXTURE_MANAGER_MIN_LEVELS 7
+
+struct CTextureManagerStats
+{
+	int Textures, References, PathHits, ContentHits, Misses, Failed, Demotions, Promotions;
+	long long ResidentBytes, DemotedBytes, Budget;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CTexture;
+class CTextureEntry;
+class CTextureHashRequest;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CTextureHandle
+{
+protected:
+	CTextureEntry *Entry;
+
+public:
+	CTextureHandle();
+	CTextureHandle(CTextureEntry *Entry);
+	CTextureHandle(const CTextureHandle &Handle);
+	CTextureHandle(CTextureHandle &&Handle);
+	~CTextureHandle();
+
+	CTextureHandle& operator = (const CTextureHandle &Handle);
+	CTextureHandle& operator = (CTextureHandle &&Handle);
+
+	operator GLuint ();
+
+	bool IsValid();
+	CTexture* GetTexture();
+	void Release();
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// textures are looked up by file name first, then by a hash of the file contents, so copies of the same image
+// under different names share one decode and one GPU texture; a new name shows the placeholder while its file is hashed
+// on the thread pool, Update then points it to the texture of the same contents or streams it, handing the hash on so
+// the file is not read again for the cache key; all calls must come from the rendering thread
+
+// with a budget the least recently used textures lose their finest mipmap level while the resident bytes are over it
+// and get it back one level per frame when the textures in use fit again; the levels are dropped by streaming the
+// texture again at the smaller size, the old texture is shown until the new one is complete
+
+class CTextureManager
+{
+protected:
+	std::unordered_map<std::string, CTextureEntry*> Paths;
+	std::unordered_map<HASH64, CTextureEntry*> Contents;
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	std::deque<CTextureHashRequest*> Hashed;
+	std::vector<CTextureHashRequest*> HashRequests;
+	std::atomic<int> Hashing;
+	CTextureManagerStats Stats;
+	int Frame;
+
+public:
+	long long Budget;
+
+public:
+	CTextureManager();
+	~CTextureManager();
+
+	CTextureHandle LoadTexture2D(const char *Texture2DFileName);
+	void Update();
+	bool Finish();
+	void GetStats(CTextureManagerStats &Stats);
+	void Destroy();
+
+protected:
+	void AddReference(CTextureEntry *Entry);
+	void Release(CTextureEntry *Entry);
+	void Use(CTextureEntry *Entry);
+	void UpdateHashes();
+	bool Restream(CTextureEntry *Entry, int SkipLevels, long long ExpectedBytes);
+
+	friend class CTextureHandle;
+};
+
+extern CTextureManager TextureManager;
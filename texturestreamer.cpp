@@ -0,0 +1,436 @@
+#include "texturestreamer.h"
+#include "profiler.h"
+#include "threadpool.h"
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CTextureStreamer::CTextureStreamer()
+{
+	Decoding = 0;
+	Uploading = NULL;
+	PlaceholderTextureID = 0;
+	memset(PixelBuffers, 0, sizeof(PixelBuffers));
+	PixelBuffer = 0;
+	memset(&Stats, 0, sizeof(Stats));
+	TotalLatency = 0.0;
+
+	UploadBudget = 4 * 1024 * 1024;
+}
+
+CTextureStreamer::~CTextureStreamer()
+{
+}
+
+void CTextureStreamer::Init()
+{
+	BYTE Checker[16] =
+	{
+		128, 128, 128, 255,  192, 192, 192, 255,
+		192, 192, 192, 255,  128, 128, 128, 255
+	};
+
+	glGenTextures(1, &PlaceholderTextureID);
+	glBindTexture(GL_TEXTURE_2D, PlaceholderTextureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, Checker);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if(gl_version >= 21 || GLEW_ARB_pixel_buffer_object)
+	{
+		glGenBuffers(TEXTURE_STREAMER_PIXEL_BUFFERS, PixelBuffers);
+	}
+
+	ThreadPool.Start();
+}
+
+// a texture that is reloaded at another size keeps showing the old one until the new one is complete; the ContentHash of
+// the file is handed to the decode when the caller knows it
+
+bool CTextureStreamer::LoadTexture2D(CTexture *Texture, const char *Texture2DFileName, int SkipLevels, const HASH64 *ContentHash)
+{
+	if(PlaceholderTextureID == 0)
+	{
+		ErrorLog.Append("CTextureStreamer::Init was not called!\r\n");
+		return false;
+	}
+
+	Cancel(Texture);
+
+	ShowPlaceholder(Texture);
+
+	CTextureStreamRequest *Request = new CTextureStreamRequest();
+
+	Request->Texture = Texture;
+	Request->FileName = Texture2DFileName;
+	Request->ContentHash = ContentHash ? *ContentHash : 0;
+	Request->ContentHashed = ContentHash != NULL;
+	Request->Success = false;
+	Request->RequestTime = GetTime();
+	Request->TextureID = 0;
+	Request->SkipLevels = SkipLevels;
+	Request->Level = 0;
+	Request->UploadedRows = 0;
+
+	Requests.push_back(Request);
+
+	Decoding++;
+
+	ThreadPool.Submit([this, Request]()
+	{
+		Request->Success = Request->Image.Load(Request->FileName, Request->Errors, Request->SkipLevels, Request->ContentHashed ? &Request->ContentHash : NULL);
+
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		Decoded.push_back(Request);
+		Decoding--;
+
+		Condition.notify_all();
+	});
+
+	return true;
+}
+
+// only a texture without one yet shows the placeholder
+
+void CTextureStreamer::ShowPlaceholder(CTexture *Texture)
+{
+	if((GLuint)*Texture == 0)
+	{
+		Texture->SetTextureID(PlaceholderTextureID);
+	}
+}
+
+void CTextureStreamer::Update()
+{
+	Update(UploadBudget);
+}
+
+bool CTextureStreamer::Finish()
+{
+	PROFILE_ZONE("CTextureStreamer::Finish");
+
+	int Failed = Stats.Failed;
+
+	while(true)
+	{
+		Update(0x7FFFFFFF);
+
+		std::unique_lock<std::mutex> Lock(Mutex);
+
+		if(Decoding == 0 && Decoded.size() == 0 && Uploading == NULL)
+		{
+			break;
+		}
+
+		Condition.wait(Lock, [this]{ return Decoded.size() > 0 || Decoding == 0; });
+	}
+
+	return Stats.Failed == Failed;
+}
+
+void CTextureStreamer::Cancel(CTexture *Texture)
+{
+	for(size_t i = 0; i < Requests.size(); i++)
+	{
+		if(Requests[i]->Texture == Texture)
+		{
+			Requests[i]->Texture = NULL;
+		}
+	}
+}
+
+bool CTextureStreamer::IsLoading(CTexture *Texture)
+{
+	for(size_t i = 0; i < Requests.size(); i++)
+	{
+		if(Requests[i]->Texture == Texture)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool CTextureStreamer::IsPlaceholder(GLuint TextureID)
+{
+	return TextureID != 0 && TextureID == PlaceholderTextureID;
+}
+
+void CTextureStreamer::GetStats(CTextureStreamerStats &Stats)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	Stats = this->Stats;
+
+	Stats.DecodeQueueDepth = Decoding;
+	Stats.UploadQueueDepth = (int)Decoded.size() + (Uploading ? 1 : 0);
+	Stats.AverageLatency = Stats.Loaded > 0 ? TotalLatency / Stats.Loaded : 0.0;
+}
+
+void CTextureStreamer::Destroy()
+{
+	{
+		std::unique_lock<std::mutex> Lock(Mutex);
+		Condition.wait(Lock, [this]{ return Decoding == 0; });
+	}
+
+	if(Uploading)
+	{
+		glDeleteTextures(1, &Uploading->TextureID);
+		Uploading = NULL;
+	}
+
+	for(size_t i = 0; i < Requests.size(); i++)
+	{
+		delete Requests[i];
+	}
+
+	Requests.clear();
+	Decoded.clear();
+
+	if(PixelBuffers[0])
+	{
+		glDeleteBuffers(TEXTURE_STREAMER_PIXEL_BUFFERS, PixelBuffers);
+		memset(PixelBuffers, 0, sizeof(PixelBuffers));
+	}
+
+	glDeleteTextures(1, &PlaceholderTextureID);
+	PlaceholderTextureID = 0;
+}
+
+void CTextureStreamer::Update(int Budget)
+{
+	PROFILE_ZONE("CTextureStreamer::Update");
+
+	int Bytes = 0;
+
+	while(Bytes < Budget)
+	{
+		if(Uploading == NULL)
+		{
+			CTextureStreamRequest *Request;
+
+			{
+				std::lock_guard<std::mutex> Lock(Mutex);
+
+				if(Decoded.size() == 0) break;
+
+				Request = Decoded.front();
+				Decoded.pop_front();
+			}
+
+			if(!BeginUpload(Request)) continue;
+
+			Uploading = Request;
+		}
+
+		if(Uploading->Texture == NULL)
+		{
+			glDeleteTextures(1, &Uploading->TextureID);
+			Release(Uploading);
+			Uploading = NULL;
+			continue;
+		}
+
+		int Pitch, LevelRows;
+
+		GetLevelRows(Uploading->Image, Uploading->Level, Pitch, LevelRows);
+
+		int Rows = (Budget - Bytes) / Pitch;
+
+		if(Rows < 1) Rows = 1;
+		if(Rows > LevelRows - Uploading->UploadedRows) Rows = LevelRows - Uploading->UploadedRows;
+
+		UploadRows(Uploading, Rows);
+
+		Bytes += Rows * Pitch;
+
+		if(Uploading->Level == Uploading->Image.GetLevelsCount())
+		{
+			Complete(Uploading);
+			Uploading = NULL;
+		}
+	}
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	Stats.UploadedBytes += Bytes;
+	Stats.UploadedBytesLastFrame = Bytes;
+}
+
+bool CTextureStreamer::BeginUpload(CTextureStreamRequest *Request)
+{
+	if(Request->Texture == NULL)
+	{
+		Release(Request);
+		return false;
+	}
+
+	if(!Request->Success)
+	{
+		ErrorLog += Request->Errors;
+
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Stats.Failed++;
+		Release(Request);
+
+		return false;
+	}
+
+	CTextureImage &Image = Request->Image;
+
+	glGenTextures(1, &Request->TextureID);
+	glBindTexture(GL_TEXTURE_2D, Request->TextureID);
+	CTexture::SetParameters(Image);
+
+	CPixelFormat &PixelFormat = Image.PixelFormat;
+
+	for(int i = 0; i < Image.Compressed.LevelsCount; i++)
+	{
+		CCompressedLevel &Level = Image.Compressed.Levels[i];
+
+		glCompressedTexImage2D(GL_TEXTURE_2D, i, PixelFormat.InternalFormat, Level.Width, Level.Height, 0, (GLsizei)Level.Size, NULL);
+	}
+
+	for(int i = 0; i < Image.Mipmaps.LevelsCount; i++)
+	{
+		CMipmapLevel &Level = Image.Mipmaps.Levels[i];
+
+		glTexImage2D(GL_TEXTURE_2D, i, PixelFormat.InternalFormat, Level.Width, Level.Height, 0, PixelFormat.Format, PixelFormat.Type, NULL);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return true;
+}
+
+void CTextureStreamer::UploadRows(CTextureStreamRequest *Request, int Rows)
+{
+	PROFILE_ZONE("CTextureStreamer::UploadRows");
+
+	CTextureImage &Image = Request->Image;
+
+	int Pitch, LevelRows;
+
+	GetLevelRows(Image, Request->Level, Pitch, LevelRows);
+
+	BYTE *LevelData = Image.IsCompressed() ? Image.Compressed.Levels[Request->Level].Data : Image.Mipmaps.Levels[Request->Level].Data;
+
+	int Size = Rows * Pitch;
+	BYTE *Source = LevelData + Request->UploadedRows * Pitch;
+
+	glBindTexture(GL_TEXTURE_2D, Request->TextureID);
+
+	void *Pixels = Source;
+
+	if(PixelBuffers[0])
+	{
+		// orphaning the buffer lets the driver hand out fresh storage instead of waiting for the previous transfer
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PixelBuffers[PixelBuffer]);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, Size, NULL, GL_STREAM_DRAW);
+
+		void *Mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+
+		if(Mapped)
+		{
+			memcpy(Mapped, Source, Size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			Pixels = NULL;
+		}
+		else
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+
+		PixelBuffer = (PixelBuffer + 1) % TEXTURE_STREAMER_PIXEL_BUFFERS;
+	}
+
+	if(Image.IsCompressed())
+	{
+		// a row of blocks covers 4 rows of texels, the last one may cover fewer
+
+		CCompressedLevel &Level = Image.Compressed.Levels[Request->Level];
+
+		int y = Request->UploadedRows * 4, Height = (Request->UploadedRows + Rows) * 4 < Level.Height ? Rows * 4 : Level.Height - y;
+
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, Request->Level, 0, y, Level.Width, Height, Image.PixelFormat.InternalFormat, Size, Pixels);
+	}
+	else
+	{
+		CMipmapLevel &Level = Image.Mipmaps.Levels[Request->Level];
+
+		glTexSubImage2D(GL_TEXTURE_2D, Request->Level, 0, Request->UploadedRows, Level.Width, Rows, Image.PixelFormat.Format, Image.PixelFormat.Type, Pixels);
+	}
+
+	if(PixelBuffers[0])
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Request->UploadedRows += Rows;
+
+	if(Request->UploadedRows == LevelRows)
+	{
+		Request->Level++;
+		Request->UploadedRows = 0;
+	}
+}
+
+void CTextureStreamer::Complete(CTextureStreamRequest *Request)
+{
+	glBindTexture(GL_TEXTURE_2D, Request->TextureID);
+	CTexture::GenerateMissingMipmaps(Request->Image);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Request->Texture->SetTextureID(Request->TextureID, Request->Image.Width, Request->Image.Height, Request->Image.PixelFormat.InternalFormat, Request->Image.GetTextureLevelsCount());
+
+	double Latency = GetTime() - Request->RequestTime;
+
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		Stats.Loaded++;
+		TotalLatency += Latency;
+
+		if(Latency > Stats.MaxLatency) Stats.MaxLatency = Latency;
+	}
+
+	Release(Request);
+}
+
+// compressed levels are uploaded in rows of blocks
+
+void CTextureStreamer::GetLevelRows(CTextureImage &Image, int Level, int &Pitch, int &Rows)
+{
+	if(Image.IsCompressed())
+	{
+		Pitch = Image.Compressed.Levels[Level].Pitch;
+		Rows = Image.Compressed.Levels[Level].Rows;
+	}
+	else
+	{
+		Pitch = Image.Mipmaps.Levels[Level].Pitch;
+		Rows = Image.Mipmaps.Levels[Level].Height;
+	}
+}
+
+void CTextureStreamer::Release(CTextureStreamRequest *Request)
+{
+	for(size_t i = 0; i < Requests.size(); i++)
+	{
+		if(Requests[i] == Request)
+		{
+			Requests.erase(Requests.begin() + i);
+			break;
+		}
+	}
+
+	delete Request;
+}
+
+CTextureStreamer TextureStreamer;
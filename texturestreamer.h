@@ -0,0 +1,82 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+#define TEXTURE_STREAMER_PIXEL_BUFFERS 4
+
+struct CTextureStreamerStats
+{
+	int DecodeQueueDepth, UploadQueueDepth, Loaded, Failed;
+	double AverageLatency, MaxLatency;
+	long long UploadedBytes;
+	int UploadedBytesLastFrame;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CTextureStreamRequest
+{
+public:
+	CTexture *Texture;
+	CString FileName, Errors;
+	HASH64 ContentHash;
+	bool ContentHashed;
+	CTextureImage Image;
+	bool Success;
+	double RequestTime;
+	GLuint TextureID;
+	int SkipLevels, Level, UploadedRows;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CTextureStreamer
+{
+protected:
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	std::deque<CTextureStreamRequest*> Decoded;
+	std::vector<CTextureStreamRequest*> Requests;
+	std::atomic<int> Decoding;
+	CTextureStreamRequest *Uploading;
+	GLuint PlaceholderTextureID, PixelBuffers[TEXTURE_STREAMER_PIXEL_BUFFERS];
+	int PixelBuffer;
+	CTextureStreamerStats Stats;
+	double TotalLatency;
+
+public:
+	int UploadBudget;
+
+public:
+	CTextureStreamer();
+	~CTextureStreamer();
+
+	void Init();
+	bool LoadTexture2D(CTexture *Texture, const char *Texture2DFileName, int SkipLevels = 0, const HASH64 *ContentHash = NULL);
+	void ShowPlaceholder(CTexture *Texture);
+	void Update();
+	bool Finish();
+	void Cancel(CTexture *Texture);
+	bool IsLoading(CTexture *Texture);
+	bool IsPlaceholder(GLuint TextureID);
+	void GetStats(CTextureStreamerStats &Stats);
+	void Destroy();
+
+protected:
+	void Update(int Budget);
+	bool BeginUpload(CTextureStreamRequest *Request);
+	void UploadRows(CTextureStreamRequest *Request, int Rows);
+	void Complete(CTextureStreamRequest *Request);
+	void GetLevelRows(CTextureImage &Image, int Level, int &Pitch, int &Rows);
+	void Release(CTextureStreamRequest *Request);
+};
+
+extern CTextureStreamer TextureStreamer;
@@ -0,0 +1,173 @@
+#include "threadpool.h"
+
+#include <atomic>
+#include <memory>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CThreadPool::CThreadPool()
+{
+	Quit = false;
+}
+
+CThreadPool::~CThreadPool()
+{
+	Destroy();
+}
+
+void CThreadPool::Start(int ThreadsCount)
+{
+	if(Threads.size() > 0)
+	{
+		return;
+	}
+
+	if(ThreadsCount <= 0)
+	{
+		ThreadsCount = (int)std::thread::hardware_concurrency() - 1;
+
+		if(ThreadsCount < 1) ThreadsCount = 1;
+	}
+
+	Quit = false;
+
+	for(int i = 0; i < ThreadsCount; i++)
+	{
+		Threads.push_back(std::thread(&CThreadPool::WorkerThread, this));
+	}
+}
+
+void CThreadPool::Submit(std::function<void()> Job)
+{
+	if(Threads.size() == 0)
+	{
+		Start();
+	}
+
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Jobs.push_back(Job);
+	}
+
+	Condition.notify_one();
+}
+
+void CThreadPool::ParallelFor(int Count, int Grain, std::function<void(int Begin, int End)> Function)
+{
+	if(Count <= 0)
+	{
+		return;
+	}
+
+	if(Grain < 1) Grain = 1;
+
+	int Chunks = (Count + Grain - 1) / Grain;
+
+	if(Chunks == 1)
+	{
+		Function(0, Count);
+		return;
+	}
+
+	// the calling thread takes chunks too, so nested calls from worker threads cannot deadlock,
+	// and helpers that start after all chunks are taken just return
+
+	struct CParallelFor
+	{
+		std::atomic<int> NextChunk, DoneChunks;
+		std::mutex Mutex;
+		std::condition_variable Condition;
+	};
+
+	std::shared_ptr<CParallelFor> State = std::make_shared<CParallelFor>();
+
+	State->NextChunk = 0;
+	State->DoneChunks = 0;
+
+	auto Work = [State, Count, Grain, Chunks, Function]()
+	{
+		int Chunk;
+
+		while((Chunk = State->NextChunk++) < Chunks)
+		{
+			int Begin = Chunk * Grain;
+			int End = Begin + Grain < Count ? Begin + Grain : Count;
+
+			Function(Begin, End);
+
+			if(++State->DoneChunks == Chunks)
+			{
+				std::lock_guard<std::mutex> Lock(State->Mutex);
+				State->Condition.notify_all();
+			}
+		}
+	};
+
+	int Helpers = GetThreadsCount();
+
+	if(Helpers > Chunks - 1) Helpers = Chunks - 1;
+
+	for(int i = 0; i < Helpers; i++)
+	{
+		Submit(Work);
+	}
+
+	Work();
+
+	std::unique_lock<std::mutex> Lock(State->Mutex);
+	State->Condition.wait(Lock, [&State, Chunks]{ return State->DoneChunks == Chunks; });
+}
+
+int CThreadPool::GetThreadsCount()
+{
+	if(Threads.size() == 0)
+	{
+		Start();
+	}
+
+	return (int)Threads.size();
+}
+
+void CThreadPool::Destroy()
+{
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Quit = true;
+	}
+
+	Condition.notify_all();
+
+	for(size_t i = 0; i < Threads.size(); i++)
+	{
+		Threads[i].join();
+	}
+
+	Threads.clear();
+	Jobs.clear();
+}
+
+void CThreadPool::WorkerThread()
+{
+	while(true)
+	{
+		std::function<void()> Job;
+
+		{
+			std::unique_lock<std::mutex> Lock(Mutex);
+
+			Condition.wait(Lock, [this]{ return Quit || Jobs.size() > 0; });
+
+			if(Quit)
+			{
+				return;
+			}
+
+			Job = Jobs.front();
+			Jobs.pop_front();
+		}
+
+		Job();
+	}
+}
+
+CThreadPool ThreadPool;
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CThreadPool
+{
+protected:
+	std::vector<std::thread> Threads;
+	std::deque<std::function<void()>> Jobs;
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	bool Quit;
+
+public:
+	CThreadPool();
+	~CThreadPool();
+
+	void Start(int ThreadsCount = 0);
+	void Submit(std::function<void()> Job);
+	void ParallelFor(int Count, int Grain, std::function<void(int Begin, int End)> Function);
+	int GetThreadsCount();
+	void Destroy();
+
+protected:
+	void WorkerThread();
+};
+
+extern CThreadPool ThreadPool;
@@ -0,0 +1,1005 @@
+#include "virtualtexture.h"
+#include "shaderlibrary.h"
+#include "texturecache.h"
+#include "profiler.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <math.h>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// bump when the tile layout or the mipmap generation changes the output
+
+#define VIRTUAL_TEXTURE_MAGIC 0x58455456
+#define VIRTUAL_TEXTURE_VERSION 1
+
+#define VIRTUAL_TEXTURE_EMPTY 0xFFFFFFFF
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// the tile starts Border pixels up and left of its area, pixels off the level repeat the edge
+
+static void CopyTile(const CMipmapLevel &Level, int Channels, bool BGR, int X, int Y, int Size, BYTE *Tile)
+{
+	int Red = BGR ? 2 : 0, Blue = BGR ? 0 : 2;
+
+	for(int y = 0; y < Size; y++)
+	{
+		const BYTE *Row = Level.Data + std::min(std::max(Y + y, 0), Level.Height - 1) * Level.Pitch;
+		BYTE *Texel = Tile + y * Size * 4;
+
+		for(int x = 0; x < Size; x++)
+		{
+			const BYTE *Source = Row + std::min(std::max(X + x, 0), Level.Width - 1) * Channels;
+
+			Texel[0] = Source[Red];
+			Texel[1] = Source[1];
+			Texel[2] = Source[Blue];
+			Texel[3] = Channels == 4 ? Source[3] : 255;
+
+			Texel += 4;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CVirtualTexture::CVirtualTexture()
+{
+	Loading = 0;
+
+	CacheTiles = 32;
+	UploadBudget = 16;
+
+	ProgramVariant = FeedbackProgramVariant = -1;
+
+	SetDefaults();
+}
+
+CVirtualTexture::~CVirtualTexture()
+{
+}
+
+// the feedback pass is the main shader with FEEDBACK defined; the variants stay added when the texture is loaded again,
+// the programs belong to ShaderLibrary
+
+void CVirtualTexture::AddPrograms()
+{
+	if(ProgramVariant == -1 && gl_version >= 21)
+	{
+		ProgramVariant = ShaderLibrary.Add("glsl120virtualtexture.vs", "glsl120virtualtexture.fs");
+		FeedbackProgramVariant = ShaderLibrary.Add("glsl120virtualtexture.vs", "glsl120virtualtexture.fs", "FEEDBACK");
+	}
+}
+
+// image files are cut into a pyramid in the texture cache directory once, .vtex files are mapped as they are
+
+bool CVirtualTexture::Load(const char *FileName)
+{
+	PROFILE_ZONE("CVirtualTexture::Load");
+
+	Destroy();
+
+	if(gl_version < 21 || (gl_version < 30 && !GLEW_ARB_framebuffer_object))
+	{
+		ErrorLog.Append("Virtual texturing needs OpenGL 2.1 and GL_ARB_framebuffer_object!\r\n");
+		return false;
+	}
+
+	CString SourceFileName = CString::Concat({ModuleDirectory, FileName});
+
+	const char *Extension = strrchr(FileName, '.');
+
+	if(Extension != NULL && (strcmp(Extension, ".vtex") == 0 || strcmp(Extension, ".VTEX") == 0))
+	{
+		if(!Map(SourceFileName))
+		{
+			ErrorLog.AppendStrings({"Error loading file ", SourceFileName, "! -> invalid virtual texture", "\r\n"});
+			return false;
+		}
+	}
+	else
+	{
+		HASH64 Key;
+
+		if(!TextureCache.GetKey(SourceFileName, Key))
+		{
+			ErrorLog.AppendStrings({"Error loading file ", SourceFileName, "!\r\n"});
+			return false;
+		}
+
+		int Settings[] = {VIRTUAL_TEXTURE_VERSION, VIRTUAL_TEXTURE_TILE_SIZE, VIRTUAL_TEXTURE_BORDER, TextureCache.IsEnabled() ? 1 : 0};
+
+		CString PyramidFileName = TextureCache.GetFileName(Hash64(Settings, sizeof(Settings), Key), "vtex");
+
+		if(!Map(PyramidFileName))
+		{
+			CString Errors;
+
+			if(!Build(SourceFileName, PyramidFileName, Errors))
+			{
+				ErrorLog += Errors;
+				return false;
+			}
+
+			if(!Map(PyramidFileName))
+			{
+				ErrorLog.AppendStrings({"Error loading file ", PyramidFileName, "! -> invalid virtual texture", "\r\n"});
+				return false;
+			}
+		}
+	}
+
+	// tiles the driver cannot take compressed are decoded on upload
+
+	Decode = Format != BC_FORMAT_NONE && !IsBlockFormatSupported(Format, false, PixelFormatCaps);
+
+	if(Decode)
+	{
+		DecodeBuffer = new BYTE[PaddedTileSize * PaddedTileSize * 4];
+	}
+
+	PhysicalTilesX = PhysicalTilesY = std::min(std::min(CacheTiles, gl_max_texture_size / PaddedTileSize), 255);
+
+	if(PhysicalTilesX < 2)
+	{
+		ErrorLog.Append("Virtual texture cache too small!\r\n");
+		Destroy();
+		return false;
+	}
+
+	GLenum InternalFormat = Format == BC_FORMAT_NONE || Decode ? GL_RGBA8 : GetBlockInternalFormat(Format);
+
+	glGenTextures(1, &PhysicalTexture);
+	glBindTexture(GL_TEXTURE_2D, PhysicalTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, InternalFormat, PhysicalTilesX * PaddedTileSize, PhysicalTilesY * PaddedTileSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	// until something finer is resident every entry points to the coarsest tile in slot 0
+
+	int Top = Header.LevelsCount - 1;
+
+	PageTable = new BYTE*[Header.LevelsCount];
+	DirtyRects = new int[Header.LevelsCount * 4];
+
+	glGenTextures(1, &PageTableTexture);
+	glBindTexture(GL_TEXTURE_2D, PageTableTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, Top);
+
+	for(int Level = 0; Level < Header.LevelsCount; Level++)
+	{
+		int Size = Header.VirtualTiles >> Level;
+
+		PageTable[Level] = new BYTE[Size * Size * 4];
+
+		for(int i = 0; i < Size * Size; i++)
+		{
+			BYTE *Entry = PageTable[Level] + i * 4;
+
+			Entry[0] = 0;
+			Entry[1] = 0;
+			Entry[2] = (BYTE)Top;
+			Entry[3] = 255;
+		}
+
+		int *Rect = DirtyRects + Level * 4;
+
+		Rect[0] = Rect[1] = Size;
+		Rect[2] = Rect[3] = 0;
+
+		glTexImage2D(GL_TEXTURE_2D, Level, GL_RGBA8, Size, Size, 0, GL_RGBA, GL_UNSIGNED_BYTE, PageTable[Level]);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	int SlotsCount = PhysicalTilesX * PhysicalTilesY;
+
+	Slots = new CSlot[SlotsCount];
+
+	for(int i = 0; i < SlotsCount; i++)
+	{
+		Slots[i].Key = VIRTUAL_TEXTURE_EMPTY;
+		Slots[i].Frame = -1;
+
+		if(i > 0)
+		{
+			Slots[i].Position = LRU.insert(LRU.end(), i);
+		}
+	}
+
+	unsigned int Root = GetKey(Top, 0, 0);
+
+	UploadTile(Root, 0);
+
+	Slots[0].Key = Root;
+	Resident[Root] = 0;
+
+	glGenFramebuffers(1, &FrameBuffer);
+	glGenRenderbuffers(2, RenderBuffers);
+	glGenBuffers(2, FeedbackBuffers);
+
+	if(!InitPrograms())
+	{
+		Destroy();
+		return false;
+	}
+
+	ThreadPool.Start();
+
+	return true;
+}
+
+// the feedback is rendered at 1 / VIRTUAL_TEXTURE_FEEDBACK_SCALE of the screen size, small features may be missed for a
+// frame or two
+
+void CVirtualTexture::Resize(int Width, int Height)
+{
+	if(FrameBuffer == 0)
+	{
+		return;
+	}
+
+	FeedbackWidth = std::max(Width / VIRTUAL_TEXTURE_FEEDBACK_SCALE, 1);
+	FeedbackHeight = std::max(Height / VIRTUAL_TEXTURE_FEEDBACK_SCALE, 1);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, RenderBuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, FeedbackWidth, FeedbackHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, RenderBuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, FeedbackWidth, FeedbackHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, FrameBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, RenderBuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, RenderBuffers[1]);
+
+	bool Complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for(int i = 0; i < 2; i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, FeedbackBuffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, FeedbackWidth * FeedbackHeight * 4, NULL, GL_STREAM_READ);
+
+		FeedbackPending[i] = false;
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// without feedback only the coarsest tile is shown
+
+	if(!Complete)
+	{
+		ErrorLog.Append("Virtual texture feedback framebuffer incomplete!\r\n");
+		FeedbackWidth = FeedbackHeight = 0;
+	}
+}
+
+// the caller draws the geometry between BeginFeedback and EndFeedback with the same transformations as in the main pass
+
+bool CVirtualTexture::BeginFeedback()
+{
+	if(FeedbackWidth == 0)
+	{
+		return false;
+	}
+
+	glGetIntegerv(GL_VIEWPORT, Viewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, ClearColor);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, FrameBuffer);
+	glViewport(0, 0, FeedbackWidth, FeedbackHeight);
+
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glUseProgram(*FeedbackProgram);
+
+	return true;
+}
+
+// the pixels are read into a pixel buffer and mapped one frame later, so the read does not stall
+
+void CVirtualTexture::EndFeedback()
+{
+	glUseProgram(0);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, FeedbackBuffers[FeedbackBuffer]);
+	glReadPixels(0, 0, FeedbackWidth, FeedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	FeedbackPending[FeedbackBuffer] = true;
+	FeedbackBuffer ^= 1;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glViewport(Viewport[0], Viewport[1], Viewport[2], Viewport[3]);
+	glClearColor(ClearColor[0], ClearColor[1], ClearColor[2], ClearColor[3]);
+}
+
+void CVirtualTexture::Update()
+{
+	PROFILE_ZONE("CVirtualTexture::Update");
+
+	if(PhysicalTexture == 0)
+	{
+		return;
+	}
+
+	Frame++;
+
+	ReadFeedback();
+	RequestTiles();
+	UploadTiles();
+	UploadPageTable();
+}
+
+void CVirtualTexture::Bind()
+{
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, PageTableTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, PhysicalTexture);
+
+	glUseProgram(*Program);
+}
+
+void CVirtualTexture::Unbind()
+{
+	glUseProgram(0);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void CVirtualTexture::GetStats(CVirtualTextureStats &Stats)
+{
+	Stats = this->Stats;
+
+	Stats.PhysicalTiles = PhysicalTilesX * PhysicalTilesY;
+	Stats.ResidentTiles = (int)Resident.size();
+	Stats.PendingTiles = (int)Pending.size();
+}
+
+void CVirtualTexture::Destroy()
+{
+	{
+		std::unique_lock<std::mutex> Lock(Mutex);
+		Condition.wait(Lock, [this]{ return Loading == 0; });
+	}
+
+	Ready.clear();
+	Pending.clear();
+	Resident.clear();
+	Requests.clear();
+	LRU.clear();
+
+	delete [] Slots;
+
+	if(PageTable)
+	{
+		for(int Level = 0; Level < Header.LevelsCount; Level++)
+		{
+			delete [] PageTable[Level];
+		}
+
+		delete [] PageTable;
+	}
+
+	delete [] DirtyRects;
+	delete [] DecodeBuffer;
+
+	if(PhysicalTexture) glDeleteTextures(1, &PhysicalTexture);
+	if(PageTableTexture) glDeleteTextures(1, &PageTableTexture);
+	if(FrameBuffer) glDeleteFramebuffers(1, &FrameBuffer);
+	if(RenderBuffers[0]) glDeleteRenderbuffers(2, RenderBuffers);
+	if(FeedbackBuffers[0]) glDeleteBuffers(2, FeedbackBuffers);
+
+	File.Close();
+
+	SetDefaults();
+}
+
+// the level 0 tiles of a W x H image cover the smallest power of two square of tiles around it, every next level halves
+// the image until a single tile holds it all; the tiles are encoded like the cached textures, BC7, BC1 or BC3, or kept
+// RGBA8 when texture compression is off; the whole image has to fit in memory once
+
+bool CVirtualTexture::Build(const char *SourceFileName, const char *FileName, CString &Errors)
+{
+	PROFILE_ZONE("CVirtualTexture::Build");
+
+	CString ErrorText = CString::Concat({"Error loading file ", SourceFileName, "! ->"});
+
+	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(SourceFileName);
+
+	if(fif == FIF_UNKNOWN)
+	{
+		fif = FreeImage_GetFIFFromFilename(SourceFileName);
+	}
+
+	if(fif == FIF_UNKNOWN)
+	{
+		Errors.AppendStrings({ErrorText, "fif is FIF_UNKNOWN", "\r\n"});
+		return false;
+	}
+
+	FIBITMAP *dib = NULL;
+
+	if(FreeImage_FIFSupportsReading(fif))
+	{
+		dib = FreeImage_Load(fif, SourceFileName);
+	}
+
+	if(dib == NULL)
+	{
+		Errors.AppendStrings({ErrorText, "dib is NULL", "\r\n"});
+		return false;
+	}
+
+	// only 8 bit RGB and RGBA rows are cut into tiles, grey is expanded
+
+	CPixelFormatCaps Caps;
+
+	Caps.BGR = true;
+
+	CPixelConverter Pixels;
+	CString ConvertErrors;
+
+	if(!Pixels.Convert(dib, Caps, ConvertErrors))
+	{
+		Errors.AppendStrings({ErrorText, ConvertErrors, "\r\n"});
+		FreeImage_Unload(dib);
+		return false;
+	}
+
+	CPixelFormat PixelFormat = Pixels.PixelFormat;
+
+	int Width = Pixels.Width, Height = Pixels.Height, VirtualTiles = 1, LevelsCount = 1;
+
+	while(VirtualTiles * VIRTUAL_TEXTURE_TILE_SIZE < std::max(Width, Height))
+	{
+		VirtualTiles *= 2;
+		LevelsCount++;
+	}
+
+	if(PixelFormat.Channels < 3 || Pixels.Data == NULL || VirtualTiles > VIRTUAL_TEXTURE_MAX_TILES)
+	{
+		Errors.AppendStrings({ErrorText, PixelFormat.Channels < 3 ? "unsupported pixel format" : "image too large", "\r\n"});
+		Pixels.Destroy();
+		FreeImage_Unload(dib);
+		return false;
+	}
+
+	CMipmapChain Mipmaps;
+
+	if(!Mipmaps.Generate(Pixels.Data, Width, Height, Pixels.Pitch, PixelFormat.Channels, MIPMAP_FILTER_KAISER, true, PixelFormat.Channels == 4 && !PixelFormat.Opaque))
+	{
+		Errors.AppendStrings({ErrorText, "Mipmaps.Generate failed", "\r\n"});
+		Pixels.Destroy();
+		FreeImage_Unload(dib);
+		return false;
+	}
+
+	int PaddedTileSize = VIRTUAL_TEXTURE_TILE_SIZE + VIRTUAL_TEXTURE_BORDER * 2;
+
+	BC_FORMAT Format = TextureCache.GetFormat(PixelFormat, PaddedTileSize, PaddedTileSize, PixelFormatCaps);
+	BC_QUALITY Quality = TextureCache.GetQuality();
+
+	int TileBytes = Format == BC_FORMAT_NONE ? PaddedTileSize * PaddedTileSize * 4 : (PaddedTileSize / 4) * (PaddedTileSize / 4) * GetBlockSize(Format);
+
+	bool BGR = PixelFormat.Format == GL_BGR || PixelFormat.Format == GL_BGRA;
+
+	CVirtualTextureHeader Header = {VIRTUAL_TEXTURE_MAGIC, VIRTUAL_TEXTURE_VERSION, Width, Height, VIRTUAL_TEXTURE_TILE_SIZE, VIRTUAL_TEXTURE_BORDER, LevelsCount, VirtualTiles, Format, PixelFormat.Opaque ? 1 : 0};
+
+	CVirtualTextureLevel *Levels = new CVirtualTextureLevel[LevelsCount];
+
+	int TilesCount = 0;
+
+	for(int Level = 0; Level < LevelsCount; Level++)
+	{
+		Levels[Level].Width = Mipmaps.Levels[Level].Width;
+		Levels[Level].Height = Mipmaps.Levels[Level].Height;
+		Levels[Level].TilesX = (Levels[Level].Width + VIRTUAL_TEXTURE_TILE_SIZE - 1) / VIRTUAL_TEXTURE_TILE_SIZE;
+		Levels[Level].TilesY = (Levels[Level].Height + VIRTUAL_TEXTURE_TILE_SIZE - 1) / VIRTUAL_TEXTURE_TILE_SIZE;
+		Levels[Level].FirstTile = TilesCount;
+
+		TilesCount += Levels[Level].TilesX * Levels[Level].TilesY;
+	}
+
+	FILE *File;
+
+	if(fopen_s(&File, FileName, "wb") != 0)
+	{
+		Errors.AppendStrings({"Error saving file ", FileName, "!\r\n"});
+		delete [] Levels;
+		Pixels.Destroy();
+		FreeImage_Unload(dib);
+		return false;
+	}
+
+	bool Written = fwrite(&Header, sizeof(Header), 1, File) == 1 && fwrite(Levels, sizeof(CVirtualTextureLevel), LevelsCount, File) == (size_t)LevelsCount;
+
+	// a row of tiles is cut and encoded at a time
+
+	BYTE *Row = new BYTE[Levels[0].TilesX * TileBytes];
+
+	for(int Level = 0; Level < LevelsCount && Written; Level++)
+	{
+		const CMipmapLevel &MipmapLevel = Mipmaps.Levels[Level];
+
+		for(int y = 0; y < Levels[Level].TilesY && Written; y++)
+		{
+			ThreadPool.ParallelFor(Levels[Level].TilesX, 1, [&](int Begin, int End)
+			{
+				BYTE *Tile = new BYTE[PaddedTileSize * PaddedTileSize * 4];
+
+				for(int x = Begin; x < End; x++)
+				{
+					CopyTile(MipmapLevel, PixelFormat.Channels, BGR, x * VIRTUAL_TEXTURE_TILE_SIZE - VIRTUAL_TEXTURE_BORDER, y * VIRTUAL_TEXTURE_TILE_SIZE - VIRTUAL_TEXTURE_BORDER, PaddedTileSize, Tile);
+
+					if(Format == BC_FORMAT_NONE)
+					{
+						memcpy(Row + x * TileBytes, Tile, TileBytes);
+					}
+					else
+					{
+						EncodeBlocks(Tile, PaddedTileSize, PaddedTileSize, PaddedTileSize * 4, 4, false, Format, Quality, Row + x * TileBytes);
+					}
+				}
+
+				delete [] Tile;
+			});
+
+			Written = fwrite(Row, TileBytes, Levels[Level].TilesX, File) == (size_t)Levels[Level].TilesX;
+		}
+	}
+
+	delete [] Row;
+	delete [] Levels;
+
+	Mipmaps.Destroy();
+	Pixels.Destroy();
+	FreeImage_Unload(dib);
+
+	if(fclose(File) != 0 || !Written)
+	{
+		remove(FileName);
+		Errors.AppendStrings({"Error saving file ", FileName, "!\r\n"});
+		return false;
+	}
+
+	return true;
+}
+
+bool CVirtualTexture::Map(const char *FileName)
+{
+	File.Close();
+
+	if(!File.Open(FileName))
+	{
+		return false;
+	}
+
+	bool Valid = File.Size >= sizeof(Header);
+
+	if(Valid)
+	{
+		memcpy(&Header, File.Data, sizeof(Header));
+
+		Valid = Header.Magic == VIRTUAL_TEXTURE_MAGIC && Header.Version == VIRTUAL_TEXTURE_VERSION;
+		Valid &= Header.Width > 0 && Header.Height > 0 && Header.TileSize > 0 && Header.Border >= 0;
+		Valid &= (Header.TileSize + Header.Border * 2) % 4 == 0 && Header.TileSize + Header.Border * 2 <= 1024;
+		Valid &= Header.VirtualTiles > 0 && Header.VirtualTiles <= VIRTUAL_TEXTURE_MAX_TILES && (Header.VirtualTiles & (Header.VirtualTiles - 1)) == 0;
+		Valid &= Header.LevelsCount >= 1 && Header.LevelsCount <= 31 && Header.VirtualTiles == 1 << (Header.LevelsCount - 1);
+		Valid &= Header.Format == BC_FORMAT_NONE || Header.Format == BC_FORMAT_BC1 || Header.Format == BC_FORMAT_BC3 || Header.Format == BC_FORMAT_BC7;
+	}
+
+	size_t TilesOffset = sizeof(Header) + (Valid ? Header.LevelsCount : 0) * sizeof(CVirtualTextureLevel);
+
+	Valid = Valid && File.Size >= TilesOffset;
+
+	if(Valid)
+	{
+		Levels = (const CVirtualTextureLevel*)(File.Data + sizeof(Header));
+		Format = (BC_FORMAT)Header.Format;
+
+		PaddedTileSize = Header.TileSize + Header.Border * 2;
+
+		TileBytes = Format == BC_FORMAT_NONE ? PaddedTileSize * PaddedTileSize * 4 : (PaddedTileSize / 4) * (PaddedTileSize / 4) * GetBlockSize(Format);
+
+		long long TilesCount = 0;
+
+		for(int Level = 0; Level < Header.LevelsCount && Valid; Level++)
+		{
+			int Size = Header.VirtualTiles >> Level;
+
+			Valid = Levels[Level].TilesX > 0 && Levels[Level].TilesX <= Size && Levels[Level].TilesY > 0 && Levels[Level].TilesY <= Size;
+			Valid &= Levels[Level].FirstTile == TilesCount;
+
+			TilesCount += (long long)Levels[Level].TilesX * Levels[Level].TilesY;
+		}
+
+		Valid = Valid && (long long)(File.Size - TilesOffset) / TileBytes >= TilesCount;
+	}
+
+	if(!Valid)
+	{
+		File.Close();
+		return false;
+	}
+
+	Tiles = File.Data + TilesOffset;
+
+	return true;
+}
+
+bool CVirtualTexture::InitPrograms()
+{
+	AddPrograms();
+
+	Program = ShaderLibrary.Get(ProgramVariant);
+	FeedbackProgram = ShaderLibrary.Get(FeedbackProgramVariant);
+
+	if(Program == NULL || FeedbackProgram == NULL)
+	{
+		return false;
+	}
+
+	// the values never change, so they are set once; the uniforms a program does not use are at -1 and ignored
+
+	float VirtualSize = (float)(Header.VirtualTiles * Header.TileSize);
+
+	CShaderProgram *Programs[] = {Program, FeedbackProgram};
+
+	for(int i = 0; i < 2; i++)
+	{
+		CShaderProgram &Program = *Programs[i];
+
+		glUseProgram(Program);
+
+		glUniform2f(Program.GetUniformLocation(HASH_NAME32("ImageScale")), Header.Width / VirtualSize, Header.Height / VirtualSize);
+		glUniform1f(Program.GetUniformLocation(HASH_NAME32("VirtualTiles")), (float)Header.VirtualTiles);
+		glUniform1f(Program.GetUniformLocation(HASH_NAME32("TileSize")), (float)Header.TileSize);
+		glUniform1f(Program.GetUniformLocation(HASH_NAME32("MaxLevel")), (float)(Header.LevelsCount - 1));
+		glUniform1f(Program.GetUniformLocation(HASH_NAME32("LodBias")), i == 1 ? -log2f((float)VIRTUAL_TEXTURE_FEEDBACK_SCALE) : 0.0f);
+		glUniform1i(Program.GetUniformLocation(HASH_NAME32("PhysicalTexture")), 0);
+		glUniform1i(Program.GetUniformLocation(HASH_NAME32("PageTable")), 1);
+		glUniform2f(Program.GetUniformLocation(HASH_NAME32("PhysicalSize")), (float)(PhysicalTilesX * PaddedTileSize), (float)(PhysicalTilesY * PaddedTileSize));
+		glUniform1f(Program.GetUniformLocation(HASH_NAME32("PaddedTileSize")), (float)PaddedTileSize);
+		glUniform1f(Program.GetUniformLocation(HASH_NAME32("Border")), (float)Header.Border);
+	}
+
+	glUseProgram(0);
+
+	return true;
+}
+
+// the feedback pixels hold the low 8 bits of the tile x and y in red and green, the high 4 bits of both in blue and the
+// level in alpha, 255 where nothing was drawn
+
+void CVirtualTexture::ReadFeedback()
+{
+	if(!FeedbackPending[FeedbackBuffer])
+	{
+		return;
+	}
+
+	FeedbackPending[FeedbackBuffer] = false;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, FeedbackBuffers[FeedbackBuffer]);
+
+	const BYTE *Pixels = (const BYTE*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+
+	if(Pixels)
+	{
+		Requests.clear();
+
+		unsigned int Last = VIRTUAL_TEXTURE_EMPTY;
+
+		for(int i = 0; i < FeedbackWidth * FeedbackHeight; i++)
+		{
+			const BYTE *Pixel = Pixels + i * 4;
+
+			if(Pixel[3] >= Header.LevelsCount)
+			{
+				continue;
+			}
+
+			int Level = Pixel[3];
+			int X = std::min(Pixel[0] | (Pixel[2] & 15) << 8, Levels[Level].TilesX - 1);
+			int Y = std::min(Pixel[1] | (Pixel[2] >> 4) << 8, Levels[Level].TilesY - 1);
+
+			unsigned int Key = GetKey(Level, X, Y);
+
+			if(Key != Last)
+			{
+				Requests.push_back(Last = Key);
+			}
+		}
+
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+		std::sort(Requests.begin(), Requests.end());
+		Requests.erase(std::unique(Requests.begin(), Requests.end()), Requests.end());
+
+		Stats.RequestedTiles = (int)Requests.size();
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// the last requests are kept until new feedback arrives; a missing tile loads its missing ancestors too, coarsest first,
+// so the detail comes in level by level instead of jumping from the coarsest tile
+
+void CVirtualTexture::RequestTiles()
+{
+	std::vector<unsigned int> Loads;
+
+	for(size_t i = 0; i < Requests.size(); i++)
+	{
+		int Level = Requests[i] >> 24, X = Requests[i] & 4095, Y = (Requests[i] >> 12) & 4095;
+
+		for(; Level < Header.LevelsCount; Level++, X >>= 1, Y >>= 1)
+		{
+			X = std::min(X, Levels[Level].TilesX - 1);
+			Y = std::min(Y, Levels[Level].TilesY - 1);
+
+			unsigned int Key = GetKey(Level, X, Y);
+
+			std::unordered_map<unsigned int, int>::iterator Slot = Resident.find(Key);
+
+			if(Slot != Resident.end())
+			{
+				Touch(Slot->second);
+				break;
+			}
+
+			if(Pending.find(Key) == Pending.end())
+			{
+				Loads.push_back(Key);
+			}
+		}
+	}
+
+	std::sort(Loads.begin(), Loads.end(), [](unsigned int a, unsigned int b){ return a > b; });
+	Loads.erase(std::unique(Loads.begin(), Loads.end()), Loads.end());
+
+	for(size_t i = 0; i < Loads.size() && Loading < VIRTUAL_TEXTURE_MAX_LOADS; i++)
+	{
+		unsigned int Key = Loads[i];
+
+		Pending.insert(Key);
+
+		Loading++;
+
+		ThreadPool.Submit([this, Key]()
+		{
+			File.Prefetch(GetTile(Key) - File.Data, TileBytes);
+
+			std::lock_guard<std::mutex> Lock(Mutex);
+
+			Ready.push_back(Key);
+			Loading--;
+
+			Condition.notify_all();
+		});
+	}
+}
+
+// a tile takes the least recently used slot unless that slot was asked for in this frame, then the cache is too small
+// for the view and the tile is dropped until it is requested again
+
+void CVirtualTexture::UploadTiles()
+{
+	for(int i = 0; i < UploadBudget; i++)
+	{
+		unsigned int Key;
+
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+
+			if(Ready.size() == 0) break;
+
+			Key = Ready.front();
+			Ready.pop_front();
+		}
+
+		Pending.erase(Key);
+
+		int Slot = LRU.back();
+
+		if(Slots[Slot].Frame == Frame)
+		{
+			Stats.DroppedTiles++;
+			continue;
+		}
+
+		if(Slots[Slot].Key != VIRTUAL_TEXTURE_EMPTY)
+		{
+			Resident.erase(Slots[Slot].Key);
+			SetPageTableEntry(Slots[Slot].Key, -1);
+			Stats.EvictedTiles++;
+		}
+
+		UploadTile(Key, Slot);
+
+		Slots[Slot].Key = Key;
+		Resident[Key] = Slot;
+		Touch(Slot);
+
+		SetPageTableEntry(Key, Slot);
+
+		Stats.LoadedTiles++;
+	}
+}
+
+void CVirtualTexture::Touch(int Slot)
+{
+	if(Slot > 0)
+	{
+		LRU.splice(LRU.begin(), LRU, Slots[Slot].Position);
+		Slots[Slot].Frame = Frame;
+	}
+}
+
+void CVirtualTexture::UploadTile(unsigned int Key, int Slot)
+{
+	const BYTE *Tile = GetTile(Key);
+
+	int X = Slot % PhysicalTilesX * PaddedTileSize, Y = Slot / PhysicalTilesX * PaddedTileSize;
+
+	glBindTexture(GL_TEXTURE_2D, PhysicalTexture);
+
+	if(Format == BC_FORMAT_NONE)
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, X, Y, PaddedTileSize, PaddedTileSize, GL_RGBA, GL_UNSIGNED_BYTE, Tile);
+	}
+	else if(Decode)
+	{
+		DecodeBlocks(Tile, PaddedTileSize, PaddedTileSize, Format, DecodeBuffer, PaddedTileSize * 4);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, X, Y, PaddedTileSize, PaddedTileSize, GL_RGBA, GL_UNSIGNED_BYTE, DecodeBuffer);
+	}
+	else
+	{
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, X, Y, PaddedTileSize, PaddedTileSize, GetBlockInternalFormat(Format), TileBytes, Tile);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Stats.UploadedBytes += Decode ? PaddedTileSize * PaddedTileSize * 4 : TileBytes;
+}
+
+// an entry is the slot x, y and level of the tile itself or of its nearest resident ancestor; a change is pushed down
+// to every finer entry under the tile that has no resident tile of its own, Slot -1 evicts
+
+void CVirtualTexture::SetPageTableEntry(unsigned int Key, int Slot)
+{
+	int Level = Key >> 24, X = Key & 4095, Y = (Key >> 12) & 4095;
+
+	int Size = Header.VirtualTiles >> Level;
+
+	BYTE *Entry = PageTable[Level] + (Y * Size + X) * 4;
+
+	if(Slot >= 0)
+	{
+		Entry[0] = (BYTE)(Slot % PhysicalTilesX);
+		Entry[1] = (BYTE)(Slot / PhysicalTilesX);
+		Entry[2] = (BYTE)Level;
+	}
+	else
+	{
+		memcpy(Entry, PageTable[Level + 1] + ((Y >> 1) * (Size >> 1) + (X >> 1)) * 4, 4);
+	}
+
+	for(int l = Level, Span = 1; l >= 0; l--, Span *= 2)
+	{
+		int LevelSize = Header.VirtualTiles >> l, x0 = X * Span, y0 = Y * Span;
+
+		if(l < Level)
+		{
+			const BYTE *Parents = PageTable[l + 1];
+
+			for(int y = y0; y < y0 + Span; y++)
+			{
+				BYTE *Child = PageTable[l] + (y * LevelSize + x0) * 4;
+
+				for(int x = x0; x < x0 + Span; x++, Child += 4)
+				{
+					if(Child[2] != l)
+					{
+						memcpy(Child, Parents + ((y >> 1) * (LevelSize >> 1) + (x >> 1)) * 4, 4);
+					}
+				}
+			}
+		}
+
+		int *Rect = DirtyRects + l * 4;
+
+		Rect[0] = std::min(Rect[0], x0);
+		Rect[1] = std::min(Rect[1], y0);
+		Rect[2] = std::max(Rect[2], x0 + Span);
+		Rect[3] = std::max(Rect[3], y0 + Span);
+	}
+}
+
+void CVirtualTexture::UploadPageTable()
+{
+	bool Bound = false;
+
+	for(int Level = 0; Level < Header.LevelsCount; Level++)
+	{
+		int *Rect = DirtyRects + Level * 4, Size = Header.VirtualTiles >> Level;
+
+		if(Rect[0] >= Rect[2])
+		{
+			continue;
+		}
+
+		if(!Bound)
+		{
+			glBindTexture(GL_TEXTURE_2D, PageTableTexture);
+			Bound = true;
+		}
+
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, Size);
+		glTexSubImage2D(GL_TEXTURE_2D, Level, Rect[0], Rect[1], Rect[2] - Rect[0], Rect[3] - Rect[1], GL_RGBA, GL_UNSIGNED_BYTE, PageTable[Level] + (Rect[1] * Size + Rect[0]) * 4);
+
+		Rect[0] = Rect[1] = Size;
+		Rect[2] = Rect[3] = 0;
+	}
+
+	if(Bound)
+	{
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+}
+
+const BYTE *CVirtualTexture::GetTile(unsigned int Key)
+{
+	int Level = Key >> 24, X = Key & 4095, Y = (Key >> 12) & 4095;
+
+	return Tiles + (size_t)(Levels[Level].FirstTile + Y * Levels[Level].TilesX + X) * TileBytes;
+}
+
+void CVirtualTexture::SetDefaults()
+{
+	memset(&Header, 0, sizeof(Header));
+	Levels = NULL;
+	Tiles = NULL;
+	Format = BC_FORMAT_NONE;
+	PaddedTileSize = TileBytes = 0;
+	Decode = false;
+	DecodeBuffer = NULL;
+
+	PhysicalTexture = PageTableTexture = FrameBuffer = 0;
+	RenderBuffers[0] = RenderBuffers[1] = 0;
+	FeedbackBuffers[0] = FeedbackBuffers[1] = 0;
+	PhysicalTilesX = PhysicalTilesY = FeedbackWidth = FeedbackHeight = FeedbackBuffer = 0;
+	FeedbackPending[0] = FeedbackPending[1] = false;
+
+	Program = FeedbackProgram = NULL;
+
+	PageTable = NULL;
+	DirtyRects = NULL;
+	Slots = NULL;
+
+	Frame = 0;
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+unsigned int CVirtualTexture::GetKey(int Level, int X, int Y)
+{
+	return (unsigned int)Level << 24 | (unsigned int)Y << 12 | (unsigned int)X;
+}
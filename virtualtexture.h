@@ -0,0 +1,128 @@
+#pragma once
+
+#include "win32_opengl_glew_freeimage_glm.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+#define VIRTUAL_TEXTURE_TILE_SIZE 128
+#define VIRTUAL_TEXTURE_BORDER 4
+#define VIRTUAL_TEXTURE_MAX_TILES 4096
+#define VIRTUAL_TEXTURE_FEEDBACK_SCALE 8
+#define VIRTUAL_TEXTURE_MAX_LOADS 64
+
+// a .vtex file is the header, LevelsCount level descriptions and the tiles of all levels in rows, finest level first;
+// every tile is (TileSize + 2 * Border) pixels square with the neighbouring pixels in the border, RGBA8 or blocks
+
+struct CVirtualTextureHeader
+{
+	DWORD Magic, Version;
+	int Width, Height, TileSize, Border, LevelsCount, VirtualTiles, Format, Opaque;
+};
+
+struct CVirtualTextureLevel
+{
+	int Width, Height, TilesX, TilesY, FirstTile;
+};
+
+struct CVirtualTextureStats
+{
+	int PhysicalTiles, ResidentTiles, RequestedTiles, PendingTiles, LoadedTiles, EvictedTiles, DroppedTiles;
+	long long UploadedBytes;
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// shows images of any size through a physical cache texture of tile slots; a feedback pass at a fraction of the screen
+// size writes the tile each pixel wants, the tiles are paged in from the mapped pyramid on the thread pool and the
+// least recently used slots are reused for them; the page table maps every tile of every level to the slot of itself or
+// of its nearest resident ancestor, the coarsest tile is always resident
+
+class CVirtualTexture
+{
+protected:
+	struct CSlot
+	{
+		unsigned int Key;
+		int Frame;
+		std::list<int>::iterator Position;
+	};
+
+protected:
+	CMappedFile File;
+	CVirtualTextureHeader Header;
+	const CVirtualTextureLevel *Levels;
+	const BYTE *Tiles;
+	BC_FORMAT Format;
+	int PaddedTileSize, TileBytes;
+	bool Decode;
+	BYTE *DecodeBuffer;
+
+	GLuint PhysicalTexture, PageTableTexture, FrameBuffer, RenderBuffers[2], FeedbackBuffers[2];
+	int PhysicalTilesX, PhysicalTilesY, FeedbackWidth, FeedbackHeight, FeedbackBuffer;
+	bool FeedbackPending[2];
+	GLint Viewport[4];
+	GLfloat ClearColor[4];
+	int ProgramVariant, FeedbackProgramVariant;
+	CShaderProgram *Program, *FeedbackProgram;
+
+	BYTE **PageTable;
+	int *DirtyRects;
+
+	CSlot *Slots;
+	std::list<int> LRU;
+	std::unordered_map<unsigned int, int> Resident;
+	std::unordered_set<unsigned int> Pending;
+	std::vector<unsigned int> Requests;
+
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	std::deque<unsigned int> Ready;
+	std::atomic<int> Loading;
+
+	int Frame;
+	CVirtualTextureStats Stats;
+
+public:
+	int CacheTiles, UploadBudget;
+
+public:
+	CVirtualTexture();
+	~CVirtualTexture();
+
+	void AddPrograms();
+	bool Load(const char *FileName);
+	void Resize(int Width, int Height);
+	bool BeginFeedback();
+	void EndFeedback();
+	void Update();
+	void Bind();
+	void Unbind();
+	void GetStats(CVirtualTextureStats &Stats);
+	void Destroy();
+
+	static bool Build(const char *SourceFileName, const char *FileName, CString &Errors);
+
+protected:
+	bool Map(const char *FileName);
+	bool InitPrograms();
+	void ReadFeedback();
+	void RequestTiles();
+	void UploadTiles();
+	void Touch(int Slot);
+	void UploadTile(unsigned int Key, int Slot);
+	void SetPageTableEntry(unsigned int Key, int Slot);
+	void UploadPageTable();
+	const BYTE *GetTile(unsigned int Key);
+	void SetDefaults();
+
+	static unsigned int GetKey(int Level, int X, int Y);
+};
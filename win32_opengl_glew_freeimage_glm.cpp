@@ -1,22 +1,60 @@
 #include "win32_opengl_glew_freeimage_glm.h"
+#include "benchmark.h"
+#include "bvh.h"
+#include "debugdraw.h"
+#include "frameuniforms.h"
+#include "instances.h"
+#include "mesh.h"
+#include "meshloader.h"
+#include "microbenchmark.h"
+#include "profiler.h"
+#include "scenegraph.h"
+#include "shadercache.h"
+#include "shaderlibrary.h"
+#include "texturecache.h"
+#include "texturestreamer.h"
+#include "textureatlas.h"
+#include "threadpool.h"
+#include "virtualtexture.h"
 
 // ----------------------------------------------------------------------------------------------------------------------------
 
-void DisplayError(char *ErrorText)
+#ifdef _WIN32
+
+void DisplayError(const char *ErrorText)
 {
 	MessageBox(NULL, ErrorText, "Error", MB_OK | MB_ICONERROR);
 }
 
-void DisplayInfo(char *InfoText)
+void DisplayInfo(const char *InfoText)
 {
 	MessageBox(NULL, InfoText, "Info", MB_OK | MB_ICONINFORMATION);
 }
 
-bool DisplayQuestion(char *QuestionText)
+bool DisplayQuestion(const char *QuestionText)
 {
 	return MessageBox(NULL, QuestionText, "Question", MB_YESNO | MB_ICONQUESTION) == IDYES;
 }
 
+#else
+
+void DisplayError(const char *ErrorText)
+{
+	fprintf(stderr, "Error: %s\n", ErrorText);
+}
+
+void DisplayInfo(const char *InfoText)
+{
+	printf("Info: %s\n", InfoText);
+}
+
+bool DisplayQuestion(const char * /* QuestionText */)
+{
+	return false;
+}
+
+#endif
+
 // ----------------------------------------------------------------------------------------------------------------------------
 
 CString ModuleDirectory, ErrorLog;
@@ -26,30 +64,231 @@ int gl_version = 0, gl_max_texture_size = 0, gl_max_texture_max_anisotropy_ext =
 
 // ----------------------------------------------------------------------------------------------------------------------------
 
-CTexture::CTexture()
+CCommandLine::CCommandLine()
 {
-	TextureID = 0;
+	Width = 800;
+	Height = 600;
+	Samples = 4;
+	Frames = 1;
+	UploadBudget = 4096;
+	TextureBudget = 0;
+	InstancesCount = 0;
+	FullScreen = false;
+	AskFullScreen = true;
+	TextureCompression = true;
+	ShaderCache = true;
+	TextureCompressionQuality = BC_QUALITY_NORMAL;
+	FrameTime = 0.016f;
+	ScreenShotFileName = NULL;
+	BenchmarkFileName = NULL;
+	CameraPathFileName = NULL;
+	RecordFileName = NULL;
+	TraceFileName = NULL;
+	MicroBenchmarkName = NULL;
+	VirtualTextureFileName = NULL;
+	AtlasFileName = NULL;
+	MeshFileName = NULL;
 }
 
-CTexture::~CTexture()
+CCommandLine::~CCommandLine()
 {
 }
 
-CTexture::operator GLuint ()
+bool CCommandLine::Parse(int argc, char **argv)
 {
-	return TextureID;
+	for(int i = 1; i < argc; i++)
+	{
+		bool HasValue = i + 1 < argc;
+
+		if(strcmp(argv[i], "-fullscreen") == 0)
+		{
+			FullScreen = true;
+			AskFullScreen = false;
+		}
+		else if(strcmp(argv[i], "-windowed") == 0)
+		{
+			FullScreen = false;
+			AskFullScreen = false;
+		}
+		else if(strcmp(argv[i], "-width") == 0 && HasValue)
+		{
+			Width = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-height") == 0 && HasValue)
+		{
+			Height = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-samples") == 0 && HasValue)
+		{
+			Samples = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-frames") == 0 && HasValue)
+		{
+			Frames = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-frametime") == 0 && HasValue)
+		{
+			FrameTime = (float)atof(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-uploadbudget") == 0 && HasValue)
+		{
+			UploadBudget = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-texturebudget") == 0 && HasValue)
+		{
+			TextureBudget = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-instances") == 0 && HasValue)
+		{
+			InstancesCount = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-noshadercache") == 0)
+		{
+			ShaderCache = false;
+		}
+		else if(strcmp(argv[i], "-texturecompression") == 0 && HasValue)
+		{
+			char *Value = argv[++i];
+
+			TextureCompression = strcmp(Value, "none") != 0;
+
+			if(strcmp(Value, "fast") == 0) TextureCompressionQuality = BC_QUALITY_FAST;
+			else if(strcmp(Value, "normal") == 0) TextureCompressionQuality = BC_QUALITY_NORMAL;
+			else if(strcmp(Value, "high") == 0) TextureCompressionQuality = BC_QUALITY_HIGH;
+			else if(TextureCompression)
+			{
+				ErrorLog.Set("Invalid command line argument value!");
+				return false;
+			}
+		}
+		else if(strcmp(argv[i], "-screenshot") == 0 && HasValue)
+		{
+			ScreenShotFileName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-benchmark") == 0 && HasValue)
+		{
+			BenchmarkFileName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-camerapath") == 0 && HasValue)
+		{
+			CameraPathFileName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-record") == 0 && HasValue)
+		{
+			RecordFileName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-trace") == 0 && HasValue)
+		{
+			TraceFileName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-microbenchmark") == 0 && HasValue)
+		{
+			MicroBenchmarkName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-virtualtexture") == 0 && HasValue)
+		{
+			VirtualTextureFileName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-atlas") == 0 && HasValue)
+		{
+			AtlasFileName = argv[++i];
+		}
+		else if(strcmp(argv[i], "-mesh") == 0 && HasValue)
+		{
+			MeshFileName = argv[++i];
+		}
+		else
+		{
+			ErrorLog.Set("Unknown command line argument %s!", argv[i]);
+			return false;
+		}
+	}
+
+	if(Width <= 0 || Height <= 0 || Frames < 0 || UploadBudget <= 0 || TextureBudget < 0 || InstancesCount < 0)
+	{
+		ErrorLog.Set("Invalid command line argument value!");
+		return false;
+	}
+
+	return true;
 }
 
-void CTexture::Delete()
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CTextureImage::CTextureImage()
 {
-	glDeleteTextures(1, &TextureID);
-	TextureID = 0;
+	dib = NULL;
+	Data = NULL;
+	Width = Height = Pitch = 0;
+	memset(&PixelFormat, 0, sizeof(PixelFormat));
 }
 
-bool CTexture::LoadTexture2D(char *Texture2DFileName)
+CTextureImage::~CTextureImage()
 {
-	CString FileName = ModuleDirectory + Texture2DFileName;
-	CString ErrorText = "Error loading file " + FileName + "! ->";
+	Destroy();
+}
+
+// SkipLevels drops the largest mip levels, compressed textures after they are encoded and cached, the rest by
+// resampling; a ContentHash of the file already known saves reading it once more for the cache key
+
+bool CTextureImage::Load(const char *Texture2DFileName, CString &Errors, int SkipLevels, const HASH64 *ContentHash)
+{
+	PROFILE_ZONE("CTextureImage::Load");
+
+	Destroy();
+
+	CString FileName = CString::Concat({ModuleDirectory, Texture2DFileName});
+	CString ErrorText = CString::Concat({"Error loading file ", FileName, "! ->"});
+
+	// pre-baked containers are mapped and uploaded as they are, DDS files this cannot use are still read by FreeImage
+
+	const char *Extension = strrchr(Texture2DFileName, '.');
+
+	bool DDS = Extension != NULL && (strcmp(Extension, ".dds") == 0 || strcmp(Extension, ".DDS") == 0);
+	bool KTX2 = Extension != NULL && (strcmp(Extension, ".ktx2") == 0 || strcmp(Extension, ".KTX2") == 0);
+
+	if((DDS || KTX2) && Compressed.Load(FileName))
+	{
+		int LevelWidth = Compressed.Levels[0].Width, LevelHeight = Compressed.Levels[0].Height;
+
+		bool Fits = LevelWidth <= gl_max_texture_size && LevelHeight <= gl_max_texture_size;
+		bool PowerOfTwo = (LevelWidth & (LevelWidth - 1)) == 0 && (LevelHeight & (LevelHeight - 1)) == 0;
+
+		if(Fits && (PowerOfTwo || GLEW_ARB_texture_non_power_of_two) && IsBlockFormatSupported(Compressed.Format, Compressed.sRGB, PixelFormatCaps))
+		{
+			SetCompressed(Compressed.Opaque, SkipLevels);
+
+			return true;
+		}
+
+		Compressed.Destroy();
+	}
+
+	if(KTX2)
+	{
+		Errors.AppendStrings({ErrorText, "unsupported KTX2 format or size", "\r\n"});
+		return false;
+	}
+
+	HASH64 CacheKey;
+
+	bool Cacheable = TextureCache.IsEnabled();
+
+	if(Cacheable && ContentHash)
+	{
+		CacheKey = TextureCache.GetKey(*ContentHash);
+	}
+	else if(Cacheable)
+	{
+		Cacheable = TextureCache.GetKey(FileName, CacheKey);
+	}
+
+	if(Cacheable && TextureCache.Load(CacheKey, Compressed))
+	{
+		SetCompressed(Compressed.Opaque, SkipLevels);
+
+		return true;
+	}
 
 	FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(FileName);
 
@@ -60,12 +299,10 @@ bool CTexture::LoadTexture2D(char *Texture2DFileName)
 	
 	if(fif == FIF_UNKNOWN)
 	{
-		ErrorLog.Append(ErrorText + "fif is FIF_UNKNOWN" + "\r\n");
+		Errors.AppendStrings({ErrorText, "fif is FIF_UNKNOWN", "\r\n"});
 		return false;
 	}
 
-	FIBITMAP *dib = NULL;
-
 	if(FreeImage_FIFSupportsReading(fif))
 	{
 		dib = FreeImage_Load(fif, FileName);
@@ -73,18 +310,19 @@ bool CTexture::LoadTexture2D(char *Texture2DFileName)
 	
 	if(dib == NULL)
 	{
-		ErrorLog.Append(ErrorText + "dib is NULL" + "\r\n");
+		Errors.AppendStrings({ErrorText, "dib is NULL", "\r\n"});
 		return false;
 	}
 
-	int Width = FreeImage_GetWidth(dib), oWidth = Width;
-	int Height = FreeImage_GetHeight(dib), oHeight = Height;
-	int Pitch = FreeImage_GetPitch(dib);
-	int BPP = FreeImage_GetBPP(dib);
+	Width = FreeImage_GetWidth(dib);
+	Height = FreeImage_GetHeight(dib);
+
+	int oWidth = Width, oHeight = Height;
 
 	if(Width == 0 || Height == 0)
 	{
-		ErrorLog.Append(ErrorText + "Width or Height is 0" + "\r\n");
+		Errors.AppendStrings({ErrorText, "Width or Height is 0", "\r\n"});
+		Destroy();
 		return false;
 	}
 
@@ -97,213 +335,544 @@ bool CTexture::LoadTexture2D(char *Texture2DFileName)
 		Height = 1 << (int)floor((log((float)Height) / log(2.0f)) + 0.5f);
 	}
 
-	if(Width != oWidth || Height != oHeight)
-	{
-		FIBITMAP *rdib = FreeImage_Rescale(dib, Width, Height, FILTER_BICUBIC);
-
-		FreeImage_Unload(dib);
-
-		if((dib = rdib) == NULL)
-		{
-			ErrorLog.Append(ErrorText + "rdib is NULL" + "\r\n");
-			return false;
-		}
-
-		Pitch = FreeImage_GetPitch(dib);
-	}
-
-	BYTE *Data = FreeImage_GetBits(dib);
+	CString ConvertErrors;
 
-	if(Data == NULL)
+	if(!Pixels.Convert(dib, PixelFormatCaps, ConvertErrors))
 	{
-		ErrorLog.Append(ErrorText + "Data is NULL" + "\r\n");
+		Errors.AppendStrings({ErrorText, ConvertErrors, "\r\n"});
+		Destroy();
 		return false;
 	}
 
-	GLenum Format = 0;
-
-	if(BPP == 32) Format = GL_BGRA;
-	if(BPP == 24) Format = GL_BGR;
+	BC_FORMAT Format = Cacheable ? TextureCache.GetFormat(Pixels.PixelFormat, Width, Height, PixelFormatCaps) : BC_FORMAT_NONE;
 
-	if(Format == 0)
+	if(Format == BC_FORMAT_NONE)
 	{
-		FreeImage_Unload(dib);
-		ErrorLog.Append(ErrorText + "Format is 0" + "\r\n");
-		return false;
+		Width = Width >> SkipLevels > 0 ? Width >> SkipLevels : 1;
+		Height = Height >> SkipLevels > 0 ? Height >> SkipLevels : 1;
 	}
 
-	if(gl_version < 12)
-	{
-		if(Format == GL_BGRA) Format = GL_RGBA;
-		if(Format == GL_BGR) Format = GL_RGB;
-
-		int bpp = BPP / 8;
+	// 16 bit per channel and float images are still rescaled by FreeImage
 
-		BYTE *line = Data;
-
-		for(int y = 0; y < Height; y++)
+	if(Width != oWidth || Height != oHeight)
+	{
+		if(Pixels.PixelFormat.Channels > 0)
 		{
-			BYTE *pixel = line;
-
-			for(int x = 0; x < Width; x++)
+			if(!Pixels.Resample(Width, Height, RESAMPLE_FILTER_BICUBIC))
 			{
-				BYTE Temp = pixel[0];
-				pixel[0] = pixel[2];
-				pixel[2] = Temp;
+				Errors.AppendStrings({ErrorText, "Pixels.Resample failed", "\r\n"});
+				Destroy();
+				return false;
+			}
+		}
+		else
+		{
+			FIBITMAP *rdib = FreeImage_Rescale(dib, Width, Height, FILTER_BICUBIC);
 
-				pixel += bpp;
+			FreeImage_Unload(dib);
+
+			if((dib = rdib) == NULL)
+			{
+				Errors.AppendStrings({ErrorText, "rdib is NULL", "\r\n"});
+				Destroy();
+				return false;
 			}
 
-			line += Pitch;
+			if(!Pixels.Convert(dib, PixelFormatCaps, ConvertErrors))
+			{
+				Errors.AppendStrings({ErrorText, ConvertErrors, "\r\n"});
+				Destroy();
+				return false;
+			}
 		}
 	}
 
-	glGenTextures(1, &TextureID);
+	Data = Pixels.Data;
+	Pitch = Pixels.Pitch;
+	PixelFormat = Pixels.PixelFormat;
 
-	glBindTexture(GL_TEXTURE_2D, TextureID);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, gl_version >= 14 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	
-	if(GLEW_EXT_texture_filter_anisotropic)
+	if(Data == NULL)
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, gl_max_texture_max_anisotropy_ext);
+		Errors.AppendStrings({ErrorText, "Data is NULL", "\r\n"});
+		Destroy();
+		return false;
 	}
-	
-	if(gl_version >= 14 && gl_version <= 21)
+
+	// 16 bit per channel and float data get their mipmaps from the driver
+
+	if(PixelFormat.Channels == 0)
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+		Mipmaps.SetBaseLevel(Data, Width, Height, Pitch);
 	}
-	
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, Width, Height, 0, Format, GL_UNSIGNED_BYTE, Data);
-	
-	if(gl_version >= 30)
+	else if(!Mipmaps.Generate(Data, Width, Height, Pitch, PixelFormat.Channels, MIPMAP_FILTER_KAISER, true, PixelFormat.Channels == 4 && !PixelFormat.Opaque))
 	{
-		glGenerateMipmap(GL_TEXTURE_2D);
+		Errors.AppendStrings({ErrorText, "Mipmaps.Generate failed", "\r\n"});
+		Destroy();
+		return false;
 	}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	// the pixels are dropped once encoded, a failed encode leaves the texture uncompressed at full size
+
+	if(Format != BC_FORMAT_NONE && TextureCache.Encode(CacheKey, Mipmaps, PixelFormat, Format, Compressed))
+	{
+		Mipmaps.Destroy();
+		Pixels.Destroy();
+
+		FreeImage_Unload(dib);
+
+		dib = NULL;
+		Data = NULL;
+		Pitch = 0;
 
-	FreeImage_Unload(dib);
+		SetCompressed(Compressed.Opaque, SkipLevels);
+	}
 
 	return true;
 }
 
-// ----------------------------------------------------------------------------------------------------------------------------
+bool CTextureImage::IsCompressed()
+{
+	return Compressed.LevelsCount > 0;
+}
 
-CShaderProgram::CShaderProgram()
+int CTextureImage::GetLevelsCount()
 {
-	SetDefaults();
+	return IsCompressed() ? Compressed.LevelsCount : Mipmaps.LevelsCount;
 }
 
-CShaderProgram::~CShaderProgram()
+void CTextureImage::Destroy()
 {
+	Compressed.Destroy();
+	Mipmaps.Destroy();
+	Pixels.Destroy();
+
+	if(dib)
+	{
+		FreeImage_Unload(dib);
+	}
+
+	dib = NULL;
+	Data = NULL;
+	Width = Height = Pitch = 0;
+	memset(&PixelFormat, 0, sizeof(PixelFormat));
 }
 
-CShaderProgram::operator GLuint ()
+int CTextureImage::GetTextureLevelsCount()
 {
-	return Program;
+	return GetLevelsCount() == 1 && !IsCompressed() && gl_version >= 30 ? CMipmapChain::GetLevelsCount(Width, Height) : GetLevelsCount();
 }
 
-void CShaderProgram::Delete()
+void CTextureImage::SetCompressed(bool Opaque, int SkipLevels)
 {
-	delete [] UniformLocations;
+	Compressed.DropLevels(SkipLevels);
 
-	glDetachShader(Program, VertexShader);
-	glDetachShader(Program, FragmentShader);
+	Width = Compressed.Levels[0].Width;
+	Height = Compressed.Levels[0].Height;
 
-	glDeleteShader(VertexShader);
-	glDeleteShader(FragmentShader);
+	memset(&PixelFormat, 0, sizeof(PixelFormat));
 
-	glDeleteProgram(Program);
+	PixelFormat.InternalFormat = GetBlockInternalFormat(Compressed.Format, Compressed.sRGB);
+	PixelFormat.Channels = Compressed.Format == BC_FORMAT_BC4 ? 1 : Compressed.Format == BC_FORMAT_BC5 ? 2 : Opaque ? 3 : 4;
+	PixelFormat.Grey = Compressed.Format == BC_FORMAT_BC4;
+	PixelFormat.Opaque = Opaque;
+}
 
-	SetDefaults();
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CTexture::CTexture()
+{
+	TextureID = 0;
+	Width = Height = LevelsCount = 0;
+	InternalFormat = 0;
 }
 
-bool CShaderProgram::Load(char *VertexShaderFileName, char *FragmentShaderFileName)
+CTexture::~CTexture()
 {
-	if(UniformLocations || VertexShader || FragmentShader || Program)
+}
+
+CTexture::operator GLuint ()
+{
+	return TextureID;
+}
+
+void CTexture::Delete()
+{
+	TextureStreamer.Cancel(this);
+
+	if(!TextureStreamer.IsPlaceholder(TextureID))
 	{
-		Delete();
+		glDeleteTextures(1, &TextureID);
 	}
 
-	bool Error = false;
+	TextureID = 0;
+	Width = Height = LevelsCount = 0;
+}
 
-	Error |= ((VertexShader = LoadShader(GL_VERTEX_SHADER, VertexShaderFileName)) == 0);
+bool CTexture::LoadTexture2D(const char *Texture2DFileName)
+{
+	PROFILE_ZONE("CTexture::LoadTexture2D");
 
-	Error |= ((FragmentShader = LoadShader(GL_FRAGMENT_SHADER, FragmentShaderFileName)) == 0);
+	CTextureImage Image;
 
-	if(Error)
+	if(!Image.Load(Texture2DFileName, ErrorLog))
 	{
-		Delete();
 		return false;
 	}
 
-	Program = glCreateProgram();
-	glAttachShader(Program, VertexShader);
-	glAttachShader(Program, FragmentShader);
-	glLinkProgram(Program);
+	return Upload(Image);
+}
 
-	int Param = 0;
-	glGetProgramiv(Program, GL_LINK_STATUS, &Param);
+bool CTexture::Upload(CTextureImage &Image)
+{
+	PROFILE_ZONE("CTexture::Upload");
 
-	if(Param == GL_FALSE)
+	GLuint NewTextureID;
+
+	glGenTextures(1, &NewTextureID);
+
+	glBindTexture(GL_TEXTURE_2D, NewTextureID);
+
+	SetParameters(Image);
+
+	CPixelFormat &PixelFormat = Image.PixelFormat;
+
+	for(int i = 0; i < Image.Compressed.LevelsCount; i++)
 	{
-		ErrorLog.Append("Error linking program (%s, %s)!\r\n", VertexShaderFileName, FragmentShaderFileName);
+		CCompressedLevel &Level = Image.Compressed.Levels[i];
 
-		int InfoLogLength = 0;
-		glGetProgramiv(Program, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	
-		if(InfoLogLength > 0)
-		{
-			char *InfoLog = new char[InfoLogLength];
-			int CharsWritten  = 0;
-			glGetProgramInfoLog(Program, InfoLogLength, &CharsWritten, InfoLog);
-			ErrorLog.Append(InfoLog);
-			delete [] InfoLog;
-		}
+		glCompressedTexImage2D(GL_TEXTURE_2D, i, PixelFormat.InternalFormat, Level.Width, Level.Height, 0, (GLsizei)Level.Size, Level.Data);
+	}
 
-		Delete();
+	for(int i = 0; i < Image.Mipmaps.LevelsCount; i++)
+	{
+		CMipmapLevel &Level = Image.Mipmaps.Levels[i];
 
-		return false;
+		glTexImage2D(GL_TEXTURE_2D, i, PixelFormat.InternalFormat, Level.Width, Level.Height, 0, PixelFormat.Format, PixelFormat.Type, Level.Data);
 	}
 
+	GenerateMissingMipmaps(Image);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	SetTextureID(NewTextureID, Image.Width, Image.Height, PixelFormat.InternalFormat, Image.GetTextureLevelsCount());
+
 	return true;
 }
 
-GLuint CShaderProgram::LoadShader(GLenum Type, char *ShaderFileName)
+void CTexture::SetTextureID(GLuint TextureID, int Width, int Height, GLenum InternalFormat, int LevelsCount)
+{
+	if(this->TextureID != 0 && !TextureStreamer.IsPlaceholder(this->TextureID))
+	{
+		glDeleteTextures(1, &this->TextureID);
+	}
+
+	this->TextureID = TextureID;
+	this->Width = Width;
+	this->Height = Height;
+	this->InternalFormat = InternalFormat;
+	this->LevelsCount = LevelsCount;
+}
+
+int CTexture::GetLevelsCount()
 {
-	CString FileName = ModuleDirectory + ShaderFileName;
+	return LevelsCount;
+}
 
-	FILE *File;
+// compressed levels take whole 4x4 blocks
 
-	if(fopen_s(&File, FileName, "rb") != 0)
+long long CTexture::GetLevelBytes(int Level)
+{
+	if(Level < 0 || Level >= LevelsCount)
 	{
-		ErrorLog.Append("Error loading file " + FileName + "!\r\n");
 		return 0;
 	}
 
-	fseek(File, 0, SEEK_END);
-	long Size = ftell(File);
-	fseek(File, 0, SEEK_SET);
-	char *Source = new char[Size + 1];
-	fread(Source, 1, Size, File);
-	fclose(File);
-	Source[Size] = 0;
+	long long LevelWidth = Width >> Level > 0 ? Width >> Level : 1, LevelHeight = Height >> Level > 0 ? Height >> Level : 1;
 
-	GLuint Shader;
+	if(IsBlockInternalFormat(InternalFormat))
+	{
+		LevelWidth = (LevelWidth + 3) & ~3;
+		LevelHeight = (LevelHeight + 3) & ~3;
+	}
 
-	Shader = glCreateShader(Type);
-	glShaderSource(Shader, 1, (const char**)&Source, NULL);
-	delete [] Source;
-	glCompileShader(Shader);
+	return LevelWidth * LevelHeight * GetInternalFormatBits(InternalFormat) / 8;
+}
 
-	int Param = 0;
+long long CTexture::GetResidentBytes()
+{
+	long long Bytes = 0;
+
+	for(int Level = 0; Level < LevelsCount; Level++)
+	{
+		Bytes += GetLevelBytes(Level);
+	}
+
+	return Bytes;
+}
+
+void CTexture::SetParameters(CTextureImage &Image)
+{
+	// glGenerateMipmap cannot fill in compressed levels
+
+	bool Mipmapped = Image.GetLevelsCount() > 1 || (gl_version >= 30 && !Image.IsCompressed()) || (Image.Width == 1 && Image.Height == 1);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, Mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	
+	if(GLEW_EXT_texture_filter_anisotropic)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, gl_max_texture_max_anisotropy_ext);
+	}
+
+	if(Image.PixelFormat.Grey)
+	{
+		GLint Swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, Swizzle);
+	}
+}
+
+void CTexture::GenerateMissingMipmaps(CTextureImage &Image)
+{
+	if(Image.GetLevelsCount() == 1 && !Image.IsCompressed() && gl_version >= 30)
+	{
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+CShaderProgram::CShaderProgram()
+{
+	SetDefaults();
+}
+
+CShaderProgram::~CShaderProgram()
+{
+}
+
+CShaderProgram::operator GLuint ()
+{
+	return Program;
+}
+
+void CShaderProgram::Delete()
+{
+	delete [] UniformLocations;
+
+	// programs loaded from the cache have no shaders attached
+
+	if(VertexShader) glDetachShader(Program, VertexShader);
+	if(FragmentShader) glDetachShader(Program, FragmentShader);
+
+	glDeleteShader(VertexShader);
+	glDeleteShader(FragmentShader);
+
+	glDeleteProgram(Program);
+
+	SetDefaults();
+}
+
+bool CShaderProgram::Load(const char *VertexShaderFileName, const char *FragmentShaderFileName, const char *Defines)
+{
+	PROFILE_ZONE("CShaderProgram::Load");
+
+	CShaderPreprocessor Preprocessor;
+
+	std::string VertexShaderSource, FragmentShaderSource;
+	std::vector<std::string> FileNames;
+
+	if(!Preprocessor.Expand(VertexShaderFileName, Defines, VertexShaderSource, FileNames) || !Preprocessor.Expand(FragmentShaderFileName, Defines, FragmentShaderSource, FileNames))
+	{
+		return false;
+	}
+
+	CString Name = CString::Concat({VertexShaderFileName, ", ", FragmentShaderFileName});
+
+	if(Defines)
+	{
+		Name.AppendStrings({" [", Defines, "]"});
+	}
+
+	Begin(Name, VertexShaderSource.c_str(), (int)VertexShaderSource.size(), FragmentShaderSource.c_str(), (int)FragmentShaderSource.size());
+
+	return End();
+}
+
+// a program from the cache is ready at once
+
+bool CShaderProgram::Begin(const char *Name, const char *VertexShaderSource, int VertexShaderLength, const char *FragmentShaderSource, int FragmentShaderLength)
+{
+	PROFILE_ZONE("CShaderProgram::Begin");
+
+	if(UniformLocations || VertexShader || FragmentShader || Program)
+	{
+		Delete();
+	}
+
+	this->Name = Name;
+
+	Cacheable = ShaderCache.IsEnabled();
+
+	if(Cacheable)
+	{
+		const BYTE *Sources[] = {(const BYTE*)VertexShaderSource, (const BYTE*)FragmentShaderSource};
+		size_t Sizes[] = {(size_t)VertexShaderLength, (size_t)FragmentShaderLength};
+
+		Key = ShaderCache.GetKey(Sources, Sizes, 2);
+	}
+
+	Program = glCreateProgram();
+
+	if(Cacheable && ShaderCache.Load(Key, Program))
+	{
+		Linked = true;
+
+		Reflect();
+
+		return true;
+	}
+
+	double Start = GetTime();
+
+	VertexShader = CreateShader(GL_VERTEX_SHADER, VertexShaderSource, VertexShaderLength);
+	FragmentShader = CreateShader(GL_FRAGMENT_SHADER, FragmentShaderSource, FragmentShaderLength);
+
+	glAttachShader(Program, VertexShader);
+	glAttachShader(Program, FragmentShader);
+
+	if(Cacheable)
+	{
+		glProgramParameteri(Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	glLinkProgram(Program);
+
+	ShaderCache.CountBuild(GetTime() - Start);
+
+	return true;
+}
+
+bool CShaderProgram::IsReady()
+{
+	if(Linked || Program == 0 || !IsParallelCompileSupported())
+	{
+		return true;
+	}
+
+	GLint Completed = GL_FALSE;
+
+	glGetProgramiv(Program, GL_COMPLETION_STATUS_ARB, &Completed);
+
+	return Completed == GL_TRUE;
+}
+
+bool CShaderProgram::End()
+{
+	PROFILE_ZONE("CShaderProgram::End");
+
+	if(Program == 0)
+	{
+		return false;
+	}
+
+	if(Linked)
+	{
+		return true;
+	}
+
+	double Start = GetTime();
+
+	bool Error = false;
+
+	Error |= !CheckShader(VertexShader, "vertex");
+	Error |= !CheckShader(FragmentShader, "fragment");
+
+	if(Error)
+	{
+		Delete();
+		return false;
+	}
+
+	int Param = 0;
+	glGetProgramiv(Program, GL_LINK_STATUS, &Param);
+
+	if(Param == GL_FALSE)
+	{
+		ErrorLog.Append("Error linking program (%s)!\r\n", (char*)Name);
+
+		int InfoLogLength = 0;
+		glGetProgramiv(Program, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	
+		if(InfoLogLength > 0)
+		{
+			char *InfoLog = new char[InfoLogLength];
+			int CharsWritten  = 0;
+			glGetProgramInfoLog(Program, InfoLogLength, &CharsWritten, InfoLog);
+			ErrorLog += InfoLog;
+			delete [] InfoLog;
+		}
+
+		Delete();
+
+		return false;
+	}
+
+	ShaderCache.CountBuild(GetTime() - Start);
+
+	if(Cacheable)
+	{
+		ShaderCache.Save(Key, Program);
+	}
+
+	Linked = true;
+
+	Reflect();
+
+	return true;
+}
+
+GLint CShaderProgram::GetUniformLocation(unsigned int NameHash)
+{
+	if(UniformLocations == NULL)
+	{
+		return -1;
+	}
+
+	for(int Slot = NameHash & UniformLocationsMask; UniformLocations[Slot].Location != -1; Slot = (Slot + 1) & UniformLocationsMask)
+	{
+		if(UniformLocations[Slot].Hash == NameHash)
+		{
+			return UniformLocations[Slot].Location;
+		}
+	}
+
+	return -1;
+}
+
+bool CShaderProgram::IsParallelCompileSupported()
+{
+	return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+}
+
+GLuint CShaderProgram::CreateShader(GLenum Type, const char *Source, int Length)
+{
+	GLuint Shader = glCreateShader(Type);
+
+	glShaderSource(Shader, 1, &Source, &Length);
+	glCompileShader(Shader);
+
+	return Shader;
+}
+
+bool CShaderProgram::CheckShader(GLuint Shader, const char *Type)
+{
+	int Param = 0;
 	glGetShaderiv(Shader, GL_COMPILE_STATUS, &Param);
 
 	if(Param == GL_FALSE)
 	{
-		ErrorLog.Append("Error compiling shader %s!\r\n", ShaderFileName);
+		ErrorLog.Append("Error compiling %s shader (%s)!\r\n", Type, (char*)Name);
 
 		int InfoLogLength = 0;
 		glGetShaderiv(Shader, GL_INFO_LOG_LENGTH, &InfoLogLength);
@@ -313,24 +882,97 @@ GLuint CShaderProgram::LoadShader(GLenum Type, char *ShaderFileName)
 			char *InfoLog = new char[InfoLogLength];
 			int CharsWritten  = 0;
 			glGetShaderInfoLog(Shader, InfoLogLength, &CharsWritten, InfoLog);
-			ErrorLog.Append(InfoLog);
+			ErrorLog += InfoLog;
 			delete [] InfoLog;
 		}
 
-		glDeleteShader(Shader);
+		return false;
+	}
 
-		return 0;
+	return true;
+}
+
+// the table has at least twice as many slots as uniforms, so every lookup ends at an empty slot soon; the uniform
+// blocks are bound here too, a program taken from the cache does not keep the bindings
+
+void CShaderProgram::Reflect()
+{
+	FrameUniforms.BindBlocks(Program);
+
+	GLint UniformsCount = 0, MaxLength = 0;
+
+	glGetProgramiv(Program, GL_ACTIVE_UNIFORMS, &UniformsCount);
+	glGetProgramiv(Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &MaxLength);
+
+	int SlotsCount = 2;
+
+	while(SlotsCount < UniformsCount * 2) SlotsCount <<= 1;
+
+	UniformLocations = new CUniformLocation[SlotsCount];
+	UniformLocationsMask = SlotsCount - 1;
+
+	for(int Slot = 0; Slot < SlotsCount; Slot++)
+	{
+		UniformLocations[Slot].Hash = 0;
+		UniformLocations[Slot].Location = -1;
 	}
 
-	return Shader;
+	char *UniformName = new char[MaxLength + 1];
+
+	for(GLint i = 0; i < UniformsCount; i++)
+	{
+		GLsizei Length = 0;
+		GLint Size = 0;
+		GLenum Type = 0;
+
+		glGetActiveUniform(Program, i, MaxLength + 1, &Length, &Size, &Type, UniformName);
+
+		// built-in uniforms and the ones in blocks have no location
+
+		GLint Location = glGetUniformLocation(Program, UniformName);
+
+		if(Location == -1)
+		{
+			continue;
+		}
+
+		if(Length > 3 && strcmp(UniformName + Length - 3, "[0]") == 0)
+		{
+			UniformName[Length - 3] = 0;
+		}
+
+		unsigned int Hash = HashName32(UniformName);
+
+		int Slot = Hash & UniformLocationsMask;
+
+		while(UniformLocations[Slot].Location != -1 && UniformLocations[Slot].Hash != Hash)
+		{
+			Slot = (Slot + 1) & UniformLocationsMask;
+		}
+
+		if(UniformLocations[Slot].Location != -1)
+		{
+			ErrorLog.Append("Error reflecting uniform %s (%s)! -> another uniform has the same name hash\r\n", UniformName, (char*)Name);
+			continue;
+		}
+
+		UniformLocations[Slot].Hash = Hash;
+		UniformLocations[Slot].Location = Location;
+	}
+
+	delete [] UniformName;
 }
 
 void CShaderProgram::SetDefaults()
 {
 	UniformLocations = NULL;
+	UniformLocationsMask = 0;
 	VertexShader = 0;
 	FragmentShader = 0;
 	Program = 0;
+	Key = 0;
+	Cacheable = false;
+	Linked = false;
 }
 
 // ----------------------------------------------------------------------------------------------------------------------------
@@ -472,243 +1114,893 @@ void CCamera::OnMouseWheel(short zDelta)
 
 	if(zDelta < 0 && length(Position) < 500.0f)
 	{
-		Position += Position * 0.1f;
+		Position += Position * 0.1f;
+	}
+
+	if(zDelta > 0 && length(Position) > 0.05f)
+	{
+		Position -= Position * 0.1f;
+	}
+
+	Position += Reference;
+
+	CalculateViewMatrix();
+}
+
+void CCamera::SetViewMatrixPointer(mat4x4 *View)
+{
+	this->View = View;
+
+	CalculateViewMatrix();
+}
+
+CCamera Camera;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+// four vertices per face, the faces in the order +z, -z, +x, -x, +y, -y
+
+static const CVertex CubeVertices[24] =
+{
+	{vec3(-0.5f, -0.5f,  0.5f), vec3( 0.0f, 0.0f, 1.0f), vec2(0.0f, 0.0f)},
+	{vec3( 0.5f, -0.5f,  0.5f), vec3( 0.0f, 0.0f, 1.0f), vec2(1.0f, 0.0f)},
+	{vec3( 0.5f,  0.5f,  0.5f), vec3( 0.0f, 0.0f, 1.0f), vec2(1.0f, 1.0f)},
+	{vec3(-0.5f,  0.5f,  0.5f), vec3( 0.0f, 0.0f, 1.0f), vec2(0.0f, 1.0f)},
+
+	{vec3( 0.5f, -0.5f, -0.5f), vec3( 0.0f, 0.0f, -1.0f), vec2(0.0f, 0.0f)},
+	{vec3(-0.5f, -0.5f, -0.5f), vec3( 0.0f, 0.0f, -1.0f), vec2(1.0f, 0.0f)},
+	{vec3(-0.5f,  0.5f, -0.5f), vec3( 0.0f, 0.0f, -1.0f), vec2(1.0f, 1.0f)},
+	{vec3( 0.5f,  0.5f, -0.5f), vec3( 0.0f, 0.0f, -1.0f), vec2(0.0f, 1.0f)},
+
+	{vec3( 0.5f, -0.5f,  0.5f), vec3(1.0f, 0.0f, 0.0f), vec2(0.0f, 0.0f)},
+	{vec3( 0.5f, -0.5f, -0.5f), vec3(1.0f, 0.0f, 0.0f), vec2(1.0f, 0.0f)},
+	{vec3( 0.5f,  0.5f, -0.5f), vec3(1.0f, 0.0f, 0.0f), vec2(1.0f, 1.0f)},
+	{vec3( 0.5f,  0.5f,  0.5f), vec3(1.0f, 0.0f, 0.0f), vec2(0.0f, 1.0f)},
+
+	{vec3(-0.5f, -0.5f, -0.5f), vec3(-1.0f,  0.0f,  0.0f), vec2(0.0f, 0.0f)},
+	{vec3(-0.5f, -0.5f,  0.5f), vec3(-1.0f,  0.0f,  0.0f), vec2(1.0f, 0.0f)},
+	{vec3(-0.5f,  0.5f,  0.5f), vec3(-1.0f,  0.0f,  0.0f), vec2(1.0f, 1.0f)},
+	{vec3(-0.5f,  0.5f, -0.5f), vec3(-1.0f,  0.0f,  0.0f), vec2(0.0f, 1.0f)},
+
+	{vec3(-0.5f,  0.5f,  0.5f), vec3( 0.0f,  1.0f,  0.0f), vec2(0.0f, 0.0f)},
+	{vec3( 0.5f,  0.5f,  0.5f), vec3( 0.0f,  1.0f,  0.0f), vec2(1.0f, 0.0f)},
+	{vec3( 0.5f,  0.5f, -0.5f), vec3( 0.0f,  1.0f,  0.0f), vec2(1.0f, 1.0f)},
+	{vec3(-0.5f,  0.5f, -0.5f), vec3( 0.0f,  1.0f,  0.0f), vec2(0.0f, 1.0f)},
+
+	{vec3(-0.5f, -0.5f, -0.5f), vec3( 0.0f,  -1.0f,  0.0f), vec2(0.0f, 0.0f)},
+	{vec3( 0.5f, -0.5f, -0.5f), vec3( 0.0f,  -1.0f,  0.0f), vec2(1.0f, 0.0f)},
+	{vec3( 0.5f, -0.5f,  0.5f), vec3( 0.0f,  -1.0f,  0.0f), vec2(1.0f, 1.0f)},
+	{vec3(-0.5f, -0.5f,  0.5f), vec3( 0.0f,  -1.0f,  0.0f), vec2(0.0f, 1.0f)}
+};
+
+static const unsigned int QuadCorners[6] = {0, 1, 2, 0, 2, 3};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+COpenGLRenderer::COpenGLRenderer()
+{
+	ShowAxisGrid = true;
+	Stop = false;
+	Angle = 0.0f;
+	ModelNode = ObjectNode = -1;
+	Shader = NULL;
+	VirtualTexture = NULL;
+	VirtualTextureFileName = NULL;
+	Atlas = NULL;
+	AtlasFileName = NULL;
+	Cube = NULL;
+	Mesh = NULL;
+	MeshFileName = NULL;
+	Instances = NULL;
+	InstancesCount = 0;
+	Scene = NULL;
+	SceneMins = SceneMaxs = NULL;
+	PickedObject = -1;
+	AxisGridBatch = -1;
+	AtlasCubes = NULL;
+	AtlasLayerBuffer = 0;
+	AtlasBatches = NULL;
+	AtlasBatchesCount = 0;
+
+	Camera.SetViewMatrixPointer(&View);
+}
+
+COpenGLRenderer::~COpenGLRenderer()
+{
+}
+
+bool COpenGLRenderer::Init()
+{
+	/*if(gl_version < 21)
+	{
+		ErrorLog.Set("OpenGL 2.1 not supported!");
+		return false;
+	}*/
+
+	bool Error = false;
+
+	Texture = TextureManager.LoadTexture2D("golddiag.jpg");
+
+	Error |= !Texture.IsValid();
+
+	if(VirtualTextureFileName) VirtualTexture = new CVirtualTexture();
+	if(AtlasFileName) Atlas = new CTextureAtlas();
+	if(MeshFileName) Mesh = new CMesh();
+	if(InstancesCount > 0) Instances = new CInstances();
+
+	// every program is added and started before anything loads, so they all compile while the rest loads, each is
+	// waited for where it is first needed
+
+	int ShaderVariant = -1;
+
+	FrameUniforms.Init();
+
+	if(gl_version >= 21)
+	{
+		ShaderLibrary.Init();
+
+		ShaderVariant = ShaderLibrary.Add("glsl120shader.vs", "glsl120shader.fs");
+
+		if(VirtualTexture) VirtualTexture->AddPrograms();
+		if(Atlas) Atlas->AddPrograms();
+		if(Instances) Instances->AddPrograms();
+
+		DebugDraw.AddPrograms();
+
+		Error |= !ShaderLibrary.Compile();
+	}
+
+	if(VirtualTexture)
+	{
+		Error |= !VirtualTexture->Load(VirtualTextureFileName);
+	}
+
+	if(Atlas)
+	{
+		Error |= !Atlas->Load(AtlasFileName);
+	}
+
+	if(Mesh)
+	{
+		Error |= !LoadMesh(MeshFileName);
+	}
+
+	if(Instances)
+	{
+		Error |= !Instances->Init(InstancesCount);
+	}
+
+	if(gl_version >= 21)
+	{
+		Error |= (Shader = ShaderLibrary.Get(ShaderVariant)) == NULL;
+	}
+
+	Error |= !DebugDraw.Init();
+
+	if(Error)
+	{
+		return false;
+	}
+
+	// the quads are split into two triangles each
+
+	unsigned int CubeIndices[36];
+
+	for(int i = 0; i < 36; i++)
+	{
+		CubeIndices[i] = i / 6 * 4 + QuadCorners[i % 6];
+	}
+
+	Cube = new CMesh();
+
+	Cube->Set(CubeVertices, 24, CubeIndices, 36);
+	Cube->Optimize();
+	Cube->Upload();
+
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+
+	// the cube turns with the model node, a loaded mesh is scaled to its size below it, the instances carry their own
+	// transforms
+
+	Angle = 0.0f;
+
+	ModelNode = SceneGraph.Add(-1, mat4x4());
+	ObjectNode = SceneGraph.Add(Instances ? -1 : ModelNode, Mesh != NULL && Atlas == NULL && Instances == NULL ? MeshTransform : mat4x4());
+
+	Camera.LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.75f, 1.75f, 5.0f));
+
+	if(Atlas)
+	{
+		InitAtlasCubes();
+	}
+
+	if(Instances)
+	{
+		InitInstances();
+	}
+
+	InitScene();
+
+	InitAxisGrid();
+
+	// DisplayInfo("Information text ...");
+
+	return true;
+}
+
+void COpenGLRenderer::Render(float FrameTime)
+{
+	PROFILE_GPU_ZONE("COpenGLRenderer::Render");
+
+	TextureManager.Update();
+	TextureStreamer.Update();
+
+	if(gl_version >= 21)
+	{
+		ShaderLibrary.Update();
+	}
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// the fixed-function matrices stay for the shaders without uniform buffers and for the debug lines below OpenGL 2.1
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixf((GLfloat*)&View);
+
+	FrameUniforms.Update(View, Projection, Camera.Position);
+
+	// only the nodes below a changed local transform are recomputed, nothing is while the model is stopped
+
+	bool Moved = SceneGraph.Update() > 0;
+
+	mat4x4 ObjectModel = SceneGraph.GetWorld(ObjectNode);
+
+	if(Moved)
+	{
+		UpdateScene(ObjectModel);
+	}
+
+	DebugDraw.Begin(View, Projection);
+
+	if(ShowAxisGrid)
+	{
+		PROFILE_GPU_ZONE("COpenGLRenderer::Render::Grid");
+
+		DebugDraw.Draw(AxisGridBatch);
+	}
+
+	if(PickedObject >= 0)
+	{
+		vec3 Min, Max;
+
+		Scene->GetBounds(PickedObject, Min, Max);
+
+		DebugDraw.Box(Min, Max, DebugColor(1.0f, 1.0f, 0.0f));
+	}
+
+	DebugDraw.Flush();
+
+	glMultMatrixf((GLfloat*)&ObjectModel);
+
+	FrameUniforms.SetModel(ObjectModel);
+
+	if(!Stop)
+	{
+		SceneGraph.SetLocal(ModelNode, rotate(mat4x4(), Angle, vec3(0.0f, 1.0f, 0.0f)) * rotate(mat4x4(), Angle, vec3(1.0f, 0.0f, 0.0f)));
+
+		Angle += 11.25f * FrameTime;
+	}
+
+	// the tiles the feedback asks for are requested one frame later
+
+	if(VirtualTexture)
+	{
+		PROFILE_GPU_ZONE("COpenGLRenderer::Render::VirtualTextureFeedback");
+
+		if(VirtualTexture->BeginFeedback())
+		{
+			RenderCube();
+
+			VirtualTexture->EndFeedback();
+		}
+
+		VirtualTexture->Update();
+	}
+
+	PROFILE_GPU_ZONE("COpenGLRenderer::Render::Cube");
+
+	if(VirtualTexture)
+	{
+		VirtualTexture->Bind();
+
+		RenderCube();
+
+		VirtualTexture->Unbind();
+
+		return;
+	}
+
+	if(Atlas)
+	{
+		RenderAtlasCubes();
+
+		return;
+	}
+
+	if(Instances)
+	{
+		Instances->Cull(Projection * View);
+		Instances->Update(Stop ? 0.0f : FrameTime);
+
+		glEnable(GL_TEXTURE_2D);
+
+		glBindTexture(GL_TEXTURE_2D, Texture);
+
+		Instances->Draw(*Cube);
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glDisable(GL_TEXTURE_2D);
+
+		return;
+	}
+
+	glEnable(GL_TEXTURE_2D);
+
+	glBindTexture(GL_TEXTURE_2D, Texture);
+
+	if(gl_version >= 21)
+	{
+		glUseProgram(*Shader);
+	}
+
+	RenderCube();
+
+	if(gl_version >= 21)
+	{
+		glUseProgram(0);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glDisable(GL_TEXTURE_2D);
+}
+
+void COpenGLRenderer::Resize(int Width, int Height)
+{
+	this->Width = Width;
+	this->Height = Height;
+
+	glViewport(0, 0, Width, Height);
+
+	Projection = perspective(45.0f, (float)Width / (Height > 0 ? (float)Height : 1.0f), 0.125f, 512.0f);
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf((GLfloat*)&Projection);
+
+	if(VirtualTexture)
+	{
+		VirtualTexture->Resize(Width, Height);
+	}
+}
+
+bool COpenGLRenderer::GetAtlasStats(CTextureAtlasStats &Stats)
+{
+	if(Atlas == NULL)
+	{
+		return false;
+	}
+
+	Atlas->GetStats(Stats);
+
+	return true;
+}
+
+bool COpenGLRenderer::GetInstancesStats(CInstancesStats &Stats)
+{
+	if(Instances == NULL)
+	{
+		return false;
+	}
+
+	Instances->GetStats(Stats);
+
+	return true;
+}
+
+bool COpenGLRenderer::GetSceneGraphStats(CSceneGraphStats &Stats)
+{
+	if(ObjectNode < 0)
+	{
+		return false;
+	}
+
+	SceneGraph.GetStats(Stats);
+
+	return true;
+}
+
+bool COpenGLRenderer::GetSceneStats(CBVHStats &Stats)
+{
+	if(Scene == NULL)
+	{
+		return false;
+	}
+
+	Scene->GetStats(Stats);
+
+	return true;
+}
+
+// the ray runs from the near to the far plane through the pixel, the objects are hit as the boxes of the last frame
+
+int COpenGLRenderer::Pick(int x, int y)
+{
+	PickedObject = -1;
+
+	if(Scene == NULL || Width <= 0 || Height <= 0)
+	{
+		return PickedObject;
+	}
+
+	mat4x4 InverseViewProjection = inverse(Projection * View);
+
+	float NDCX = (x + 0.5f) / Width * 2.0f - 1.0f, NDCY = 1.0f - (y + 0.5f) / Height * 2.0f;
+
+	vec4 Near = InverseViewProjection * vec4(NDCX, NDCY, -1.0f, 1.0f);
+	vec4 Far = InverseViewProjection * vec4(NDCX, NDCY, 1.0f, 1.0f);
+
+	vec3 Origin = vec3(Near.x, Near.y, Near.z) / Near.w;
+	vec3 Direction = vec3(Far.x, Far.y, Far.z) / Far.w - Origin;
+
+	float Distance;
+
+	PickedObject = Scene->RayCast(Origin, normalize(Direction), length(Direction), Distance);
+
+	return PickedObject;
+}
+
+bool COpenGLRenderer::GetVirtualTextureStats(CVirtualTextureStats &Stats)
+{
+	if(VirtualTexture == NULL)
+	{
+		return false;
+	}
+
+	VirtualTexture->GetStats(Stats);
+
+	return true;
+}
+
+void COpenGLRenderer::Destroy()
+{
+	Texture.Release();
+	
+	if(gl_version >= 21)
+	{
+		ShaderLibrary.Destroy();
+		Shader = NULL;
+	}
+
+	FrameUniforms.Destroy();
+
+	if(VirtualTexture)
+	{
+		VirtualTexture->Destroy();
+		delete VirtualTexture;
+		VirtualTexture = NULL;
+	}
+
+	if(Atlas)
+	{
+		Atlas->Destroy();
+		delete Atlas;
+		Atlas = NULL;
+	}
+
+	if(AtlasCubes)
+	{
+		AtlasCubes->Destroy();
+		delete AtlasCubes;
+		AtlasCubes = NULL;
+	}
+
+	if(AtlasLayerBuffer)
+	{
+		glDeleteBuffers(1, &AtlasLayerBuffer);
+		AtlasLayerBuffer = 0;
+	}
+
+	delete [] AtlasBatches;
+
+	AtlasBatches = NULL;
+	AtlasBatchesCount = 0;
+
+	if(Cube)
+	{
+		Cube->Destroy();
+		delete Cube;
+		Cube = NULL;
 	}
 
-	if(zDelta > 0 && length(Position) > 0.05f)
+	if(Mesh)
 	{
-		Position -= Position * 0.1f;
+		Mesh->Destroy();
+		delete Mesh;
+		Mesh = NULL;
 	}
 
-	Position += Reference;
+	if(Instances)
+	{
+		Instances->Destroy();
+		delete Instances;
+		Instances = NULL;
+	}
 
-	CalculateViewMatrix();
-}
+	if(Scene)
+	{
+		Scene->Destroy();
+		delete Scene;
+		Scene = NULL;
+	}
 
-void CCamera::SetViewMatrixPointer(mat4x4 *View)
-{
-	this->View = View;
+	delete [] SceneMins;
+	delete [] SceneMaxs;
 
-	CalculateViewMatrix();
-}
+	SceneMins = SceneMaxs = NULL;
+	PickedObject = -1;
 
-CCamera Camera;
+	SceneGraph.Destroy();
 
-// ----------------------------------------------------------------------------------------------------------------------------
+	ModelNode = ObjectNode = -1;
 
-COpenGLRenderer::COpenGLRenderer()
-{
-	ShowAxisGrid = true;
-	Stop = false;
+	DebugDraw.Destroy();
 
-	Camera.SetViewMatrixPointer(&View);
+	AxisGridBatch = -1;
 }
 
-COpenGLRenderer::~COpenGLRenderer()
+void COpenGLRenderer::RenderCube()
 {
+	if(Mesh)
+	{
+		Mesh->Draw();
+		return;
+	}
+
+	Cube->Draw();
 }
 
-bool COpenGLRenderer::Init()
+// OBJ and PLY files are parsed, optimized and saved to the texture cache directory once, .mesh files are mapped as they
+// are
+
+bool COpenGLRenderer::LoadMesh(const char *FileName)
 {
-	/*if(gl_version < 21)
-	{
-		ErrorLog.Set("OpenGL 2.1 not supported!");
-		return false;
-	}*/
+	PROFILE_ZONE("COpenGLRenderer::LoadMesh");
 
-	bool Error = false;
+	CString SourceFileName = CString::Concat({ModuleDirectory, FileName});
 
-	Error |= !Texture.LoadTexture2D("golddiag.jpg");
+	const char *Extension = strrchr(FileName, '.');
 
-	if(gl_version >= 21)
+	if(Extension != NULL && (strcmp(Extension, ".mesh") == 0 || strcmp(Extension, ".MESH") == 0))
 	{
-		Error |= !Shader.Load("glsl120shader.vs", "glsl120shader.fs");
+		if(!Mesh->Load(SourceFileName))
+		{
+			ErrorLog.AppendStrings({"Error loading file ", SourceFileName, "! -> invalid mesh", "\r\n"});
+			return false;
+		}
 	}
-
-	if(Error)
+	else
 	{
-		return false;
-	}
+		HASH64 Key;
+
+		if(!CMeshLoader::IsSupported(FileName) || !HashFile64(SourceFileName, &Key))
+		{
+			ErrorLog.AppendStrings({"Error loading file ", SourceFileName, "!\r\n"});
+			return false;
+		}
 
-	TexCoords = new vec2[24];
-	Normals = new vec3[24];
-	Vertices = new vec3[24];
+		int Settings[] = {MESH_FILE_VERSION, MESH_SCORE_CACHE_SIZE, MESH_FIFO_CACHE_SIZE};
 
-	TexCoords[0] = vec2(0.0f, 0.0f); Normals[0] = vec3( 0.0f, 0.0f, 1.0f); Vertices[0] = vec3(-0.5f, -0.5f,  0.5f);
-	TexCoords[1] = vec2(1.0f, 0.0f); Normals[1] = vec3( 0.0f, 0.0f, 1.0f); Vertices[1] = vec3( 0.5f, -0.5f,  0.5f);
-	TexCoords[2] = vec2(1.0f, 1.0f); Normals[2] = vec3( 0.0f, 0.0f, 1.0f); Vertices[2] = vec3( 0.5f,  0.5f,  0.5f);
-	TexCoords[3] = vec2(0.0f, 1.0f); Normals[3] = vec3( 0.0f, 0.0f, 1.0f); Vertices[3] = vec3(-0.5f,  0.5f,  0.5f);
+		CString CachedFileName = TextureCache.GetFileName(Hash64(Settings, sizeof(Settings), Key), "mesh");
 
-	TexCoords[4] = vec2(0.0f, 0.0f); Normals[4] = vec3( 0.0f, 0.0f, -1.0f); Vertices[4] = vec3( 0.5f, -0.5f, -0.5f);
-	TexCoords[5] = vec2(1.0f, 0.0f); Normals[5] = vec3( 0.0f, 0.0f, -1.0f); Vertices[5] = vec3(-0.5f, -0.5f, -0.5f);
-	TexCoords[6] = vec2(1.0f, 1.0f); Normals[6] = vec3( 0.0f, 0.0f, -1.0f); Vertices[6] = vec3(-0.5f,  0.5f, -0.5f);
-	TexCoords[7] = vec2(0.0f, 1.0f); Normals[7] = vec3( 0.0f, 0.0f, -1.0f); Vertices[7] = vec3( 0.5f,  0.5f, -0.5f);
+		if(!Mesh->Load(CachedFileName))
+		{
+			CMeshLoader MeshLoader;
 
-	TexCoords[8] = vec2(0.0f, 0.0f); Normals[8] = vec3(1.0f, 0.0f, 0.0f); Vertices[8] = vec3( 0.5f, -0.5f,  0.5f);
-	TexCoords[9] = vec2(1.0f, 0.0f); Normals[9] = vec3(1.0f, 0.0f, 0.0f); Vertices[9] = vec3( 0.5f, -0.5f, -0.5f);
-	TexCoords[10] = vec2(1.0f, 1.0f); Normals[10] = vec3(1.0f, 0.0f, 0.0f); Vertices[10] = vec3( 0.5f,  0.5f, -0.5f);
-	TexCoords[11] = vec2(0.0f, 1.0f); Normals[11] = vec3(1.0f, 0.0f, 0.0f); Vertices[11] = vec3( 0.5f,  0.5f,  0.5f);
+			if(!MeshLoader.Load(SourceFileName, *Mesh))
+			{
+				return false;
+			}
 
-	TexCoords[12] = vec2(0.0f, 0.0f); Normals[12] = vec3(-1.0f,  0.0f,  0.0f); Vertices[12] = vec3(-0.5f, -0.5f, -0.5f);
-	TexCoords[13] = vec2(1.0f, 0.0f); Normals[13] = vec3(-1.0f,  0.0f,  0.0f); Vertices[13] = vec3(-0.5f, -0.5f,  0.5f);
-	TexCoords[14] = vec2(1.0f, 1.0f); Normals[14] = vec3(-1.0f,  0.0f,  0.0f); Vertices[14] = vec3(-0.5f,  0.5f,  0.5f);
-	TexCoords[15] = vec2(0.0f, 1.0f); Normals[15] = vec3(-1.0f,  0.0f,  0.0f); Vertices[15] = vec3(-0.5f,  0.5f, -0.5f);
+			Mesh->Optimize();
+			Mesh->Save(CachedFileName);
+			Mesh->Upload();
+		}
+	}
 
-	TexCoords[16] = vec2(0.0f, 0.0f); Normals[16] = vec3( 0.0f,  1.0f,  0.0f); Vertices[16] = vec3(-0.5f,  0.5f,  0.5f);
-	TexCoords[17] = vec2(1.0f, 0.0f); Normals[17] = vec3( 0.0f,  1.0f,  0.0f); Vertices[17] = vec3( 0.5f,  0.5f,  0.5f);
-	TexCoords[18] = vec2(1.0f, 1.0f); Normals[18] = vec3( 0.0f,  1.0f,  0.0f); Vertices[18] = vec3( 0.5f,  0.5f, -0.5f);
-	TexCoords[19] = vec2(0.0f, 1.0f); Normals[19] = vec3( 0.0f,  1.0f,  0.0f); Vertices[19] = vec3(-0.5f,  0.5f, -0.5f);
+	vec3 Min, Max;
 
-	TexCoords[20] = vec2(0.0f, 0.0f); Normals[20] = vec3( 0.0f,  -1.0f,  0.0f); Vertices[20] = vec3(-0.5f, -0.5f, -0.5f);
-	TexCoords[21] = vec2(1.0f, 0.0f); Normals[21] = vec3( 0.0f,  -1.0f,  0.0f); Vertices[21] = vec3( 0.5f, -0.5f, -0.5f);
-	TexCoords[22] = vec2(1.0f, 1.0f); Normals[22] = vec3( 0.0f,  -1.0f,  0.0f); Vertices[22] = vec3( 0.5f, -0.5f,  0.5f);
-	TexCoords[23] = vec2(0.0f, 1.0f); Normals[23] = vec3( 0.0f,  -1.0f,  0.0f); Vertices[23] = vec3(-0.5f, -0.5f,  0.5f);
+	Mesh->GetBounds(Min, Max);
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	vec3 Size = Max - Min;
 
-	Camera.LookAt(vec3(0.0f, 0.0f, 0.0f), vec3(1.75f, 1.75f, 5.0f));
+	float Extent = std::max(std::max(Size.x, Size.y), Size.z);
 
-	// DisplayInfo("Information text ...");
+	MeshTransform = scale(mat4x4(), vec3(Extent > 0.0f ? 1.0f / Extent : 1.0f)) * translate(mat4x4(), (Min + Max) * -0.5f);
 
 	return true;
 }
 
-void COpenGLRenderer::Render(float FrameTime)
+// the cubes stand in a square grid, sorted by page into one mesh; a batch is the range of indices of a page, with an
+// array texture there is one batch for all and the layers are in a buffer of their own, read as the second texture
+// coordinate; the boxes of the cubes are kept for the scene
+
+void COpenGLRenderer::InitAtlasCubes()
 {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	int CubesCount = Atlas->GetRegionsCount(), PagesCount = Atlas->GetPagesCount();
+	int Side = (int)ceil(sqrt((float)CubesCount));
 
-	glMatrixMode(GL_MODELVIEW);
-	glLoadMatrixf((GLfloat*)&View);
+	float Spacing = 3.0f / Side;
 
-	if(ShowAxisGrid)
+	CVertex *Vertices = new CVertex[CubesCount * 24];
+	unsigned int *Indices = new unsigned int[CubesCount * 36];
+	float *Layers = new float[CubesCount * 24];
+
+	SceneMins = new vec3[CubesCount];
+	SceneMaxs = new vec3[CubesCount];
+
+	AtlasBatchesCount = Atlas->IsArray() ? 1 : PagesCount;
+	AtlasBatches = new int[AtlasBatchesCount + 1];
+
+	int Cube = 0;
+
+	for(int Batch = 0; Batch < AtlasBatchesCount; Batch++)
 	{
-		glLineWidth(2.0f);
+		AtlasBatches[Batch] = Cube * 36;
+
+		for(int i = 0; i < CubesCount; i++)
+		{
+			if(!Atlas->IsArray() && Atlas->GetRegion(i).Page != Batch)
+			{
+				continue;
+			}
+
+			vec3 Position = vec3((i % Side + 0.5f) * Spacing - 1.5f, (i / Side + 0.5f) * Spacing - 1.5f, 0.0f);
+
+			for(int Vertex = 0; Vertex < 24; Vertex++)
+			{
+				CVertex &AtlasVertex = Vertices[Cube * 24 + Vertex];
+
+				vec3 TexCoord;
 
-		glBegin(GL_LINES);
+				Atlas->RemapTexCoords(i, &CubeVertices[Vertex].TexCoord, 1, &TexCoord);
 
-		glColor4f(1.0f, 0.0f, 0.0f, 1.0f);
+				AtlasVertex.Position = Position + CubeVertices[Vertex].Position * Spacing * 0.75f;
+				AtlasVertex.Normal = CubeVertices[Vertex].Normal;
+				AtlasVertex.TexCoord = vec2(TexCoord.x, TexCoord.y);
 
-		glVertex3f(0.0f, 0.0f, 0.0f); glVertex3f(1.0f, 0.0f, 0.0f);
-		glVertex3f(1.0f, 0.1f, 0.0f); glVertex3f(1.1f, -0.1f, 0.0f);
-		glVertex3f(1.1f, 0.1f, 0.0f); glVertex3f(1.0f, -0.1f, 0.0f);
+				Layers[Cube * 24 + Vertex] = TexCoord.z;
+			}
 
-		glColor4f(0.0f, 1.0f, 0.0f, 1.0f);
+			for(int Index = 0; Index < 36; Index++)
+			{
+				Indices[Cube * 36 + Index] = Cube * 24 + Index / 6 * 4 + QuadCorners[Index % 6];
+			}
 
-		glVertex3f(0.0f, 0.0f, 0.0f); glVertex3f(0.0f, 1.0f, 0.0f);
-		glVertex3f(-0.05f, 1.25f, 0.0f); glVertex3f(0.0f, 1.15f, 0.0f);
-		glVertex3f(0.05f,1.25f, 0.0f); glVertex3f(0.0f, 1.15f, 0.0f);
-		glVertex3f(0.0f,1.15f, 0.0f); glVertex3f(0.0f, 1.05f, 0.0f);
+			SceneMins[Cube] = Position - vec3(Spacing * 0.375f);
+			SceneMaxs[Cube] = Position + vec3(Spacing * 0.375f);
 
-		glColor4f(0.0f, 0.0f, 1.0f, 1.0f);
+			Cube++;
+		}
+	}
 
-		glVertex3f(0.0f,0.0f,0.0f); glVertex3f(0.0f, 0.0f, 1.0f);
-		glVertex3f(-0.05f,0.1f,1.05f); glVertex3f(0.05f, 0.1f, 1.05f);
-		glVertex3f(0.05f,0.1f,1.05f); glVertex3f(-0.05f, -0.1f, 1.05f);
-		glVertex3f(-0.05f,-0.1f,1.05f); glVertex3f(0.05f, -0.1f, 1.05f);
+	AtlasBatches[AtlasBatchesCount] = Cube * 36;
 
-		glEnd();
+	AtlasCubes = new CMesh();
 
-		glLineWidth(1.0f);
+	AtlasCubes->Attach(Vertices, Cube * 24, Indices, Cube * 36);
+	AtlasCubes->Upload();
 
-		glColor3f(1.0f, 1.0f, 1.0f);
+	if(Atlas->IsArray())
+	{
+		glGenBuffers(1, &AtlasLayerBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, AtlasLayerBuffer);
+		glBufferData(GL_ARRAY_BUFFER, Cube * 24 * sizeof(float), Layers, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
 
-		glBegin(GL_LINES);
+	delete [] Layers;
+}
 
-		float d = 50.0f;
+void COpenGLRenderer::RenderAtlasCubes()
+{
+	if(!Atlas->IsArray())
+	{
+		glEnable(GL_TEXTURE_2D);
 
-		for(float i = -d; i <= d; i += 1.0f)
+		if(gl_version >= 21)
 		{
-			glVertex3f(i, 0.0f, -d);
-			glVertex3f(i, 0.0f, d);
-			glVertex3f(-d, 0.0f, i);
-			glVertex3f(d, 0.0f, i);
+			glUseProgram(*Shader);
 		}
-
-		glEnd();
 	}
 
-	glMultMatrixf((GLfloat*)&Model);
+	AtlasCubes->Bind();
 
-	if(!Stop)
+	if(AtlasLayerBuffer)
 	{
-		static float a = 0.0f;
+		glClientActiveTexture(GL_TEXTURE1);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+		glBindBuffer(GL_ARRAY_BUFFER, AtlasLayerBuffer);
+		glTexCoordPointer(1, GL_FLOAT, 0, NULL);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
 
-		Model = rotate(mat4x4(), a, vec3(0.0f, 1.0f, 0.0f)) * rotate(mat4x4(), a, vec3(1.0f, 0.0f, 0.0f));
+	for(int Batch = 0; Batch < AtlasBatchesCount; Batch++)
+	{
+		Atlas->Bind(Batch);
 
-		a += 11.25f * FrameTime;
+		AtlasCubes->DrawRange(AtlasBatches[Batch], AtlasBatches[Batch + 1] - AtlasBatches[Batch]);
 	}
 
-	glEnable(GL_TEXTURE_2D);
+	Atlas->Unbind();
 
-	glBindTexture(GL_TEXTURE_2D, Texture);
+	if(AtlasLayerBuffer)
+	{
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glClientActiveTexture(GL_TEXTURE0);
+	}
 
-	if(gl_version >= 21)
+	AtlasCubes->Unbind();
+
+	if(!Atlas->IsArray())
 	{
-		glUseProgram(Shader);
+		if(gl_version >= 21)
+		{
+			glUseProgram(0);
+		}
+
+		glDisable(GL_TEXTURE_2D);
 	}
+}
+
+// the axes with their letters and the grid never change, they are drawn from one static buffer
 
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glTexCoordPointer(2, GL_FLOAT, 0, TexCoords);
+void COpenGLRenderer::InitAxisGrid()
+{
+	DWORD Red = DebugColor(1.0f, 0.0f, 0.0f), Green = DebugColor(0.0f, 1.0f, 0.0f), Blue = DebugColor(0.0f, 0.0f, 1.0f), White = DebugColor(1.0f, 1.0f, 1.0f);
 
-	glEnableClientState(GL_NORMAL_ARRAY);
-	glNormalPointer(GL_FLOAT, 0, Normals);
+	DebugDraw.Line(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), Red);
+	DebugDraw.Line(vec3(1.0f, 0.1f, 0.0f), vec3(1.1f, -0.1f, 0.0f), Red);
+	DebugDraw.Line(vec3(1.1f, 0.1f, 0.0f), vec3(1.0f, -0.1f, 0.0f), Red);
 
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glVertexPointer(3, GL_FLOAT, 0, Vertices);
+	DebugDraw.Line(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f), Green);
+	DebugDraw.Line(vec3(-0.05f, 1.25f, 0.0f), vec3(0.0f, 1.15f, 0.0f), Green);
+	DebugDraw.Line(vec3(0.05f, 1.25f, 0.0f), vec3(0.0f, 1.15f, 0.0f), Green);
+	DebugDraw.Line(vec3(0.0f, 1.15f, 0.0f), vec3(0.0f, 1.05f, 0.0f), Green);
 
-	glDrawArrays(GL_QUADS, 0, 24);
+	DebugDraw.Line(vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f), Blue);
+	DebugDraw.Line(vec3(-0.05f, 0.1f, 1.05f), vec3(0.05f, 0.1f, 1.05f), Blue);
+	DebugDraw.Line(vec3(0.05f, 0.1f, 1.05f), vec3(-0.05f, -0.1f, 1.05f), Blue);
+	DebugDraw.Line(vec3(-0.05f, -0.1f, 1.05f), vec3(0.05f, -0.1f, 1.05f), Blue);
 
-	glDisableClientState(GL_VERTEX_ARRAY);
-	glDisableClientState(GL_NORMAL_ARRAY);
-	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	float d = 50.0f;
 
-	if(gl_version >= 21)
+	for(float i = -d; i <= d; i += 1.0f)
 	{
-		glUseProgram(0);
+		DebugDraw.Line(vec3(i, 0.0f, -d), vec3(i, 0.0f, d), White);
+		DebugDraw.Line(vec3(-d, 0.0f, i), vec3(d, 0.0f, i), White);
 	}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	AxisGridBatch = DebugDraw.Bake();
+}
 
-	glDisable(GL_TEXTURE_2D);
+// a block of cubes around the origin, each turning at its own speed from its own angle
+
+void COpenGLRenderer::InitInstances()
+{
+	int Count = Instances->GetCount();
+
+	int Side = 1;
+
+	while(Side * Side * Side < Count) Side++;
+
+	float Spacing = 2.0f, Offset = (Side - 1) * Spacing * 0.5f;
+
+	unsigned int Random = 12345;
+
+	for(int i = 0; i < Count; i++)
+	{
+		vec3 Position = vec3(i % Side * Spacing - Offset, i / Side % Side * Spacing - Offset, i / (Side * Side) * Spacing - Offset);
+
+		Random = Random * 1664525 + 1013904223;
+
+		float Angle = (Random >> 8) / 16777216.0f * 6.28318531f;
+
+		Random = Random * 1664525 + 1013904223;
+
+		float Speed = (0.5f + (Random >> 8) / 16777216.0f) * 0.19634954f;
+
+		Instances->Set(i, Position, 1.0f, Count > 1 ? Angle : 0.0f, Speed);
+	}
 }
 
-void COpenGLRenderer::Resize(int Width, int Height)
+// the instances never move, so their tree is built once; the atlas cubes and the cube turn with the model, their boxes
+// in model space are kept and the tree is refit to the boxes of the transformed ones every frame; the boxes of the atlas
+// cubes are there from InitAtlasCubes
+
+void COpenGLRenderer::InitScene()
 {
-	this->Width = Width;
-	this->Height = Height;
+	int Count = Instances ? Instances->GetCount() : Atlas ? AtlasBatches[AtlasBatchesCount] / 36 : 1;
 
-	glViewport(0, 0, Width, Height);
+	if(Atlas == NULL)
+	{
+		SceneMins = new vec3[Count];
+		SceneMaxs = new vec3[Count];
 
-	Projection = perspective(45.0f, (float)Width / (Height > 0 ? (float)Height : 1.0f), 0.125f, 512.0f);
+		for(int i = 0; i < Count; i++)
+		{
+			if(Instances)
+			{
+				Instances->GetBounds(i, SceneMins[i], SceneMaxs[i]);
+			}
+			else
+			{
+				SceneMins[i] = vec3(-0.5f);
+				SceneMaxs[i] = vec3(0.5f);
+			}
+		}
+	}
 
-	glMatrixMode(GL_PROJECTION);
-	glLoadMatrixf((GLfloat*)&Projection);
+	Scene = new CBVH();
+
+	Scene->Build(SceneMins, SceneMaxs, Count);
+
+	PickedObject = -1;
 }
 
-void COpenGLRenderer::Destroy()
+// the box of a transformed box has the transformed center and the extents summed over the absolute rotation and scale
+
+void COpenGLRenderer::UpdateScene(const mat4x4 &ObjectModel)
 {
-	Texture.Delete();
-	
-	if(gl_version >= 21)
+	if(Instances)
+	{
+		return;
+	}
+
+	int Count = Scene->GetCount();
+
+	for(int i = 0; i < Count; i++)
 	{
-		Shader.Delete();
+		vec3 Center = (SceneMins[i] + SceneMaxs[i]) * 0.5f, Extents = (SceneMaxs[i] - SceneMins[i]) * 0.5f;
+
+		vec4 TransformedCenter = ObjectModel * vec4(Center, 1.0f);
+		vec3 TransformedExtents;
+
+		for(int Axis = 0; Axis < 3; Axis++)
+		{
+			TransformedExtents[Axis] = fabs(ObjectModel[0][Axis]) * Extents.x + fabs(ObjectModel[1][Axis]) * Extents.y + fabs(ObjectModel[2][Axis]) * Extents.z;
+		}
+
+		Center = vec3(TransformedCenter.x, TransformedCenter.y, TransformedCenter.z);
+
+		Scene->SetBounds(i, Center - TransformedExtents, Center + TransformedExtents);
 	}
 
-	delete [] TexCoords;
-	delete [] Normals;
-	delete [] Vertices;
+	Scene->Refit();
 }
 
 COpenGLRenderer OpenGLRenderer;
 
 // ----------------------------------------------------------------------------------------------------------------------------
 
+#ifdef _WIN32
+
 CWnd::CWnd()
 {
 	char *moduledirectory = new char[256];
-	GetModuleFileName(GetModuleHandle(NULL), moduledirectory, 256);
-	*(strrchr(moduledirectory, '//') + 1) = 0;
+	GetModuleDirectory(moduledirectory, 256);
 	ModuleDirectory = moduledirectory;
 	delete [] moduledirectory;
 
@@ -719,7 +2011,7 @@ CWnd::~CWnd()
 {
 }
 
-bool CWnd::Create(HINSTANCE hInstance, char *WindowName, int Width, int Height, bool FullScreen, int Samples, bool CreateForwardCompatibleContext, bool DisableVerticalSynchronization)
+bool CWnd::Create(HINSTANCE hInstance, const char *WindowName, int Width, int Height, bool FullScreen, int Samples, bool CreateForwardCompatibleContext, bool DisableVerticalSynchronization)
 {
 	WNDCLASSEX WndClassEx;
 
@@ -907,11 +2199,17 @@ bool CWnd::Create(HINSTANCE hInstance, char *WindowName, int Width, int Height,
 		glGetIntegerv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &gl_max_texture_max_anisotropy_ext);
 	}
 
+	PixelFormatCaps.Init();
+
 	if(DisableVerticalSynchronization  && WGLEW_EXT_swap_control)
 	{
 		wglSwapIntervalEXT(0);
 	}
 
+	Profiler.Init();
+
+	TextureStreamer.Init();
+
 	return OpenGLRenderer.Init();
 }
 
@@ -960,8 +2258,16 @@ void CWnd::MsgLoop()
 {
 	MSG Msg;
 
-	while(GetMessage(&Msg, NULL, 0, 0) > 0)
+	while(true)
 	{
+		{
+			PROFILE_ZONE("CWnd::MsgLoop::GetMessage");
+
+			if(GetMessage(&Msg, NULL, 0, 0) <= 0) break;
+		}
+
+		PROFILE_ZONE("CWnd::MsgLoop::DispatchMessage");
+
 		TranslateMessage(&Msg);
 		DispatchMessage(&Msg);
 	}
@@ -971,6 +2277,11 @@ void CWnd::Destroy()
 {
 	OpenGLRenderer.Destroy();
 
+	TextureManager.Destroy();
+	TextureStreamer.Destroy();
+
+	Profiler.Destroy();
+
 	wglDeleteContext(hGLRC);
 
 	DestroyWindow(hWnd);
@@ -1021,7 +2332,7 @@ void CWnd::SetMouseFocus()
 
 void CWnd::StartFPSCounter()
 {
-	Start = Begin = GetTickCount();
+	Start = Begin = GetTime();
 }
 
 void CWnd::OnKeyDown(UINT nChar)
@@ -1055,6 +2366,18 @@ void CWnd::OnKeyDown(UINT nChar)
 			}
 			break;
 
+		case VK_F4:
+			if(Profiler.Enabled)
+			{
+				if(!Profiler.Save(Profiler.TraceFileName)) DisplayError(ErrorLog);
+				Profiler.Stop();
+			}
+			else
+			{
+				Profiler.Start();
+			}
+			break;
+
 		case VK_SPACE:
 			OpenGLRenderer.Stop = !OpenGLRenderer.Stop;
 			break;
@@ -1081,21 +2404,35 @@ void CWnd::OnKillFocus()
 void CWnd::OnLButtonDown(int cx, int cy)
 {
 	SetMouseFocus();
+
+	// in game mode the cursor is kept at the center of the window
+
+	if(!Benchmark.Running)
+	{
+		OpenGLRenderer.Pick(MouseGameMode ? WidthD2 : cx, MouseGameMode ? HeightD2 : cy);
+	}
 }
 
 void CWnd::OnMouseMove(int cx, int cy)
 {
+	if(Benchmark.Running)
+	{
+		return;
+	}
+
 	if(MouseGameMode && MouseFocus)
 	{
 		if(cx != WidthD2 || cy != HeightD2)
 		{
 			Camera.OnMouseMove(WidthD2 - cx, HeightD2 - cy);
+			CameraPath.RecordMouseMove(WidthD2 - cx, HeightD2 - cy);
 			SetCurPos(WidthD2, HeightD2);
 		}
 	}
 	else if(GetKeyState(VK_RBUTTON) & 0x80)
 	{
 		Camera.OnMouseMove(LastCurPos.x - cx, LastCurPos.y - cy);
+		CameraPath.RecordMouseMove(LastCurPos.x - cx, LastCurPos.y - cy);
 
 		LastCurPos.x = cx;
 		LastCurPos.y = cy;
@@ -1104,7 +2441,13 @@ void CWnd::OnMouseMove(int cx, int cy)
 
 void CWnd::OnMouseWheel(short zDelta)
 {
+	if(Benchmark.Running)
+	{
+		return;
+	}
+
 	Camera.OnMouseWheel(zDelta);
+	CameraPath.RecordMouseWheel(zDelta);
 }
 
 void CWnd::OnPaint()
@@ -1115,12 +2458,20 @@ void CWnd::OnPaint()
 
 	static int FPS = 0;
 
-	DWORD End = GetTickCount();
+	double End = GetTime();
 
-	float FrameTime = (End - Begin) * 0.001f;
+	float FrameTime = (float)(End - Begin);
 	Begin = End;
 
-	if(End - Start > 1000)
+	bool Benchmarking = Benchmark.Running;
+
+	if(Benchmarking)
+	{
+		CameraPath.Apply(Benchmark.BeginFrame());
+		FrameTime = Benchmark.FrameTime;
+	}
+
+	if(End - Start > 1.0)
 	{
 		CString Text = WindowName;
 
@@ -1128,6 +2479,11 @@ void CWnd::OnPaint()
 		Text.Append(", ATF %dx", gl_max_texture_max_anisotropy_ext);
 		Text.Append(", MSAA %dx", Samples);
 		Text.Append(", FPS: %d", FPS);
+
+		CTextureStreamerStats Stats;
+		TextureStreamer.GetStats(Stats);
+		if(Stats.DecodeQueueDepth + Stats.UploadQueueDepth > 0) Text.Append(", Streaming %d/%d", Stats.DecodeQueueDepth, Stats.UploadQueueDepth);
+
 		/*Text.Append(" - OpenGL %d.%d", gl_version / 10, gl_version % 10);
 		if(gl_version >= 30) if(wgl_context_forward_compatible) Text.Append(" Forward compatible"); else Text.Append(" Compatibility profile");*/
 		Text.Append(" - %s", (char*)glGetString(GL_RENDERER));
@@ -1142,7 +2498,7 @@ void CWnd::OnPaint()
 		FPS++;
 	}
 
-	if(KeyBoardFocus)
+	if(KeyBoardFocus && !Benchmarking)
 	{
 		BYTE Keys = 0x00;
 
@@ -1159,12 +2515,26 @@ void CWnd::OnPaint()
 		{
 			vec3 Movement = Camera.OnKeys(Keys, FrameTime);
 			Camera.Move(Movement);
+			CameraPath.RecordMove(Movement);
 		}
 	}
 
 	OpenGLRenderer.Render(FrameTime);
 
-	SwapBuffers(hDC);
+	{
+		PROFILE_ZONE("SwapBuffers");
+
+		SwapBuffers(hDC);
+	}
+
+	Profiler.EndFrame();
+
+	if(Benchmarking && !Benchmark.EndFrame())
+	{
+		PostQuitMessage(0);
+	}
+
+	CameraPath.RecordFrame++;
 
 	EndPaint(hWnd, &ps);
 
@@ -1276,10 +2646,119 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uiMsg, WPARAM wParam, LPARAM lParam)
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR sCmdLine, int iShow)
 {
-	if(Wnd.Create(hInstance, "Win32, OpenGL, GLEW, FreeImage, GLM", 800, 600, DisplayQuestion("Would you like to run in fullscreen mode?")))
+	Benchmark.MarkProcessStart();
+
+	CCommandLine CommandLine;
+
+	if(!CommandLine.Parse(__argc, __argv))
+	{
+		DisplayError(ErrorLog);
+		return 1;
+	}
+
+	if(CommandLine.MicroBenchmarkName)
+	{
+		CString Report;
+
+		bool Error = !RunMicroBenchmarks(CommandLine.MicroBenchmarkName, Report);
+
+		if(!Error)
+		{
+			if(CommandLine.BenchmarkFileName)
+			{
+				Error = !SaveMicroBenchmarkReport(CommandLine.BenchmarkFileName, Report);
+			}
+			else
+			{
+				DisplayInfo(Report);
+			}
+		}
+
+		if(Error)
+		{
+			DisplayError(ErrorLog);
+		}
+
+		return Error ? 1 : 0;
+	}
+
+	Profiler.TraceFileName = CommandLine.TraceFileName ? CString(CommandLine.TraceFileName) : ModuleDirectory + "trace.json";
+
+	if(CommandLine.TraceFileName)
+	{
+		Profiler.Start();
+	}
+
+	TextureStreamer.UploadBudget = CommandLine.UploadBudget * 1024;
+	TextureManager.Budget = (long long)CommandLine.TextureBudget * 1024 * 1024;
+
+	TextureCache.Init(CString::Concat({ModuleDirectory, "cache/"}), CommandLine.TextureCompression, CommandLine.TextureCompressionQuality);
+	ShaderCache.Init(CString::Concat({ModuleDirectory, "cache/"}), CommandLine.ShaderCache);
+
+	OpenGLRenderer.VirtualTextureFileName = CommandLine.VirtualTextureFileName;
+	OpenGLRenderer.AtlasFileName = CommandLine.AtlasFileName;
+	OpenGLRenderer.MeshFileName = CommandLine.MeshFileName;
+	OpenGLRenderer.InstancesCount = CommandLine.InstancesCount;
+
+	if(CommandLine.AskFullScreen && CommandLine.BenchmarkFileName == NULL)
+	{
+		CommandLine.FullScreen = DisplayQuestion("Would you like to run in fullscreen mode?");
+	}
+
+	if(Wnd.Create(hInstance, "Win32, OpenGL, GLEW, FreeImage, GLM", CommandLine.Width, CommandLine.Height, CommandLine.FullScreen, CommandLine.Samples))
 	{
-		Wnd.Show();
-		Wnd.MsgLoop();
+		bool Error = false;
+
+		if(CommandLine.BenchmarkFileName)
+		{
+			if(CommandLine.CameraPathFileName)
+			{
+				Error |= !CameraPath.Load(CommandLine.CameraPathFileName);
+			}
+			else
+			{
+				CameraPath.CreateOrbit(CommandLine.Frames);
+			}
+		}
+
+		if(CommandLine.BenchmarkFileName)
+		{
+			Error |= !TextureManager.Finish();
+		}
+
+		if(!Error)
+		{
+			Wnd.Show();
+
+			if(CommandLine.BenchmarkFileName)
+			{
+				Benchmark.Start(CommandLine.Frames, CommandLine.FrameTime);
+			}
+
+			CameraPath.Recording = CommandLine.RecordFileName != NULL;
+
+			Wnd.MsgLoop();
+
+			if(CommandLine.BenchmarkFileName)
+			{
+				Error |= !Benchmark.Save(CommandLine.BenchmarkFileName);
+			}
+
+			if(CommandLine.RecordFileName)
+			{
+				Error |= !CameraPath.Save(CommandLine.RecordFileName);
+			}
+
+			if(CommandLine.TraceFileName)
+			{
+				Error |= !Profiler.Save(Profiler.TraceFileName);
+			}
+		}
+
+		if(Error)
+		{
+			DisplayError(ErrorLog);
+		}
 	}
 	else
 	{
@@ -1288,5 +2767,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR sCmdLine,
 
 	Wnd.Destroy();
 
+	ThreadPool.Destroy();
+
 	return 0;
 }
+
+#endif
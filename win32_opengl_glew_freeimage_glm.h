@@ -1,9 +1,19 @@
-#include <windows.h>
+#pragma once
 
+#include "platform.h"
 #include "string.h"
+#include "mipmap.h"
+#include "blockcompress.h"
+#include "pixelformat.h"
+#include "texturemanager.h"
 
-#include <gl/glew.h> // http://glew.sourceforge.net/
-#include <gl/wglew.h>
+#include <GL/glew.h> // http://glew.sourceforge.net/
+
+#ifdef _WIN32
+#include <GL/wglew.h>
+#else
+#include <GL/osmesa.h> // https://docs.mesa3d.org/osmesa.html
+#endif
 
 #include <FreeImage.h> // http://freeimage.sourceforge.net/
 
@@ -12,17 +22,73 @@
 
 using namespace glm;
 
+#ifdef _WIN32
+
 #pragma comment(lib, "opengl32.lib")
 #pragma comment(lib, "glu32.lib")
 #pragma comment(lib, "glew32.lib")
 
 #pragma comment(lib, "FreeImage.lib")
 
+#endif
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+void DisplayError(const char *ErrorText);
+void DisplayInfo(const char *InfoText);
+bool DisplayQuestion(const char *QuestionText);
+
 // ----------------------------------------------------------------------------------------------------------------------------
 
-void DisplayError(char *ErrorText);
-void DisplayInfo(char *InfoText);
-bool DisplayQuestion(char *QuestionText);
+extern CString ModuleDirectory, ErrorLog;
+
+extern bool wgl_context_forward_compatible;
+extern int gl_version, gl_max_texture_size, gl_max_texture_max_anisotropy_ext;
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CCommandLine
+{
+public:
+	int Width, Height, Samples, Frames, UploadBudget, TextureBudget, InstancesCount;
+	bool FullScreen, AskFullScreen, TextureCompression, ShaderCache;
+	BC_QUALITY TextureCompressionQuality;
+	float FrameTime;
+	char *ScreenShotFileName, *BenchmarkFileName, *CameraPathFileName, *RecordFileName, *TraceFileName, *MicroBenchmarkName, *VirtualTextureFileName, *AtlasFileName, *MeshFileName;
+
+public:
+	CCommandLine();
+	~CCommandLine();
+
+	bool Parse(int argc, char **argv);
+};
+
+// ----------------------------------------------------------------------------------------------------------------------------
+
+class CTextureImage
+{
+public:
+	FIBITMAP *dib;
+	CPixelConverter Pixels;
+	BYTE *Data;
+	int Width, Height, Pitch;
+	CPixelFormat PixelFormat;
+	CMipmapChain Mipmaps;
+	CCompressedMipmapChain Compressed;
+
+public:
+	CTextureImage();
+	~CTextureImage();
+
+	bool Load(const char *Texture2DFileName, CString &Errors, int SkipLevels = 0, const HASH64 *ContentHash = NULL);
+	bool IsCompressed();
+	int GetLevelsCount();
+	int GetTextureLevelsCount();
+	void Destroy();
+
+protected:
+	void SetCompressed(bool Opaque, int SkipLevels);
+};
 
 // ----------------------------------------------------------------------------------------------------------------------------
 
@@ -30,6 +96,8 @@ class CTexture
 {
 protected:
 	GLuint TextureID;
+	int Width, Height, LevelsCount;
+	GLenum InternalFormat;
 
 public:
 	CTexture();
@@ -38,18 +106,42 @@ public:
 	operator GLuint ();
 
 	void Delete();
-	bool LoadTexture2D(char *Texture2DFileName);
+	bool LoadTexture2D(const char *Texture2DFileName);
+	bool Upload(CTextureImage &Image);
+	void SetTextureID(GLuint TextureID, int Width = 0, int Height = 0, GLenum InternalFormat = GL_RGBA8, int LevelsCount = 1);
+	int GetLevelsCount();
+	long long GetLevelBytes(int Level);
+	long long GetResidentBytes();
+
+	static void SetParameters(CTextureImage &Image);
+	static void GenerateMissingMipmaps(CTextureImage &Image);
 };
 
 // ----------------------------------------------------------------------------------------------------------------------------
 
-class CShaderProgram
+// Load is Begin and End in one, Begin only hands the sources to the driver and End waits for the program; IsReady
+// tells without waiting if End would wait, when the driver compiles in parallel
+
+// the active uniforms are reflected once the program is linked into an open addressing table keyed by the hash of the
+// name, GetUniformLocation(HASH_NAME32("Name")) costs no string work; uniform arrays are found by the name without [0],
+// uniforms in blocks are not in the table
+
+struct CUniformLocation
 {
-public:
-	GLuint *UniformLocations;
+	unsigned int Hash;
+	GLint Location;
+};
 
+class CShaderProgram
+{
 protected:
+	CUniformLocation *UniformLocations;
+	int UniformLocationsMask;
+
 	GLuint VertexShader, FragmentShader, Program;
+	CString Name;
+	HASH64 Key;
+	bool Cacheable, Linked;
 
 public:
 	CShaderProgram();
@@ -58,10 +150,18 @@ public:
 	operator GLuint ();
 
 	void Delete();
-	bool Load(char *VertexShaderFileName, char *FragmentShaderFileName);
+	bool Load(const char *VertexShaderFileName, const char *FragmentShaderFileName, const char *Defines = NULL);
+	bool Begin(const char *Name, const char *VertexShaderSource, int VertexShaderLength, const char *FragmentShaderSource, int FragmentShaderLength);
+	bool IsReady();
+	bool End();
+	GLint GetUniformLocation(unsigned int NameHash);
+
+	static bool IsParallelCompileSupported();
 
 protected:
-	GLuint LoadShader(GLenum Type, char *ShaderFileName);
+	GLuint CreateShader(GLenum Type, const char *Source, int Length);
+	bool CheckShader(GLuint Shader, const char *Type);
+	void Reflect();
 	void SetDefaults();
 };
 
@@ -87,22 +187,64 @@ public:
 	void SetViewMatrixPointer(mat4x4 *View);
 };
 
+extern CCamera Camera;
+
 // ----------------------------------------------------------------------------------------------------------------------------
 
+class CVirtualTexture;
+struct CVirtualTextureStats;
+class CTextureAtlas;
+struct CTextureAtlasStats;
+class CMesh;
+class CInstances;
+struct CInstancesStats;
+class CBVH;
+struct CBVHStats;
+struct CSceneGraphStats;
+
+// with VirtualTextureFileName set before Init the cube shows that image through a virtual texture
+
+// with MeshFileName set before Init an OBJ, PLY or .mesh file is drawn in place of the cube
+
+// with InstancesCount set before Init that many cubes are drawn with instancing
+
+// with AtlasFileName set before Init a small cube is drawn for every image the file lists, the images are packed into
+// atlas pages and the cubes on a page are drawn with one bind and one draw call
+
+// the transforms of the model and the object on it are nodes of the scene graph, which recomputes them only when the
+// model turns
+
+// the instances, the atlas cubes or the cube are kept in a bounding volume hierarchy, a click picks the one under the
+// cursor and outlines its box
+
 class COpenGLRenderer
 {
 protected:
 	int Width, Height;
-	mat4x4 Model, View, Projection;
-
-	CTexture Texture;
-	CShaderProgram Shader;
-
-	vec2 *TexCoords;
-	vec3 *Normals, *Vertices;
+	mat4x4 View, Projection;
+	float Angle;
+	int ModelNode, ObjectNode;
+
+	CTextureHandle Texture;
+	CShaderProgram *Shader;
+	CVirtualTexture *VirtualTexture;
+	CTextureAtlas *Atlas;
+	CMesh *Cube, *Mesh;
+	mat4x4 MeshTransform;
+	CInstances *Instances;
+	CBVH *Scene;
+	vec3 *SceneMins, *SceneMaxs;
+	int PickedObject;
+	int AxisGridBatch;
+
+	CMesh *AtlasCubes;
+	GLuint AtlasLayerBuffer;
+	int *AtlasBatches, AtlasBatchesCount;
 
 public:
 	bool ShowAxisGrid, Stop;
+	char *VirtualTextureFileName, *AtlasFileName, *MeshFileName;
+	int InstancesCount;
 
 public:
 	COpenGLRenderer();
@@ -111,31 +253,62 @@ public:
 	bool Init();
 	void Render(float FrameTime);
 	void Resize(int Width, int Height);
+	bool GetVirtualTextureStats(CVirtualTextureStats &Stats);
+	bool GetAtlasStats(CTextureAtlasStats &Stats);
+	bool GetInstancesStats(CInstancesStats &Stats);
+	bool GetSceneStats(CBVHStats &Stats);
+	bool GetSceneGraphStats(CSceneGraphStats &Stats);
+	int Pick(int x, int y);
 	void Destroy();
+
+protected:
+	void RenderCube();
+	bool LoadMesh(const char *FileName);
+	void InitAtlasCubes();
+	void RenderAtlasCubes();
+	void InitInstances();
+	void InitAxisGrid();
+	void InitScene();
+	void UpdateScene(const mat4x4 &ObjectModel);
 };
 
+extern COpenGLRenderer OpenGLRenderer;
+
 // ----------------------------------------------------------------------------------------------------------------------------
 
 class CWnd
 {
 protected:
-	char *WindowName;
+	const char *WindowName;
 	bool FullScreen, DeFullScreened;
+	int Samples;
+	int Width, Height, WidthD2, HeightD2;
+	double Start, Begin;
+	bool MouseGameMode, KeyBoardFocus, MouseFocus;
+
+#ifdef _WIN32
 	DEVMODE DevMode;
 	HWND hWnd;
 	HDC hDC;
-	int Samples;
 	HGLRC hGLRC;
-	int Width, Height, WidthD2, HeightD2;
-	DWORD Start, Begin;
 	POINT LastCurPos;
-	bool MouseGameMode, KeyBoardFocus, MouseFocus;
+#else
+	OSMesaContext Context;
+	BYTE *FrameBuffer;
+	int Frames;
+	float FrameTime;
+#endif
 
 public:
 	CWnd();
 	~CWnd();
 
-	bool Create(HINSTANCE hInstance, char *WindowName, int Width, int Height, bool FullScreen = false, int Samples = 4, bool CreateForwardCompatibleContext = false, bool DisableVerticalSynchronization = true);
+#ifdef _WIN32
+	bool Create(HINSTANCE hInstance, const char *WindowName, int Width, int Height, bool FullScreen = false, int Samples = 4, bool CreateForwardCompatibleContext = false, bool DisableVerticalSynchronization = true);
+#else
+	bool Create(const char *WindowName, int Width, int Height, int Frames = 1, float FrameTime = 0.016f);
+	bool SaveScreenShot(char *ScreenShotFileName);
+#endif
 	void Show(bool MouseGameMode = false, bool Maximized = false);
 	void MsgLoop();
 	void Destroy();
@@ -159,7 +332,13 @@ public:
 	void OnSize(int sx, int sy);
 };
 
+extern CWnd Wnd;
+
 // ----------------------------------------------------------------------------------------------------------------------------
 
+#ifdef _WIN32
 LRESULT CALLBACK WndProc(HWND hWnd, UINT uiMsg, WPARAM wParam, LPARAM lParam);
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR sCmdLine, int iShow);
+#else
+int main(int argc, char **argv);
+#endif